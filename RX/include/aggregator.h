@@ -0,0 +1,126 @@
+#pragma once
+
+#ifndef _AGGREGATOR_H_
+#define _AGGREGATOR_H_
+
+#include <stdint.h>
+#include "radio.h"
+#include "packet_schema.h"
+
+/*
+ * Aggregation of small messages (AGGREGATE in the mains).  A telemetry
+ * message of a few bytes in a payload of its own pays the whole packet and
+ * its ACK on the air for it; instead the sender packs the messages of every
+ * flow into one payload, each behind a one byte sub-header, and sends it
+ * when it is full or when the message that can wait least in it is due.
+ * Each flow has its own deadline, 0 sends its messages right away.  The
+ * receiver splits the payload back into the messages.
+ *
+ *  payload:      AGGREGATE_CHAR, then messages until a zero sub-header
+ *  message:      AggregateHeader, then its bytes
+ */
+
+#define AGGREGATE_PAYLOAD_BYTES 32    // size of FIFO in bytes, as FIFO_SIZE_BYTES
+#define AGGREGATE_CHAR '&'            // first byte of an aggregate, never one of a hex file
+#define AGGREGATE_FLOW_BITS 3
+#define AGGREGATE_LENGTH_BITS 5
+#define AGGREGATE_FLOWS (1 << AGGREGATE_FLOW_BITS)
+#define AGGREGATE_MAX_MESSAGE (AGGREGATE_PAYLOAD_BYTES - 2)  // past the mark and a sub-header
+#define AGGREGATE_DEADLINE_US 10000   // of a flow not given its own
+
+/* sub-header of a message, the length in the low bits and its flow above */
+typedef PacketField<0, AGGREGATE_LENGTH_BITS> AggregateLength;
+typedef PacketFieldAfter<AggregateLength, AGGREGATE_FLOW_BITS> AggregateFlow;
+typedef PacketLayout<AGGREGATE_PAYLOAD_BYTES - 1, AggregateLength, AggregateFlow> AggregateHeader;
+
+static_assert(AggregateHeader::BYTES == 1, "a sub-header is a byte");
+static_assert(AggregateLength::MAX >= AGGREGATE_MAX_MESSAGE, "a length fits any message");
+
+
+/*
+ * Hands over a message split out of an aggregate
+ */
+typedef void (*aggregate_deliver_f)(void * ctx, uint8_t flow, const char * message, uint8_t size);
+
+
+/*
+ * Function splitAggregate() hands every message of an aggregate to `deliver'
+ *
+ * Params:
+ *  payload:
+ *    AGGREGATE_PAYLOAD_BYTES, starting with AGGREGATE_CHAR
+ *
+ * Outputs:
+ *  the number of messages, none if a sub-header runs past the payload
+ */
+uint8_t splitAggregate(const char * payload, aggregate_deliver_f deliver, void * ctx);
+
+
+/*
+ * Aggregator packs messages into payloads and writes them to the receiver
+ */
+class Aggregator
+{
+public:
+  Aggregator(Radio & radio);
+
+  /*
+   * Function begin() drops any messages still waiting and gives every flow
+   * AGGREGATE_DEADLINE_US
+   */
+  void begin(void);
+
+  /*
+   * Function setDeadline() is the longest a message of `flow' waits for
+   * others to share its payload
+   */
+  void setDeadline(uint8_t flow, uint32_t deadline_us);
+
+  /*
+   * Function add() queues a message, sending the payload first if the
+   * message does not fit in it, and after if it is full or due
+   *
+   * Params:
+   *  flow:
+   *    below AGGREGATE_FLOWS
+   *  size:
+   *    1 to AGGREGATE_MAX_MESSAGE
+   *
+   * Outputs:
+   *  false if the message was not taken
+   */
+  bool add(uint8_t flow, const char * message, uint8_t size);
+
+  /*
+   * Function poll() sends the payload once its earliest deadline is past,
+   * call it often
+   */
+  void poll(void);
+
+  /*
+   * Function flush() sends what is queued now
+   */
+  void flush(void);
+
+  /*
+   * Getters for the counts since begin(): the payloads sent, the messages in
+   * them and the messages in the payloads the receiver never acknowledged
+   */
+  uint32_t getPayloads(void);
+  uint32_t getMessages(void);
+  uint32_t getLost(void);
+
+private:
+  Radio & radio;
+  char payload[AGGREGATE_PAYLOAD_BYTES];
+  uint8_t fill {1};
+  uint8_t queued {0};
+  uint32_t due {0};
+  uint32_t deadlines[AGGREGATE_FLOWS];
+
+  uint32_t payloads {0};
+  uint32_t messages {0};
+  uint32_t lost {0};
+};
+
+#endif /* _AGGREGATOR_H_ */
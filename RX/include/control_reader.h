@@ -0,0 +1,106 @@
+#pragma once
+
+#ifndef _CONTROL_READER_H_
+#define _CONTROL_READER_H_
+
+#include <stdint.h>
+#include "serial_io.h"
+
+#define CONTROL_ESCAPE '}'        // leads an escaped data byte, with a matching counterpart in Python
+#define CONTROL_ESCAPE_XOR 0x20   // an escaped byte is sent xored with this
+#define CONTROL_HOLD_BYTES 256    // data kept while looking ahead for a command, more than a chunk
+#define CONTROL_NONE 0            // no command came in
+
+
+/*
+ * Reads the next byte the computer sent
+ *
+ * Params:
+ *  ctx:
+ *    what was given to the ControlReader
+ *
+ * Outputs:
+ *  the byte, or -1 if none is waiting
+ */
+typedef int (*control_read_f)(void * ctx);
+
+
+/*
+ * ControlReader splits what the computer sends into data and control
+ * commands.  Data never holds TX_CHAR: the computer sends it, and
+ * CONTROL_ESCAPE, as CONTROL_ESCAPE then the byte xored with
+ * CONTROL_ESCAPE_XOR.  So an unescaped TX_CHAR always starts a command,
+ * wherever it lands in a write, and the byte after the run of TX_CHAR is
+ * the command.  Nothing waits on the at_cmd interrupt to tell them apart;
+ * the interrupt only wakes the loops that do not read serial.
+ *
+ * Data that comes in ahead of a command while such a loop looks for it is
+ * held, and read before anything that follows the command.
+ */
+class ControlReader
+{
+public:
+  ControlReader(control_read_f read, void * ctx);
+
+  /*
+   * Function available() tells whether a data byte can be read.  It is
+   * false while a command is in and no data came before it, so callers
+   * reading data check command() when it is.
+   */
+  bool available(void);
+
+  /*
+   * Function read() takes the next data byte
+   *
+   * Outputs:
+   *  the byte, or -1 if none is available()
+   */
+  int read(void);
+
+  /*
+   * Function seekCommand() reads ahead for a command, holding the data
+   * before it, as long as there is room
+   *
+   * Outputs:
+   *  true once a command is in
+   */
+  bool seekCommand(void);
+
+  /*
+   * Getter for the command that came in, CONTROL_NONE if none did
+   */
+  char command(void);
+
+  /*
+   * Function takeCommand() returns the command that came in and clears it,
+   * so the data after it can be read
+   */
+  char takeCommand(void);
+
+  /*
+   * Function clear() drops the data held, for a transfer that was given up
+   */
+  void clear(void);
+
+private:
+  control_read_f source;
+  void * ctx;
+
+  uint8_t held[CONTROL_HOLD_BYTES];
+  uint16_t head {0};
+  uint16_t count {0};
+
+  char pending {CONTROL_NONE};
+  bool escaped {false};
+  bool at_chars {false};
+
+  /*
+   * Takes one byte from the computer, into held if it is data
+   *
+   * Outputs:
+   *  false if none was waiting
+   */
+  bool pull(void);
+};
+
+#endif /* _CONTROL_READER_H_ */
@@ -0,0 +1,93 @@
+#pragma once
+
+#ifndef _LATENCY_HISTOGRAM_H_
+#define _LATENCY_HISTOGRAM_H_
+
+#include <stdint.h>
+
+/*
+ * Buckets are log spaced as in an HDR histogram: every power of two is split
+ * into LATENCY_SUB_BUCKETS linear buckets, so a bucket is at most 1/16 of
+ * its value wide whatever the delay, and all of 32 bit microseconds fits
+ * in LATENCY_BUCKETS counters (under 2 KB).
+ */
+#define LATENCY_SUB_BITS 4
+#define LATENCY_SUB_BUCKETS (1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS ((32 - LATENCY_SUB_BITS + 1) * LATENCY_SUB_BUCKETS)
+#define LATENCY_DUMP_END '\t'      // ends a dump, as HANDSHAKE_CHAR
+
+
+/*
+ * LatencyHistogram counts one-way delays in fixed memory, so the tail of
+ * a transfer of any length can be read off it.
+ */
+class LatencyHistogram
+{
+public:
+  LatencyHistogram();
+
+  /*
+   * Function record() counts one delay
+   *
+   * Params:
+   *  us:
+   *    the delay in microseconds
+   */
+  void record(uint32_t us);
+
+  /*
+   * Function merge() adds every delay counted by `other'
+   */
+  void merge(const LatencyHistogram & other);
+
+  /*
+   * Function percentile() finds the delay `q' of the delays are at or below
+   *
+   * Params:
+   *  q:
+   *    0-1, 0.99 for the 99th percentile
+   *
+   * Outputs:
+   *  the top of the bucket the delay fell in, 0 with nothing counted
+   */
+  uint32_t percentile(float q) const;
+
+  /*
+   * Getters for the delays counted, the shortest and the longest
+   */
+  uint32_t getCount(void) const;
+  uint32_t getMin(void) const;
+  uint32_t getMax(void) const;
+
+  /*
+   * Getter for the delays counted in a bucket
+   */
+  uint32_t getBucket(uint16_t bucket) const;
+
+  /*
+   * Function clear() drops every delay
+   */
+  void clear(void);
+
+  /*
+   * Function dump() prints a "count,min,p50,p99,p999,max" line, then one
+   * "top_us,count" line per bucket that counted anything, then a
+   * LATENCY_DUMP_END to indicate that the transmission is over
+   */
+  void dump(void) const;
+
+  /*
+   * Functions bucketOf() and bucketTop() map a delay to its bucket and a
+   * bucket to the longest delay it holds
+   */
+  static uint16_t bucketOf(uint32_t us);
+  static uint32_t bucketTop(uint16_t bucket);
+
+private:
+  uint32_t counts[LATENCY_BUCKETS];
+  uint32_t count {0};
+  uint32_t min {0};
+  uint32_t max {0};
+};
+
+#endif /* _LATENCY_HISTOGRAM_H_ */
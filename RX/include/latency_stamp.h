@@ -0,0 +1,114 @@
+#pragma once
+
+#ifndef _LATENCY_STAMP_H_
+#define _LATENCY_STAMP_H_
+
+#include <stdint.h>
+#include "radio.h"
+#include "packet_schema.h"
+
+/*
+ * One-way latency of the lockstep transfer (LATENCY_STAMP in the mains).
+ * Every payload then carries the time it went on the air in its last
+ * LATENCY_STAMP_BYTES, in the receiver's clock, and the receiver takes
+ * the delay off its own clock when it reads the payload.
+ *
+ * The clocks are aligned by a handshake over the air before every file:
+ * the sender sends LATENCY_SYNC_CHAR payloads with its time, the receiver
+ * answers each with the time it got it and the time it answered, and the
+ * exchange with the shortest round trip gives the offset, as NTP does.
+ */
+
+#define LATENCY_PAYLOAD_BYTES 32    // size of FIFO in bytes, as FIFO_SIZE_BYTES
+#define LATENCY_ADDRESS_BYTES 4     // address width, as ADDRESS_BYTES
+#define LATENCY_STAMP_BYTES 4
+#define LATENCY_STAMP_OFFSET (LATENCY_PAYLOAD_BYTES - LATENCY_STAMP_BYTES)
+#define LATENCY_FILE_BYTES LATENCY_STAMP_OFFSET  // file bytes left in a stamped payload
+#define LATENCY_READING_PIPE 1      // pipe 0 takes the ACK address of whatever we write
+
+typedef PacketField<8 * LATENCY_STAMP_OFFSET, 8 * LATENCY_STAMP_BYTES> LatencyStamp;
+
+/*
+ * Sync payload, sender -> receiver: LATENCY_SYNC_CHAR, the round, the
+ * address to answer to and the sender's time.  The answer echoes the
+ * round and the sender's time and adds the receiver's times.
+ */
+#define LATENCY_SYNC_CHAR '{'       // not hex, not the END_CHAR of a file
+#define LATENCY_ROUND_OFFSET 1
+#define LATENCY_REPLY_OFFSET 2      // LATENCY_ADDRESS_BYTES
+#define LATENCY_SENT_OFFSET 6       // sender's time
+#define LATENCY_GOT_OFFSET 10       // receiver's time on receipt
+#define LATENCY_ANSWERED_OFFSET 14  // receiver's time as it answered
+
+/* the reply address goes in as bytes, as radio.openWritingPipe() takes it */
+typedef PacketField<8 * LATENCY_ROUND_OFFSET, 8> LatencyRound;
+typedef PacketField<8 * LATENCY_SENT_OFFSET, 32> LatencySent;
+typedef PacketFieldAfter<LatencySent, 32> LatencyGot;
+typedef PacketFieldAfter<LatencyGot, 32> LatencyAnswered;
+typedef PacketLayout<LATENCY_PAYLOAD_BYTES, LatencyRound, LatencySent, LatencyGot, LatencyAnswered> LatencySync;
+
+#define LATENCY_SYNC_ROUNDS 8
+#define LATENCY_SYNC_TIMEOUT_US 10000 // wait for an answer, a round trip at 250 kbps is 4 ms
+
+
+/*
+ * LatencyClock keeps the sender's view of the receiver's clock and stamps
+ * payloads with it
+ */
+class LatencyClock
+{
+public:
+  LatencyClock(Radio & radio);
+
+  /*
+   * Function sync() aligns with the receiver's clock, leaving the radio a
+   * transmitter to `receiver' again
+   *
+   * Params:
+   *  address, receiver:
+   *    our address and the receiver's, LATENCY_ADDRESS_BYTES
+   *
+   * Outputs:
+   *  false if the receiver never answered; the last offset is kept
+   */
+  bool sync(uint8_t * address, uint8_t * receiver);
+
+  /*
+   * Function stamp() writes the receiver's time into a payload about to go
+   * on the air, at LATENCY_STAMP_OFFSET
+   */
+  void stamp(char * payload);
+
+  /*
+   * Getters for the receiver's clock less ours, and the round trip of the
+   * exchange it came from; the offset is off by at most half of it
+   */
+  int32_t getOffset(void);
+  uint32_t getRoundTrip(void);
+
+private:
+  Radio & radio;
+  int32_t offset {0};
+  uint32_t round_trip {0};
+};
+
+
+/*
+ * Function answerLatencySync() answers a sync payload the receiver just
+ * read, then goes back to listening on `address' (pipe 0)
+ *
+ * Params:
+ *  payload:
+ *    the sync payload
+ *  got:
+ *    micros() when it was read
+ */
+void answerLatencySync(Radio & radio, const char * payload, uint32_t got, uint8_t * address);
+
+/*
+ * Function latencyOf() takes the one-way delay of a stamped payload the
+ * receiver read at `got', negative if the clocks drifted apart
+ */
+int32_t latencyOf(const char * payload, uint32_t got);
+
+#endif /* _LATENCY_STAMP_H_ */
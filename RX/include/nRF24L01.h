@@ -276,6 +276,26 @@
 #define RF_PWR_0 1
 #define RF_PWR_1 2
 
+/*
+ * PIN definitions of FEATURE (0x1D) register
+ */
+
+/*
+ * Enables the W_TX_PAYLOAD_NO_ACK command. Without it the chip
+ * silently ignores payloads written with that command.
+ */
+#define EN_DYN_ACK 0
+
+/*
+ * Enables payloads on ACK packets
+ */
+#define EN_ACK_PAY 1
+
+/*
+ * Enables dynamic payload length
+ */
+#define EN_DPL 2
+
 #define SPI_SETTINGS SPISettings(SPI_FRQ, MSBFIRST, SPI_MODE0)
 
 
@@ -292,6 +312,9 @@
  */
 #define REGISTER_MASK 0x1F
 
+/* times the driver's private SPI calls, see micro_bench.h */
+class MicroBench;
+
 /*
  *  The module uses a packet structure called Enhanced ShockBurst.
  *  This structure is broken down into 5 fields. 
@@ -376,12 +399,35 @@ namespace nRF24Module {
         DATA_RATE_2MBPS = 0b00001000,
         DATA_RATE_250KBPS = 0b00100000,
     };
+
+    /* RF_PWR_1:0 of RF_SETUP */
+    enum pa_level
+    {
+        PA_LEVEL_MIN = 0b00000000,  // -18 dBm
+        PA_LEVEL_LOW = 0b00000010,  // -12 dBm
+        PA_LEVEL_HIGH = 0b00000100, // -6 dBm
+        PA_LEVEL_MAX = 0b00000110,  // 0 dBm
+    };
     
     class nRF24 
     {
+        friend class ::MicroBench;
+
     public:
         nRF24(uint8_t cePin, uint8_t csnPin);
 
+        /*
+         *  begin
+         *
+         *  Description:
+         *      Sets up the pins and SPI and resets the module to
+         *      standby with the defaults below, so that the user can
+         *      configure it. Nothing touches the module before it, so
+         *      a global can be constructed before the board is up;
+         *      calling it again resets the module the same way.
+         */
+        void begin();
+
         /*
          *  readSPI
          *  
@@ -411,8 +457,46 @@ namespace nRF24Module {
          *      
          *      This is done by sending one byte at a time
          *      until the FIFO is full 
+         *
+         *      Returns whether the payload was acknowledged. Without
+         *      auto acknowledgement (see setAutoAck) it is always true.
+         */
+        bool writeSPI(char * arr, uint32_t size);   
+
+        /*
+         *  writeFastSPI
+         *  
+         *  args: 
+         *      arr (char *)
+         *      size (uint32_t)
+         * 
+         *  Description:
+         *      Queues `size' bytes from the buffer `arr' in the TX FIFO
+         *      and leaves CE high instead of dropping it after the
+         *      payload. While the FIFO is fed faster than it drains the
+         *      module stays in TX and each payload follows the one before
+         *      without the 130 micro second PLL settling; once it drains
+         *      the module idles in standby-II.
+         *
+         *      Blocks only while the FIFO is full. Returns false if a
+         *      payload queued earlier hit MAX_RT, which flushes the FIFO
+         *      and so also drops the payloads queued behind it. End the
+         *      burst with txStandBy.
+         */
+        bool writeFastSPI(char * arr, uint32_t size);
+
+        /*
+         *  txStandBy
+         *  
+         *  args:
+         *      none.
+         *  
+         *  Description:
+         *      Waits for the payloads queued by writeFastSPI to go out,
+         *      then drops CE back to standby-I. Returns false if one of
+         *      them hit MAX_RT.
          */
-        void writeSPI(char * arr, uint32_t size);   
+        bool txStandBy();
 
         /*
          *  flushTXPayload
@@ -570,6 +654,59 @@ namespace nRF24Module {
          */
         void setDataRate(data_rate rate);
 
+        /*
+         *  setPALevel
+         *
+         *  args:
+         *      level (pa_level)
+         *
+         *  Description:
+         *      Sets the TX output power, one of
+         *      { PA_LEVEL_MIN, PA_LEVEL_LOW, PA_LEVEL_HIGH, PA_LEVEL_MAX }
+         */
+        void setPALevel(pa_level level);
+
+        /*
+         *  setRetries
+         *
+         *  args:
+         *      delay (uint8_t)
+         *      count (uint8_t)
+         *
+         *  Description:
+         *      Sets how long to wait for an ACK, (delay + 1) * 250
+         *      micro seconds, and how many times to retransmit before
+         *      giving up. Both are 0-15. Only used with auto
+         *      acknowledgement.
+         */
+        void setRetries(uint8_t delay, uint8_t count);
+
+        /*
+         *  setAutoAck
+         *
+         *  args:
+         *      enable (bool)
+         *
+         *  Description:
+         *      With auto acknowledgement writeSPI asks the receiver for
+         *      an ACK and retransmits until it gets one, otherwise every
+         *      payload is sent once. Off by default. The receiver
+         *      acknowledges either way.
+         */
+        void setAutoAck(bool enable);
+
+        /*
+         *  getARC
+         *
+         *  args:
+         *      none.
+         *
+         *  Description:
+         *      Returns how many retransmits the last payload took
+         *      (ARC_CNT in OBSERVE_TX).
+         */
+        uint8_t getARC();
+
         /*
          *  txFIFOEmpty
          *  
@@ -598,6 +735,20 @@ namespace nRF24Module {
          */
         bool txFIFOFull();
 
+        /*
+         *  carrierDetected
+         *
+         *  args:
+         *      none.
+         *
+         *  Description:
+         *      Returns whether the received power detector (RPD, the CD
+         *      register) sees a signal above -64 dBm on the current channel.
+         *      Only meaningful after the module has been a receiver for at
+         *      least 170 micro seconds.
+         */
+        bool carrierDetected();
+
         uint8_t status();
 
     private:
@@ -605,8 +756,22 @@ namespace nRF24Module {
         uint8_t csnPin_;
         uint8_t addressWidth_;        
         bool txMode_;
+        bool autoAck_;
 
         data_frame_u makeFrame(uint8_t cmd, byte data);
+
+        /*
+         *  uploadPayload
+         *  
+         *  args:
+         *      arr (char *)
+         *      size (uint32_t)
+         *  
+         *  Description:
+         *      Writes `size' bytes from `arr' into the TX FIFO, padded
+         *      to a full FIFO, without touching CE.
+         */
+        void uploadPayload(char * arr, uint32_t size);
         
         /*
          *  setRegister
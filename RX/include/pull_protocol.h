@@ -0,0 +1,72 @@
+#pragma once
+
+#ifndef _PULL_PROTOCOL_H_
+#define _PULL_PROTOCOL_H_
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * Receiver driven pull of a file that several TX boards hold copies of
+ * (PULL_MODE in the mains).  The file is cut into blocks of
+ * PULL_BLOCK_BYTES; the RX board asks every source for a range of blocks
+ * (PullClient) and each source sends the blocks of its range, every one
+ * tagged with its index (PullServer).  All sources share the receiver's
+ * channel, each under its own address.
+ */
+
+#define PULL_PAYLOAD_BYTES 32       // size of FIFO in bytes, as FIFO_SIZE_BYTES
+#define PULL_ADDRESS_BYTES 4        // address width, as ADDRESS_BYTES
+#define PULL_INDEX_BYTES 4          // block index in front of every data payload
+#define PULL_BLOCK_BYTES (PULL_PAYLOAD_BYTES - PULL_INDEX_BYTES)
+#define PULL_READING_PIPE 1         // pipe 0 takes the ACKs of whatever we write
+#define PULL_FETCH_BLOCKS 8         // blocks a source fetches from its computer at once
+
+/* request payload, RX -> source */
+#define PULL_REQUEST 'q'
+#define PULL_TYPE_OFFSET 0
+#define PULL_FIRST_OFFSET 1         // first block of the range, 4 bytes
+#define PULL_COUNT_OFFSET 5         // blocks in the range, 4 bytes, 0 to stop
+#define PULL_REPLY_OFFSET 9         // address to send the blocks to
+
+/*
+ * Block index of the file's description, which a source sends when asked
+ * for it (as the only block of a range): the file size, then its extension
+ */
+#define PULL_INFO_BLOCK 0xFFFFFFFF
+#define PULL_INFO_SIZE_OFFSET 0     // 4 bytes
+#define PULL_INFO_EXTENSION_OFFSET 4
+#define PULL_INFO_EXTENSION_BYTES 10  // as EXTENSION_BYTES
+
+/*
+ * Between the boards and their computers (serve_file.py, pull_file.py).
+ * TX asks for blocks with PULL_FETCH_CHAR and the first one's index (4
+ * bytes), and gets PULL_FETCH_BLOCKS of them back.  RX hands up the file's
+ * size and extension after PULL_INFO_CHAR, every block after
+ * PULL_BLOCK_CHAR (offset, 4 bytes, size, 1 byte, then the data) and the
+ * blocks and new blocks of every source after PULL_DONE_CHAR (4 bytes each)
+ */
+#define PULL_FETCH_CHAR 'f'
+#define PULL_INFO_CHAR 'i'
+#define PULL_BLOCK_CHAR 'b'
+#define PULL_DONE_CHAR 'd'
+
+
+/*
+ * Little endian 32 bit numbers in payloads, same layout as uint32_serial_u
+ */
+static inline void
+pullPut32(char * at, uint32_t value)
+{
+  for (uint8_t i = 0; i < 4; ++i) at[i] = (char) ((value >> (8 * i)) & 0xff);
+}
+
+static inline uint32_t
+pullGet32(const char * at)
+{
+  uint32_t value {0};
+  for (uint8_t i = 0; i < 4; ++i) value |= (uint32_t) (uint8_t) at[i] << (8 * i);
+  return value;
+}
+
+#endif /* _PULL_PROTOCOL_H_ */
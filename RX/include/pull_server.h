@@ -0,0 +1,82 @@
+#pragma once
+
+#ifndef _PULL_SERVER_H_
+#define _PULL_SERVER_H_
+
+#include <stdint.h>
+#include "radio.h"
+#include "pull_protocol.h"
+
+
+/*
+ * Fetches a block of the file
+ *
+ * Params:
+ *  ctx:
+ *    what was given to PullServer::begin()
+ *  block:
+ *    index of the block
+ *  data:
+ *    where to put its PULL_BLOCK_BYTES bytes, zero padded past the end
+ *
+ * Outputs:
+ *  false if it could not be read
+ */
+typedef bool (*pull_read_f)(void * ctx, uint32_t block, char * data);
+
+
+/*
+ * PullServer is a source of a pull (see pull_protocol.h): it listens on
+ * its address for requests and sends the blocks of the latest range asked
+ * for, going back to listening between blocks so the receiver can change
+ * the range at any time.
+ */
+class PullServer
+{
+public:
+  PullServer(Radio & radio);
+
+  /*
+   * Function begin() starts listening for requests for a file
+   *
+   * Params:
+   *  address:
+   *    our address, PULL_ADDRESS_BYTES
+   *  size, extension:
+   *    the file's size and extension, for PULL_INFO_BLOCK
+   *  read, ctx:
+   *    where the blocks come from
+   */
+  void begin(uint8_t * address, uint32_t size, const char * extension, pull_read_f read, void * ctx);
+
+  /*
+   * Function poll() takes in a request if one came in
+   *
+   * Outputs:
+   *  whether there is a block to send
+   */
+  bool poll(void);
+
+  /*
+   * Function sendNext() sends the next block of the range and goes back to
+   * listening
+   *
+   * Outputs:
+   *  whether the receiver acked it
+   */
+  bool sendNext(void);
+
+private:
+  Radio & radio;
+  uint8_t address[PULL_ADDRESS_BYTES];
+  uint8_t reply[PULL_ADDRESS_BYTES];
+  uint32_t size {0};
+  char extension[PULL_INFO_EXTENSION_BYTES];
+  pull_read_f read {nullptr};
+  void * ctx {nullptr};
+  /* what is left of the range asked for */
+  uint32_t next {0};
+  uint32_t left {0};
+};
+
+#endif /* _PULL_SERVER_H_ */
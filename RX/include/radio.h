@@ -0,0 +1,165 @@
+/*
+ *  Radio is what the mains talk to instead of a particular nRF24L01+
+ *  driver, so the third-party RF24 library and our own nRF24Module
+ *  driver can be swapped (RADIO_BACKEND in main.cpp) and compared
+ *  (RADIO_BENCHMARK in the TX main).
+ *
+ *  The calls mirror the subset of RF24 the mains use, with its
+ *  semantics: payloads are acknowledged and retransmitted, and write()
+ *  blocks until the payload is acknowledged or given up on.
+ */
+
+#pragma once
+
+#ifndef _RADIO_H_
+#define _RADIO_H_
+
+#include <stdint.h>
+
+/* values of RADIO_BACKEND */
+#define RADIO_RF24 0     // third-party RF24 library
+#define RADIO_NRF24 1    // in-house nRF24Module driver
+
+typedef enum
+{
+    RADIO_250KBPS,
+    RADIO_1MBPS,
+    RADIO_2MBPS,
+} radio_data_rate_e;
+
+typedef enum
+{
+    RADIO_PA_MIN,
+    RADIO_PA_LOW,
+    RADIO_PA_HIGH,
+    RADIO_PA_MAX,
+} radio_pa_level_e;
+
+class Radio
+{
+public:
+    virtual ~Radio() {}
+
+    /*
+     *  begin
+     *
+     *  args:
+     *      none.
+     *
+     *  Description:
+     *      Resets the module to the backend's defaults. Everything else
+     *      has to be set up again afterwards.
+     */
+    virtual void begin() = 0;
+
+    virtual void setAddressWidth(uint8_t aw) = 0;
+    virtual void setChannel(uint8_t channel) = 0;
+    virtual void setDataRate(radio_data_rate_e rate) = 0;
+    virtual void setPALevel(radio_pa_level_e level) = 0;
+
+    /*
+     *  setRetries
+     *
+     *  args:
+     *      delay (uint8_t)
+     *      count (uint8_t)
+     *
+     *  Description:
+     *      Waits (delay + 1) * 250 micro seconds for an ACK and
+     *      retransmits up to `count' times. Both are 0-15.
+     */
+    virtual void setRetries(uint8_t delay, uint8_t count) = 0;
+
+    /*
+     *  setAutoAck
+     *
+     *  args:
+     *      enable (bool)
+     *
+     *  Description:
+     *      Turns ACKs off (and with them retransmits) on every pipe, for
+     *      senders that recover losses themselves. write() then returns
+     *      true once the payload is out. Both ends must agree.
+     */
+    virtual void setAutoAck(bool enable) = 0;
+
+    virtual void openWritingPipe(uint8_t * address) = 0;
+    virtual void openReadingPipe(uint8_t pipe, uint8_t * address) = 0;
+    virtual void startListening() = 0;
+    virtual void stopListening() = 0;
+
+    /*
+     *  write
+     *
+     *  args:
+     *      buf (const void *)
+     *      len (uint8_t)
+     *
+     *  Description:
+     *      Sends `len' bytes, padded to a full FIFO, and returns whether
+     *      they were acknowledged.
+     */
+    virtual bool write(const void * buf, uint8_t len) = 0;
+
+    /*
+     *  writeFast
+     *
+     *  args:
+     *      buf (const void *)
+     *      len (uint8_t)
+     *
+     *  Description:
+     *      Queues `len' bytes, padded to a full FIFO, and keeps the
+     *      module transmitting (CE high) instead of returning to
+     *      standby-I after the payload, so payloads written faster than
+     *      they go out follow each other without PLL settling. Blocks
+     *      only while the TX FIFO is full, and returns false if a
+     *      payload queued before it was given up on.
+     *
+     *      txStandBy() ends the burst. write(), startListening(),
+     *      stopListening() and openWritingPipe() end it as well, without
+     *      telling whether its last payloads got across.
+     */
+    virtual bool writeFast(const void * buf, uint8_t len) = 0;
+
+    /*
+     *  txStandBy
+     *
+     *  args:
+     *      none.
+     *
+     *  Description:
+     *      Waits for the payloads queued by writeFast() to go out and
+     *      returns to standby-I. Returns false if one was given up on.
+     */
+    virtual bool txStandBy() = 0;
+
+    /*
+     *  available
+     *
+     *  args:
+     *      none.
+     *
+     *  Description:
+     *      Returns whether a received payload is waiting in the RX FIFO.
+     *      Costs exactly one SPI transaction on both backends.
+     */
+    virtual bool available() = 0;
+
+    virtual void read(void * buf, uint8_t len) = 0;
+
+    /*
+     *  getARC
+     *
+     *  args:
+     *      none.
+     *
+     *  Description:
+     *      Retransmits the last write() took.
+     */
+    virtual uint8_t getARC() = 0;
+
+    virtual const char * name() = 0;
+};
+
+#endif /* _RADIO_H_ */
@@ -0,0 +1,113 @@
+#pragma once
+
+#ifndef _RENDEZVOUS_H_
+#define _RENDEZVOUS_H_
+
+#include <stdint.h>
+#include "radio.h"
+#include "packet_schema.h"
+
+/*
+ * Pairing over the air (RENDEZVOUS in the mains).  An idle receiver
+ * listens on the discovery channel and address, which every board knows,
+ * instead of a configured link.  The sender invites it onto the sender's
+ * own link there, then both move over:
+ *
+ *  TX -> RX  invite, on discovery:  RENDEZVOUS_CHAR, RENDEZVOUS_INVITE,
+ *                                   channel, address, nonce
+ *  RX -> TX  join, on the link:     RENDEZVOUS_CHAR, RENDEZVOUS_JOIN,
+ *                                   channel, address, nonce, receiver nonce
+ *  TX -> RX  welcome, on the link:  the join, RENDEZVOUS_WELCOME, sent to
+ *                                   the receiver nonce as an address
+ *
+ * Every idle receiver hears an invite, so invites are not acknowledged
+ * and the sender welcomes only the first join, at its receiver nonce; the
+ * others time out and go back to listening.  The join goes to the link's address turned
+ * around, as the other answers of the mains do, and proves the receiver
+ * made it across.  The sender keeps inviting until a receiver is welcomed,
+ * so either board may start first.
+ */
+
+#define RENDEZVOUS_PAYLOAD_BYTES 32    // size of FIFO in bytes, as FIFO_SIZE_BYTES
+#define RENDEZVOUS_ADDRESS_BYTES 4     // address width, as ADDRESS_BYTES
+#define RENDEZVOUS_READING_PIPE 1      // pipe 0 takes the ACK address of whatever we write
+
+/* above Wi-Fi channel 11 and the band sim/scripts/plan_site.py plans in */
+#define RENDEZVOUS_CHANNEL 81
+
+#define RENDEZVOUS_CHAR '^'            // not hex, not END_CHAR or another handshake
+#define RENDEZVOUS_TYPE_OFFSET 1
+#define RENDEZVOUS_CHANNEL_OFFSET 2
+#define RENDEZVOUS_LINK_OFFSET 3       // RENDEZVOUS_ADDRESS_BYTES
+#define RENDEZVOUS_NONCE_OFFSET 7      // 4 bytes, tells the joins of one invite from the last
+#define RENDEZVOUS_JOINER_OFFSET 11    // 4 bytes, the receiver's address until it is welcomed
+
+/* the link address goes in as bytes, as radio.openWritingPipe() takes it */
+typedef PacketField<8 * RENDEZVOUS_TYPE_OFFSET, 8> RendezvousType;
+typedef PacketField<8 * RENDEZVOUS_CHANNEL_OFFSET, 8> RendezvousChannel;
+typedef PacketField<8 * RENDEZVOUS_NONCE_OFFSET, 32> RendezvousNonce;
+typedef PacketFieldAfter<RendezvousNonce, 32> RendezvousJoiner;
+typedef PacketLayout<RENDEZVOUS_PAYLOAD_BYTES, RendezvousType, RendezvousChannel,
+                     RendezvousNonce, RendezvousJoiner> RendezvousHeader;
+
+/* the receiver's address is drawn until it would pass as one of sim/scripts/plan_site.py's */
+#define RENDEZVOUS_MIN_TRANSITIONS 14  // bit transitions over its 32 bits
+#define RENDEZVOUS_MAX_RUN 3           // equal bits in a row
+
+#define RENDEZVOUS_INVITE 'v'
+#define RENDEZVOUS_JOIN 'j'
+#define RENDEZVOUS_WELCOME 'w'
+
+#define RENDEZVOUS_JITTER_US 1000      // spread of the invites of several senders, and of the joins to one
+#define RENDEZVOUS_JOIN_TIMEOUT_US 2500  // wait for the join or welcome, the jitter and a payload away
+#define RENDEZVOUS_JOIN_TRIES 3
+/* a join gives up well inside the sender's wait, 500 us apart */
+#define RENDEZVOUS_RETRY_DELAY 1
+#define RENDEZVOUS_RETRY_COUNT 3
+
+/* the discovery address, 0xB91396C7 little endian as the configured ones */
+extern const uint8_t RENDEZVOUS_ADDRESS[RENDEZVOUS_ADDRESS_BYTES];
+
+
+/*
+ * Function inviteReceiver() invites listening receivers onto our link once,
+ * and welcomes the first to join
+ *
+ * Params:
+ *  channel, address:
+ *    the link, RENDEZVOUS_ADDRESS_BYTES of address
+ *  reply:
+ *    the address the join comes back to
+ *
+ * Outputs:
+ *  true if a receiver was welcomed: the radio is left a transmitter on the link.
+ *  Otherwise it is on the discovery channel, ready to invite again.
+ */
+bool inviteReceiver(Radio & radio, uint8_t channel, uint8_t * address, uint8_t * reply);
+
+
+/*
+ * Function listenForInvite() has the radio listen on the discovery channel
+ * and address, as a receiver waiting for an invite
+ */
+void listenForInvite(Radio & radio);
+
+
+/*
+ * Function joinSender() follows an invite the receiver just read onto the
+ * sender's link, tells the sender so and waits to be welcomed
+ *
+ * Params:
+ *  payload:
+ *    the invite, RENDEZVOUS_CHAR first
+ *  channel, address:
+ *    set to the link on success, RENDEZVOUS_ADDRESS_BYTES of address
+ *
+ * Outputs:
+ *  true if the sender welcomed us: the radio is left listening on the
+ *  link.  Otherwise it listens for invites again.  Either way the retries
+ *  are left at RENDEZVOUS_RETRY_*.
+ */
+bool joinSender(Radio & radio, const char * payload, uint8_t & channel, uint8_t * address);
+
+#endif /* _RENDEZVOUS_H_ */
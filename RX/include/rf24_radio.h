@@ -0,0 +1,48 @@
+/*
+ *  Radio backed by the third-party RF24 library (see the references in
+ *  the README).
+ */
+
+#pragma once
+
+#ifndef _RF24_RADIO_H_
+#define _RF24_RADIO_H_
+
+#include <stdint.h>
+#include <RF24.h>
+
+#include "radio.h"
+
+class RF24Radio : public Radio
+{
+public:
+    RF24Radio(uint8_t cePin, uint8_t csnPin);
+
+    void begin();
+    void setAddressWidth(uint8_t aw);
+    void setChannel(uint8_t channel);
+    void setDataRate(radio_data_rate_e rate);
+    void setPALevel(radio_pa_level_e level);
+    void setRetries(uint8_t delay, uint8_t count);
+    void setAutoAck(bool enable);
+    void openWritingPipe(uint8_t * address);
+    void openReadingPipe(uint8_t pipe, uint8_t * address);
+    void startListening();
+    void stopListening();
+    bool write(const void * buf, uint8_t len);
+    bool writeFast(const void * buf, uint8_t len);
+    bool txStandBy();
+    bool available();
+    void read(void * buf, uint8_t len);
+    uint8_t getARC();
+    const char * name();
+
+private:
+    RF24 radio_;
+    /* CE is held high for writeFast() */
+    bool burst_;
+
+    void endBurst();
+};
+
+#endif /* _RF24_RADIO_H_ */
@@ -0,0 +1,247 @@
+#pragma once
+
+#ifndef _ROUTE_H_
+#define _ROUTE_H_
+
+#include <stdint.h>
+#include "radio.h"
+#include "packet_schema.h"
+
+/*
+ * Routing over relays, toward one sink (a collection tree).  Every node
+ * of a mesh shares a channel and the upper bytes of its address, and
+ * takes its id as the lowest byte.  Nodes beacon their cost to the sink
+ * now and then, unacknowledged to the broadcast id, and send data to the
+ * neighbour with the cheapest path: its cost plus the link's.
+ *
+ * A link's cost is its ETX, the transmissions a payload takes to get an
+ * ACK across, counted with OBSERVE_TX on every write to the neighbour.
+ * Nodes probe one neighbour that could be their parent per beacon, the
+ * one measured longest ago, so that links not carrying data are measured
+ * too.  A write the radio gives up on counts every try it made and the
+ * parent is chosen again right away, so the payload goes on by another
+ * neighbour while the link that failed is still costed.
+ *
+ * Costs are in ROUTE_ETX_ONE per transmission; the sink's is 0.
+ *
+ * With RELAY_MODE the TX main is a relay that also sends the computer's
+ * payloads, and the RX main is the sink that hands them to its computer.
+ */
+
+#define ROUTE_PAYLOAD_BYTES 32     // size of FIFO in bytes, as FIFO_SIZE_BYTES
+#define ROUTE_ADDRESS_BYTES 4      // address width, as ADDRESS_BYTES
+#define ROUTE_READING_PIPE 1       // pipe 0 takes the ACK address of whatever we write
+#define ROUTE_BROADCAST_PIPE 2     // shares the upper address bytes with pipe 1
+
+#define ROUTE_CHAR '@'             // not hex, not END_CHAR or another handshake
+/* every payload: ROUTE_CHAR, the type, the sender and its cost to the sink */
+typedef PacketField<8, 8> RouteType;
+typedef PacketFieldAfter<RouteType, 8> RouteFrom;
+typedef PacketFieldAfter<RouteFrom, 16> RouteCost;
+
+/* beacons and probes */
+typedef PacketFieldAfter<RouteCost, 8> RouteParent;      // the sender's parent
+typedef PacketLayout<ROUTE_PAYLOAD_BYTES, RouteType, RouteFrom, RouteCost, RouteParent> RouteBeaconHeader;
+
+/* data */
+typedef PacketFieldAfter<RouteCost, 8> RouteOrigin;      // the node it came from
+typedef PacketFieldAfter<RouteOrigin, 8> RouteTtl;       // hops it may still take
+typedef PacketFieldAfter<RouteTtl, 8> RouteSeq;          // the origin's count of its payloads
+typedef PacketLayout<ROUTE_PAYLOAD_BYTES, RouteType, RouteFrom, RouteCost,
+                     RouteOrigin, RouteTtl, RouteSeq> RouteDataHeader;
+
+#define ROUTE_DATA_OFFSET RouteDataHeader::DATA_OFFSET
+#define ROUTE_DATA_BYTES RouteDataHeader::DATA_BYTES
+
+#define ROUTE_BEACON 'b'
+#define ROUTE_PROBE 'p'
+#define ROUTE_DATA 'd'
+
+#define ROUTE_BROADCAST 0xFE       // the id every node listens on
+#define ROUTE_NONE 0xFF            // no parent
+#define ROUTE_MAX_NEIGHBORS 8
+#define ROUTE_MAX_HOPS 16
+/* payloads a node remembers having passed on, a lost ACK makes a child send one again */
+#define ROUTE_RECENT 16
+
+#define ROUTE_ETX_ONE 16
+#define ROUTE_COST_MAX 0xFFFF      // no way to the sink
+/* attempts counted before the counts are halved, so old ones fade */
+#define ROUTE_ETX_WINDOW 32
+/* a write the radio gave up on, every try it made */
+#define ROUTE_FAIL_ATTEMPTS (ROUTE_RETRY_COUNT + 1)
+/* a better parent has to be this much cheaper, so routes do not flap */
+#define ROUTE_SWITCH_MARGIN (ROUTE_ETX_ONE * 3 / 2)
+
+/*
+ * Timing follows the data rate, in payload airtimes (321 bits, 160 us at
+ * 2 Mbps and 1284 us at 250 kbps), so a mesh at 250 kbps spends the same
+ * share of the channel on beacons and probes as one at 2 Mbps
+ */
+#define ROUTE_PAYLOAD_BITS (8 + 8 * ROUTE_ADDRESS_BYTES + 9 + 8 * ROUTE_PAYLOAD_BYTES + 16)
+#define ROUTE_ACK_BITS (8 + 8 * ROUTE_ADDRESS_BYTES + 9 + 16)
+#define ROUTE_TURNAROUND_US 130    // a receiver settling to TX for the ACK
+#define ROUTE_BEACON_AIRTIMES 600  // mean gap between beacons, +-50%
+#define ROUTE_TRIGGER_AIRTIMES 60  // beacon within 1-2 of this of a new parent, not sooner
+#define ROUTE_NEIGHBOR_BEACONS 10  // forget neighbours not heard in this many beacon gaps
+#define ROUTE_FORWARD_TRIES 3      // parents a payload is offered to before it is dropped
+/*
+ * A write gives up after 8 tries, each waiting out the ACK and then a step
+ * of at least a payload's airtime more per id, so neighbours that collide
+ * once do not retry in step and collide again
+ */
+#define ROUTE_ARD_STEP_US 250      // ARD's unit
+#define ROUTE_MAX_RETRY_DELAY 15
+#define ROUTE_RETRY_STAGGER 4      // ids spread the delay over this many steps
+#define ROUTE_RETRY_COUNT 7
+
+
+/*
+ * Hands a payload that reached the sink to whoever keeps it
+ */
+typedef void (*route_deliver_f)(void * ctx, uint8_t origin, const char * data);
+
+
+typedef struct
+{
+  uint8_t id;
+  uint8_t parent;       // its parent, ROUTE_NONE for none
+  uint16_t cost;        // its cost to the sink
+  uint16_t attempts;    // transmissions to it, halved every ROUTE_ETX_WINDOW
+  uint16_t acked;       // of those that got an ACK, halved alike
+  uint32_t heard;       // micros() of its last beacon or probe
+  uint32_t probed;      // micros() we last probed it
+} route_neighbor_t;
+
+
+class Router
+{
+public:
+  Router(Radio & radio);
+
+  /*
+   * Function begin() joins the mesh and starts listening
+   *
+   * Params:
+   *  id:
+   *    ours, below ROUTE_BROADCAST
+   *  mesh:
+   *    the mesh's address, ROUTE_ADDRESS_BYTES; its lowest byte is ignored
+   *  sink:
+   *    whether we are the sink, the only node that delivers
+   *  rate:
+   *    the radio's data rate, which the timing of beacons and retries follows
+   *  deliver, ctx:
+   *    called with every payload reaching the sink, may be nullptr elsewhere
+   */
+  void begin(uint8_t id, const uint8_t * mesh, bool sink, radio_data_rate_e rate, route_deliver_f deliver, void * ctx);
+
+  /*
+   * Function step() takes in what arrived, forwarding data toward the sink,
+   * and beacons or probes when it is time
+   */
+  void step(void);
+
+  /*
+   * Function send() sends ROUTE_DATA_BYTES of our own toward the sink
+   *
+   * Outputs:
+   *  false if there is no route, or no parent took it
+   */
+  bool send(const char * data);
+
+  /*
+   * Function linkEtx() is what a payload to a neighbour costs, ROUTE_COST_MAX
+   * before it was ever ACKed
+   */
+  static uint16_t linkEtx(const route_neighbor_t & n);
+
+  /*
+   * Function airtimeUs() is how long `bits' take on air at `rate'
+   */
+  static uint32_t airtimeUs(uint32_t bits, radio_data_rate_e rate);
+
+  /*
+   * Function retryDelay() is the ARD of node `id' at `rate', 0-15
+   */
+  static uint8_t retryDelay(uint8_t id, radio_data_rate_e rate);
+
+  /*
+   * Getters for the route and what went through us
+   */
+  uint8_t getParent(void);
+  uint16_t getCost(void);
+  uint8_t getNeighbors(void);
+  const route_neighbor_t * getNeighbor(uint8_t i);
+  uint32_t getForwarded(void);
+  uint32_t getDropped(void);
+  uint32_t getDuplicates(void);
+  uint32_t getParentChanges(void);
+
+private:
+  Radio & radio;
+  uint8_t address[ROUTE_ADDRESS_BYTES];
+  uint8_t id {ROUTE_NONE};
+  bool sink {false};
+  route_deliver_f deliver {nullptr};
+  void * ctx {nullptr};
+
+  route_neighbor_t neighbors[ROUTE_MAX_NEIGHBORS];
+  uint8_t count {0};
+  uint8_t parent {ROUTE_NONE};
+  uint16_t cost {ROUTE_COST_MAX};
+  uint32_t last_beacon {0};
+  uint32_t next_beacon {0};
+  uint32_t beacon_us {0};
+  uint32_t trigger_us {0};
+  uint32_t timeout_us {0};
+
+  uint8_t seq {0};
+  uint16_t recent[ROUTE_RECENT];  // origin and sequence
+  uint8_t recent_next {0};
+
+  uint32_t forwarded {0};
+  uint32_t dropped {0};
+  uint32_t duplicates {0};
+  uint32_t parent_changes {0};
+
+  route_neighbor_t * find(uint8_t from);
+
+  /*
+   * Whether a data payload was passed on before, remembering it if not
+   */
+  bool seen(const char * payload);
+  void heard(const char * payload);
+
+  /*
+   * A full table keeps the neighbours it has, they are measured, unless
+   * one is further from the sink than `cost': the furthest of those makes
+   * room, so a dense mesh does not fill it with nodes that have no route
+   */
+  route_neighbor_t * replace(uint16_t cost);
+  void forget(void);
+
+  /*
+   * Picks the cheapest parent, and beacons soon if it is a new one
+   */
+  void choose(void);
+
+  /*
+   * Brings the next beacon forward, to trigger_us after the last
+   */
+  void hurry(void);
+
+  /*
+   * Writes a payload to `to', ROUTE_BROADCAST without an ACK, and counts
+   * the attempts against the neighbour.  True if it was ACKed.
+   */
+  bool transmit(uint8_t to, const char * payload);
+  void header(char * payload, char type);
+
+  /*
+   * Offers a data payload to parents until one takes it
+   */
+  bool forward(char * payload);
+};
+
+#endif /* _ROUTE_H_ */
@@ -6,6 +6,7 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <stdint.h>
+#include "link_profile.h"
 
 #define FLUSH_CONST 9        // byte value we expect  when flushing Serial buffer
 #define FLUSH_COUNT 5        // number of sequential FLUSH_CONST needed to switch serial_state_e to READING
@@ -18,14 +19,48 @@
  */
 #define CUNK_SIZE_BYTES 1
 
-#define MAX_CHUNK_CHARS 224   // given by the size of our Serial buffer
+#define MAX_CHUNK_CHARS PROFILE_CHUNK_CHARS   // bounded by the size of our Serial buffer
 #define EXTENSION_BYTES 10    // expected bytes in our file extension
 #define BAUD_RATE 115200      // for serial communication
 #define FIFO_SIZE_BYTES 32    // size of FIFO in bytes, used to configure buffers for serial data
 #define HANDSHAKE_CHAR '\t'   // used to communicate state changes between the Arduino and Computer
 #define END_CHAR '}'          // signify the end of transmission
+#define END_LENGTH_OFFSET 1   // byte of END_TX_CHUNK holding the file bytes in the last payload
 #define TX_CHAR '~'           // at_cmd UART char with matching counterpart in Python receive_hex script 
-#define TX_CHAR_REPS 1        // necessary reps of at_cmd char over UART to trigger at_cmd UART interrupt
+#define TX_CHAR_REPS 3        // necessary reps of at_cmd char over UART to trigger at_cmd UART interrupt
+#define AT_CMD_IDLE_US 200    // quiet line needed before and after the at_cmd chars
+#define AT_CMD_GAP_US 500     // longest gap between at_cmd chars of one command
+
+/* control commands, sent by the computer right after the at_cmd chars, see control_reader.h */
+#define CONTROL_ABORT 'a'     // drop the transfer, keep the configuration
+#define CONTROL_PAUSE 'p'     // hold the transfer until CONTROL_RESUME
+#define CONTROL_RESUME 'r'    // carry on with a paused transfer
+#define CONTROL_PREEMPT 'n'   // drop the transfer and wait for a new configuration
+
+#define SHAPING_FLOWS 4       // flows with a token bucket of their own, see rate_shaper.h
+#define SHAPING_UNLIMITED 0   // shaping rate that means no cap, as BUCKET_UNLIMITED
+
+/*
+ * Virtual channels over serial, see SerialIO::startMux().  Every frame is a
+ * channel byte, a length byte and up to MUX_MAX_FRAME bytes.
+ */
+#define MUX_HEADER_BYTES 2     // channel, then length
+#define MUX_MAX_FRAME 64       // most bytes in one frame, so no frame holds up the others for long
+#define MUX_CONTROL 0          // commands from the computer, credits and acks back
+#define MUX_TELEMETRY 1        // stats, Arduino -> computer
+#define MUX_DATA 2             // channel of the first data stream
+#define MUX_DATA_STREAMS 2     // data streams, each a file
+#define MUX_CHANNELS (MUX_DATA + MUX_DATA_STREAMS)
+#define MUX_STREAM_BYTES 256   // buffer of a data stream, so the most credit it has out
+#define MUX_SERIAL_BUFFER 1024 // Serial's receive buffer, room for all credit and control
+
+/* ops of MUX_CONTROL frames, the first byte of the frame */
+#define MUX_OP_CREDIT 'c'      // channel, then 2 bytes: the computer may send that many more
+#define MUX_OP_STATS 's'       // ask for a frame on MUX_TELEMETRY
+#define MUX_OP_OPEN 'o'        // stream, then the file extension: a new file on the stream
+#define MUX_OP_CLOSE 'e'       // stream: all of the file is in; echoed once it is sent
+/* CONTROL_ABORT, CONTROL_PAUSE and CONTROL_RESUME, then a stream, act on that stream only;
+   CONTROL_PREEMPT ends the session */
 
 /* To clarify return values of getExpectedRadioState() */
 #define RX_MODE 0
@@ -41,6 +76,65 @@ typedef union {
 } uint32_serial_u;
 
 
+/*
+ * One token bucket sent over serial at session setup
+ */
+typedef struct
+{
+  uint32_serial_u rate;   // sustained bytes per second, SHAPING_UNLIMITED for no cap
+  uint32_serial_u burst;  // bytes that may go out back to back
+} shaping_bucket_t;
+
+
+/*
+ * Airtime caps of a TX link: the link as a whole and each of its flows
+ */
+typedef struct
+{
+  shaping_bucket_t link;
+  shaping_bucket_t flows[SHAPING_FLOWS];
+} shaping_config_t;
+
+
+/*
+ * What a TX Arduino reports on MUX_TELEMETRY, in this order and little endian
+ */
+typedef struct
+{
+  uint32_t payloads;                   // payloads sent
+  uint32_t lost;                       // payloads that were never acked
+  uint32_t retries;                    // auto retransmits of all payloads
+  uint16_t queued[MUX_DATA_STREAMS];   // bytes waiting in each stream
+} mux_telemetry_t;
+
+
+/*
+ * States of a data stream over the virtual channels
+ */
+typedef enum
+{
+  MUX_STREAM_IDLE,      // no file
+  MUX_STREAM_OPEN,      // file coming in
+  MUX_STREAM_CLOSING,   // all of the file is in, the rest is to be sent
+  MUX_STREAM_ABORTED    // the computer dropped the file
+} mux_stream_state_e;
+
+
+/*
+ * A data stream's buffer, a ring of the bytes not sent yet
+ */
+typedef struct
+{
+  char buffer[MUX_STREAM_BYTES];
+  uint16_t head;      // next byte to read
+  uint16_t count;     // bytes waiting
+  uint16_t freed;     // bytes read since the last credit
+  char extension[EXTENSION_BYTES];
+  mux_stream_state_e state;
+  bool paused;
+} mux_stream_t;
+
+
 /*
  * States signify whether the board is currently being configured or 
  * has been configured and is now ready to send and receive files.
@@ -88,11 +182,22 @@ public:
    */
   uint32_t getAddressNum(void);
 
+  /*
+   * Fills reply with input_address.bytes turned around (every bit
+   * flipped), the address the receiver answers the transmitter on
+   */
+  void getReplyAddress(uint8_t * reply);
+
   /*
    * Getter for input_channel, set after setConfig() is run
    */
   uint8_t getChannel(void);
 
+  /*
+   * Getter for shaping, set after setShaping() is run
+   */
+  shaping_config_t * getShaping(void);
+
   /*
    * Getter for file_chunk, set after setFileHexChunk() is run
    */
@@ -118,7 +223,8 @@ public:
 
   /*
    * Reads from Serial to set a variable of a predetermined size, by setting
-   * one byte at a time.  
+   * one byte at a time.  A control command among the bytes is acted on
+   * where it comes in, and the bytes around it are kept.
    * 
    * Params:
    *  toSet: 
@@ -130,13 +236,7 @@ public:
 
   /*
    * Reads from Serial to set a variable of a predetermined size, by setting
-   * one byte at a time.
-   * 
-   * Params:
-   *  toSet: 
-   *    Our uint8_t * to set over serial
-   *  size:
-   *    size in bytes of toSet
+   * one byte at a time, as setFromSerial(char *, uint32_t)
    */
   void setFromSerial(uint8_t * toSet, uint32_t size);
 
@@ -152,6 +252,26 @@ public:
    */
   void setConfig(void);
 
+  /*
+   * Function setLink() replaces the configured channel and address with a
+   * link set up over the air, see rendezvous.h
+   *
+   * Params:
+   *  channel:
+   *    the link's channel
+   *  address:
+   *    its address, ADDRESS_BYTES
+   */
+  void setLink(uint8_t channel, const uint8_t * address);
+
+  /*
+   * Function setShaping() reads the airtime caps of a TX link, sent by the
+   * computer right after the configuration: the link's rate and burst, then
+   * those of every flow, each as a 4 byte number.  Until then the link
+   * runs at PROFILE_LINK_RATE and the flows are not capped.
+   */
+  void setShaping(void);
+
   /*
    * Function setExtension() reads data sent over serial to set the desired file
    * extension so we can decode our sent hex file on the RX side.
@@ -228,6 +348,108 @@ public:
    */
   void configAtCmdCharInterrupt(char c, uint8_t reps);
 
+  /*
+   * Function enableControl() lets the computer abort, pause, resume or preempt a
+   * transfer out of band.  The at_cmd interrupt is configured for TX_CHAR_REPS
+   * TX_CHAR with AT_CMD_IDLE_US of quiet line around them, and an ISR allocated
+   * for it which only flags the command.  The command itself is handled by
+   * checkControl() and by the serial reads, which tell it from data by the
+   * escaping of control_reader.h.  Call after Serial.begin().
+   * 
+   * Outputs:
+   *  false if the interrupt could not be allocated, control is then disabled
+   */
+  bool enableControl(void);
+
+  /*
+   * Function checkControl() handles a control command flagged by the at_cmd ISR,
+   * for the busy loops that do not read serial (sending and waiting on the radio).
+   * A pause returns once the computer resumes; an abort or preempt marks the
+   * transfer stopped.
+   * 
+   * Outputs:
+   *  true if the transfer is stopped and the caller should give up on it
+   */
+  bool checkControl(void);
+
+  /*
+   * Whether data from the computer is waiting to be read, commands aside
+   */
+  bool available(void);
+
+  /*
+   * Getter for transfer_stopped, set by an abort or preempt and cleared by
+   * softReset()
+   */
+  bool transferStopped(void);
+
+
+  /* Virtual channels */
+
+  /*
+   * Function startMux() replaces the lockstep protocol with virtual channels
+   * for the rest of the session, after a handshake: control, telemetry and
+   * MUX_DATA_STREAMS data streams share the serial link in tagged frames.
+   * The computer may only send on a data stream what it has credit for,
+   * which is what the stream's buffer can hold, so no stream ever holds up
+   * control or the others.  The session ends with CONTROL_PREEMPT, which
+   * marks the transfer stopped.
+   * 
+   * Serial's receive buffer must be MUX_SERIAL_BUFFER, set before
+   * Serial.begin().
+   */
+  void startMux(void);
+
+  /*
+   * Function pollMux() takes in whatever frames have arrived, without
+   * blocking: data goes to its stream, control is acted on and stats are
+   * answered.  checkControl() polls too while the channels are up.
+   */
+  void pollMux(void);
+
+  /*
+   * Function readStream() takes up to `size' bytes of a data stream out of
+   * its buffer, and gives the computer credit for them
+   * 
+   * Params:
+   *  stream:
+   *    data stream, 0 to MUX_DATA_STREAMS - 1
+   *  data:
+   *    where to put the bytes
+   *  size:
+   *    most bytes to take
+   * 
+   * Outputs:
+   *  number of bytes taken
+   */
+  uint16_t readStream(uint8_t stream, char * data, uint16_t size);
+
+  /*
+   * Function finishStream() frees a stream once its file is sent or dropped,
+   * and tells the computer with MUX_OP_CLOSE
+   */
+  void finishStream(uint8_t stream);
+
+  /*
+   * Getters for a data stream's state, pause, file extension and bytes waiting
+   */
+  mux_stream_state_e getStreamState(uint8_t stream);
+  bool streamPaused(uint8_t stream);
+  char * getStreamExtension(uint8_t stream);
+  uint16_t streamQueued(uint8_t stream);
+
+  /*
+   * Setter for the stats sent on MUX_TELEMETRY when asked, kept up to date
+   * by the caller; the bytes queued are filled in here
+   */
+  void setTelemetry(mux_telemetry_t * stats);
+
+  /*
+   * Function sendFrame() sends `size' bytes (at most MUX_MAX_FRAME) on a
+   * virtual channel
+   */
+  void sendFrame(uint8_t channel, const void * data, uint8_t size);
+
 
   /* Arduino -> Computer */
 
@@ -240,7 +462,12 @@ public:
   void send(uint8_t data);
   void send(uint32_t data);
 
-  char END_TX_CHUNK[32] {'}'};
+  /*
+   * Prints exactly `size' bytes of data, NULs included, then a HANDSHAKE_CHAR
+   */
+  void send(const char * data, uint32_t size);
+
+  char END_TX_CHUNK[32] {END_CHAR, FIFO_SIZE_BYTES};
 
 private:
 
@@ -249,12 +476,46 @@ private:
   serial_state_e serial_state {FLUSHING};
   uint8_t input_channel {0};
   uint32_serial_u input_address;
+  shaping_config_t shaping;
 
 
   /* -----file configuration variables----- */
   char file_extension[EXTENSION_BYTES];
   uint8_t next_chunk_size {0};
   char file_chunk[MAX_CHUNK_CHARS];
+
+
+  /* -----control variables----- */
+  bool transfer_stopped {false};
+
+
+  /* -----virtual channel variables----- */
+  bool mux_enabled {false};
+  uint8_t mux_header[MUX_HEADER_BYTES];
+  char mux_frame[MUX_MAX_FRAME];
+  uint8_t mux_received {0};
+  mux_stream_t streams[MUX_DATA_STREAMS];
+  mux_telemetry_t * telemetry {NULL};
+
+  /*
+   * Acts on a frame from the computer
+   */
+  void handleFrame(uint8_t channel, const char * data, uint8_t size);
+
+  /*
+   * Acts on a MUX_CONTROL frame
+   */
+  void handleMuxControl(const char * data, uint8_t size);
+
+  /*
+   * Tells the computer it may send `bytes' more on a channel
+   */
+  void sendCredit(uint8_t channel, uint16_t bytes);
+
+  /*
+   * Acts on the command that came in, blocking through a pause
+   */
+  void handleControl(void);
 };
 
 #endif /* _SERIAL_IO_H_ */
\ No newline at end of file
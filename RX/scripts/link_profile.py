@@ -0,0 +1,19 @@
+#!/bin/python3
+"""
+Link settings for a site, written by sim/scripts/autotune.py together with
+include/link_profile.h.  Must match the profile flashed on the boards.
+"""
+
+# file bytes per serial chunk, up to 224
+PROFILE_CHUNK_CHARS = 224
+
+# TX airtime cap in file bytes per second (0 for none) and the bytes it may
+# send back to back, sent at session setup
+PROFILE_LINK_RATE = 3200
+PROFILE_LINK_BURST = 96
+
+# caps of single flows on the link, flow: (bytes per second, burst bytes),
+# see rate_shaper.h: 0 the file transfer, 1 the second SERIAL_MUX stream,
+# 2 AGGREGATE payloads, 3 the latency sync, session and rendezvous before a
+# file.  A burst below a payload counts as one.
+PROFILE_FLOW_SHAPING = {}
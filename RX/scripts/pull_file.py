@@ -0,0 +1,122 @@
+#!/bin/python3
+"""
+Pulls a file through an RX Arduino built with PULL_MODE from every TX board
+serving a copy of it (serve_file.py), all at once: the Arduino asks each
+source for a range of blocks, hands ranges of slow or silent sources to the
+others, and passes every block up as it arrives, in any order.
+
+Params:
+    sys.argv[1]:
+        Absolute path of Serial port
+
+    sys.argv[2]:
+        Baudrate of Serial port
+
+    sys.argv[3:]:
+        Addresses of the sources, up to PULL_MAX_SOURCES
+
+Sends:
+    channel, address:
+        The channel all the sources are on, and our own address
+
+    sources:
+        How many sources there are, 1 byte, then their addresses
+
+Control:
+    Ctrl-C stops pulling and leaves the Arduino ready for the next run.
+
+"""
+
+
+import os
+import sys
+import time
+import serial
+from arduino_serial_io import *
+
+RX_FILE_PATH = "./rx-files/"
+
+# must match pull_protocol.h and pull_scheduler.h
+PULL_MAX_SOURCES = 5
+PULL_INFO_EXTENSION_BYTES = 10
+PULL_INFO_CHAR = 'i'
+PULL_BLOCK_CHAR = 'b'
+PULL_DONE_CHAR = 'd'
+
+
+def readExactly(ser, size):
+    data = b""
+    while len(data) < size:
+        data += ser.read(size - len(data))
+    return data
+
+
+if __name__ == "__main__":
+
+    sources = [int(a) for a in sys.argv[3:]]
+    if not 1 <= len(sources) <= PULL_MAX_SOURCES or not all(MIN_ADDRESS <= a <= MAX_ADDRESS for a in sources):
+        sys.exit("give 1-{0} source addresses ({1}-{2})".format(PULL_MAX_SOURCES, MIN_ADDRESS, MAX_ADDRESS))
+
+    channel, address = setConfig(sys.argv[1])
+
+    # configuring our serial
+    ser = serial.Serial()
+    ser.port = sys.argv[1]
+    ser.baudrate = int(sys.argv[2])
+    ser.open()
+
+    flushSerial(ser)
+
+    # sending over our configurations and the sources
+    writeData(ser, channel)
+    writeData(ser, address)
+    writeData(ser, len(sources).to_bytes(1, byteorder=ENDIANESS))
+    for a in sources:
+        writeData(ser, a.to_bytes(4, byteorder=ENDIANESS))
+
+    print("\nPulling from {0} sources please wait...".format(len(sources)))
+
+    os.makedirs(RX_FILE_PATH, exist_ok=True)
+    try:
+        # the description comes first
+        while ser.read(1) != PULL_INFO_CHAR.encode():
+            pass
+        size = int.from_bytes(readExactly(ser, 4), byteorder=ENDIANESS)
+        extension = readExactly(ser, PULL_INFO_EXTENSION_BYTES).decode("utf-8", "replace").strip(" \0")
+
+        rx_file_path = RX_FILE_PATH + str(int(time.time())) + "." + extension
+        started = time.time()
+        received = 0
+
+        # blocks go where they belong as they come, the file has its size from the start
+        with open(rx_file_path + ".part", "wb") as f:
+            f.truncate(size)
+            while True:
+                kind = ser.read(1)
+                if kind == PULL_DONE_CHAR.encode():
+                    break
+                if kind != PULL_BLOCK_CHAR.encode():
+                    continue
+
+                offset = int.from_bytes(readExactly(ser, 4), byteorder=ENDIANESS)
+                length = readExactly(ser, 1)[0]
+                f.seek(offset)
+                f.write(readExactly(ser, length))
+                received += length
+
+        os.rename(rx_file_path + ".part", rx_file_path)
+        elapsed = time.time() - started
+
+        print("Saved {0} bytes to {1} in {2:.1f} s, {3:.0f} bps".format(
+            received, rx_file_path, elapsed, 8 * received / elapsed if elapsed else 0))
+        for a in sources:
+            blocks = int.from_bytes(readExactly(ser, 4), byteorder=ENDIANESS)
+            fresh = int.from_bytes(readExactly(ser, 4), byteorder=ENDIANESS)
+            print("  source {0}: {1} blocks, {2} new".format(a, blocks, fresh))
+    except KeyboardInterrupt:
+        sendControl(ser, CONTROL_PREEMPT)
+        print("\nPull cancelled")
+        ser.close()
+        sys.exit(1)
+
+    ser.close()
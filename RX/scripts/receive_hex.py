@@ -22,7 +22,7 @@ Sends:
         0-125
         
     address:
-        0-10000
+        4 bytes, 0-0xFFFFFFFF
 
     file_extension_bytes:
         File extension of our sent file
@@ -30,6 +30,12 @@ Sends:
     raw_hex_bytes:
         Raw-hex of our file
 
+Files sent compressed (send_hex.py --xz or --csv) are decompressed as they
+arrive.
+
+Control:
+    Ctrl-C stops listening and leaves the Arduino ready for the next run.
+
 """
 
 
@@ -44,10 +50,22 @@ RX_FILE_PATH="./rx-files/"
 # used to debug communication
 DEBUG = 1
 
+# must match LINK_TRACE in main.cpp
+LINK_TRACE = 0
+
+# must match LATENCY_STAMP in main.cpp
+LATENCY_STAMP = 0
+
+# must match RENDEZVOUS in main.cpp; the sender picks the link, so none is asked for
+RENDEZVOUS = 0
+
+# must match DIVERSITY in main.cpp
+DIVERSITY = 0
+
 
 if __name__ == "__main__":
 
-    channel, address = setConfig()
+    channel, address = discoveryConfig() if RENDEZVOUS else setConfig(sys.argv[1])
 
     # configuring our serial
     ser = serial.Serial()
@@ -58,8 +76,8 @@ if __name__ == "__main__":
     flushSerial(ser)
 
     # sending over our configurations
-    ser.write(channel)
-    ser.write(address)
+    writeData(ser, channel)
+    writeData(ser, address)
 
     print("\nListening for file please wait...")
 
@@ -69,14 +87,51 @@ if __name__ == "__main__":
         handshake(ser)
         file_extension = getData(ser).strip()  # remove extra whitespace
 
+    # a compressed file is decompressed payload by payload
+    file_extension, decompressor = streamDecoder(file_extension)
+    file_bytes = bytearray()
+
     file = ""
     data = ""
-    while data != END_CHAR:
-        file += data
-        handshake(ser)
-        data = getData(ser)
+    try:
+        while data != END_CHAR:
+            if decompressor:
+                file_bytes.extend(decompressor.feed(data))
+            else:
+                file += data
+            handshake(ser)
+            data = getData(ser)
+    except KeyboardInterrupt:
+        sendControl(ser, CONTROL_PREEMPT)
+        print("\nStopped listening")
+        ser.close()
+        sys.exit(1)
+
+    if LINK_TRACE:
+        print("Saved link trace to " + saveTrace(ser, "rx"))
+
+    if LATENCY_STAMP:
+        latency, path = saveLatency(ser, "rx")
+        if latency:
+            print("Latency of {0} payloads: p50 {1} us, p99 {2} us, p999 {3} us, max {4} us".format(
+                latency["count"], latency["p50"], latency["p99"], latency["p999"], latency["max"]))
+            print("Saved latency histogram to " + path)
+
+    if DIVERSITY:
+        diversity = readDiversity(ser)
+        if diversity:
+            print("Diversity: radio 1 first for {0} payloads, radio 2 for {1}, {2} copies dropped, {3} missed".format(
+                diversity["first0"], diversity["first1"], diversity["duplicates"], diversity["missed"]))
 
     ser.close()
 
+    rx_file_path = RX_FILE_PATH + str(int(time.time())) + "." + file_extension
+
+    if decompressor:
+        file_bytes.extend(decompressor.flush())
+        with open(rx_file_path, "wb") as f:
+            f.write(file_bytes)
+        sys.exit(0)
+
     # convert the file back to its orriginal form
-    call( 'printf "' + file + '" >' + RX_FILE_PATH + str(int(time.time())) + "." + file_extension, shell=True)
+    call( 'printf "' + file + '" >' + rx_file_path, shell=True)
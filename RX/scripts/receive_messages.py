@@ -0,0 +1,61 @@
+#!/bin/python3
+"""
+Prints the messages a TX Arduino built with AGGREGATE sends
+(send_messages.py), as an RX Arduino built with AGGREGATE splits them out
+of their payloads, one line each: the flow, then the message.
+
+Params:
+    sys.argv[1]:
+        Absolute path of Serial port
+
+    sys.argv[2]:
+        Baudrate of Serial port
+
+Sends:
+    channel, address:
+        The channel of the link, and our own address
+
+Control:
+    Ctrl-C stops receiving and leaves the Arduino ready for the next run.
+
+"""
+
+
+import sys
+import serial
+from arduino_serial_io import *
+
+
+if __name__ == "__main__":
+
+    channel, address = setConfig(sys.argv[1])
+
+    # configuring our serial
+    ser = serial.Serial()
+    ser.port = sys.argv[1]
+    ser.baudrate = int(sys.argv[2])
+    ser.timeout = 1
+    ser.open()
+
+    flushSerial(ser)
+
+    # sending over our configurations
+    writeData(ser, channel)
+    writeData(ser, address)
+
+    print("\nReceiving messages, Ctrl-C to stop...")
+
+    received = 0
+    try:
+        while True:
+            message = readMessage(ser)
+            if message is None:
+                continue
+            flow, data = message
+            print("{0} {1}".format(flow, data.decode("utf-8", "replace")))
+            received += 1
+    except KeyboardInterrupt:
+        sendControl(ser, CONTROL_PREEMPT)
+        print("\nReceived {0} messages".format(received))
+
+    ser.close()
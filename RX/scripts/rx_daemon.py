@@ -0,0 +1,346 @@
+#!/bin/python3
+"""
+Long running receiver for a collection point: attaches every RX Arduino
+that is plugged in, configures it and saves every file it receives, from
+all of them at once and without anyone at the keyboard.
+
+Each board gets a thread of its own, which spends its time blocked on
+serial reads, so receiving scales with the boards attached.  Files are
+written to disk payload by payload as they arrive (decompressed on the
+way if sent compressed) under RX_FILE_PATH/<port>/, and only take their
+final name once complete.
+
+Boards are configured from --links, a csv of "device,channel,address"
+where device is the port (/dev/ttyUSB0) or the USB serial number of the
+board; the others get --channel and --address.
+
+Stats of every link and of the station are printed every --stats-sec,
+written as json to --status, and served over http with --http-port.
+With --latency (boards built with LATENCY_STAMP) they include the one-way
+latency percentiles of each board's last file.
+
+Usage:
+    rx_daemon.py [--links FILE] [--channel N] [--address N] ...
+
+Stop with Ctrl-C or SIGTERM, which leaves every board ready for the next
+configuration.
+"""
+
+import argparse
+import json
+import os
+import re
+import signal
+import sys
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+import serial
+from serial.tools import list_ports
+from arduino_serial_io import *
+
+RX_FILE_PATH = "./rx-files/"
+STATUS_PATH = "./logs/rx-daemon-status.json"
+BAUD_RATE = 115200
+
+# the boards' USB serial ports, as rx_interface.sh looks for them
+PORT_PATTERN = r"ttyU|cu\.S"
+
+# seconds between looks for new boards, and a serial read's longest wait
+ATTACH_SEC = 1
+READ_TIMEOUT_SEC = 1
+
+# window of the throughput figures
+RATE_WINDOW_SEC = 10
+
+
+class LinkStats:
+    """
+    What one board has received, for the status.
+    """
+
+    def __init__(self, port, channel, address):
+        self.port = port
+        self.channel = channel
+        self.address = address
+        self.attached = time.time()
+        self.files = 0
+        self.bytes = 0
+        self.current = None     # file being received
+        self.last_file = None
+        self.errors = 0
+        self.latency = None     # percentiles of the last file, with --latency
+        self.recent = []        # (time, bytes) within RATE_WINDOW_SEC
+        self.lock = threading.Lock()
+
+    def received(self, size):
+        now = time.time()
+        with self.lock:
+            self.bytes += size
+            self.recent.append((now, size))
+            while self.recent and self.recent[0][0] < now - RATE_WINDOW_SEC:
+                self.recent.pop(0)
+
+    def rate(self):
+        """
+        Bytes per second over the last RATE_WINDOW_SEC.
+        """
+        now = time.time()
+        with self.lock:
+            return sum(size for t, size in self.recent if t >= now - RATE_WINDOW_SEC) / RATE_WINDOW_SEC
+
+    def report(self):
+        return {
+            "port": self.port,
+            "channel": self.channel,
+            "address": self.address,
+            "attached_sec": int(time.time() - self.attached),
+            "files": self.files,
+            "bytes": self.bytes,
+            "rate_bps": int(8 * self.rate()),
+            "receiving": self.current,
+            "last_file": self.last_file,
+            "errors": self.errors,
+            "latency_us": self.latency,
+        }
+
+
+class Link(threading.Thread):
+    """
+    Serves one RX Arduino: configures it, then receives files from it until
+    it is unplugged or the station stops.
+    """
+
+    def __init__(self, station, port, channel, address):
+        super().__init__(daemon=True)
+        self.station = station
+        self.port = port
+        self.stats = LinkStats(port, channel, address)
+        self.ser = None
+
+    def exchange(self):
+        """
+        One lockstep transaction: handshake, then whatever the Arduino sends
+        up to its HANDSHAKE_CHAR.  Blocks on reads rather than polling, so an
+        idle board costs nothing.
+
+        Outputs:
+            bytes: the data, or None once the station stops
+        """
+        self.ser.write(HANDSHAKE_BYTE)
+        for _ in range(2):  # its handshake, then the data
+            data = b""
+            while not data.endswith(HANDSHAKE_BYTE):
+                if not self.station.running:
+                    return None
+                data += self.ser.read_until(HANDSHAKE_BYTE)
+        return data[:-len(HANDSHAKE_BYTE)]
+
+    def receiveFile(self):
+        """
+        Receives one file to disk.
+
+        Outputs:
+            bool: False once the station stops
+        """
+        extension = END_CHAR.encode()
+        while extension == END_CHAR.encode():  # residual END_CHAR, as receive_hex.py
+            extension = self.exchange()
+            if extension is None:
+                return False
+            extension = extension.strip()
+
+        extension = extension.decode("utf-8", "replace")
+        extension, decompressor = streamDecoder(extension)
+
+        directory = os.path.join(RX_FILE_PATH, os.path.basename(self.port))
+        os.makedirs(directory, exist_ok=True)
+        path = os.path.join(directory, "{0}-{1}.{2}".format(int(time.time()), self.stats.files, extension))
+        self.stats.current = path
+
+        # only a complete file gets its name
+        with open(path + ".part", "wb") as f:
+            while True:
+                data = self.exchange()
+                if data is None:
+                    return False
+                if data == END_CHAR.encode():
+                    break
+                self.stats.received(len(data))
+                f.write(decompressor.feed(data.decode("ascii")) if decompressor else data)
+
+            if decompressor:
+                f.write(decompressor.flush())
+
+        os.rename(path + ".part", path)
+
+        if self.station.args.latency:
+            data = self.exchange()
+            if data is None:
+                return False
+            latency = parseLatency(data.decode("ascii", "replace"))
+            if latency:
+                self.stats.latency = {q: latency[q] for q in ("p50", "p99", "p999", "max")}
+
+        self.stats.files += 1
+        self.stats.last_file = path
+        self.stats.current = None
+        return True
+
+    def run(self):
+        try:
+            self.ser = serial.Serial(self.port, BAUD_RATE, timeout=READ_TIMEOUT_SEC)
+            flushSerial(self.ser)
+            writeData(self.ser, self.stats.channel.to_bytes(1, byteorder=ENDIANESS))
+            writeData(self.ser, self.stats.address.to_bytes(4, byteorder=ENDIANESS))
+
+            while self.receiveFile():
+                pass
+
+            # leave the board ready for the next configuration
+            sendControl(self.ser, CONTROL_PREEMPT)
+        except (serial.SerialException, OSError, ValueError) as e:
+            self.stats.errors += 1
+            print("{0}: {1}".format(self.port, e), file=sys.stderr)
+        finally:
+            if self.ser:
+                self.ser.close()
+            self.station.detach(self)
+
+
+class Station:
+    """
+    Attaches boards as they are plugged in and keeps the station's status.
+    """
+
+    def __init__(self, args):
+        self.args = args
+        self.links = {}       # port: Link
+        self.finished = []    # LinkStats of boards that went away
+        self.lock = threading.Lock()
+        self.running = True
+        self.started = time.time()
+        self.configs = readLinks(args.links) if args.links else {}
+
+    def attach(self):
+        """
+        Starts a Link for every board plugged in since the last look.
+        """
+        for info in list_ports.comports():
+            if not re.search(self.args.match, info.device):
+                continue
+            with self.lock:
+                if info.device in self.links:
+                    continue
+                channel, address = self.configs.get(info.device, self.configs.get(info.serial_number, (self.args.channel, self.args.address)))
+                link = Link(self, info.device, channel, address)
+                self.links[info.device] = link
+            print("attached {0} on channel {1} address {2}".format(info.device, channel, address))
+            link.start()
+
+    def detach(self, link):
+        with self.lock:
+            self.links.pop(link.port, None)
+            self.finished.append(link.stats)
+        if self.running:
+            print("detached {0}".format(link.port))
+
+    def report(self):
+        """
+        Status of the station and each link, as a dict.
+        """
+        with self.lock:
+            links = [link.stats.report() for link in self.links.values()]
+            finished = [stats.report() for stats in self.finished]
+
+        return {
+            "uptime_sec": int(time.time() - self.started),
+            "boards": len(links),
+            "files": sum(l["files"] for l in links + finished),
+            "bytes": sum(l["bytes"] for l in links + finished),
+            "rate_bps": sum(l["rate_bps"] for l in links),
+            "links": links,
+        }
+
+    def writeStatus(self):
+        report = self.report()
+        with open(self.args.status + ".tmp", "w") as f:
+            json.dump(report, f, indent=2)
+        os.replace(self.args.status + ".tmp", self.args.status)
+
+        print("{0} boards, {1} files, {2} bytes, {3} bps".format(
+            report["boards"], report["files"], report["bytes"], report["rate_bps"]))
+        for l in report["links"]:
+            print("  {0}: ch {1} {2} files {3} bytes {4} bps{5}{6}".format(
+                l["port"], l["channel"], l["files"], l["bytes"], l["rate_bps"],
+                ", latency p50/p99/p999 {p50}/{p99}/{p999} us".format(**l["latency_us"]) if l["latency_us"] else "",
+                ", receiving" if l["receiving"] else ""))
+
+    def stop(self):
+        self.running = False
+        with self.lock:
+            links = list(self.links.values())
+        for link in links:
+            link.join(READ_TIMEOUT_SEC + 2 * AT_CMD_IDLE_SEC + 1)
+
+
+def serveStatus(station, port):
+    """
+    Serves the station's status as json on every GET.
+    """
+    class StatusHandler(BaseHTTPRequestHandler):
+        def do_GET(self):
+            body = json.dumps(station.report(), indent=2).encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, *args):
+            pass
+
+    server = ThreadingHTTPServer(("", port), StatusHandler)
+    threading.Thread(target=server.serve_forever, daemon=True).start()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Receive files from every attached RX Arduino.")
+    parser.add_argument("--links", help="csv of device,channel,address per board")
+    parser.add_argument("--channel", type=int, default=76, help="channel of boards not in --links")
+    parser.add_argument("--address", type=int, default=0, help="address of boards not in --links")
+    parser.add_argument("--match", default=PORT_PATTERN, help="regex of the boards' serial ports")
+    parser.add_argument("--status", default=STATUS_PATH, help="json status file")
+    parser.add_argument("--stats-sec", type=float, default=10, help="seconds between status updates")
+    parser.add_argument("--http-port", type=int, help="serve the status over http on this port")
+    parser.add_argument("--latency", action="store_true", help="query the latency after every file (LATENCY_STAMP)")
+    args = parser.parse_args()
+
+    for value, low, high, name in [(args.channel, MIN_CHANNEL, MAX_CHANNEL, "channel"),
+                                   (args.address, MIN_ADDRESS, MAX_ADDRESS, "address")]:
+        if not low <= value <= high:
+            sys.exit("{0} must be {1}-{2}".format(name, low, high))
+
+    os.makedirs(RX_FILE_PATH, exist_ok=True)
+    os.makedirs(os.path.dirname(args.status), exist_ok=True)
+
+    station = Station(args)
+    if args.http_port:
+        serveStatus(station, args.http_port)
+
+    signal.signal(signal.SIGTERM, lambda *_: sys.exit(0))
+    print("Receiving from every attached board, Ctrl-C to stop...")
+
+    next_status = time.time() + args.stats_sec
+    try:
+        while True:
+            station.attach()
+            if time.time() >= next_status:
+                station.writeStatus()
+                next_status += args.stats_sec
+            time.sleep(ATTACH_SEC)
+    except (KeyboardInterrupt, SystemExit):
+        station.stop()
+        station.writeStatus()
+        print("\nGoodbye!")
@@ -0,0 +1,100 @@
+"""
+Tests of rx_daemon.py against a board stand-in, run with pytest from this
+directory.  The stand-in answers every handshake with the next transaction
+of the RX main's loop(), so several files go through one open port as they
+do on a collection point.
+"""
+
+import os
+import types
+
+import rx_daemon
+from arduino_serial_io import HANDSHAKE_BYTE, END_CHAR
+
+
+class FakeBoard:
+    """
+    Serial port of an RX Arduino: every handshake from the computer gets the
+    board's handshake, then the next of `replies' and its HANDSHAKE_CHAR.
+    Once they run out the station stops, as a read that times out would.
+    """
+
+    def __init__(self, station, replies):
+        self.station = station
+        self.replies = list(replies)
+        self.pending = b""
+
+    def write(self, data):
+        if bytes(data) != bytes(HANDSHAKE_BYTE):
+            return
+        if not self.replies:
+            self.station.running = False
+            return
+        self.pending += HANDSHAKE_BYTE + self.replies.pop(0) + HANDSHAKE_BYTE
+
+    def read_until(self, terminator):
+        at = self.pending.find(terminator)
+        if at < 0:
+            data, self.pending = self.pending, b""
+            self.station.running = False
+            return data
+        data, self.pending = self.pending[:at + len(terminator)], self.pending[at + len(terminator):]
+        return data
+
+
+def fileReplies(extension, data, chunk=64):
+    """
+    What loop() sends for one file: the extension, each chunk, then END_CHAR.
+    """
+    chunks = [data[i:i + chunk] for i in range(0, len(data), chunk)]
+    return [extension.encode()] + chunks + [END_CHAR.encode()]
+
+
+def receiveAll(tmp_path, monkeypatch, replies):
+    monkeypatch.setattr(rx_daemon, "RX_FILE_PATH", str(tmp_path))
+    station = types.SimpleNamespace(running=True, args=types.SimpleNamespace(latency=False))
+    link = rx_daemon.Link(station, "/dev/ttyUSB0", 76, 0)
+    link.ser = FakeBoard(station, replies)
+
+    while link.receiveFile():
+        pass
+
+    directory = os.path.join(str(tmp_path), "ttyUSB0")
+    paths = sorted((p for p in os.listdir(directory) if not p.endswith(".part")), key=lambda p: int(p.split("-")[1].split(".")[0]))
+    contents = []
+    for p in paths:
+        with open(os.path.join(directory, p), "rb") as f:
+            contents.append((p.split(".", 1)[1], f.read()))
+    return link, contents
+
+
+def test_files_back_to_back_on_one_port(tmp_path, monkeypatch):
+    files = [("txt", b"first file\n" * 20), ("hex", bytes(range(256)).hex().encode()), ("csv", b"a,b\n1,2\n")]
+    replies = []
+    for extension, data in files:
+        replies += fileReplies(extension, data)
+
+    link, contents = receiveAll(tmp_path, monkeypatch, replies)
+
+    assert link.stats.files == len(files)
+    assert contents == files
+
+
+def test_residual_end_before_a_file_is_skipped(tmp_path, monkeypatch):
+    files = [("txt", b"after an aborted transfer")]
+    replies = [END_CHAR.encode()] + fileReplies(*files[0])
+
+    link, contents = receiveAll(tmp_path, monkeypatch, replies)
+
+    assert link.stats.files == 1
+    assert contents == files
+
+
+def test_unfinished_file_keeps_its_part_name(tmp_path, monkeypatch):
+    replies = fileReplies("txt", b"complete") + [b"log", b"cut short"]
+
+    link, contents = receiveAll(tmp_path, monkeypatch, replies)
+
+    assert link.stats.files == 1
+    assert contents == [("txt", b"complete")]
+    assert any(p.endswith(".part") for p in os.listdir(os.path.join(str(tmp_path), "ttyUSB0")))
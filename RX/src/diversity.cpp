@@ -0,0 +1,133 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "diversity.h"
+
+#define DIVERSITY_TOP_CHANNEL 125  // RF_CH is 7 bits, the band ends at 2.525 GHz
+
+
+uint8_t
+diversityChannel(uint8_t channel)
+{
+  if (channel + DIVERSITY_CHANNEL_GAP <= DIVERSITY_TOP_CHANNEL) return channel + DIVERSITY_CHANNEL_GAP;
+  return channel - DIVERSITY_CHANNEL_GAP;
+}
+
+
+/* -----Sender----- */
+
+DiversitySender::DiversitySender(Radio & radio) : radio(radio) {}
+
+
+void
+DiversitySender::begin(uint8_t channel, uint8_t paired)
+{
+  channels[0] = channel;
+  channels[1] = paired;
+  seq = 0;
+
+  radio.stopListening();
+  radio.setAutoAck(false);
+}
+
+
+void
+DiversitySender::send(const char * payload, uint8_t copies)
+{
+  char numbered[DIVERSITY_PAYLOAD_BYTES];
+  memcpy(numbered, payload, DIVERSITY_SEQ_OFFSET);
+  DiversitySeq::put(numbered, seq);
+  ++seq;
+
+  /* one copy reaches both radios when they share the channel */
+  uint8_t count = (channels[0] == channels[1]) ? 1 : DIVERSITY_RADIOS;
+
+  for (uint8_t copy = 0; copy < copies; ++copy) {
+    for (uint8_t i = 0; i < count; ++i) {
+      if (count > 1) radio.setChannel(channels[i]);
+      radio.write(numbered, DIVERSITY_PAYLOAD_BYTES);
+    }
+  }
+  if (count > 1) radio.setChannel(channels[0]);
+}
+
+
+/* -----Receiver----- */
+
+DiversityReceiver::DiversityReceiver(Radio & first, Radio & second) : radios {&first, &second} {}
+
+
+void
+DiversityReceiver::begin(uint8_t channel, uint8_t paired, uint8_t * address)
+{
+  ready = false;
+  started = false;
+  memset(first, 0, sizeof(first));
+  duplicates = 0;
+  missed = 0;
+
+  /* two ACKs at once on the same channel would only collide, and nobody waits for them */
+  uint8_t channels[DIVERSITY_RADIOS] {channel, paired};
+  for (uint8_t i = 0; i < DIVERSITY_RADIOS; ++i) {
+    radios[i]->stopListening();
+    radios[i]->setChannel(channels[i]);
+    radios[i]->setAutoAck(false);
+    radios[i]->openReadingPipe(0, address);
+    radios[i]->startListening();
+  }
+}
+
+
+bool
+DiversityReceiver::available()
+{
+  for (uint8_t i = 0; i < DIVERSITY_RADIOS && !ready; ++i) {
+    if (!radios[i]->available()) continue;
+    radios[i]->read(next, DIVERSITY_PAYLOAD_BYTES);
+
+    uint16_t seq = DiversitySeq::get(next);
+
+    /* the copy the other radio had first, or a late one of a payload already passed */
+    int16_t ahead = (int16_t) (seq - last);
+    if (started && ahead <= 0) {
+      ++duplicates;
+      continue;
+    }
+
+    if (started) missed += ahead - 1;
+    started = true;
+    last = seq;
+    ++first[i];
+    ready = true;
+  }
+  return ready;
+}
+
+
+void
+DiversityReceiver::read(char * payload)
+{
+  memcpy(payload, next, DIVERSITY_PAYLOAD_BYTES);
+  ready = false;
+}
+
+
+/* -----Getters----- */
+
+uint32_t
+DiversityReceiver::getFirst(uint8_t radio)
+{
+  return (radio < DIVERSITY_RADIOS) ? first[radio] : 0;
+}
+
+uint32_t
+DiversityReceiver::getDuplicates()
+{
+  return duplicates;
+}
+
+uint32_t
+DiversityReceiver::getMissed()
+{
+  return missed;
+}
@@ -0,0 +1,121 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "erasure_code.h"
+
+/* x^8 + x^4 + x^3 + x^2 + 1, the usual Reed-Solomon field */
+#define GF_POLYNOMIAL 0x11d
+
+ErasureCode::ErasureCode()
+{
+  uint16_t x {1};
+  for (uint16_t i = 0; i < 255; ++i) {
+    gf_exp[i] = gf_exp[i + 255] = (uint8_t) x;
+    gf_log[x] = (uint8_t) i;
+    x <<= 1;
+    if (x & 0x100) x ^= GF_POLYNOMIAL;
+  }
+  gf_exp[510] = gf_exp[511] = 0;
+  gf_log[0] = 0;
+}
+
+
+void
+ErasureCode::encode(const uint8_t * data, uint8_t k, uint8_t parity, uint8_t size, uint8_t * out)
+{
+  memset(out, 0, size);
+
+  for (uint8_t j = 0; j < k; ++j) {
+    uint8_t c = coefficient(parity, j);
+    const uint8_t * symbol = data + j * size;
+    for (uint8_t b = 0; b < size; ++b) out[b] ^= mul(c, symbol[b]);
+  }
+}
+
+
+bool
+ErasureCode::decode(uint8_t * symbols, uint32_t have, uint8_t k, uint8_t size)
+{
+  uint8_t rows[ERASURE_MAX_DATA][ERASURE_MAX_DATA];
+  uint8_t used[ERASURE_MAX_DATA];  // symbol each row came from
+  uint8_t n {0};
+
+  /* the data symbols that arrived, then enough parity to make up k */
+  for (uint8_t index = 0; index < k + ERASURE_MAX_PARITY && n < k; ++index) {
+    if (!(have & ((uint32_t) 1 << index))) continue;
+
+    for (uint8_t j = 0; j < k; ++j) {
+      rows[n][j] = (index < k) ? (j == index) : coefficient(index - k, j);
+    }
+    used[n++] = index;
+  }
+  if (n < k) return false;
+
+  /* nothing lost, nothing to do */
+  bool complete {true};
+  for (uint8_t j = 0; j < k; ++j) complete = complete && used[j] == j;
+  if (complete) return true;
+
+  /* Gauss-Jordan on a copy of the received symbols, in row order */
+  uint8_t work[ERASURE_MAX_DATA][ERASURE_MAX_SYMBOL_BYTES];
+  for (uint8_t r = 0; r < k; ++r) memcpy(work[r], symbols + used[r] * size, size);
+
+  for (uint8_t col = 0; col < k; ++col) {
+    uint8_t pivot = col;
+    while (pivot < k && !rows[pivot][col]) ++pivot;
+    if (pivot == k) return false;  // cannot happen with a Cauchy code
+
+    if (pivot != col) {
+      for (uint8_t j = 0; j < k; ++j) {
+        uint8_t t = rows[col][j];
+        rows[col][j] = rows[pivot][j];
+        rows[pivot][j] = t;
+      }
+      for (uint8_t b = 0; b < size; ++b) {
+        uint8_t t = work[col][b];
+        work[col][b] = work[pivot][b];
+        work[pivot][b] = t;
+      }
+    }
+
+    uint8_t scale = inv(rows[col][col]);
+    for (uint8_t j = 0; j < k; ++j) rows[col][j] = mul(rows[col][j], scale);
+    for (uint8_t b = 0; b < size; ++b) work[col][b] = mul(work[col][b], scale);
+
+    for (uint8_t r = 0; r < k; ++r) {
+      uint8_t f = rows[r][col];
+      if (r == col || !f) continue;
+      for (uint8_t j = 0; j < k; ++j) rows[r][j] ^= mul(f, rows[col][j]);
+      for (uint8_t b = 0; b < size; ++b) work[r][b] ^= mul(f, work[col][b]);
+    }
+  }
+
+  /* row j now holds data symbol j */
+  for (uint8_t j = 0; j < k; ++j) {
+    if (!(have & ((uint32_t) 1 << j))) memcpy(symbols + j * size, work[j], size);
+  }
+  return true;
+}
+
+
+uint8_t
+ErasureCode::mul(uint8_t a, uint8_t b)
+{
+  if (!a || !b) return 0;
+  return gf_exp[gf_log[a] + gf_log[b]];
+}
+
+
+uint8_t
+ErasureCode::inv(uint8_t a)
+{
+  return gf_exp[255 - gf_log[a]];
+}
+
+
+uint8_t
+ErasureCode::coefficient(uint8_t i, uint8_t j)
+{
+  /* 1 / (x_i + y_j) with x_i = ERASURE_MAX_DATA + i and y_j = j, never equal */
+  return inv((uint8_t) (ERASURE_MAX_DATA + i) ^ j);
+}
@@ -0,0 +1,364 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include "harq.h"
+
+uint8_t
+harqSymbolsFor(uint8_t need, float loss, uint8_t most)
+{
+  if (!need) return 0;
+  if (loss <= 0.0f) return need;
+  if (loss >= 1.0f) return most;
+
+  /* P(at least `need' of n arrive), the binomial pmf from all n down */
+  float odds = loss / (1.0f - loss);
+  for (uint8_t n = need; n < most; ++n) {
+    float term = powf(1.0f - loss, n);
+    float enough = 0.0f;
+    for (uint8_t k = n; k >= need; --k) {
+      enough += term;
+      term *= odds * (float) k / (float) (n - k + 1);
+    }
+    if (enough >= HARQ_DECODE_TARGET) return n;
+  }
+  return most;
+}
+
+
+/* -----HarqSender----- */
+
+HarqSender::HarqSender(Radio & radio) : radio(radio) {}
+
+
+void
+HarqSender::begin(uint8_t * address, uint8_t * receiver, harq_mode_e mode, uint8_t parity,
+                  harq_pace_f pace, void * ctx)
+{
+  memcpy(this->address, address, HARQ_ADDRESS_BYTES);
+  memcpy(this->receiver, receiver, HARQ_ADDRESS_BYTES);
+  this->mode = mode;
+  fixed_parity = (parity < ERASURE_MAX_PARITY) ? parity : ERASURE_MAX_PARITY;
+  this->pace = pace;
+  this->ctx = ctx;
+
+  group = 0;
+  loss = HARQ_INITIAL_LOSS;
+  payloads = parity_sent = retransmits = 0;
+
+  radio.setAutoAck(false);
+  radio.openReadingPipe(HARQ_READING_PIPE, this->address);
+  radio.openWritingPipe(this->receiver);
+  radio.stopListening();
+}
+
+
+bool
+HarqSender::sendGroup(const char * blocks, uint8_t count)
+{
+  char payload[HARQ_PAYLOAD_BYTES];
+  char rep[HARQ_PAYLOAD_BYTES];
+
+  if (count > HARQ_GROUP_BLOCKS) count = HARQ_GROUP_BLOCKS;
+  uint32_t missing = ((uint32_t) 1 << count) - 1;
+  uint8_t have {0};
+  uint8_t next_parity {0};
+
+  uint8_t n = count;
+  if (mode == HARQ_FEC) n += fixed_parity;
+  if (mode == HARQ_HYBRID) n = harqSymbolsFor(count, loss, count + ERASURE_MAX_PARITY);
+
+  for (round = 0; round < HARQ_MAX_ROUNDS; ++round) {
+    uint8_t sent {0};
+    HarqGroup::put(payload, group);
+    HarqCount::put(payload, count);
+
+    /* what is missing of the data first, then parity nobody has seen yet */
+    for (uint8_t j = 0; j < count && sent < n; ++j) {
+      if (!(missing & ((uint32_t) 1 << j))) continue;
+
+      HarqIndex::put(payload, j);
+      memcpy(payload + HARQ_HEADER_BYTES, blocks + j * HARQ_BLOCK_BYTES, HARQ_BLOCK_BYTES);
+      send(payload);
+      if (round) ++retransmits;
+      ++sent;
+    }
+    for (; sent < n && next_parity < ERASURE_MAX_PARITY; ++sent) {
+      HarqIndex::put(payload, count + next_parity);
+      code.encode((const uint8_t *) blocks, count, next_parity++, HARQ_BLOCK_BYTES,
+                  (uint8_t *) payload + HARQ_HEADER_BYTES);
+      send(payload);
+      ++parity_sent;
+    }
+
+    if (mode == HARQ_FEC) break;
+    if (!poll(HARQ_POLL, round, rep)) return false;
+
+    /* every block new to the receiver counts, so what did not arrive was lost */
+    uint8_t now = HarqReportHave::get(rep);
+    uint8_t arrived = (now > have) ? now - have : 0;
+    if (sent) loss += HARQ_LOSS_WEIGHT * ((float) (sent - ((arrived < sent) ? arrived : sent)) / sent - loss);
+    have = now;
+
+    if (HarqReportDone::get(rep)) break;
+
+    missing = HarqReportMissing::get(rep) & (((uint32_t) 1 << count) - 1);
+    uint8_t left = __builtin_popcount(missing) + ERASURE_MAX_PARITY - next_parity;
+    uint8_t need = (count > have) ? count - have : 1;
+
+    n = (mode == HARQ_ARQ) ? __builtin_popcount(missing) : harqSymbolsFor(need, loss, left);
+  }
+  if (round == HARQ_MAX_ROUNDS) return false;
+
+  ++group;
+  return true;
+}
+
+
+bool
+HarqSender::end(uint8_t last_size)
+{
+  char rep[HARQ_PAYLOAD_BYTES];
+
+  if (mode != HARQ_FEC) return poll(HARQ_END, last_size, rep);
+
+  /* nobody answers without feedback, say it a few times */
+  char payload[HARQ_PAYLOAD_BYTES] {};
+  HarqGroup::put(payload, group);
+  HarqIndex::put(payload, HARQ_END);
+  HarqCount::put(payload, last_size);
+  memcpy(payload + HARQ_REPLY_OFFSET, address, HARQ_ADDRESS_BYTES);
+  for (uint8_t i = 0; i < HARQ_END_REPEATS; ++i) send(payload);
+  return true;
+}
+
+
+float
+HarqSender::getLoss()
+{
+  return loss;
+}
+
+
+uint32_t
+HarqSender::getPayloads()
+{
+  return payloads;
+}
+
+
+uint32_t
+HarqSender::getParity()
+{
+  return parity_sent;
+}
+
+
+uint32_t
+HarqSender::getRetransmits()
+{
+  return retransmits;
+}
+
+
+void
+HarqSender::send(const char * payload)
+{
+  if (pace) pace(ctx);
+  /* no ACKs to wait for, so the payloads of a group go out back to back */
+  radio.writeFast(payload, HARQ_PAYLOAD_BYTES);
+  ++payloads;
+}
+
+
+bool
+HarqSender::poll(uint8_t index, uint8_t value, char * report)
+{
+  char payload[HARQ_PAYLOAD_BYTES] {};
+  HarqGroup::put(payload, group);
+  HarqIndex::put(payload, index);
+  HarqCount::put(payload, value);
+  memcpy(payload + HARQ_REPLY_OFFSET, address, HARQ_ADDRESS_BYTES);
+
+  for (uint8_t t = 0; t < HARQ_POLL_TRIES; ++t) {
+    send(payload);
+    radio.startListening();
+
+    uint32_t start = micros();
+    while (micros() - start < HARQ_REPORT_TIMEOUT_US) {
+      if (!radio.available()) continue;
+
+      /* a late report of an earlier poll does not count */
+      radio.read(report, HARQ_PAYLOAD_BYTES);
+      if (HarqReportGroup::get(report) == group && HarqReportRound::get(report) == value) {
+        radio.stopListening();
+        return true;
+      }
+    }
+    radio.stopListening();
+  }
+  return false;
+}
+
+
+/* -----HarqReceiver----- */
+
+HarqReceiver::HarqReceiver(Radio & radio) : radio(radio) {}
+
+
+void
+HarqReceiver::begin(uint8_t * address, harq_deliver_f deliver, void * ctx)
+{
+  memcpy(this->address, address, HARQ_ADDRESS_BYTES);
+  this->deliver = deliver;
+  this->ctx = ctx;
+
+  started = holding = false;
+  groups = repaired = lost = 0;
+
+  radio.setAutoAck(false);
+  radio.openReadingPipe(HARQ_READING_PIPE, this->address);
+  radio.startListening();
+}
+
+
+bool
+HarqReceiver::step()
+{
+  char payload[HARQ_PAYLOAD_BYTES];
+
+  while (radio.available()) {
+    radio.read(payload, HARQ_PAYLOAD_BYTES);
+
+    uint16_t g = HarqGroup::get(payload);
+    uint8_t index = HarqIndex::get(payload);
+    int16_t ahead = started ? (int16_t) (g - group) : 1;
+
+    if (index == HARQ_END) {
+      if (ahead >= 0) startGroup(g);  // what is left of the last group goes out as it is
+
+      uint8_t last = HarqCount::get(payload);
+      if (holding) deliver(ctx, held, (last && last < HARQ_BLOCK_BYTES) ? last : HARQ_BLOCK_BYTES);
+      holding = false;
+
+      report(payload, true);
+      return false;
+    }
+
+    if (ahead > 0) startGroup(g);
+
+    if (index == HARQ_POLL) {
+      report(payload, false);
+      continue;
+    }
+    if (ahead < 0 || index >= ERASURE_MAX_SYMBOLS) continue;
+
+    /* keep counting after decoding, the sender learns the loss from it */
+    uint32_t bit = (uint32_t) 1 << index;
+    if (have & bit) continue;
+    have |= bit;
+    count = HarqCount::get(payload);
+    if (done) continue;
+
+    memcpy(symbols[index], payload + HARQ_HEADER_BYTES, HARQ_BLOCK_BYTES);
+    if (haveCount() >= count) finishGroup(false);
+  }
+  return true;
+}
+
+
+uint32_t
+HarqReceiver::getGroups()
+{
+  return groups;
+}
+
+
+uint32_t
+HarqReceiver::getRepaired()
+{
+  return repaired;
+}
+
+
+uint32_t
+HarqReceiver::getLost()
+{
+  return lost;
+}
+
+
+void
+HarqReceiver::startGroup(uint16_t g)
+{
+  /* without feedback the sender moved on, whatever we have of the group goes */
+  if (started && !done) finishGroup(true);
+
+  group = g;
+  count = 0;
+  have = 0;
+  done = false;
+  started = true;
+}
+
+
+void
+HarqReceiver::finishGroup(bool force)
+{
+  if (!count) {
+    done = true;
+    return;
+  }
+
+  bool decoded = code.decode(&symbols[0][0], have, count, HARQ_BLOCK_BYTES);
+  if (!decoded && !force) return;
+
+  uint32_t data = ((uint32_t) 1 << count) - 1;
+  if (decoded && (have & data) != data) ++repaired;
+
+  for (uint8_t j = 0; j < count; ++j) {
+    if (!decoded && !(have & ((uint32_t) 1 << j))) {
+      memset(symbols[j], 0, HARQ_BLOCK_BYTES);
+      ++lost;
+    }
+    pass((const char *) symbols[j], HARQ_BLOCK_BYTES);
+  }
+
+  ++groups;
+  done = true;
+}
+
+
+void
+HarqReceiver::pass(const char * data, uint8_t size)
+{
+  if (holding) deliver(ctx, held, HARQ_BLOCK_BYTES);
+  memcpy(held, data, size);
+  holding = true;
+}
+
+
+void
+HarqReceiver::report(const char * poll, bool over)
+{
+  char rep[HARQ_PAYLOAD_BYTES] {};
+  bool old = (int16_t) (HarqGroup::get(poll) - group) < 0;
+
+  HarqReportGroup::put(rep, HarqGroup::get(poll));
+  HarqReportRound::put(rep, HarqCount::get(poll));
+  HarqReportHave::put(rep, old ? 0 : haveCount());
+  HarqReportMissing::put(rep, old ? 0 : (uint16_t) ~have);
+  HarqReportDone::put(rep, over || old || done);
+
+  radio.stopListening();
+  radio.openWritingPipe((uint8_t *) poll + HARQ_REPLY_OFFSET);
+  radio.write(rep, HARQ_PAYLOAD_BYTES);
+  radio.startListening();
+}
+
+
+uint8_t
+HarqReceiver::haveCount()
+{
+  return __builtin_popcount(have);
+}
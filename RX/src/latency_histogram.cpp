@@ -0,0 +1,139 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "latency_histogram.h"
+
+LatencyHistogram::LatencyHistogram()
+{
+  clear();
+}
+
+
+void
+LatencyHistogram::record(uint32_t us)
+{
+  ++counts[bucketOf(us)];
+  if (!count || us < min) min = us;
+  if (us > max) max = us;
+  ++count;
+}
+
+
+void
+LatencyHistogram::merge(const LatencyHistogram & other)
+{
+  if (!other.count) return;
+
+  for (uint16_t b = 0; b < LATENCY_BUCKETS; ++b) {
+    counts[b] += other.counts[b];
+  }
+  if (!count || other.min < min) min = other.min;
+  if (other.max > max) max = other.max;
+  count += other.count;
+}
+
+
+uint32_t
+LatencyHistogram::percentile(float q) const
+{
+  if (!count) return 0;
+
+  /* the rank of the delay, counting from 1 */
+  uint32_t rank = (uint32_t) (q * count + 0.999999f);
+  if (rank < 1) rank = 1;
+  if (rank > count) rank = count;
+
+  uint32_t seen {0};
+  for (uint16_t b = 0; b < LATENCY_BUCKETS; ++b) {
+    seen += counts[b];
+    if (seen >= rank) {
+      uint32_t top = bucketTop(b);
+      return (top < max) ? top : max;
+    }
+  }
+  return max;
+}
+
+
+uint32_t
+LatencyHistogram::getCount(void) const
+{
+  return count;
+}
+
+
+uint32_t
+LatencyHistogram::getMin(void) const
+{
+  return min;
+}
+
+
+uint32_t
+LatencyHistogram::getMax(void) const
+{
+  return max;
+}
+
+
+uint32_t
+LatencyHistogram::getBucket(uint16_t bucket) const
+{
+  return (bucket < LATENCY_BUCKETS) ? counts[bucket] : 0;
+}
+
+
+void
+LatencyHistogram::clear(void)
+{
+  memset(counts, 0, sizeof(counts));
+  count = min = max = 0;
+}
+
+
+void
+LatencyHistogram::dump(void) const
+{
+  Serial.print(count);
+  Serial.print(',');
+  Serial.print(min);
+  Serial.print(',');
+  Serial.print(percentile(0.5f));
+  Serial.print(',');
+  Serial.print(percentile(0.99f));
+  Serial.print(',');
+  Serial.print(percentile(0.999f));
+  Serial.print(',');
+  Serial.println(max);
+
+  for (uint16_t b = 0; b < LATENCY_BUCKETS; ++b) {
+    if (!counts[b]) continue;
+    Serial.print(bucketTop(b));
+    Serial.print(',');
+    Serial.println(counts[b]);
+  }
+
+  Serial.print(LATENCY_DUMP_END);
+}
+
+
+uint16_t
+LatencyHistogram::bucketOf(uint32_t us)
+{
+  /* below two sub bucket counts every delay has a bucket of its own */
+  if (us < 2 * LATENCY_SUB_BUCKETS) return us;
+
+  uint8_t shift = 31 - __builtin_clz(us) - LATENCY_SUB_BITS;
+  return (shift + 1) * LATENCY_SUB_BUCKETS + (us >> shift) - LATENCY_SUB_BUCKETS;
+}
+
+
+uint32_t
+LatencyHistogram::bucketTop(uint16_t bucket)
+{
+  if (bucket < 2 * LATENCY_SUB_BUCKETS) return bucket;
+
+  uint8_t shift = bucket / LATENCY_SUB_BUCKETS - 1;
+  uint32_t bottom = (uint32_t) (LATENCY_SUB_BUCKETS + bucket % LATENCY_SUB_BUCKETS) << shift;
+  return bottom + (((uint32_t) 1 << shift) - 1);
+}
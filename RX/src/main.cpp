@@ -1,22 +1,382 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <stdint.h>
-#include <RF24.h>
+#include <string.h>
 #include "serial_io.h"
+#include "link_trace.h"
+#include "link_profile.h"
+#include "radio.h"
+#include "rf24_radio.h"
+#include "nrf24_radio.h"
+#include "pull_client.h"
+#include "harq.h"
+#include "latency_stamp.h"
+#include "latency_histogram.h"
+#include "session.h"
+#include "rendezvous.h"
+#include "diversity.h"
+#include "aggregator.h"
+#include "route.h"
 
 #define CE 26
 #define CSN 25
+#define RADIO_BACKEND RADIO_RF24  // or RADIO_NRF24 for our own driver
+#define LINK_TRACE 0  // record every received payload and dump them after every file
+#define PULL_MODE 0  // pull a file from several TX boards at once, see pull_protocol.h
+#define HARQ_MODE PROFILE_HARQ  // receive files by hybrid ARQ instead of ACKs, see harq.h
+#define LATENCY_STAMP 0  // histogram of the one-way latency of stamped payloads, see latency_stamp.h
+#define SESSION_NEGOTIATE 0  // agree on rate and features with the sender before every file, see session.h
+#define RENDEZVOUS 0  // wait for a sender to invite us onto its link instead of the configured one, see rendezvous.h
+#define DIVERSITY 0  // keep the first copy of every payload off a second radio on CE2 and CSN2, see diversity.h
+#define CE2 27
+#define CSN2 33
+#define AGGREGATE 0  // split the small messages an AGGREGATE sender packs into payloads instead of receiving files, see aggregator.h
+#define RELAY_MODE 0  // be the sink of a mesh of RELAY_MODE senders instead of receiving files, see route.h
+
+/* the modes that run loop() on their own, then what each of them leaves out */
+#if PULL_MODE + AGGREGATE + RELAY_MODE > 1
+#error "PULL_MODE, AGGREGATE and RELAY_MODE each take over loop(), pick one"
+#endif
+
+#if (PULL_MODE || AGGREGATE || RELAY_MODE) && (HARQ_MODE || LATENCY_STAMP || SESSION_NEGOTIATE || RENDEZVOUS || DIVERSITY || LINK_TRACE)
+#error "PULL_MODE, AGGREGATE and RELAY_MODE receive no files the lockstep way, turn the transfer features off"
+#endif
+
+#if HARQ_MODE && !SESSION_NEGOTIATE && (LATENCY_STAMP || DIVERSITY || LINK_TRACE)
+#error "every file comes by hybrid ARQ, which reads its own payloads: negotiate the session or turn HARQ_MODE off"
+#endif
+
+#if LATENCY_STAMP && DIVERSITY
+#error "the latency stamp and the sequence number of DIVERSITY both take the end of a payload"
+#endif
+
+#if LATENCY_STAMP
+#define PAYLOAD_FILE_BYTES LATENCY_FILE_BYTES
+#elif DIVERSITY
+#define PAYLOAD_FILE_BYTES DIVERSITY_FILE_BYTES
+#else
+#define PAYLOAD_FILE_BYTES FIFO_SIZE_BYTES
+#endif
 
 char FIFO_BUFFER[32] {"g"};  // arbitrary non-hex char
 
 // /* create an instance of the radio */
-RF24 radio(CE, CSN);
+#if RADIO_BACKEND == RADIO_NRF24
+NRF24Radio backend(CE, CSN);
+#else
+RF24Radio backend(CE, CSN);
+#endif
+Radio & radio = backend;
+#if DIVERSITY
+#if RADIO_BACKEND == RADIO_NRF24
+NRF24Radio second(CE2, CSN2);
+#else
+RF24Radio second(CE2, CSN2);
+#endif
+DiversityReceiver diversity(radio, second);
+#endif
 SerialIO io;
+#if LINK_TRACE
+LinkTrace trace;
+uint16_t seq {0};
+#endif
+#if PULL_MODE
+PullClient client(radio);
+#endif
+#if LATENCY_STAMP
+LatencyHistogram latency;
+#endif
+#if HARQ_MODE
+HarqReceiver harq(radio);
+bool got_extension {false};
+#endif
+#if RELAY_MODE
+Router router(radio);
+#endif
+/* what the sender and we agreed on for the current file */
+session_caps_t session {};
+
+
+/*
+ * Whether the file comes by hybrid ARQ, which a negotiated session only
+ * does when the sender does it too
+ */
+bool useHarq() {
+  return SESSION_NEGOTIATE ? (session.features & SESSION_HARQ) : HARQ_MODE;
+}
+
+
+#if PULL_MODE
+/*
+ * Hands a block to the computer as it comes, wherever it is in the file
+ */
+void deliverBlock(void * ctx, uint32_t offset, const char * data, uint8_t size) {
+  (void) ctx;
+  uint32_serial_u at;
+  at.num = offset;
+
+  Serial.print(PULL_BLOCK_CHAR);
+  Serial.write(at.bytes, sizeof(at.bytes));
+  Serial.write(size);
+  Serial.write((const uint8_t *) data, size);
+}
+
+
+/*
+ * Pulls one file from the sources the computer names (their count, then
+ * their addresses): the file's size and extension go up first, then every
+ * block as it arrives, then how much each source delivered
+ */
+void pull() {
+  uint8_t sources {0};
+  uint8_t addresses[PULL_MAX_SOURCES][PULL_ADDRESS_BYTES];
+
+  io.setFromSerial(&sources, 1);
+  if (sources > PULL_MAX_SOURCES) sources = PULL_MAX_SOURCES;
+  io.setFromSerial(&addresses[0][0], sources * PULL_ADDRESS_BYTES);
+  if (io.transferStopped()) return;
+
+  client.begin(io.getAddressBytes(), sources, addresses, deliverBlock, nullptr);
+  while (!client.describe()) {
+    if (io.checkControl()) return;
+  }
+
+  uint32_serial_u size;
+  size.num = client.getSize();
+  Serial.print(PULL_INFO_CHAR);
+  Serial.write(size.bytes, sizeof(size.bytes));
+  Serial.write((const uint8_t *) client.getExtension(), PULL_INFO_EXTENSION_BYTES);
+
+  while (client.step()) {
+    if (io.checkControl()) return;
+  }
+
+  /* every source's blocks, and how many of them were new */
+  Serial.print(PULL_DONE_CHAR);
+  for (uint8_t s = 0; s < sources; ++s) {
+    const pull_source_t * p = client.getScheduler().getSource(s);
+    uint32_serial_u count;
+    count.num = p->blocks;
+    Serial.write(count.bytes, sizeof(count.bytes));
+    count.num = p->fresh;
+    Serial.write(count.bytes, sizeof(count.bytes));
+  }
+}
+#endif
+
+
+#if AGGREGATE
+/*
+ * Hands a message to the computer: its flow, its length and its bytes
+ */
+void deliverMessage(void * ctx, uint8_t flow, const char * message, uint8_t size) {
+  (void) ctx;
+  Serial.write(flow);
+  Serial.write(size);
+  Serial.write((const uint8_t *) message, size);
+}
+
+
+/*
+ * Splits every aggregate that arrives into its messages until the computer
+ * ends the session
+ */
+void receiveMessages() {
+  char payload[AGGREGATE_PAYLOAD_BYTES];
+
+  while (!io.checkControl()) {
+    if (!radio.available()) continue;
+    radio.read(payload, AGGREGATE_PAYLOAD_BYTES);
+    if (payload[0] == AGGREGATE_CHAR) splitAggregate(payload, deliverMessage, nullptr);
+  }
+}
+#endif
+
+
+#if RELAY_MODE
+/*
+ * Hands a payload that reached the sink to the computer: the node it came
+ * from, then its ROUTE_DATA_BYTES
+ */
+void deliverRouted(void * ctx, uint8_t origin, const char * data) {
+  (void) ctx;
+  Serial.write(origin);
+  Serial.write((const uint8_t *) data, ROUTE_DATA_BYTES);
+}
+
+
+/*
+ * Sinks the mesh's payloads until the computer ends the session.  The
+ * configured address is the mesh's, its lowest byte our id.
+ */
+void sinkRouted() {
+  uint8_t * mesh = io.getAddressBytes();
+  router.begin(mesh[0], mesh, true, PROFILE_DATA_RATE, deliverRouted, nullptr);
+
+  while (!io.checkControl()) router.step();
+}
+#endif
+
+
+#if HARQ_MODE
+/*
+ * Hands a block of the file to the computer, as the lockstep transfer does
+ * with payloads.  The extension comes first, in a zero padded block of its own.
+ */
+void deliverHarq(void * ctx, const char * data, uint8_t size) {
+  (void) ctx;
+  if (!got_extension) {
+    size = strnlen(data, size);
+    got_extension = true;
+  }
+
+  io.handshake();
+  if (!io.transferStopped()) io.send(data, size);
+}
+
+
+/*
+ * Receives one file by hybrid ARQ
+ *
+ * Outputs:
+ *  false if the computer gave up on the file
+ */
+bool receiveHarq() {
+  got_extension = false;
+  harq.begin(io.getAddressBytes(), deliverHarq, nullptr);
+
+  while (harq.step()) {
+    if (io.checkControl()) return false;
+  }
+  return true;
+}
+#endif
+
+
+#if RENDEZVOUS
+/*
+ * Listens on the discovery channel until a sender invites us onto its
+ * link, which replaces the configured one
+ *
+ * Outputs:
+ *  false if the computer gave up on the file
+ */
+bool waitForInvite() {
+  uint8_t channel;
+  uint8_t address[ADDRESS_BYTES];
+  char payload[FIFO_SIZE_BYTES];
+
+  listenForInvite(radio);
+  while (!io.checkControl()) {
+    if (!radio.available()) continue;
+    radio.read(payload, FIFO_SIZE_BYTES);
+
+    if (payload[0] == RENDEZVOUS_CHAR && joinSender(radio, payload, channel, address)) {
+      io.setLink(channel, address);
+      radio.setRetries(PROFILE_RETRY_DELAY, PROFILE_RETRY_COUNT);  // the join left them short
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
+
+#if SESSION_NEGOTIATE
+/*
+ * Answers the sender's offers at the base rate until it confirms a
+ * session and checks it at the agreed rate.  Every receiving script
+ * decompresses, so we always take compressed files.
+ *
+ * Outputs:
+ *  false if the computer gave up on the file
+ */
+bool negotiate() {
+  session_caps_t ours {SESSION_VERSION, PROFILE_DATA_RATE, SESSION_LZMA, PROFILE_HARQ_WINDOW, PAYLOAD_FILE_BYTES};
+  if (HARQ_MODE) ours.features |= SESSION_HARQ;
+
+  session = {};
+  radio.setDataRate((radio_data_rate_e) SESSION_BASE_RATE);
+
+  char payload[FIFO_SIZE_BYTES];
+  while (!io.checkControl()) {
+    if (!radio.available()) continue;
+    radio.read(payload, FIFO_SIZE_BYTES);
+
+    if (payload[0] == SESSION_CHAR &&
+        answerSession(radio, payload, io.getAddressBytes(), ours, session)) {
+      radio.setDataRate((radio_data_rate_e) session.max_rate);
+      if (checkSession(radio)) return true;
+
+      /* the confirm's ACK was lost, the sender offers again at the base rate */
+      session = {};
+      radio.setDataRate((radio_data_rate_e) SESSION_BASE_RATE);
+    }
+  }
+  return false;
+}
+#endif
+
+
+#if DIVERSITY
+/*
+ * Brings the second radio up as the first is, and has both listen for the
+ * file, the second on the paired channel
+ */
+void startDiversity() {
+  second.begin();
+  second.setAddressWidth(ADDRESS_BYTES);
+  second.setPALevel(RADIO_PA_MAX);
+  second.setDataRate(SESSION_NEGOTIATE ? (radio_data_rate_e) session.max_rate : PROFILE_DATA_RATE);
+  diversity.begin(io.getChannel(), diversityChannel(io.getChannel()), io.getAddressBytes());
+}
+
+
+/*
+ * Tells the computer what each radio had first, the copies dropped and
+ * the payloads neither heard, on one line
+ */
+void reportDiversity() {
+  Serial.print(diversity.getFirst(0));
+  Serial.print(',');
+  Serial.print(diversity.getFirst(1));
+  Serial.print(',');
+  Serial.print(diversity.getDuplicates());
+  Serial.print(',');
+  Serial.println(diversity.getMissed());
+  Serial.print(HANDSHAKE_CHAR);
+}
+#endif
+
+
+/*
+ * Whether a payload of the file is waiting, off either radio with DIVERSITY
+ */
+bool payloadAvailable() {
+#if DIVERSITY
+  return diversity.available();
+#else
+  return radio.available();
+#endif
+}
+
+
+/*
+ * Reads it into FIFO_BUFFER
+ */
+void readPayload() {
+#if DIVERSITY
+  diversity.read(FIFO_BUFFER);
+#else
+  radio.read(FIFO_BUFFER, FIFO_SIZE_BYTES);
+#endif
+}
 
 
 void setup() {
   SPI.begin();
   Serial.begin(BAUD_RATE);
+  io.enableControl();  // without it a transfer always runs to the end
 }
 
 
@@ -26,22 +386,157 @@ void loop() {
   radio.setAddressWidth(ADDRESS_BYTES);
   radio.setChannel(io.getChannel());
   radio.openReadingPipe(0, io.getAddressBytes());
-  radio.setPALevel(RF24_PA_MAX);
-  radio.setDataRate(RF24_250KBPS);
+  radio.setPALevel(RADIO_PA_MAX);
+  radio.setDataRate(PROFILE_DATA_RATE);
   radio.startListening();
 
+#if PULL_MODE
+  pull();
+  radio.stopListening();
+  io.softReset();
+  return;
+#endif
+
+#if AGGREGATE
+  receiveMessages();
+  radio.stopListening();
+  io.softReset();
+  return;
+#endif
+
+#if RELAY_MODE
+  sinkRouted();
+  radio.stopListening();
+  io.softReset();
+  return;
+#endif
+
+#if RENDEZVOUS
+  if (!waitForInvite()) {
+    radio.stopListening();
+    io.softReset();
+    return;
+  }
+#endif
+
+#if SESSION_NEGOTIATE
+  if (!negotiate()) {
+    radio.stopListening();
+    io.softReset();
+    return;
+  }
+#endif
+
+#if HARQ_MODE
+  if (useHarq()) {
+    if (!receiveHarq()) {
+      radio.stopListening();
+      io.softReset();
+      return;
+    }
+
+    io.handshake();
+    io.send(END_CHAR); // transmission over
+    radio.stopListening();
+    io.softReset();
+    return;
+  }
+#endif
+
+#if DIVERSITY
+  startDiversity();
+#endif
+
+  /*
+   * The last payload of a file may be short, which we only learn from the
+   * END_CHAR payload after it, so every file payload is held back until the
+   * next one arrives
+   */
+  char held[FIFO_SIZE_BYTES];
+  bool holding {false};
+  bool got_extension {false};
+
   /* Send file and extension in chunks until told to stop */
   while (FIFO_BUFFER[0] != END_CHAR) {
-    if (radio.available(0)) {
-      radio.read(FIFO_BUFFER, FIFO_SIZE_BYTES);
+    /* the computer gave up on the file */
+    if (io.checkControl()) {
+      radio.stopListening();
+      io.softReset();
+      FIFO_BUFFER[0] = 'g';
+      return;
+    }
+
+    if (payloadAvailable()) {
+#if LATENCY_STAMP
+      uint32_t got = micros();
+#endif
+      readPayload();
+
+#if LINK_TRACE
+      trace.record(seq++, io.getChannel(), TRACE_RX);
+#endif
+
+#if LATENCY_STAMP
+      /* the sender aligns our clocks before every file */
+      if (FIFO_BUFFER[0] == LATENCY_SYNC_CHAR) {
+        answerLatencySync(radio, FIFO_BUFFER, got, io.getAddressBytes());
+        continue;
+      }
 
-      if (FIFO_BUFFER[0] != END_CHAR) {
+      /* a delay below zero is the clocks drifting apart since, count it as none */
+      int32_t delay = latencyOf(FIFO_BUFFER, got);
+      latency.record((delay > 0) ? delay : 0);
+#endif
+
+      /* the extension comes first, in a zero padded payload of its own */
+      if (!got_extension && FIFO_BUFFER[0] != END_CHAR) {
         io.handshake();
-        io.send(FIFO_BUFFER);
+        if (!io.transferStopped()) io.send(FIFO_BUFFER, strnlen(FIFO_BUFFER, PAYLOAD_FILE_BYTES));
+        got_extension = true;
+        continue;
       }
+
+      if (holding) {
+        uint32_t size = PAYLOAD_FILE_BYTES;
+        if (FIFO_BUFFER[0] == END_CHAR && FIFO_BUFFER[END_LENGTH_OFFSET] < PAYLOAD_FILE_BYTES) {
+          size = FIFO_BUFFER[END_LENGTH_OFFSET];
+        }
+
+        io.handshake();
+        if (!io.transferStopped()) io.send(held, size);
+      }
+
+      memcpy(held, FIFO_BUFFER, FIFO_SIZE_BYTES);
+      holding = FIFO_BUFFER[0] != END_CHAR;
     }
   }
 
   io.handshake();
   io.send(END_CHAR); // transmission over
+
+#if LINK_TRACE
+  /* hand the arrivals of this file to the computer */
+  io.handshake();
+  trace.dump();
+  trace.clear();
+  seq = 0;
+#endif
+
+#if LATENCY_STAMP
+  /* the computer queries the file's latency with a handshake */
+  io.handshake();
+  latency.dump();
+  latency.clear();
+#endif
+
+#if DIVERSITY
+  /* the computer queries what each radio caught with a handshake */
+  io.handshake();
+  reportDiversity();
+#endif
+
+  /* ready for the next file, the computer may keep the port open for it */
+  radio.stopListening();
+  io.softReset();
+  FIFO_BUFFER[0] = 'g';
 }
@@ -14,8 +14,16 @@
 using namespace nRF24Module;
 
 nRF24::nRF24(uint8_t cePin, uint8_t csnPin) 
-    : cePin_(cePin), csnPin_(csnPin), txMode_(false)
+    : cePin_(cePin), csnPin_(csnPin), txMode_(false), autoAck_(false)
 {
+}
+
+void
+nRF24::begin()
+{
+    txMode_ = false;
+    autoAck_ = false;
+
     SPI.begin();
     pinMode(cePin_, OUTPUT);
     pinMode(csnPin_, OUTPUT);
@@ -27,7 +35,8 @@ nRF24::nRF24(uint8_t cePin, uint8_t csnPin)
     setAddressWidth(MAX_ADDRESS_WIDTH);
     
     setRegister(DYNPD, 0);
-    setRegister(FEATURE, 0);
+    /* writeSPI uploads with W_TX_PAYLOAD_NO_ACK, which needs EN_DYN_ACK */
+    setRegister(FEATURE, (1 << EN_DYN_ACK));
     
     /* when intialized the module will be in standby so that the user can configure */
     flushRXPayload();
@@ -55,7 +64,7 @@ nRF24::setToReceiver()
 
     /* set the PRIM_RX field to 1 and the CE pin to HIGH */
     byte data = 0b0000001;
-    setRegister(CONFIG, (getRegister(CONFIG | data)));
+    setRegister(CONFIG, (getRegister(CONFIG) | data));
     digitalWrite(cePin_, HIGH);
     /* delay for RX settings is 130 micro sec. so delay 1 ms */    
     delayMicroseconds(140);
@@ -106,44 +115,74 @@ nRF24::readSPI(byte * arr, uint32_t size)
     endTransaction();
 }
 
-void
+bool
 nRF24::writeSPI(char * arr, uint32_t size)
 {
     // write to the TX buffer when the CE pin is low
     digitalWrite(cePin_, LOW);
+    uploadPayload(arr, size);
 
-    beginTransaction();
+    digitalWrite(cePin_, HIGH);
+    uint8_t data = 0b00110000;
+    uint8_t result;
+    while (!((result = status()) & data)) {}
+
+    digitalWrite(cePin_, LOW);
+
+    flushTXPayload();
     
-    data_frame_u df = makeFrame(W_TX_PAYLOAD_NO_ACK, NO_DATA);
-    uint8_t status_data = SPI.transfer(df.atomic_frame.preamble);
+    setRegister(STATUS, data);
 
-#if DEBUG
-    Serial.print("Status is: ");
-    Serial.println(status_data);
-#endif
+    //flushTXPayload();
 
-    for (int i = 0; i < size; ++i) {
-        SPI.transfer(arr[i]);
-    }
+    /* TX_DS, MAX_RT is the other bit */
+    return result & 0b00100000;
+}
 
-    // a full 32 bytes need to be sent
-    for (int i = 4; i < 32; ++i) {
-        SPI.transfer(NO_DATA);
+bool
+nRF24::writeFastSPI(char * arr, uint32_t size)
+{
+    uint8_t tx_full = 0b00000001;   // TX_FULL of STATUS
+    uint8_t max_rt = 0b00010000;
+    uint8_t result;
+    bool delivered = true;
+
+    /* the payloads ahead keep going out while we wait for room */
+    while ((result = status()) & (tx_full | max_rt)) {
+        if (result & max_rt) {
+            /* the payload at the head would block the FIFO for good */
+            digitalWrite(cePin_, LOW);
+            flushTXPayload();
+            setRegister(STATUS, max_rt);
+            delivered = false;
+        }
     }
 
-    endTransaction();
-
+    uploadPayload(arr, size);
     digitalWrite(cePin_, HIGH);
-    uint8_t data = 0b00110000;
-    while (!(status() & data)) {}
 
-    digitalWrite(cePin_, LOW);
+    return delivered;
+}
+
+bool
+nRF24::txStandBy()
+{
+    uint8_t tx_empty_bit = 0b00010000; // of FIFO_STATUS
+    uint8_t max_rt = 0b00010000;
+    bool delivered = true;
 
+    while (!(getFIFOStatus(FIFO_STATUS) & tx_empty_bit)) {
+        if (status() & max_rt) {
+            delivered = false;
+            break;
+        }
+    }
+
+    digitalWrite(cePin_, LOW);
     flushTXPayload();
-    
-    setRegister(STATUS, data);
-    
-    //flushTXPayload();
+    setRegister(STATUS, 0b00110000);
+
+    return delivered;
 }
 
 void 
@@ -185,11 +224,11 @@ nRF24::setReadingPipeAddr(uint8_t pipe, uint8_t * address)
             break;
         case 4:
             data = RX_ADDR_P4;
-            payloadWidth = RX_ADDR_P4;
+            payloadWidth = RX_PW_P4;
             break;
         case 5:
             data = RX_ADDR_P5;
-            payloadWidth = RX_ADDR_P5;
+            payloadWidth = RX_PW_P5;
             break;
         default:
             data = RX_ADDR_P0;
@@ -209,6 +248,9 @@ nRF24::setReadingPipeAddr(uint8_t pipe, uint8_t * address)
     /* the FIFOs will use 32 bytes */
     uint8_t numBytes = 32;
     setRegister(payloadWidth, numBytes);
+
+    /* only pipes 0 and 1 are enabled out of reset */
+    setRegister(EN_RXADDR, (getRegister(EN_RXADDR) | (1 << pipe)));
 }
 
 data_frame_u
@@ -220,6 +262,35 @@ nRF24::makeFrame(uint8_t cmd, byte data)
     return df;
 }
 
+void
+nRF24::uploadPayload(char * arr, uint32_t size)
+{
+    beginTransaction();
+    
+    data_frame_u df = makeFrame(autoAck_ ? W_TX_PAYLOAD : W_TX_PAYLOAD_NO_ACK, NO_DATA);
+#if DEBUG
+    uint8_t status_data = SPI.transfer(df.atomic_frame.preamble);
+    Serial.print("Status is: ");
+    Serial.println(status_data);
+#else
+    SPI.transfer(df.atomic_frame.preamble);
+#endif
+
+    /*
+     * The payload goes out of the caller's buffer in one burst through the
+     * SPI data registers, rather than a transfer() per byte
+     */
+    static uint8_t padding[FIFO_SZ] {NO_DATA};
+    SPI.writeBytes((uint8_t *) arr, size);
+
+    // a full 32 bytes need to be sent
+    if (size < FIFO_SZ) {
+        SPI.writeBytes(padding, FIFO_SZ - size);
+    }
+
+    endTransaction();
+}
+
 void
 nRF24::setWritingAddress(uint8_t * address)
 {
@@ -295,15 +366,42 @@ nRF24::setAddressWidth(uint8_t aw)
     if (aw > MAX_ADDRESS_WIDTH || aw < MIN_ADDRESS_WIDTH) aw = MIN_ADDRESS_WIDTH;
     addressWidth_ = aw;
     // making sure that aw is formatted correctly
-    // to match the data sheet definition
-    aw = 0b11111100 & (0b11111100 | (aw-2));  
-    setRegister(SETUP_AW, (getRegister(SETUP_AW) & aw));
+    // to match the data sheet definition ('01' = 3 bytes ... '11' = 5 bytes)
+    aw = 0b00000011 & (aw - 2);
+    setRegister(SETUP_AW, ((getRegister(SETUP_AW) & 0b11111100) | aw));
 }
 
 void 
 nRF24::setDataRate(data_rate rate)
 {
-    setRegister(RF_SETUP, (getRegister(RF_SETUP) | rate));
+    /* clear both RF_DR bits first, '11' is not a valid rate */
+    uint8_t mask = ~((1 << RF_DR_0) | (1 << RF_DR_1));
+    setRegister(RF_SETUP, ((getRegister(RF_SETUP) & mask) | rate));
+}
+
+void
+nRF24::setPALevel(pa_level level)
+{
+    uint8_t mask = ~((1 << RF_PWR_0) | (1 << RF_PWR_1));
+    setRegister(RF_SETUP, ((getRegister(RF_SETUP) & mask) | level));
+}
+
+void
+nRF24::setRetries(uint8_t delay, uint8_t count)
+{
+    setRegister(SETUP_RETR, (((delay & 0x0F) << ARD_0) | ((count & 0x0F) << ARC_0)));
+}
+
+void
+nRF24::setAutoAck(bool enable)
+{
+    autoAck_ = enable;
+}
+
+uint8_t
+nRF24::getARC()
+{
+    return getRegister(OBSERVE_TX) & 0x0F;
 }
 
 void
@@ -411,6 +509,12 @@ nRF24::txFIFOFull()
     return (status & tx_full_bit) == full_val;
 }
 
+bool
+nRF24::carrierDetected()
+{
+    return getRegister(CD) & 0b00000001;
+}
+
 uint8_t 
 nRF24::status() 
 {
@@ -0,0 +1,163 @@
+#include <Arduino.h>
+#include <stdint.h>
+
+#include "nrf24_radio.h"
+
+using namespace nRF24Module;
+
+/* RX_P_NO in STATUS reads '111' while the RX FIFO is empty */
+#define RX_P_NO_EMPTY 0b00001110
+
+NRF24Radio::NRF24Radio(uint8_t cePin, uint8_t csnPin)
+    : radio_(cePin, csnPin), burst_(false)
+{
+}
+
+void
+NRF24Radio::begin()
+{
+    radio_.begin();
+    burst_ = false;
+
+    /* RF24 acknowledges by default, match it */
+    radio_.setAutoAck(true);
+}
+
+void
+NRF24Radio::setAddressWidth(uint8_t aw)
+{
+    radio_.setAddressWidth(aw);
+}
+
+void
+NRF24Radio::setChannel(uint8_t channel)
+{
+    radio_.setChannel(channel);
+}
+
+void
+NRF24Radio::setDataRate(radio_data_rate_e rate)
+{
+    switch (rate) {
+    case RADIO_1MBPS:
+        radio_.setDataRate(DATA_RATE_1MBPS);
+        break;
+    case RADIO_2MBPS:
+        radio_.setDataRate(DATA_RATE_2MBPS);
+        break;
+    default:
+        radio_.setDataRate(DATA_RATE_250KBPS);
+        break;
+    }
+}
+
+void
+NRF24Radio::setPALevel(radio_pa_level_e level)
+{
+    switch (level) {
+    case RADIO_PA_MIN:
+        radio_.setPALevel(PA_LEVEL_MIN);
+        break;
+    case RADIO_PA_LOW:
+        radio_.setPALevel(PA_LEVEL_LOW);
+        break;
+    case RADIO_PA_HIGH:
+        radio_.setPALevel(PA_LEVEL_HIGH);
+        break;
+    default:
+        radio_.setPALevel(PA_LEVEL_MAX);
+        break;
+    }
+}
+
+void
+NRF24Radio::setRetries(uint8_t delay, uint8_t count)
+{
+    radio_.setRetries(delay, count);
+}
+
+void
+NRF24Radio::setAutoAck(bool enable)
+{
+    radio_.setAutoAck(enable);
+}
+
+void
+NRF24Radio::openWritingPipe(uint8_t * address)
+{
+    /* the driver only takes a TX address while it is a transmitter */
+    endBurst();
+    radio_.setToTransmitter();
+    radio_.setWritingAddress(address);
+}
+
+void
+NRF24Radio::openReadingPipe(uint8_t pipe, uint8_t * address)
+{
+    radio_.setReadingPipeAddr(pipe, address);
+}
+
+void
+NRF24Radio::startListening()
+{
+    endBurst();
+    radio_.setToReceiver();
+}
+
+void
+NRF24Radio::stopListening()
+{
+    endBurst();
+    radio_.setToTransmitter();
+}
+
+bool
+NRF24Radio::write(const void * buf, uint8_t len)
+{
+    endBurst();
+    return radio_.writeSPI((char *) buf, len);
+}
+
+bool
+NRF24Radio::writeFast(const void * buf, uint8_t len)
+{
+    burst_ = true;
+    return radio_.writeFastSPI((char *) buf, len);
+}
+
+bool
+NRF24Radio::txStandBy()
+{
+    burst_ = false;
+    return radio_.txStandBy();
+}
+
+bool
+NRF24Radio::available()
+{
+    return (radio_.status() & RX_P_NO_EMPTY) != RX_P_NO_EMPTY;
+}
+
+void
+NRF24Radio::read(void * buf, uint8_t len)
+{
+    radio_.readSPI((byte *) buf, len);
+}
+
+uint8_t
+NRF24Radio::getARC()
+{
+    return radio_.getARC();
+}
+
+void
+NRF24Radio::endBurst()
+{
+    if (burst_) txStandBy();
+}
+
+const char *
+NRF24Radio::name()
+{
+    return "nRF24";
+}
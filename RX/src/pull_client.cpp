@@ -0,0 +1,124 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "pull_client.h"
+
+PullClient::PullClient(Radio & radio) : radio(radio) {}
+
+
+void
+PullClient::begin(uint8_t * address, uint8_t sources, uint8_t (* addresses)[PULL_ADDRESS_BYTES],
+                  pull_deliver_f deliver, void * ctx)
+{
+  this->sources = (sources < PULL_MAX_SOURCES) ? sources : PULL_MAX_SOURCES;
+  memcpy(this->address, address, PULL_ADDRESS_BYTES);
+  memcpy(source_addresses, addresses, this->sources * PULL_ADDRESS_BYTES);
+  this->deliver = deliver;
+  this->ctx = ctx;
+  size = 0;
+  memset(extension, 0, sizeof(extension));
+
+  radio.setRetries(PULL_REQUEST_RETRY_DELAY, 15);
+  radio.openReadingPipe(PULL_READING_PIPE, this->address);
+  radio.startListening();
+}
+
+
+bool
+PullClient::describe()
+{
+  char payload[PULL_PAYLOAD_BYTES];
+  uint32_t index;
+
+  for (uint8_t s = 0; s < sources; ++s) {
+    if (!request(s, PULL_INFO_BLOCK, 1)) continue;
+
+    uint32_t start = micros();
+    while (micros() - start < PULL_INFO_TIMEOUT_US) {
+      if (!receive(payload, &index) || index != PULL_INFO_BLOCK) continue;
+
+      char * info = payload + PULL_INDEX_BYTES;
+      size = pullGet32(info + PULL_INFO_SIZE_OFFSET);
+      memcpy(extension, info + PULL_INFO_EXTENSION_OFFSET, PULL_INFO_EXTENSION_BYTES);
+      scheduler.begin((size + PULL_BLOCK_BYTES - 1) / PULL_BLOCK_BYTES, sources);
+      return true;
+    }
+  }
+  return false;
+}
+
+
+bool
+PullClient::step()
+{
+  char payload[PULL_PAYLOAD_BYTES];
+  uint32_t index;
+
+  while (receive(payload, &index)) {
+    if (!scheduler.received(index, micros())) continue;
+
+    uint32_t offset = index * PULL_BLOCK_BYTES;
+    uint32_t left = size - offset;
+    deliver(ctx, offset, payload + PULL_INDEX_BYTES, (left < PULL_BLOCK_BYTES) ? left : PULL_BLOCK_BYTES);
+  }
+  if (scheduler.complete()) return false;
+
+  scheduler.update(micros());
+  for (uint8_t s = 0; s < sources; ++s) {
+    const pull_source_t * p = scheduler.getSource(s);
+
+    /* a source we cannot reach is caught by the stall timeout */
+    if (p->announce && request(s, p->first, p->count)) scheduler.announced(s, micros());
+  }
+  return true;
+}
+
+
+uint32_t
+PullClient::getSize()
+{
+  return size;
+}
+
+
+char *
+PullClient::getExtension()
+{
+  return extension;
+}
+
+
+PullScheduler &
+PullClient::getScheduler()
+{
+  return scheduler;
+}
+
+
+bool
+PullClient::request(uint8_t source, uint32_t first, uint32_t count)
+{
+  char payload[PULL_PAYLOAD_BYTES] {PULL_REQUEST};
+  pullPut32(payload + PULL_FIRST_OFFSET, first);
+  pullPut32(payload + PULL_COUNT_OFFSET, count);
+  memcpy(payload + PULL_REPLY_OFFSET, address, PULL_ADDRESS_BYTES);
+
+  /* half duplex: blocks sent to us meanwhile are retransmitted by their source */
+  radio.stopListening();
+  radio.openWritingPipe(source_addresses[source]);
+  bool acked = radio.write(payload, PULL_PAYLOAD_BYTES);
+  radio.startListening();
+
+  return acked;
+}
+
+
+bool
+PullClient::receive(char * payload, uint32_t * index)
+{
+  if (!radio.available()) return false;
+
+  radio.read(payload, PULL_PAYLOAD_BYTES);
+  *index = pullGet32(payload);
+  return true;
+}
@@ -0,0 +1,198 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "pull_scheduler.h"
+
+PullScheduler::PullScheduler() {}
+
+
+void
+PullScheduler::begin(uint32_t blocks, uint8_t sources)
+{
+  this->blocks = (blocks < PULL_MAX_BLOCKS) ? blocks : PULL_MAX_BLOCKS;
+  this->sources = (sources < PULL_MAX_SOURCES) ? sources : PULL_MAX_SOURCES;
+  missing = this->blocks;
+  scan_from = 0;
+
+  memset(have, 0, sizeof(have));
+  memset(progress, 0, sizeof(progress));
+}
+
+
+void
+PullScheduler::update(uint32_t now_us)
+{
+  for (uint8_t s = 0; s < sources; ++s) {
+    pull_source_t * p = &progress[s];
+    if (p->count && now_us - p->last_us > PULL_STALL_US) {
+      release(s);
+      if (p->failures < 5) ++p->failures;
+      p->retry_us = now_us + (PULL_STALL_US << p->failures);
+    }
+  }
+
+  for (uint8_t s = 0; s < sources && missing; ++s) {
+    pull_source_t * p = &progress[s];
+    if (p->count || (int32_t) (now_us - p->retry_us) < 0) continue;
+
+    if (!assign(s, now_us)) steal(s, now_us);
+  }
+}
+
+
+bool
+PullScheduler::received(uint32_t block, uint32_t now_us)
+{
+  if (block >= blocks) return false;
+
+  bool fresh = !has(block);
+  if (fresh) {
+    have[block >> 3] |= (1 << (block & 7));
+    --missing;
+  }
+
+  int8_t s = owner(block);
+  if (s < 0) return fresh;
+
+  pull_source_t * p = &progress[s];
+  ++p->blocks;
+  if (fresh) ++p->fresh;
+  p->last_us = now_us;
+  p->failures = 0;
+  if (block + 1 > p->next) p->next = block + 1;
+
+  /* blocks come in order, so the last one ends the range; any lost go back */
+  if (p->next >= p->first + p->count) release(s);
+
+  return fresh;
+}
+
+
+void
+PullScheduler::announced(uint8_t source, uint32_t now_us)
+{
+  progress[source].announce = false;
+  progress[source].last_us = now_us;
+}
+
+
+bool
+PullScheduler::complete()
+{
+  return !missing;
+}
+
+
+const pull_source_t *
+PullScheduler::getSource(uint8_t source)
+{
+  return &progress[source];
+}
+
+
+uint32_t
+PullScheduler::getMissing()
+{
+  return missing;
+}
+
+
+bool
+PullScheduler::has(uint32_t block)
+{
+  return have[block >> 3] & (1 << (block & 7));
+}
+
+
+int8_t
+PullScheduler::owner(uint32_t block)
+{
+  for (uint8_t s = 0; s < sources; ++s) {
+    pull_source_t * p = &progress[s];
+    if (p->count && block >= p->first && block < p->first + p->count) return s;
+  }
+  return -1;
+}
+
+
+void
+PullScheduler::release(uint8_t source)
+{
+  pull_source_t * p = &progress[source];
+
+  /* whatever of it is still missing is up for grabs again */
+  if (p->first < scan_from) scan_from = p->first;
+  p->count = 0;
+  p->announce = false;
+}
+
+
+bool
+PullScheduler::assign(uint8_t source, uint32_t now_us)
+{
+  /* lowest block nobody has and nobody is sending */
+  uint32_t first = scan_from;
+  while (first < blocks) {
+    if (!(first & 7) && have[first >> 3] == 0xff) {
+      first += 8;
+      continue;
+    }
+    if (has(first)) {
+      ++first;
+      continue;
+    }
+
+    int8_t s = owner(first);
+    if (s < 0) break;
+    first = progress[s].first + progress[s].count;
+  }
+  scan_from = first;
+  if (first >= blocks) return false;
+
+  uint32_t end = first + 1;
+  while (end < blocks && end - first < PULL_RANGE_BLOCKS && !has(end) && owner(end) < 0) ++end;
+
+  pull_source_t * p = &progress[source];
+  p->first = p->next = first;
+  p->count = end - first;
+  p->announce = true;
+  p->last_us = now_us;
+  return true;
+}
+
+
+bool
+PullScheduler::steal(uint8_t source, uint32_t now_us)
+{
+  /* the source with the most left to send is the slowest */
+  int8_t victim {-1};
+  uint32_t most {0};
+  for (uint8_t s = 0; s < sources; ++s) {
+    pull_source_t * p = &progress[s];
+    if (s == source || !p->count) continue;
+
+    uint32_t remaining = p->first + p->count - p->next;
+    if (remaining > most) {
+      most = remaining;
+      victim = s;
+    }
+  }
+  if (victim < 0 || most < 2 * PULL_STEAL_MIN_BLOCKS) return false;
+
+  pull_source_t * v = &progress[victim];
+  uint32_t end = v->first + v->count;
+  uint32_t mid = v->next + most / 2;
+
+  /* anything it lost before its progress goes back to the pool */
+  if (v->first < scan_from) scan_from = v->first;
+  v->first = v->next;
+  v->count = mid - v->next;
+  v->announce = true;
+
+  pull_source_t * p = &progress[source];
+  p->first = p->next = mid;
+  p->count = end - mid;
+  p->announce = true;
+  p->last_us = now_us;
+  return true;
+}
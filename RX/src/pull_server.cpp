@@ -0,0 +1,68 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "pull_server.h"
+
+PullServer::PullServer(Radio & radio) : radio(radio) {}
+
+
+void
+PullServer::begin(uint8_t * address, uint32_t size, const char * extension, pull_read_f read, void * ctx)
+{
+  memcpy(this->address, address, PULL_ADDRESS_BYTES);
+  this->size = size;
+  memcpy(this->extension, extension, PULL_INFO_EXTENSION_BYTES);
+  this->read = read;
+  this->ctx = ctx;
+  next = left = 0;
+
+  radio.openReadingPipe(PULL_READING_PIPE, this->address);
+  radio.startListening();
+}
+
+
+bool
+PullServer::poll()
+{
+  char payload[PULL_PAYLOAD_BYTES];
+
+  while (radio.available()) {
+    radio.read(payload, PULL_PAYLOAD_BYTES);
+    if (payload[PULL_TYPE_OFFSET] != PULL_REQUEST) continue;
+
+    /* a new range replaces the old one, whatever was left of it */
+    next = pullGet32(payload + PULL_FIRST_OFFSET);
+    left = pullGet32(payload + PULL_COUNT_OFFSET);
+    memcpy(reply, payload + PULL_REPLY_OFFSET, PULL_ADDRESS_BYTES);
+  }
+  return left;
+}
+
+
+bool
+PullServer::sendNext()
+{
+  char payload[PULL_PAYLOAD_BYTES] {};
+  pullPut32(payload, next);
+
+  if (next == PULL_INFO_BLOCK) {
+    char * info = payload + PULL_INDEX_BYTES;
+    pullPut32(info + PULL_INFO_SIZE_OFFSET, size);
+    memcpy(info + PULL_INFO_EXTENSION_OFFSET, extension, PULL_INFO_EXTENSION_BYTES);
+  } else if (next >= (size + PULL_BLOCK_BYTES - 1) / PULL_BLOCK_BYTES || !read(ctx, next, payload + PULL_INDEX_BYTES)) {
+    left = 0;
+    return false;
+  }
+
+  radio.stopListening();
+  radio.openWritingPipe(reply);
+  bool acked = radio.write(payload, PULL_PAYLOAD_BYTES);
+
+  /* pipe 0 took the receiver's address for the ACK, and would take in (and ack) the other sources' blocks */
+  radio.openReadingPipe(0, address);
+  radio.startListening();
+
+  ++next;
+  --left;
+  return acked;
+}
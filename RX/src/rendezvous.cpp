@@ -0,0 +1,177 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "rendezvous.h"
+
+const uint8_t RENDEZVOUS_ADDRESS[RENDEZVOUS_ADDRESS_BYTES] {0xC7, 0x96, 0x13, 0xB9};
+
+
+/*
+ * 32 random bits: from the ESP32's hardware generator, or the core's
+ * random() (seeded by the simulator) elsewhere.  micros() is mostly zero
+ * bytes this soon after boot, and the same on boards booted together.
+ */
+static uint32_t
+randomWord()
+{
+#if defined(ESP32)
+  return esp_random();
+#else
+  return ((uint32_t) random(0x10000) << 16) | (uint32_t) random(0x10000);
+#endif
+}
+
+
+/*
+ * Whether a random word is fit for a receiving pipe's address: many bit
+ * transitions, no long runs, and no byte like the preamble or like noise
+ */
+static bool
+fitAddress(uint32_t address)
+{
+  uint8_t transitions {0};
+  uint8_t run {1};
+  for (uint8_t i = 1; i < 32; ++i) {
+    bool same = ((address >> i) & 1) == ((address >> (i - 1)) & 1);
+    run = same ? run + 1 : 1;
+    transitions += !same;
+    if (run > RENDEZVOUS_MAX_RUN) return false;
+  }
+
+  for (uint8_t i = 0; i < 4; ++i) {
+    uint8_t octet = address >> (8 * i);
+    if (octet == 0x00 || octet == 0xFF || octet == 0x55 || octet == 0xAA) return false;
+  }
+  return transitions >= RENDEZVOUS_MIN_TRANSITIONS;
+}
+
+
+/* -----Sender----- */
+
+bool
+inviteReceiver(Radio & radio, uint8_t channel, uint8_t * address, uint8_t * reply)
+{
+  char invite[RENDEZVOUS_PAYLOAD_BYTES] {};
+  char join[RENDEZVOUS_PAYLOAD_BYTES];
+  uint32_t nonce = randomWord();
+
+  invite[0] = RENDEZVOUS_CHAR;
+  RendezvousType::put(invite, RENDEZVOUS_INVITE);
+  RendezvousChannel::put(invite, channel);
+  memcpy(invite + RENDEZVOUS_LINK_OFFSET, address, RENDEZVOUS_ADDRESS_BYTES);
+  RendezvousNonce::put(invite, nonce);
+
+  /* senders inviting in step with each other would collide every time */
+  delayMicroseconds(random(RENDEZVOUS_JITTER_US));
+
+  /* without ACKs, which every idle receiver would send at once */
+  radio.stopListening();
+  radio.setChannel(RENDEZVOUS_CHANNEL);
+  radio.openWritingPipe((uint8_t *) RENDEZVOUS_ADDRESS);
+  radio.setAutoAck(false);
+  radio.write(invite, RENDEZVOUS_PAYLOAD_BYTES);
+  radio.setAutoAck(true);
+
+  radio.setChannel(channel);
+  radio.openReadingPipe(RENDEZVOUS_READING_PIPE, reply);
+  radio.startListening();
+
+  bool joined {false};
+  uint32_t invited = micros();
+  while (!joined && micros() - invited < RENDEZVOUS_JOIN_TIMEOUT_US) {
+    if (!radio.available()) continue;
+    radio.read(join, RENDEZVOUS_PAYLOAD_BYTES);
+
+    /* the join of an earlier invite, from a receiver that gave up on it */
+    joined = join[0] == RENDEZVOUS_CHAR && RendezvousType::get(join) == RENDEZVOUS_JOIN &&
+             RendezvousNonce::get(join) == nonce;
+  }
+
+  /* the first receiver to join gets the link, the others time out */
+  radio.stopListening();
+  if (joined) {
+    RendezvousType::put(join, RENDEZVOUS_WELCOME);
+    radio.openWritingPipe((uint8_t *) join + RENDEZVOUS_JOINER_OFFSET);
+    joined = radio.write(join, RENDEZVOUS_PAYLOAD_BYTES);
+  }
+
+  radio.openWritingPipe(address);
+  if (joined) return true;
+
+  radio.setChannel(RENDEZVOUS_CHANNEL);
+  return false;
+}
+
+
+/* -----Receiver----- */
+
+void
+listenForInvite(Radio & radio)
+{
+  radio.stopListening();
+  radio.setChannel(RENDEZVOUS_CHANNEL);
+  radio.setAutoAck(false);
+  radio.openReadingPipe(0, (uint8_t *) RENDEZVOUS_ADDRESS);
+  radio.startListening();
+}
+
+
+bool
+joinSender(Radio & radio, const char * payload, uint8_t & channel, uint8_t * address)
+{
+  if (RendezvousType::get(payload) != RENDEZVOUS_INVITE) return false;
+
+  uint8_t link[RENDEZVOUS_ADDRESS_BYTES];
+  uint8_t reply[RENDEZVOUS_ADDRESS_BYTES];
+  memcpy(link, payload + RENDEZVOUS_LINK_OFFSET, RENDEZVOUS_ADDRESS_BYTES);
+  for (uint8_t i = 0; i < RENDEZVOUS_ADDRESS_BYTES; ++i) reply[i] = ~link[i];
+
+  /* the invite with our type and nonce, the sender checks its own */
+  char join[RENDEZVOUS_PAYLOAD_BYTES];
+  char welcome[RENDEZVOUS_PAYLOAD_BYTES];
+  uint32_t joiner;
+  do {
+    joiner = randomWord();
+  } while (!fitAddress(joiner));
+  memcpy(join, payload, RENDEZVOUS_PAYLOAD_BYTES);
+  RendezvousType::put(join, RENDEZVOUS_JOIN);
+  RendezvousJoiner::put(join, joiner);
+
+  radio.stopListening();
+  radio.setChannel(RendezvousChannel::get(payload));
+  radio.setAutoAck(true);
+  radio.setRetries(RENDEZVOUS_RETRY_DELAY, RENDEZVOUS_RETRY_COUNT);
+  radio.openWritingPipe(reply);
+
+  /* other idle receivers heard the same invite, so do not all join at once */
+  delayMicroseconds(random(RENDEZVOUS_JITTER_US));
+
+  bool joined {false};
+  for (uint8_t tries = 0; tries < RENDEZVOUS_JOIN_TRIES && !joined; ++tries) {
+    joined = radio.write(join, RENDEZVOUS_PAYLOAD_BYTES);
+  }
+
+  /* the welcome comes to our nonce, so only we acknowledge it */
+  radio.openReadingPipe(0, (uint8_t *) join + RENDEZVOUS_JOINER_OFFSET);
+  radio.startListening();
+
+  bool welcomed {false};
+  uint32_t sent = micros();
+  while (joined && !welcomed && micros() - sent < RENDEZVOUS_JOIN_TIMEOUT_US) {
+    if (!radio.available()) continue;
+    radio.read(welcome, RENDEZVOUS_PAYLOAD_BYTES);
+    welcomed = welcome[0] == RENDEZVOUS_CHAR && RendezvousType::get(welcome) == RENDEZVOUS_WELCOME;
+  }
+
+  if (!welcomed) {
+    listenForInvite(radio);
+    return false;
+  }
+
+  channel = RendezvousChannel::get(payload);
+  memcpy(address, link, RENDEZVOUS_ADDRESS_BYTES);
+  radio.stopListening();
+  radio.openReadingPipe(0, address);
+  radio.startListening();
+  return true;
+}
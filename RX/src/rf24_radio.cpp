@@ -0,0 +1,158 @@
+#include <stdint.h>
+#include <RF24.h>
+
+#include "rf24_radio.h"
+
+RF24Radio::RF24Radio(uint8_t cePin, uint8_t csnPin)
+    : radio_(cePin, csnPin), burst_(false)
+{
+}
+
+void
+RF24Radio::begin()
+{
+    radio_.begin();
+    burst_ = false;
+}
+
+void
+RF24Radio::setAddressWidth(uint8_t aw)
+{
+    radio_.setAddressWidth(aw);
+}
+
+void
+RF24Radio::setChannel(uint8_t channel)
+{
+    radio_.setChannel(channel);
+}
+
+void
+RF24Radio::setDataRate(radio_data_rate_e rate)
+{
+    switch (rate) {
+    case RADIO_1MBPS:
+        radio_.setDataRate(RF24_1MBPS);
+        break;
+    case RADIO_2MBPS:
+        radio_.setDataRate(RF24_2MBPS);
+        break;
+    default:
+        radio_.setDataRate(RF24_250KBPS);
+        break;
+    }
+}
+
+void
+RF24Radio::setPALevel(radio_pa_level_e level)
+{
+    switch (level) {
+    case RADIO_PA_MIN:
+        radio_.setPALevel(RF24_PA_MIN);
+        break;
+    case RADIO_PA_LOW:
+        radio_.setPALevel(RF24_PA_LOW);
+        break;
+    case RADIO_PA_HIGH:
+        radio_.setPALevel(RF24_PA_HIGH);
+        break;
+    default:
+        radio_.setPALevel(RF24_PA_MAX);
+        break;
+    }
+}
+
+void
+RF24Radio::setRetries(uint8_t delay, uint8_t count)
+{
+    radio_.setRetries(delay, count);
+}
+
+void
+RF24Radio::setAutoAck(bool enable)
+{
+    radio_.setAutoAck(enable);
+}
+
+void
+RF24Radio::openWritingPipe(uint8_t * address)
+{
+    endBurst();
+    radio_.openWritingPipe(address);
+}
+
+void
+RF24Radio::openReadingPipe(uint8_t pipe, uint8_t * address)
+{
+    radio_.openReadingPipe(pipe, address);
+}
+
+void
+RF24Radio::startListening()
+{
+    endBurst();
+    radio_.startListening();
+}
+
+void
+RF24Radio::stopListening()
+{
+    endBurst();
+    radio_.stopListening();
+}
+
+bool
+RF24Radio::write(const void * buf, uint8_t len)
+{
+    endBurst();
+    return radio_.write(buf, len);
+}
+
+bool
+RF24Radio::writeFast(const void * buf, uint8_t len)
+{
+    burst_ = true;
+    if (radio_.writeFast(buf, len)) return true;
+
+    /* MAX_RT leaves the payload blocking the FIFO: drop it and queue ours */
+    radio_.txStandBy();
+    radio_.writeFast(buf, len);
+    return false;
+}
+
+bool
+RF24Radio::txStandBy()
+{
+    burst_ = false;
+    return radio_.txStandBy();
+}
+
+bool
+RF24Radio::available()
+{
+    return radio_.available();
+}
+
+void
+RF24Radio::read(void * buf, uint8_t len)
+{
+    radio_.read(buf, len);
+}
+
+uint8_t
+RF24Radio::getARC()
+{
+    return radio_.getARC();
+}
+
+void
+RF24Radio::endBurst()
+{
+    if (burst_) txStandBy();
+}
+
+const char *
+RF24Radio::name()
+{
+    return "RF24";
+}
@@ -0,0 +1,407 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "route.h"
+
+Router::Router(Radio & radio) : radio(radio) {}
+
+
+void
+Router::begin(uint8_t id, const uint8_t * mesh, bool sink, radio_data_rate_e rate, route_deliver_f deliver, void * ctx)
+{
+  this->id = id;
+  this->sink = sink;
+  this->deliver = deliver;
+  this->ctx = ctx;
+
+  count = 0;
+  recent_next = 0;
+  memset(recent, 0xff, sizeof(recent));
+  parent = ROUTE_NONE;
+  cost = sink ? 0 : ROUTE_COST_MAX;
+  forwarded = 0;
+  dropped = 0;
+  duplicates = 0;
+  parent_changes = 0;
+
+  uint32_t airtime = airtimeUs(ROUTE_PAYLOAD_BITS, rate);
+  beacon_us = ROUTE_BEACON_AIRTIMES * airtime;
+  trigger_us = ROUTE_TRIGGER_AIRTIMES * airtime;
+  timeout_us = ROUTE_NEIGHBOR_BEACONS * beacon_us;
+
+  /* everyone beaconing at once would only collide */
+  last_beacon = micros();
+  next_beacon = last_beacon + random(beacon_us);
+
+  uint8_t broadcast[ROUTE_ADDRESS_BYTES];
+  memcpy(address, mesh, ROUTE_ADDRESS_BYTES);
+  memcpy(broadcast, mesh, ROUTE_ADDRESS_BYTES);
+  address[0] = id;
+  broadcast[0] = ROUTE_BROADCAST;
+
+  radio.stopListening();
+  radio.setAutoAck(true);
+  radio.setRetries(retryDelay(id, rate), ROUTE_RETRY_COUNT);
+  radio.openReadingPipe(ROUTE_READING_PIPE, address);
+  radio.openReadingPipe(ROUTE_BROADCAST_PIPE, broadcast);
+  radio.startListening();
+}
+
+
+void
+Router::step()
+{
+  char payload[ROUTE_PAYLOAD_BYTES];
+
+  if (radio.available()) {
+    radio.read(payload, ROUTE_PAYLOAD_BYTES);
+
+    if (payload[0] == ROUTE_CHAR) {
+      heard(payload);
+
+      if (RouteType::get(payload) == ROUTE_DATA && seen(payload)) {
+        ++duplicates;
+      } else if (RouteType::get(payload) == ROUTE_DATA) {
+        if (sink) {
+          if (deliver) deliver(ctx, RouteOrigin::get(payload), payload + ROUTE_DATA_OFFSET);
+        } else {
+          /* it thinks we are closer than it is: our cost went up since, or there is a loop */
+          if (RouteCost::get(payload) <= cost) hurry();
+
+          uint8_t ttl = RouteTtl::get(payload);
+          RouteTtl::put(payload, ttl - 1);
+          if (ttl && forward(payload)) {
+            ++forwarded;
+          } else {
+            ++dropped;
+          }
+        }
+      }
+    }
+  }
+
+  forget();
+
+  uint32_t now = micros();
+  if ((int32_t) (now - next_beacon) < 0) return;
+
+  header(payload, ROUTE_BEACON);
+  RouteParent::put(payload, parent);
+  transmit(ROUTE_BROADCAST, payload);
+  last_beacon = now;
+  next_beacon = now + beacon_us / 2 + random(beacon_us);
+
+  /*
+   * A neighbour that could be our parent and we have not measured yet,
+   * then the one measured longest ago.  Probing as soon as a neighbour is
+   * heard would have everyone who heard it probe it at once.
+   */
+  if (sink) return;
+
+  route_neighbor_t * probe = nullptr;
+  for (uint8_t i = 0; i < count; ++i) {
+    route_neighbor_t & n = neighbors[i];
+    if (n.cost == ROUTE_COST_MAX || n.parent == id) continue;
+    if (!probe || (!n.attempts && probe->attempts) ||
+        (!n.attempts == !probe->attempts && (int32_t) (n.probed - probe->probed) < 0)) {
+      probe = &n;
+    }
+  }
+
+  if (!probe) return;
+  probe->probed = now;
+  header(payload, ROUTE_PROBE);
+  RouteParent::put(payload, parent);
+  transmit(probe->id, payload);
+}
+
+
+bool
+Router::send(const char * data)
+{
+  if (sink) {
+    if (deliver) deliver(ctx, id, data);
+    return true;
+  }
+
+  char payload[ROUTE_PAYLOAD_BYTES];
+  header(payload, ROUTE_DATA);
+  RouteOrigin::put(payload, id);
+  RouteTtl::put(payload, ROUTE_MAX_HOPS);
+  RouteSeq::put(payload, seq++);
+  memcpy(payload + ROUTE_DATA_OFFSET, data, ROUTE_DATA_BYTES);
+  seen(payload);  // in case a loop brings it back
+
+  if (forward(payload)) return true;
+  ++dropped;
+  return false;
+}
+
+
+uint16_t
+Router::linkEtx(const route_neighbor_t & n)
+{
+  if (!n.acked) return ROUTE_COST_MAX;
+
+  uint32_t etx = (uint32_t) n.attempts * ROUTE_ETX_ONE / n.acked;
+  return (etx < ROUTE_COST_MAX) ? etx : ROUTE_COST_MAX - 1;
+}
+
+
+uint32_t
+Router::airtimeUs(uint32_t bits, radio_data_rate_e rate)
+{
+  uint32_t kbps = (rate == RADIO_2MBPS) ? 2000 : (rate == RADIO_1MBPS) ? 1000 : 250;
+  return (bits * 1000 + kbps - 1) / kbps;
+}
+
+
+uint8_t
+Router::retryDelay(uint8_t id, radio_data_rate_e rate)
+{
+  /*
+   * The ACK has to be in before ARD runs out, 500 us at 250 kbps as the
+   * datasheet has it; neighbours writing to each other at once would retry
+   * in step, so ids stagger ARD by a payload's airtime
+   */
+  uint32_t ack = ROUTE_TURNAROUND_US + airtimeUs(ROUTE_ACK_BITS, rate);
+  uint32_t step = airtimeUs(ROUTE_PAYLOAD_BITS, rate);
+  uint32_t delay = (ack - 1) / ROUTE_ARD_STEP_US
+                   + (id % ROUTE_RETRY_STAGGER) * ((step + ROUTE_ARD_STEP_US - 1) / ROUTE_ARD_STEP_US);
+  return (delay < ROUTE_MAX_RETRY_DELAY) ? delay : ROUTE_MAX_RETRY_DELAY;
+}
+
+
+/* -----Getters----- */
+
+uint8_t
+Router::getParent()
+{
+  return parent;
+}
+
+uint16_t
+Router::getCost()
+{
+  return cost;
+}
+
+uint8_t
+Router::getNeighbors()
+{
+  return count;
+}
+
+const route_neighbor_t *
+Router::getNeighbor(uint8_t i)
+{
+  return (i < count) ? &neighbors[i] : nullptr;
+}
+
+uint32_t
+Router::getForwarded()
+{
+  return forwarded;
+}
+
+uint32_t
+Router::getDropped()
+{
+  return dropped;
+}
+
+uint32_t
+Router::getDuplicates()
+{
+  return duplicates;
+}
+
+uint32_t
+Router::getParentChanges()
+{
+  return parent_changes;
+}
+
+
+/* -----Neighbours----- */
+
+route_neighbor_t *
+Router::find(uint8_t from)
+{
+  for (uint8_t i = 0; i < count; ++i) {
+    if (neighbors[i].id == from) return &neighbors[i];
+  }
+  return nullptr;
+}
+
+
+bool
+Router::seen(const char * payload)
+{
+  uint16_t key = (RouteOrigin::get(payload) << 8) | RouteSeq::get(payload);
+  for (uint8_t i = 0; i < ROUTE_RECENT; ++i) {
+    if (recent[i] == key) return true;
+  }
+
+  recent[recent_next] = key;
+  recent_next = (recent_next + 1) % ROUTE_RECENT;
+  return false;
+}
+
+
+void
+Router::heard(const char * payload)
+{
+  uint8_t from = RouteFrom::get(payload);
+  if (from == id || from >= ROUTE_BROADCAST) return;
+
+  uint32_t now = micros();
+  route_neighbor_t * n = find(from);
+  if (!n) {
+    n = (count < ROUTE_MAX_NEIGHBORS) ? &neighbors[count++] : replace(RouteCost::get(payload));
+    if (!n) return;
+    *n = {from, ROUTE_NONE, ROUTE_COST_MAX, 0, 0, now, now};
+  }
+
+  n->cost = RouteCost::get(payload);
+  if (RouteType::get(payload) != ROUTE_DATA) n->parent = RouteParent::get(payload);
+  n->heard = now;
+  choose();
+}
+
+
+route_neighbor_t *
+Router::replace(uint16_t cost)
+{
+  route_neighbor_t * worst = nullptr;
+  for (uint8_t i = 0; i < count; ++i) {
+    route_neighbor_t & n = neighbors[i];
+    if (n.id == parent || n.cost <= cost) continue;
+    if (!worst || n.cost > worst->cost) worst = &n;
+  }
+  return worst;
+}
+
+
+void
+Router::forget()
+{
+  uint32_t now = micros();
+  bool changed {false};
+
+  for (uint8_t i = 0; i < count;) {
+    if (now - neighbors[i].heard < timeout_us) {
+      ++i;
+      continue;
+    }
+    neighbors[i] = neighbors[--count];
+    changed = true;
+  }
+  if (changed) choose();
+}
+
+
+void
+Router::choose()
+{
+  if (sink) return;
+
+  uint8_t best {ROUTE_NONE};
+  uint32_t best_cost {ROUTE_COST_MAX};
+  uint32_t current {ROUTE_COST_MAX};
+
+  for (uint8_t i = 0; i < count; ++i) {
+    const route_neighbor_t & n = neighbors[i];
+    uint16_t etx = linkEtx(n);
+
+    /* a neighbour routing through us is no way out */
+    if (n.cost == ROUTE_COST_MAX || etx == ROUTE_COST_MAX || n.parent == id) continue;
+
+    uint32_t via = (uint32_t) n.cost + etx;
+    if (n.id == parent) current = via;
+    if (via < best_cost) {
+      best = n.id;
+      best_cost = via;
+    }
+  }
+
+  /* our children hear of a new parent soon, of a cost drifting at the next beacon */
+  if (best != parent && (current == ROUTE_COST_MAX || best_cost + ROUTE_SWITCH_MARGIN <= current)) {
+    parent = best;
+    current = best_cost;
+    if (parent != ROUTE_NONE) ++parent_changes;
+    hurry();
+  }
+
+  cost = (current < ROUTE_COST_MAX) ? current : ROUTE_COST_MAX;
+}
+
+
+void
+Router::hurry()
+{
+  uint32_t soon = last_beacon + trigger_us + random(trigger_us);
+  if ((int32_t) (soon - next_beacon) < 0) next_beacon = soon;
+}
+
+
+/* -----Radio----- */
+
+void
+Router::header(char * payload, char type)
+{
+  memset(payload, 0, ROUTE_PAYLOAD_BYTES);
+  payload[0] = ROUTE_CHAR;
+  RouteType::put(payload, type);
+  RouteFrom::put(payload, id);
+  RouteCost::put(payload, cost);
+}
+
+
+bool
+Router::transmit(uint8_t to, const char * payload)
+{
+  uint8_t destination[ROUTE_ADDRESS_BYTES];
+  memcpy(destination, address, ROUTE_ADDRESS_BYTES);
+  destination[0] = to;
+
+  radio.stopListening();
+  radio.openWritingPipe(destination);
+  if (to == ROUTE_BROADCAST) radio.setAutoAck(false);
+  bool acked = radio.write(payload, ROUTE_PAYLOAD_BYTES);
+  if (to == ROUTE_BROADCAST) radio.setAutoAck(true);
+  /*
+   * Writing left pipe 0 on the neighbour's address, where we would take and
+   * ACK whatever others send it, colliding with its own ACK
+   */
+  radio.openReadingPipe(0, address);
+  radio.startListening();
+
+  route_neighbor_t * n = find(to);
+  if (!n) return acked;
+
+  /* OBSERVE_TX: the retransmits it took, the whole budget if it never got across */
+  n->attempts += acked ? radio.getARC() + 1 : ROUTE_FAIL_ATTEMPTS;
+  if (acked) ++n->acked;
+  if (n->attempts > ROUTE_ETX_WINDOW) {
+    n->attempts /= 2;
+    n->acked /= 2;
+  }
+  choose();
+  return acked;
+}
+
+
+bool
+Router::forward(char * payload)
+{
+  for (uint8_t tries = 0; tries < ROUTE_FORWARD_TRIES; ++tries) {
+    if (parent == ROUTE_NONE) return false;
+
+    /* our cost on the way out, so the parent can tell a loop */
+    RouteFrom::put(payload, id);
+    RouteCost::put(payload, cost);
+    if (transmit(parent, payload)) return true;
+  }
+  return false;
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#ifndef _DIVERSITY_H_
+#define _DIVERSITY_H_
+
+#include <stdint.h>
+#include "radio.h"
+#include "packet_schema.h"
+
+/*
+ * Diversity reception (DIVERSITY in the mains).  The RX board drives a
+ * second nRF24L01+ on the same SPI bus, with its own CE and CSN, a few
+ * centimetres from the first: a multipath fade at one antenna is seldom
+ * one at the other.  Both listen on the link's address, the second on
+ * the paired channel, and the receiver keeps the first copy of every
+ * payload either of them hears.
+ *
+ * Nothing is acknowledged, there is no way back to the sender.  On the
+ * same channel both radios hear the one copy the sender writes; on a
+ * paired channel the sender writes a copy on each, which costs twice the
+ * airtime but also rides out a fade of one frequency.  Every payload ends
+ * in a sequence number so that copies are told apart and losses counted.
+ */
+
+#define DIVERSITY_PAYLOAD_BYTES 32    // size of FIFO in bytes, as FIFO_SIZE_BYTES
+#define DIVERSITY_ADDRESS_BYTES 4     // address width, as ADDRESS_BYTES
+#define DIVERSITY_SEQ_BYTES 2
+#define DIVERSITY_SEQ_OFFSET (DIVERSITY_PAYLOAD_BYTES - DIVERSITY_SEQ_BYTES)
+#define DIVERSITY_FILE_BYTES DIVERSITY_SEQ_OFFSET  // file bytes left in a numbered payload
+#define DIVERSITY_RADIOS 2
+
+typedef PacketField<8 * DIVERSITY_SEQ_OFFSET, 8 * DIVERSITY_SEQ_BYTES> DiversitySeq;
+
+/* far enough apart to fade apart indoors, 0 puts both radios on the link's channel */
+#define DIVERSITY_CHANNEL_GAP 8
+#define DIVERSITY_END_COPIES 4        // the END of a file goes blind, so more than once
+
+
+/*
+ * Function diversityChannel() is the channel paired with `channel',
+ * DIVERSITY_CHANNEL_GAP above it or, near the top of the band, below
+ */
+uint8_t diversityChannel(uint8_t channel);
+
+
+/*
+ * DiversitySender numbers payloads and writes a copy on each channel
+ */
+class DiversitySender
+{
+public:
+  DiversitySender(Radio & radio);
+
+  /*
+   * Function begin() starts a file with the radio a transmitter to the
+   * receiver's address, turning ACKs off
+   *
+   * Params:
+   *  channel, paired:
+   *    the channels of the receiver's radios, the same for one copy
+   */
+  void begin(uint8_t channel, uint8_t paired);
+
+  /*
+   * Function send() writes a payload, DIVERSITY_FILE_BYTES of it ours,
+   * with the next sequence number
+   *
+   * Params:
+   *  copies:
+   *    times over, all with the one number
+   */
+  void send(const char * payload, uint8_t copies = 1);
+
+private:
+  Radio & radio;
+  uint8_t channels[DIVERSITY_RADIOS];
+  uint16_t seq {0};
+};
+
+
+/*
+ * DiversityReceiver reads both radios, keeping the first copy of every
+ * payload
+ */
+class DiversityReceiver
+{
+public:
+  DiversityReceiver(Radio & first, Radio & second);
+
+  /*
+   * Function begin() has both radios listen for a file on `address',
+   * DIVERSITY_ADDRESS_BYTES, with ACKs off.  Both radios must be set up
+   * otherwise, the first on `channel'.
+   */
+  void begin(uint8_t channel, uint8_t paired, uint8_t * address);
+
+  /*
+   * Function available() reads copies off the radios until one is of a
+   * payload newer than the last, which read() then hands over
+   */
+  bool available(void);
+  void read(char * payload);
+
+  /*
+   * Getters for the counts of the file so far: the payloads each radio
+   * had first, the copies dropped and the payloads neither heard
+   */
+  uint32_t getFirst(uint8_t radio);
+  uint32_t getDuplicates(void);
+  uint32_t getMissed(void);
+
+private:
+  Radio * radios[DIVERSITY_RADIOS];
+  char next[DIVERSITY_PAYLOAD_BYTES];
+  bool ready {false};
+  bool started {false};
+  uint16_t last {0};
+
+  uint32_t first[DIVERSITY_RADIOS] {};
+  uint32_t duplicates {0};
+  uint32_t missed {0};
+};
+
+#endif /* _DIVERSITY_H_ */
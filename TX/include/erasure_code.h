@@ -0,0 +1,75 @@
+#pragma once
+
+#ifndef _ERASURE_CODE_H_
+#define _ERASURE_CODE_H_
+
+#include <stdint.h>
+
+#define ERASURE_MAX_DATA 16      // data symbols per group
+#define ERASURE_MAX_PARITY 16    // parity symbols per group
+#define ERASURE_MAX_SYMBOLS (ERASURE_MAX_DATA + ERASURE_MAX_PARITY)
+#define ERASURE_MAX_SYMBOL_BYTES 32  // a FIFO
+
+
+/*
+ * ErasureCode is a systematic Reed-Solomon code over GF(2^8): k data
+ * symbols go out as they are, followed by parity symbols, and any k of
+ * them (whichever arrived) give the data back.  Parity symbol i is the
+ * sum of the data symbols weighted by row i of a Cauchy matrix, so every
+ * k rows of the code are independent.
+ *
+ * Symbols are indexed 0..k-1 for data and k.. for parity, and are all
+ * `size' bytes long, up to ERASURE_MAX_SYMBOL_BYTES.
+ */
+class ErasureCode
+{
+public:
+  ErasureCode();
+
+  /*
+   * Function encode() computes one parity symbol
+   *
+   * Params:
+   *  data, k:
+   *    the k data symbols of the group, one after the other
+   *  parity:
+   *    which parity symbol, 0..ERASURE_MAX_PARITY-1
+   *  size:
+   *    bytes per symbol
+   *  out:
+   *    where the parity symbol goes
+   */
+  void encode(const uint8_t * data, uint8_t k, uint8_t parity, uint8_t size, uint8_t * out);
+
+  /*
+   * Function decode() recovers the data symbols of a group
+   *
+   * Params:
+   *  symbols:
+   *    ERASURE_MAX_SYMBOLS slots of `size' bytes, by index; the missing
+   *    data symbols are written into their slots
+   *  have:
+   *    bit i set if symbol i arrived, at least k of them
+   *  k, size:
+   *    data symbols in the group and bytes per symbol
+   *
+   * Outputs:
+   *  false if fewer than k symbols arrived
+   */
+  bool decode(uint8_t * symbols, uint32_t have, uint8_t k, uint8_t size);
+
+private:
+  /* exp runs twice around the group so products need no modulo */
+  uint8_t gf_exp[512];
+  uint8_t gf_log[256];
+
+  uint8_t mul(uint8_t a, uint8_t b);
+  uint8_t inv(uint8_t a);
+
+  /*
+   * Weight of data symbol j in parity symbol i
+   */
+  uint8_t coefficient(uint8_t i, uint8_t j);
+};
+
+#endif /* _ERASURE_CODE_H_ */
@@ -4,8 +4,22 @@
  * when the receiver detects the configured at_cmd char.
  * 
  * See page 340 of the esp32 technical reference manual for more details.
+ *
+ * Serial (UART0) belongs to the Arduino core, including its interrupt, so
+ * the detection runs on UART1 instead: its RX is routed through the GPIO
+ * matrix to the same pin as UART0's, so it sees every byte the computer
+ * sends, and its interrupt is ours to allocate (SerialIO::enableControl()).
  */
 
+/* the UART doing the detection, see above */
+#define AT_CMD_UART_NUM 1
+#define AT_CMD_UART_BASE 0x3FF50000
+#define AT_CMD_UART_INTR_SOURCE ETS_UART1_INTR_SOURCE
+#define AT_CMD_RX_PIN 3  // Serial's RX pin on the Feather
+
+/* the idle and gap registers count APB clock cycles */
+#define APB_CYCLES_PER_US 80
+
 /* 
  * In UART_AT_CMD_PRECNT_REG register:
  * mask of the bits used to configure the idle-time duration before the first
@@ -82,13 +96,44 @@
  */
 #define UART_AT_CMD_CHAR_DET_INT_CLR_BIT 18
 
+/* 
+ * In UART_INT_ENA_REG and UART_INT_CLR_REG registers:
+ * bits of the UART_RXFIFO_FULL_INT interrupt, raised when the receiver's
+ * FIFO holds more than its threshold
+ * 
+ * Default: 0
+ */
+#define UART_RXFIFO_FULL_INT_BIT 0
+
+/* 
+ * In UART_CONF0_REG register:
+ * bit to reset the receiver's FIFO. UART1 only listens for at_cmd chars,
+ * so whatever else it received is thrown away.
+ * 
+ * Default: 0
+ */
+#define UART_RXFIFO_RST_BIT 17
+
+/* 
+ * In UART_CLKDIV_REG register:
+ * the baud rate divider of the APB clock, in 1/16ths. UART1 is otherwise
+ * left at its reset configuration, which is already 8N1.
+ * 
+ * Default: 0x2B6
+ */
+#define UART_CLKDIV_MASK 0xfffff
+#define UART_CLKDIV_FRAG_BIT 20
+
 
 /* pointers to important registers */
-#define UART_AT_CMD_PRECNT_REG   *reinterpret_cast<uint32_t *>(0x3FF40048)
-#define UART_AT_CMD_POSTCNT_REG  *reinterpret_cast<uint32_t *>(0x3FF4004C)
-#define UART_AT_CMD_GAPTOUT_REG  *reinterpret_cast<uint32_t *>(0x3FF40050)
-#define UART_AT_CMD_CHAR_REG     *reinterpret_cast<uint32_t *>(0X3FF40054)
-#define UART_INT_RAW_REG         *reinterpret_cast<uint32_t *>(0x3FF40004)
-#define UART_INT_ST_REG          *reinterpret_cast<uint32_t *>(0x3FF40008)
-#define UART_INT_ENA_REG         *reinterpret_cast<uint32_t *>(0x3FF4000C)
-#define UART_INT_CLR_REG         *reinterpret_cast<uint32_t *>(0x3FF40010)
\ No newline at end of file
+#define UART_AT_CMD_REG(offset)  *reinterpret_cast<volatile uint32_t *>(AT_CMD_UART_BASE + (offset))
+#define UART_AT_CMD_PRECNT_REG   UART_AT_CMD_REG(0x48)
+#define UART_AT_CMD_POSTCNT_REG  UART_AT_CMD_REG(0x4C)
+#define UART_AT_CMD_GAPTOUT_REG  UART_AT_CMD_REG(0x50)
+#define UART_AT_CMD_CHAR_REG     UART_AT_CMD_REG(0x54)
+#define UART_AT_CMD_CLKDIV_REG   UART_AT_CMD_REG(0x14)
+#define UART_AT_CMD_CONF0_REG    UART_AT_CMD_REG(0x20)
+#define UART_INT_RAW_REG         UART_AT_CMD_REG(0x04)
+#define UART_INT_ST_REG          UART_AT_CMD_REG(0x08)
+#define UART_INT_ENA_REG         UART_AT_CMD_REG(0x0C)
+#define UART_INT_CLR_REG         UART_AT_CMD_REG(0x10)
@@ -0,0 +1,242 @@
+#pragma once
+
+#ifndef _HARQ_H_
+#define _HARQ_H_
+
+#include <stdint.h>
+#include "radio.h"
+#include "erasure_code.h"
+#include "packet_schema.h"
+
+/*
+ * Hybrid ARQ transfer (HARQ_MODE in the mains).  The file goes out in
+ * groups of up to HARQ_GROUP_BLOCKS blocks, without ACKs: the data blocks
+ * of a group, then as many parity blocks (ErasureCode) as the loss seen so
+ * far calls for.  The sender then polls the receiver, which reports how
+ * many of the group's blocks it has and which data blocks it is missing;
+ * once it has as many as the group has data blocks it decodes the group.
+ * Otherwise only what it still needs goes out again, padded with parity
+ * for the loss expected on the way.
+ *
+ * HARQ_ARQ and HARQ_FEC run the same transfer as plain selective repeat
+ * (no parity) and as fixed parity without feedback, for comparison.
+ */
+
+#define HARQ_PAYLOAD_BYTES 32       // size of FIFO in bytes, as FIFO_SIZE_BYTES
+#define HARQ_ADDRESS_BYTES 4        // address width, as ADDRESS_BYTES
+#define HARQ_GROUP_BLOCKS ERASURE_MAX_DATA
+#define HARQ_READING_PIPE 1         // pipe 0 takes the ACK address of whatever we write
+
+/* block payload, sender -> receiver: group, index (data first, then parity), data blocks of the group */
+typedef PacketField<0, 16> HarqGroup;
+typedef PacketFieldAfter<HarqGroup, 8> HarqIndex;
+typedef PacketFieldAfter<HarqIndex, 8> HarqCount;
+typedef PacketLayout<HARQ_PAYLOAD_BYTES, HarqGroup, HarqIndex, HarqCount> HarqHeader;
+
+#define HARQ_HEADER_BYTES HarqHeader::BYTES
+#define HARQ_BLOCK_BYTES HarqHeader::DATA_BYTES
+
+/*
+ * Poll payload, sender -> receiver: a block payload with index HARQ_POLL,
+ * the round it ends in place of the count and the address to report to.
+ * HARQ_END is a poll that ends the file, with the bytes of the file's last
+ * block in place of the round.
+ */
+#define HARQ_POLL 0xFF
+#define HARQ_END 0xFE
+#define HARQ_REPLY_OFFSET HARQ_HEADER_BYTES
+
+/* report payload, receiver -> sender */
+typedef PacketField<0, 16> HarqReportGroup;
+typedef PacketFieldAfter<HarqReportGroup, 8> HarqReportRound;     // the round of the poll it answers
+typedef PacketFieldAfter<HarqReportRound, 8> HarqReportHave;      // blocks of the group it has
+typedef PacketFieldAfter<HarqReportHave, 16> HarqReportMissing;   // bitmap of the data blocks it lacks
+typedef PacketFieldAfter<HarqReportMissing, 8> HarqReportDone;    // the group is decoded, or the file is over
+typedef PacketLayout<HARQ_PAYLOAD_BYTES, HarqReportGroup, HarqReportRound, HarqReportHave,
+                     HarqReportMissing, HarqReportDone> HarqReport;
+
+#define HARQ_REPORT_TIMEOUT_US 2000 // wait for a report after a poll
+#define HARQ_POLL_TRIES 8           // polls before giving up on a round
+#define HARQ_MAX_ROUNDS 16          // rounds before giving up on a group
+#define HARQ_END_REPEATS 4          // HARQ_END sent blind, with HARQ_FEC
+
+#define HARQ_DECODE_TARGET 0.9f    // chance a round completes its group
+#define HARQ_LOSS_WEIGHT 0.25f      // of the latest round in the loss estimate
+#define HARQ_INITIAL_LOSS 0.05f
+
+
+typedef enum
+{
+  HARQ_HYBRID,  // parity from the loss seen, retransmit what is still needed
+  HARQ_ARQ,     // no parity, retransmit the missing blocks
+  HARQ_FEC,     // fixed parity, no feedback
+} harq_mode_e;
+
+
+/*
+ * Called before every payload goes on the air, to pace the sender (the
+ * rate shaper in the TX main)
+ */
+typedef void (*harq_pace_f)(void * ctx);
+
+/*
+ * Hands a block of the file to whoever keeps it, in order.  Blocks lost
+ * for good (HARQ_FEC) come as zeros.
+ */
+typedef void (*harq_deliver_f)(void * ctx, const char * data, uint8_t size);
+
+
+/*
+ * Function harqSymbolsFor() sizes a round: the fewest blocks to send so
+ * that `need' of them get through with HARQ_DECODE_TARGET probability
+ *
+ * Params:
+ *  need:
+ *    blocks the receiver still needs
+ *  loss:
+ *    expected loss of a payload
+ *  most:
+ *    blocks there are to send at most
+ */
+uint8_t harqSymbolsFor(uint8_t need, float loss, uint8_t most);
+
+
+class HarqSender
+{
+public:
+  HarqSender(Radio & radio);
+
+  /*
+   * Function begin() starts a file
+   *
+   * Params:
+   *  address, receiver:
+   *    our address and the receiver's, HARQ_ADDRESS_BYTES
+   *  mode, parity:
+   *    the scheme, and the parity per group of HARQ_FEC
+   *  pace, ctx:
+   *    called before every payload, may be nullptr
+   */
+  void begin(uint8_t * address, uint8_t * receiver, harq_mode_e mode, uint8_t parity,
+             harq_pace_f pace, void * ctx);
+
+  /*
+   * Function sendGroup() gets a group of blocks across
+   *
+   * Params:
+   *  blocks, count:
+   *    `count' blocks of HARQ_BLOCK_BYTES, up to HARQ_GROUP_BLOCKS
+   *
+   * Outputs:
+   *  false if the receiver stopped answering; send the same group again
+   */
+  bool sendGroup(const char * blocks, uint8_t count);
+
+  /*
+   * Function end() ends the file
+   *
+   * Params:
+   *  last_size:
+   *    bytes of the last block that belong to the file
+   *
+   * Outputs:
+   *  false if the receiver never confirmed it
+   */
+  bool end(uint8_t last_size);
+
+  /*
+   * Getters for the loss estimate and what went on the air
+   */
+  float getLoss(void);
+  uint32_t getPayloads(void);
+  uint32_t getParity(void);
+  uint32_t getRetransmits(void);
+
+private:
+  Radio & radio;
+  ErasureCode code;
+  uint8_t address[HARQ_ADDRESS_BYTES];
+  uint8_t receiver[HARQ_ADDRESS_BYTES];
+  harq_mode_e mode {HARQ_HYBRID};
+  uint8_t fixed_parity {0};
+  harq_pace_f pace {nullptr};
+  void * ctx {nullptr};
+
+  uint16_t group {0};
+  uint8_t round {0};
+  float loss {HARQ_INITIAL_LOSS};
+  uint32_t payloads {0};
+  uint32_t parity_sent {0};
+  uint32_t retransmits {0};
+
+  void send(const char * payload);
+
+  /*
+   * Polls until the receiver reports on the round, true with its report
+   */
+  bool poll(uint8_t index, uint8_t value, char * report);
+};
+
+
+class HarqReceiver
+{
+public:
+  HarqReceiver(Radio & radio);
+
+  /*
+   * Function begin() starts listening for a file on `address'
+   */
+  void begin(uint8_t * address, harq_deliver_f deliver, void * ctx);
+
+  /*
+   * Function step() takes in what arrived and answers polls
+   *
+   * Outputs:
+   *  false once the file is over
+   */
+  bool step(void);
+
+  /*
+   * Getters for the groups decoded, those that needed parity, and the
+   * blocks lost for good
+   */
+  uint32_t getGroups(void);
+  uint32_t getRepaired(void);
+  uint32_t getLost(void);
+
+private:
+  Radio & radio;
+  ErasureCode code;
+  uint8_t address[HARQ_ADDRESS_BYTES];
+  harq_deliver_f deliver {nullptr};
+  void * ctx {nullptr};
+
+  /* the group being received */
+  uint16_t group {0};
+  uint8_t count {0};
+  uint32_t have {0};
+  bool done {false};
+  bool started {false};
+  uint8_t symbols[ERASURE_MAX_SYMBOLS][HARQ_BLOCK_BYTES];
+
+  /* the last block delivered is held back until we know how much of it is file */
+  char held[HARQ_BLOCK_BYTES];
+  bool holding {false};
+
+  uint32_t groups {0};
+  uint32_t repaired {0};
+  uint32_t lost {0};
+
+  void startGroup(uint16_t g);
+
+  /*
+   * Decodes the group if it can and hands its blocks on; with `force'
+   * whatever arrived of an undecodable group goes, the rest as zeros
+   */
+  void finishGroup(bool force);
+  void pass(const char * data, uint8_t size);
+  void report(const char * poll, bool over);
+  uint8_t haveCount(void);
+};
+
+#endif /* _HARQ_H_ */
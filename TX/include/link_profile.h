@@ -0,0 +1,25 @@
+#pragma once
+
+#ifndef _LINK_PROFILE_H_
+#define _LINK_PROFILE_H_
+
+/*
+ * Link settings for a site. sim/scripts/autotune.py searches them in the
+ * simulator and rewrites this file (TX and RX copies) and
+ * scripts/link_profile.py, so both boards and both computers always agree.
+ * Flash both boards after changing it.
+ */
+
+#define PROFILE_CHUNK_CHARS 224          // file bytes per serial chunk, up to 224
+#define PROFILE_DATA_RATE RADIO_250KBPS  // air data rate, must match on both ends
+#define PROFILE_PA_LEVEL RADIO_PA_HIGH   // TX output power
+#define PROFILE_RETRY_DELAY 15           // wait (PROFILE_RETRY_DELAY + 1) * 250 us for an ACK
+#define PROFILE_RETRY_COUNT 15           // retransmits before a payload is given up on
+#define PROFILE_LINK_RATE 3200           // TX airtime cap in file bytes per second, 0 for none
+#define PROFILE_LINK_BURST 96            // file bytes the TX may send back to back
+#define PROFILE_HARQ 0                   // files by hybrid ARQ (HARQ_MODE), must match on both ends
+#define PROFILE_HARQ_SCHEME HARQ_HYBRID  // HARQ_HYBRID, HARQ_ARQ or HARQ_FEC, see harq.h
+#define PROFILE_HARQ_PARITY 4            // parity blocks per group with HARQ_FEC
+#define PROFILE_HARQ_WINDOW 16           // data blocks per group, up to HARQ_GROUP_BLOCKS
+
+#endif /* _LINK_PROFILE_H_ */
@@ -0,0 +1,89 @@
+#pragma once
+
+#ifndef _LINK_TRACE_H_
+#define _LINK_TRACE_H_
+
+#include <Arduino.h>
+#include <stdint.h>
+
+/*
+ * Records kept in RAM. At 8 bytes each this is 8 KB, about 32 KB of file
+ * at one record per payload, the newest records are kept.
+ */
+#define TRACE_RECORDS 1024
+
+/* outcome byte of a record */
+#define TRACE_ARC_MASK 0x0F       // retransmits taken (OBSERVE_TX.ARC_CNT)
+#define TRACE_TX_DS (1 << 4)      // payload was acknowledged
+#define TRACE_MAX_RT (1 << 5)     // gave up after the maximum retransmits
+#define TRACE_RX (1 << 6)         // payload was received (RX side)
+
+
+/*
+ * One packet outcome as seen by the firmware
+ */
+typedef struct
+{
+  /* micros() when the outcome was known */
+  uint32_t time_us;
+  /* payload number within the transfer */
+  uint16_t seq;
+  uint8_t channel;
+  uint8_t outcome;
+} trace_record_t;
+
+
+/*
+ * LinkTrace keeps per-packet outcomes of a transfer so a poorly performing
+ * site can be replayed in the simulator (sim/, --replay) at the desk.
+ */
+class LinkTrace
+{
+public:
+  LinkTrace();
+
+  /*
+   * Function record() stores one packet outcome, overwriting the oldest
+   * record once the buffer is full
+   *
+   * Params:
+   *  seq:
+   *    payload number within the transfer
+   *  channel:
+   *    RF channel the payload went out on
+   *  outcome:
+   *    TRACE_* flags, with the retransmit count for TX
+   */
+  void record(uint16_t seq, uint8_t channel, uint8_t outcome);
+
+  /*
+   * Getter for the number of records currently held
+   */
+  uint32_t getSize(void);
+
+  /*
+   * Getter for the number of records overwritten since the last clear()
+   */
+  uint32_t getOverwritten(void);
+
+  /*
+   * Function clear() drops every record
+   */
+  void clear(void);
+
+  /*
+   * Function dump() prints the records oldest first over serial, one
+   * "time_us,seq,channel,outcome" line each, then a HANDSHAKE_CHAR to
+   * indicate that the transmission is over
+   */
+  void dump(void);
+
+private:
+  trace_record_t records[TRACE_RECORDS];
+  /* index the next record goes to */
+  uint32_t head {0};
+  uint32_t size {0};
+  uint32_t overwritten {0};
+};
+
+#endif /* _LINK_TRACE_H_ */
@@ -0,0 +1,88 @@
+#pragma once
+
+#ifndef _MICRO_BENCH_H_
+#define _MICRO_BENCH_H_
+
+#include <stdint.h>
+#include "nRF24L01.h"
+#include "erasure_code.h"
+#include "harq.h"
+
+/*
+ * Microbenchmarks of the firmware's kernels (MICRO_BENCHMARK in the TX
+ * main): SPI payload upload and register access through our own driver,
+ * reading the UART, a CRC, and the codecs of the mains.  The simulator
+ * builds the same code (--micro), so a kernel can be tuned on the host and
+ * the numbers checked against the board's.
+ *
+ * Each kernel prints one line, the same on every build:
+ *
+ *  micro,<build>,<kernel>,<bytes per call>,<calls>,<ticks>,<ticks per second>
+ *
+ * Ticks are CPU cycles (CCOUNT) on the ESP32 and nanoseconds of
+ * steady_clock on the host; scripts/micro_bench.py puts builds side by side.
+ */
+
+#define MICRO_CALLS 1000          // calls timed per kernel
+#define MICRO_SERIAL_BYTES 128    // the computer sends them after the handshake, fits the UART's RX buffer
+#define MICRO_FILL_CHAR '#'       // payload contents
+#define MICRO_PAYLOAD_BYTES 32    // size of FIFO in bytes, as FIFO_SIZE_BYTES
+#define MICRO_TX_FIFO_SLOTS 3     // payloads the TX FIFO holds
+
+
+/*
+ * What one kernel took over `calls' calls
+ */
+typedef struct
+{
+  const char * kernel;
+  uint32_t bytes;
+  uint32_t calls;
+  uint64_t ticks;
+} micro_result_t;
+
+
+class MicroBench
+{
+public:
+  /*
+   * Params:
+   *  ce, csn:
+   *    pins of the radio, driven by a driver of its own whatever
+   *    RADIO_BACKEND is
+   */
+  MicroBench(uint8_t ce, uint8_t csn);
+
+  /*
+   * Function run() times every kernel `calls' times, the UART read once
+   * over the MICRO_SERIAL_BYTES waiting in its buffer, and prints a line
+   * for each over serial
+   */
+  void run(uint32_t calls);
+
+private:
+  nRF24Module::nRF24 driver;
+  ErasureCode code;
+
+  char payload[MICRO_PAYLOAD_BYTES];
+  uint8_t blocks[HARQ_GROUP_BLOCKS * HARQ_BLOCK_BYTES];
+  uint8_t symbols[ERASURE_MAX_SYMBOLS][HARQ_BLOCK_BYTES];
+
+  /* results fold into it so no kernel is optimised away */
+  volatile uint32_t sink {0};
+
+  micro_result_t spiUpload(uint32_t calls);
+  micro_result_t spiStatus(uint32_t calls);
+  micro_result_t registerRead(uint32_t calls);
+  micro_result_t registerWrite(uint32_t calls);
+  micro_result_t serialRead(void);
+  micro_result_t crc16(uint32_t calls);
+  micro_result_t erasureEncode(uint32_t calls);
+  micro_result_t erasureDecode(uint32_t calls);
+  micro_result_t headerPack(uint32_t calls);
+  micro_result_t aggregateSplit(uint32_t calls);
+
+  void print(const micro_result_t & result);
+};
+
+#endif /* _MICRO_BENCH_H_ */
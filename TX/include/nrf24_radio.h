@@ -0,0 +1,50 @@
+/*
+ *  Radio backed by our own nRF24Module driver (nRF24L01.h).
+ *
+ *  The driver only touches the pins and SPI in its own begin(), so it
+ *  is held by value and a global is safe; begin() resets the module.
+ */
+
+#pragma once
+
+#ifndef _NRF24_RADIO_H_
+#define _NRF24_RADIO_H_
+
+#include <stdint.h>
+
+#include "radio.h"
+#include "nRF24L01.h"
+
+class NRF24Radio : public Radio
+{
+public:
+    NRF24Radio(uint8_t cePin, uint8_t csnPin);
+
+    void begin();
+    void setAddressWidth(uint8_t aw);
+    void setChannel(uint8_t channel);
+    void setDataRate(radio_data_rate_e rate);
+    void setPALevel(radio_pa_level_e level);
+    void setRetries(uint8_t delay, uint8_t count);
+    void setAutoAck(bool enable);
+    void openWritingPipe(uint8_t * address);
+    void openReadingPipe(uint8_t pipe, uint8_t * address);
+    void startListening();
+    void stopListening();
+    bool write(const void * buf, uint8_t len);
+    bool writeFast(const void * buf, uint8_t len);
+    bool txStandBy();
+    bool available();
+    void read(void * buf, uint8_t len);
+    uint8_t getARC();
+    const char * name();
+
+private:
+    nRF24Module::nRF24 radio_;
+    /* CE is held high for writeFast() */
+    bool burst_;
+
+    void endBurst();
+};
+
+#endif /* _NRF24_RADIO_H_ */
@@ -0,0 +1,178 @@
+#pragma once
+
+#ifndef _PACKET_SCHEMA_H_
+#define _PACKET_SCHEMA_H_
+
+#include <stdint.h>
+
+/*
+ * Compile time layout of the headers in our payloads.  Every sequence
+ * number, flag, stream and length has to fit in a FIFO_SIZE_BYTES payload
+ * next to the data, so a header is declared as a list of fields of any
+ * number of bits; the layout checks that the fields neither overlap nor
+ * outgrow the payload, and each field has inline put() and get() that the
+ * compiler folds into the same shifts and masks one would write by hand.
+ *
+ * A header is a little endian string of bits: bit i is bit i % 8 of byte
+ * i / 8, and a field's lowest bit is the first of its own.  A 16 bit field
+ * on a byte boundary is then a little endian uint16 (as uint32_serial_u),
+ * and a field of 3 bits after one of 5 takes the top bits of the byte.
+ *
+ *  typedef PacketField<0, 16> Seq;
+ *  typedef PacketFieldAfter<Seq, 1> Last;
+ *  typedef PacketLayout<FIFO_SIZE_BYTES, Seq, Last> Header;
+ *
+ *  Seq::put(payload, seq);
+ *  memcpy(payload + Header::BYTES, data, Header::DATA_BYTES);
+ *
+ * Plain C++11 with no library, for the ESP32 and the simulator alike.
+ */
+
+#define PACKET_MAX_FIELD_BITS 32
+
+
+/*
+ * The smallest unsigned type holding `Bits'
+ */
+template <uint8_t Bits, bool Byte = (Bits <= 8), bool Half = (Bits <= 16)>
+struct PacketUint { typedef uint32_t type; };
+
+template <uint8_t Bits>
+struct PacketUint<Bits, true, true> { typedef uint8_t type; };
+
+template <uint8_t Bits>
+struct PacketUint<Bits, false, true> { typedef uint16_t type; };
+
+
+/*
+ * PacketBits reads and writes the bits `Offset' to `End' of a payload, a
+ * byte at a time from `Bit'.  The bounds are template arguments, so every
+ * byte is its own inline call with constant shifts and masks.
+ */
+template <uint16_t Offset, uint16_t End, uint16_t Bit = Offset, bool Done = (Bit >= End)>
+struct PacketBits
+{
+  static constexpr uint8_t SHIFT = Bit % 8;
+  static constexpr uint8_t TAKE = (8 - SHIFT < End - Bit) ? 8 - SHIFT : End - Bit;
+  static constexpr uint8_t MASK = ((1u << TAKE) - 1) << SHIFT;
+
+  static inline void
+  put(uint8_t * payload, uint32_t value)
+  {
+    payload[Bit / 8] = (uint8_t) ((payload[Bit / 8] & ~MASK) | (((value >> (Bit - Offset)) << SHIFT) & MASK));
+    PacketBits<Offset, End, Bit + TAKE>::put(payload, value);
+  }
+
+  static inline uint32_t
+  get(const uint8_t * payload)
+  {
+    uint32_t part = (uint32_t) ((payload[Bit / 8] & MASK) >> SHIFT) << (Bit - Offset);
+    return part | PacketBits<Offset, End, Bit + TAKE>::get(payload);
+  }
+};
+
+template <uint16_t Offset, uint16_t End, uint16_t Bit>
+struct PacketBits<Offset, End, Bit, true>
+{
+  static inline void put(uint8_t *, uint32_t) {}
+  static inline uint32_t get(const uint8_t *) { return 0; }
+};
+
+
+/*
+ * PacketField is a field of `Bits' at bit `Offset' of a payload
+ */
+template <uint16_t Offset, uint8_t Bits>
+struct PacketField
+{
+  static_assert(Bits > 0 && Bits <= PACKET_MAX_FIELD_BITS, "a field is 1 to 32 bits");
+
+  typedef typename PacketUint<Bits>::type type;
+
+  static constexpr uint16_t OFFSET = Offset;
+  static constexpr uint16_t BITS = Bits;
+  static constexpr uint16_t END = Offset + Bits;
+
+  /* largest value the field holds */
+  static constexpr uint32_t MAX = 0xFFFFFFFFu >> (32 - Bits);
+
+  /*
+   * Function put() writes the low `Bits' of `value', leaving the bits of
+   * the other fields as they are
+   */
+  static inline void
+  put(char * payload, uint32_t value)
+  {
+    PacketBits<Offset, END>::put((uint8_t *) payload, value);
+  }
+
+  static inline type
+  get(const char * payload)
+  {
+    return (type) PacketBits<Offset, END>::get((const uint8_t *) payload);
+  }
+};
+
+
+/*
+ * PacketFieldAfter is a field of `Bits' right after `Previous'
+ */
+template <typename Previous, uint8_t Bits>
+using PacketFieldAfter = PacketField<Previous::END, Bits>;
+
+
+/* whether two fields share a bit */
+template <typename A, typename B>
+struct PacketOverlap
+{
+  static constexpr bool value = A::OFFSET < B::END && B::OFFSET < A::END;
+};
+
+/* whether `Field' shares a bit with any of `Others' */
+template <typename Field, typename... Others>
+struct PacketOverlapsAny
+{
+  static constexpr bool value = false;
+};
+
+template <typename Field, typename First, typename... Rest>
+struct PacketOverlapsAny<Field, First, Rest...>
+{
+  static constexpr bool value = PacketOverlap<Field, First>::value || PacketOverlapsAny<Field, Rest...>::value;
+};
+
+/* end of the last of the fields, and whether any two of them overlap */
+template <typename... Fields>
+struct PacketFields
+{
+  static constexpr uint16_t END = 0;
+  static constexpr bool OVERLAP = false;
+};
+
+template <typename First, typename... Rest>
+struct PacketFields<First, Rest...>
+{
+  static constexpr uint16_t END = (First::END > PacketFields<Rest...>::END) ? First::END : PacketFields<Rest...>::END;
+  static constexpr bool OVERLAP = PacketOverlapsAny<First, Rest...>::value || PacketFields<Rest...>::OVERLAP;
+};
+
+
+/*
+ * PacketLayout is a header of `Fields' in front of the data of a payload
+ * of `PayloadBytes'
+ */
+template <uint8_t PayloadBytes, typename... Fields>
+struct PacketLayout
+{
+  static constexpr uint16_t BITS = PacketFields<Fields...>::END;
+  static constexpr uint8_t BYTES = (PacketFields<Fields...>::END + 7) / 8;
+  static constexpr uint8_t PAYLOAD_BYTES = PayloadBytes;
+
+  static_assert(!PacketFields<Fields...>::OVERLAP, "fields of a header overlap");
+  static_assert(PacketFields<Fields...>::END <= 8 * PayloadBytes, "header does not fit the payload");
+
+  static constexpr uint8_t DATA_OFFSET = BYTES;
+  static constexpr uint8_t DATA_BYTES = PayloadBytes - BYTES;
+};
+
+#endif /* _PACKET_SCHEMA_H_ */
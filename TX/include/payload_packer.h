@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef _PAYLOAD_PACKER_H_
+#define _PAYLOAD_PACKER_H_
+
+#include <stdint.h>
+#include "serial_io.h"
+
+
+/*
+ * Sends a payload the packer has ready
+ *
+ * Params:
+ *  ctx:
+ *    what was given to pack()
+ *  payload:
+ *    FIFO_SIZE_BYTES to send, straight from the chunk or from the packer
+ *
+ * Outputs:
+ *  false once the transfer stopped and the rest of the chunk is not wanted
+ */
+typedef bool (*packer_send_f)(void * ctx, const char * payload);
+
+/*
+ * PayloadPacker turns the file, as it arrives in serial chunks of any size,
+ * into a stream of full radio payloads.  A payload may span two chunks, so
+ * only the last payload of a file can be short; its length goes out in the
+ * END_TX_CHUNK payload (END_LENGTH_OFFSET).
+ */
+class PayloadPacker
+{
+public:
+  /*
+   * Params:
+   *  capacity:
+   *    file bytes a payload carries, less than FIFO_SIZE_BYTES leaves the
+   *    rest of it for a trailer (the latency stamp)
+   */
+  PayloadPacker(uint8_t capacity = FIFO_SIZE_BYTES);
+
+  /*
+   * Function pack() sends a chunk of the file in full payloads.  While
+   * nothing is held and a payload carries only file bytes, whole payloads
+   * go straight from the chunk with no copy; the rest is filled in.  What
+   * does not fill a payload is held for the next chunk.
+   *
+   * Params:
+   *  data:
+   *    next bytes of the file
+   *  size:
+   *    number of bytes in data
+   *  send:
+   *    takes each full payload
+   *  ctx:
+   *    passed on to send
+   */
+  void pack(const char * data, uint32_t size, packer_send_f send, void * ctx);
+
+  /*
+   * Function fill() copies as much of `data' as fits into the payload
+   *
+   * Params:
+   *  data:
+   *    next bytes of the file
+   *  size:
+   *    number of bytes in data
+   *
+   * Outputs:
+   *  number of bytes taken, the rest goes into the next payload
+   */
+  uint32_t fill(const char * data, uint32_t size);
+
+  /*
+   * Function full() tells whether the payload holds `capacity' bytes and
+   * is ready to be sent
+   */
+  bool full(void);
+
+  /*
+   * Getter for payload, always FIFO_SIZE_BYTES long and zero padded
+   */
+  char * getPayload(void);
+
+  /*
+   * Getter for size, the file bytes in the payload
+   */
+  uint8_t getSize(void);
+
+  /*
+   * Function clear() empties the payload once it has been sent
+   */
+  void clear(void);
+
+private:
+  char payload[FIFO_SIZE_BYTES];
+  uint8_t capacity {FIFO_SIZE_BYTES};
+  uint8_t size {0};
+};
+
+#endif /* _PAYLOAD_PACKER_H_ */
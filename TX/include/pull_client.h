@@ -0,0 +1,100 @@
+#pragma once
+
+#ifndef _PULL_CLIENT_H_
+#define _PULL_CLIENT_H_
+
+#include <stdint.h>
+#include "radio.h"
+#include "pull_protocol.h"
+#include "pull_scheduler.h"
+
+#define PULL_REQUEST_RETRY_DELAY 5  // (5 + 1) * 250 us for the ACK of a request
+#define PULL_INFO_TIMEOUT_US 1000000  // wait for a source to describe the file
+
+
+/*
+ * Hands a received block to whoever keeps the file
+ *
+ * Params:
+ *  ctx:
+ *    what was given to PullClient::begin()
+ *  offset:
+ *    where the bytes go in the file
+ *  data, size:
+ *    the bytes, PULL_BLOCK_BYTES but for the last block
+ */
+typedef void (*pull_deliver_f)(void * ctx, uint32_t offset, const char * data, uint8_t size);
+
+
+/*
+ * PullClient is the receiving side of a pull (see pull_protocol.h): it
+ * asks the sources for their ranges as PullScheduler hands them out and
+ * delivers the blocks as they come, in any order.  The radio must be set
+ * up (channel, rate, power) and the receiver's address is where the
+ * sources send to.
+ */
+class PullClient
+{
+public:
+  PullClient(Radio & radio);
+
+  /*
+   * Function begin() sets up a pull from `sources' sources
+   *
+   * Params:
+   *  address:
+   *    our address, PULL_ADDRESS_BYTES
+   *  sources, addresses:
+   *    how many sources and their addresses, up to PULL_MAX_SOURCES
+   *  deliver, ctx:
+   *    what to do with every new block
+   */
+  void begin(uint8_t * address, uint8_t sources, uint8_t (* addresses)[PULL_ADDRESS_BYTES],
+             pull_deliver_f deliver, void * ctx);
+
+  /*
+   * Function describe() asks the sources for the file's size and extension,
+   * one after the other until one answers
+   *
+   * Outputs:
+   *  false if none did
+   */
+  bool describe(void);
+
+  /*
+   * Function step() takes in the blocks that arrived and asks sources for
+   * their next ranges; call until it returns false, once the file is complete
+   */
+  bool step(void);
+
+  /*
+   * Getters for the file's size and extension, set by describe(), and for
+   * the scheduler's view of every source
+   */
+  uint32_t getSize(void);
+  char * getExtension(void);
+  PullScheduler & getScheduler(void);
+
+private:
+  Radio & radio;
+  uint8_t address[PULL_ADDRESS_BYTES];
+  uint8_t sources {0};
+  uint8_t source_addresses[PULL_MAX_SOURCES][PULL_ADDRESS_BYTES];
+  pull_deliver_f deliver {nullptr};
+  void * ctx {nullptr};
+  uint32_t size {0};
+  char extension[PULL_INFO_EXTENSION_BYTES + 1];
+  PullScheduler scheduler;
+
+  /*
+   * Sends a source a request for [first, first + count), true if it was acked
+   */
+  bool request(uint8_t source, uint32_t first, uint32_t count);
+
+  /*
+   * Reads one payload if there is one, its block index into `index'
+   */
+  bool receive(char * payload, uint32_t * index);
+};
+
+#endif /* _PULL_CLIENT_H_ */
@@ -0,0 +1,104 @@
+#pragma once
+
+#ifndef _PULL_SCHEDULER_H_
+#define _PULL_SCHEDULER_H_
+
+#include <stdint.h>
+
+#define PULL_MAX_SOURCES 5          // sources pulled from at once
+#define PULL_MAX_BLOCKS 65536       // largest file, in blocks (1.8 MB)
+#define PULL_RANGE_BLOCKS 32        // blocks asked for at once
+#define PULL_STEAL_MIN_BLOCKS 8     // smallest range worth splitting off a slow source
+#define PULL_STALL_US 250000        // a source this long without a block loses its range
+
+
+/*
+ * Progress of one source
+ */
+typedef struct
+{
+  /* current range [first, first + count), count 0 while idle */
+  uint32_t first;
+  uint32_t count;
+  /* one past the highest block of the range received so far */
+  uint32_t next;
+  /* the range changed and the source has not been told yet */
+  bool announce;
+  /* micros() of the last block, or of the assignment */
+  uint32_t last_us;
+  /* micros() before which a failed source gets no new range */
+  uint32_t retry_us;
+  uint8_t failures;
+  /* blocks it delivered, and how many of them were new */
+  uint32_t blocks;
+  uint32_t fresh;
+} pull_source_t;
+
+
+/*
+ * PullScheduler decides which source sends which blocks.  Blocks nobody
+ * has are handed out in ranges of PULL_RANGE_BLOCKS to idle sources; once
+ * they run out, an idle (so fast) source takes over the second half of
+ * what the slowest source still has to send, and the slow source's range
+ * is cut short.  A source that goes quiet for PULL_STALL_US loses its
+ * range to the others and backs off.  Lost blocks are asked for again
+ * after everything else.
+ */
+class PullScheduler
+{
+public:
+  PullScheduler();
+
+  /*
+   * Function begin() starts over for a file of `blocks' pulled from
+   * `sources' sources
+   */
+  void begin(uint32_t blocks, uint8_t sources);
+
+  /*
+   * Function update() gives idle sources new ranges and takes them from
+   * stalled ones, call before looking at what to announce
+   */
+  void update(uint32_t now_us);
+
+  /*
+   * Function received() records a block that arrived
+   *
+   * Outputs:
+   *  true if it is new and so should be kept
+   */
+  bool received(uint32_t block, uint32_t now_us);
+
+  /*
+   * Function announced() records that a source was told of its range
+   */
+  void announced(uint8_t source, uint32_t now_us);
+
+  /*
+   * Whether every block has arrived
+   */
+  bool complete(void);
+
+  /*
+   * Getters for a source's progress and the blocks still missing
+   */
+  const pull_source_t * getSource(uint8_t source);
+  uint32_t getMissing(void);
+
+private:
+  uint32_t blocks {0};
+  uint8_t sources {0};
+  uint32_t missing {0};
+  /* lowest block that may be missing and not in anyone's range */
+  uint32_t scan_from {0};
+  pull_source_t progress[PULL_MAX_SOURCES];
+  uint8_t have[PULL_MAX_BLOCKS / 8];
+
+  bool has(uint32_t block);
+  int8_t owner(uint32_t block);
+  void release(uint8_t source);
+  bool assign(uint8_t source, uint32_t now_us);
+  bool steal(uint8_t source, uint32_t now_us);
+};
+
+#endif /* _PULL_SCHEDULER_H_ */
@@ -0,0 +1,47 @@
+#pragma once
+
+#ifndef _RADIO_BENCH_H_
+#define _RADIO_BENCH_H_
+
+#include <stdint.h>
+#include "radio.h"
+
+#define BENCH_PAYLOADS 500    // payloads sent per backend
+#define BENCH_SPI_POLLS 1000  // available() calls timed for the SPI cost
+#define BENCH_FILL_CHAR '#'   // payload contents, anything but END_CHAR
+
+
+/*
+ * What one backend achieved over the same transfer
+ */
+typedef struct
+{
+    /* one SPI transaction (a STATUS read) */
+    float spi_us;
+    /* write() from the first SPI byte to TX_DS or MAX_RT */
+    float write_avg_us;
+    uint32_t write_max_us;
+    uint32_t retransmits;
+    uint32_t acked;
+    uint32_t payloads;
+    float goodput_bps;
+    /* the same payloads again through writeFast(), CE held high */
+    uint32_t burst_drops;
+    float burst_goodput_bps;
+} bench_result_t;
+
+
+/*
+ * Function benchmarkRadio() sends `payloads' full FIFOs through an already
+ * configured radio back to back and measures the per-packet cost, then
+ * sends them again as one writeFast() burst. The receiver has to be
+ * listening on the same channel and address.
+ */
+bench_result_t benchmarkRadio(Radio & radio, uint32_t payloads);
+
+/*
+ * Function printBenchResult() prints one result line over serial
+ */
+void printBenchResult(Radio & radio, const bench_result_t & result);
+
+#endif /* _RADIO_BENCH_H_ */
@@ -0,0 +1,98 @@
+#pragma once
+
+#ifndef _RATE_SHAPER_H_
+#define _RATE_SHAPER_H_
+
+#include <stdint.h>
+#include "radio.h"
+#include "serial_io.h"
+#include "token_bucket.h"
+
+/* the flows of SHAPING_FLOWS, by what goes on the air */
+#define SHAPER_FLOW_FILE 0       // file payloads: the lockstep transfer, hybrid ARQ, pulls, the first SERIAL_MUX stream
+#define SHAPER_FLOW_STREAM 1     // the second SERIAL_MUX data stream
+#define SHAPER_FLOW_MESSAGES 2   // AGGREGATE payloads, and all a RELAY_MODE board sends
+#define SHAPER_FLOW_CONTROL 3    // link control before a file: latency sync, session and rendezvous
+
+
+/*
+ * RateShaper holds a payload back until both the link's bucket and its
+ * flow's bucket allow it, so every link runs at its allotted airtime and
+ * no flow takes more than its share of it.
+ */
+class RateShaper
+{
+public:
+  RateShaper();
+
+  /*
+   * Function configure() applies the caps the computer sent at session
+   * setup, see SerialIO::setShaping()
+   */
+  void configure(shaping_config_t * config);
+
+  /*
+   * Function waitUs() tells how long until a payload of `bytes' on `flow'
+   * may be sent
+   *
+   * Outputs:
+   *  micro seconds to wait, 0 if it may be sent now
+   */
+  uint32_t waitUs(uint8_t flow, uint32_t bytes);
+
+  /*
+   * Function consume() charges a sent payload to the link and its flow
+   */
+  void consume(uint8_t flow, uint32_t bytes);
+
+  /*
+   * Function pace() waits until a payload of `bytes' on `flow' may be sent
+   * and charges it, for writes that go out whatever else is going on
+   */
+  void pace(uint8_t flow, uint32_t bytes);
+
+private:
+  TokenBucket link;
+  TokenBucket flows[SHAPING_FLOWS];
+};
+
+
+/*
+ * ShapedRadio charges every payload written through it to one flow of a
+ * RateShaper, waiting for its tokens first, so traffic sent by the
+ * aggregator and the control exchanges keeps to its caps without their
+ * knowing of the shaper.  Everything else goes straight to the radio.
+ */
+class ShapedRadio : public Radio
+{
+public:
+  ShapedRadio(Radio & radio, RateShaper & shaper, uint8_t flow);
+
+  void begin();
+  void setAddressWidth(uint8_t aw);
+  void setChannel(uint8_t channel);
+  void setDataRate(radio_data_rate_e rate);
+  void setPALevel(radio_pa_level_e level);
+  void setRetries(uint8_t delay, uint8_t count);
+  void setAutoAck(bool enable);
+  void openWritingPipe(uint8_t * address);
+  void openReadingPipe(uint8_t pipe, uint8_t * address);
+  void startListening();
+  void stopListening();
+  bool write(const void * buf, uint8_t len);
+  bool writeFast(const void * buf, uint8_t len);
+  bool txStandBy();
+  bool available();
+  void read(void * buf, uint8_t len);
+  uint8_t getARC();
+  const char * name();
+
+private:
+  Radio & radio;
+  RateShaper & shaper;
+  uint8_t flow;
+
+  void pace(uint8_t len);
+};
+
+#endif /* _RATE_SHAPER_H_ */
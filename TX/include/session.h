@@ -0,0 +1,146 @@
+#pragma once
+
+#ifndef _SESSION_H_
+#define _SESSION_H_
+
+#include <stdint.h>
+#include "radio.h"
+#include "packet_schema.h"
+
+/*
+ * Capability negotiation before a file (SESSION_NEGOTIATE in the mains).
+ * Both ends start at SESSION_BASE_RATE, which every board can do and which
+ * reaches furthest, and trade what they were built with:
+ *
+ *  TX -> RX  offer:    SESSION_CHAR, SESSION_OFFER, reply address, our caps
+ *  RX -> TX  answer:   SESSION_CHAR, SESSION_ANSWER, its caps
+ *  TX -> RX  confirm:  SESSION_CHAR, SESSION_CONFIRM
+ *  TX -> RX  check:    SESSION_CHAR, SESSION_CHECK, at the agreed rate
+ *
+ * Both work out the same agreement from the two sets of caps, and switch
+ * to its data rate after the confirm, which the RX acknowledges at the
+ * base rate still.  That ACK can be lost with the RX already switched, so
+ * the TX sends the check at the new rate whether the confirm was ACKed or
+ * not, and the session stands only once the check is.  An RX that hears
+ * no check within SESSION_CHECK_US goes back to the base rate for the
+ * next offer, as does a TX whose check is not ACKed.
+ */
+
+#define SESSION_VERSION 1
+#define SESSION_PAYLOAD_BYTES 32    // size of FIFO in bytes, as FIFO_SIZE_BYTES
+#define SESSION_ADDRESS_BYTES 4     // address width, as ADDRESS_BYTES
+#define SESSION_READING_PIPE 1      // pipe 0 takes the ACK address of whatever we write
+#define SESSION_BASE_RATE RADIO_250KBPS
+
+#define SESSION_CHAR '|'            // not hex, not END_CHAR or LATENCY_SYNC_CHAR
+#define SESSION_TYPE_OFFSET 1
+#define SESSION_REPLY_OFFSET 2      // SESSION_ADDRESS_BYTES, offer only
+#define SESSION_CAPS_OFFSET 6
+
+#define SESSION_OFFER 'o'
+#define SESSION_ANSWER 'a'
+#define SESSION_CONFIRM 'c'
+#define SESSION_CHECK 'k'
+
+#define SESSION_TRIES 50            // half a second for the receiver to come up
+#define SESSION_TIMEOUT_US 10000    // wait for an answer, a round trip at 250 kbps is 4 ms
+#define SESSION_CHECK_US 200000     // the RX waits for the check, past the TX's retries of the confirm and its checks
+#define SESSION_CHECK_TX_US (SESSION_CHECK_US / 4)  // the TX keeps sending the check
+
+/* features, in session_caps_t::features */
+#define SESSION_HARQ (1 << 0)           // files by hybrid ARQ (harq.h)
+#define SESSION_LATENCY_STAMP (1 << 1)  // reserved: a latency stamp is in file_bytes, fixed at build time
+#define SESSION_LZMA (1 << 2)           // the receiving computer takes xz compressed files
+#define SESSION_ENCRYPTION (1 << 3)     // reserved, nothing encrypts yet
+
+
+/*
+ * What one end can do, and what both agreed on.  A version of 0 is no
+ * session: the ends could not agree, or never talked.
+ */
+typedef struct
+{
+  uint8_t version;
+  /* radio_data_rate_e, the fastest the board is set up for */
+  uint8_t max_rate;
+  uint8_t features;
+  /* blocks per hybrid ARQ group */
+  uint8_t window;
+  /* file bytes per payload, less with a latency stamp */
+  uint8_t file_bytes;
+} session_caps_t;
+
+#define SESSION_CAPS_BYTES 5
+
+/* the reply address goes in as bytes, as radio.openWritingPipe() takes it */
+typedef PacketField<8 * SESSION_TYPE_OFFSET, 8> SessionType;
+typedef PacketField<8 * SESSION_CAPS_OFFSET, 8> SessionVersion;
+typedef PacketFieldAfter<SessionVersion, 8> SessionMaxRate;
+typedef PacketFieldAfter<SessionMaxRate, 8> SessionFeatures;
+typedef PacketFieldAfter<SessionFeatures, 8> SessionWindow;
+typedef PacketFieldAfter<SessionWindow, 8> SessionFileBytes;
+typedef PacketLayout<SESSION_PAYLOAD_BYTES, SessionType, SessionVersion, SessionMaxRate,
+                     SessionFeatures, SessionWindow, SessionFileBytes> SessionHeader;
+static_assert(SessionHeader::BYTES == SESSION_CAPS_OFFSET + SESSION_CAPS_BYTES, "caps are session_caps_t");
+
+
+/*
+ * Function sessionAgree() works out what a session between `a' and `b'
+ * runs with: the slower of the two rates and the features both have.  The
+ * payload layout has to match; hybrid ARQ needs the same window.
+ *
+ * Outputs:
+ *  the agreement, version 0 if there is none
+ */
+session_caps_t sessionAgree(const session_caps_t & a, const session_caps_t & b);
+
+
+/*
+ * Function openSession() negotiates with the receiver, leaving the radio a
+ * transmitter to `receiver' at the agreed rate, or at the base rate
+ * without an agreement
+ *
+ * Params:
+ *  address, receiver:
+ *    our address and the receiver's, SESSION_ADDRESS_BYTES
+ *  ours:
+ *    what this board can do
+ *
+ * Outputs:
+ *  the agreement, version 0 if the receiver never answered or the two
+ *  cannot work together
+ */
+session_caps_t openSession(Radio & radio, uint8_t * address, uint8_t * receiver,
+                           const session_caps_t & ours);
+
+
+/*
+ * Function answerSession() handles a session payload the receiver just
+ * read, then goes back to listening on `address' (pipe 0)
+ *
+ * Params:
+ *  payload:
+ *    the payload, SESSION_CHAR first
+ *  ours:
+ *    what this board can do
+ *  agreed:
+ *    set from an offer
+ *
+ * Outputs:
+ *  true on the confirm: switch to the agreed rate
+ */
+bool answerSession(Radio & radio, const char * payload, uint8_t * address,
+                   const session_caps_t & ours, session_caps_t & agreed);
+
+
+/*
+ * Function checkSession() waits for the sender's check once the receiver
+ * has switched to the agreed rate after the confirm
+ *
+ * Outputs:
+ *  true if it came within SESSION_CHECK_US, otherwise the sender is not
+ *  on the agreed rate: go back to the base rate and answer its next offer
+ */
+bool checkSession(Radio & radio);
+
+#endif /* _SESSION_H_ */
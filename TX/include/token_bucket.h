@@ -0,0 +1,57 @@
+#pragma once
+
+#ifndef _TOKEN_BUCKET_H_
+#define _TOKEN_BUCKET_H_
+
+#include <stdint.h>
+
+#define BUCKET_UNLIMITED 0   // rate that means no cap
+#define BUCKET_MIN_BURST 32  // a payload, as FIFO_SIZE_BYTES: an empty bucket would never hold one back
+
+
+/*
+ * TokenBucket caps a sustained rate while letting up to a burst through at
+ * once.  Tokens are kept in millionths of a byte so that refilling at any
+ * rate from the micros() clock is exact integer arithmetic.
+ */
+class TokenBucket
+{
+public:
+  TokenBucket();
+
+  /*
+   * Function configure() sets the cap and starts over with a full bucket
+   *
+   * Params:
+   *  rate:
+   *    sustained bytes per second, BUCKET_UNLIMITED for no cap
+   *  burst:
+   *    bytes that may go out back to back, at least BUCKET_MIN_BURST.  A
+   *    send larger than the burst goes once the bucket is full.
+   */
+  void configure(uint32_t rate, uint32_t burst);
+
+  /*
+   * Function waitUs() tells how long until `bytes' may be sent
+   *
+   * Outputs:
+   *  micro seconds to wait, 0 if they may be sent now
+   */
+  uint32_t waitUs(uint32_t bytes);
+
+  /*
+   * Function consume() takes the tokens for `bytes' that were sent
+   */
+  void consume(uint32_t bytes);
+
+private:
+  void refill(void);
+
+  uint32_t rate {BUCKET_UNLIMITED};
+  uint64_t capacity {0};
+  uint64_t tokens {0};
+  /* micros() at the last refill */
+  uint32_t last_us {0};
+};
+
+#endif /* _TOKEN_BUCKET_H_ */
@@ -4,6 +4,17 @@ Module contains all the functions and constants neccessary for serial communicat
 with an Arduino to perform nRF24L01+ RF communication.
 """
 
+import base64
+import csv
+import lzma
+import os
+import random
+import struct
+import threading
+import time
+from link_profile import *
+from csv_codec import CsvDecoder, encodeCsv
+
 # We are going to store the configured integers in our Arduino in a Union,
 # by sending over our individal bytes and storing them in memory.
 # Thus, we need to consider the endianess of our Arduino
@@ -13,10 +24,14 @@ ENDIANESS = 'little'
 MAX_CHANNEL = 125
 MIN_CHANNEL = 0
 
-# Data pipe address bounds
-MAX_ADDRESS = 10000
+# Data pipe address bounds, any 4 bytes; sim/scripts/plan_site.py picks good ones
+MAX_ADDRESS = 0xFFFFFFFF
 MIN_ADDRESS = 0
 
+# csv of "device,channel,address" per board, as plan_site.py writes them:
+# setConfig takes the configuration of a board listed there instead of asking
+LINKS_ENV = "RFSLING_LINKS"
+
 # used to communicate state changes between the Arduino and Computer
 HANDSHAKE_CHAR = '\t'
 
@@ -35,6 +50,25 @@ HANDSHAKE_BYTE.extend([ord(HANDSHAKE_CHAR)])
 TX_BYTE = bytearray()
 TX_BYTE.extend([ord(TX_CHAR)])
 
+# Out of band control of a running transfer, see sendControl.  TX_CHAR_REPS
+# must match serial_io.h, and the idle time must be well above AT_CMD_IDLE_US
+TX_CHAR_REPS = 3
+AT_CMD_IDLE_SEC = 0.002
+
+CONTROL_ABORT = 'a'    # drop the transfer, keep the configuration
+CONTROL_PAUSE = 'p'    # hold the transfer until CONTROL_RESUME
+CONTROL_RESUME = 'r'   # carry on with a paused transfer
+CONTROL_PREEMPT = 'n'  # drop the transfer and wait for a new configuration
+
+AT_CMD_BYTES = bytearray()
+AT_CMD_BYTES.extend([ord(TX_CHAR) for _ in range(TX_CHAR_REPS)])
+
+# Data never holds TX_CHAR, so the Arduino tells a command from data wherever
+# it lands: TX_CHAR and ESCAPE_CHAR go out as ESCAPE_CHAR and the byte xored
+# with ESCAPE_XOR, see writeData.  Must match control_reader.h
+ESCAPE_CHAR = '}'
+ESCAPE_XOR = 0x20
+
 # How many consecutive signals we need to send over
 HANDSHAKE_REPS = 5
 
@@ -44,10 +78,76 @@ FLUSH_SIGNAL.extend([ord(HANDSHAKE_CHAR) for _ in range(HANDSHAKE_REPS)])
 # size of char array in union representing extension on Arduino
 EXTENSION_LEN = 32
 
-# Max bytes to send over to the Arduino at one time. We send 224 bytes because it is
-# a multiple of 32, the size of our our FIFO buffer on the nRF24L01+ chip, and it still
-# fits within our serial's buffer, which has a capacity of 224 hex chars.
-MAX_HEX_CHUNK_BYTES = 224
+# Max bytes to send over to the Arduino at one time. It must fit within our serial's
+# buffer, which has a capacity of 224 hex chars.  It need not be a multiple of 32, the
+# size of our FIFO buffer on the nRF24L01+ chip, as the TX Arduino packs payloads
+# across chunks.
+MAX_HEX_CHUNK_BYTES = PROFILE_CHUNK_CHARS
+
+# flows with a token bucket of their own on the TX Arduino, see getShaping
+SHAPING_FLOWS = 4
+
+# Leads the file extension of a file compressed with compressFile, so the receiving
+# computer knows to decompress it.  Never part of a real extension.
+COMPRESSED_MARK = '%'
+
+# Leads it instead for CSV telemetry sent with compressCsv
+CSV_MARK = '#'
+
+# transfer encodings of a file: as is, compressFile, or compressCsv for CSV telemetry
+ENCODING_RAW = "raw"
+ENCODING_XZ = "xz"
+ENCODING_CSV = "csv"
+
+# xz with the largest window, the computers have the memory the Arduinos lack
+COMPRESS_FILTERS = [{"id": lzma.FILTER_LZMA2, "preset": 9 | lzma.PRESET_EXTREME}]
+
+# Virtual channels, see SerialMux; must match serial_io.h
+MUX_MAX_FRAME = 64
+MUX_CONTROL = 0
+MUX_TELEMETRY = 1
+MUX_DATA = 2
+MUX_DATA_STREAMS = 2
+
+MUX_OP_CREDIT = 'c'
+MUX_OP_STATS = 's'
+MUX_OP_OPEN = 'o'
+MUX_OP_CLOSE = 'e'
+
+# what the Arduino keeps of a file extension
+EXTENSION_BYTES = 10
+
+# mux_telemetry_t: payloads, lost, retries, then the bytes queued per stream
+MUX_TELEMETRY_FORMAT = "<III" + "H" * MUX_DATA_STREAMS
+MUX_TELEMETRY_FIELDS = ["payloads", "lost", "retries"] + ["queued" + str(s) for s in range(MUX_DATA_STREAMS)]
+
+# where link traces and latency histograms from the Arduino are saved, see saveTrace
+TRACE_PATH = "./logs/"
+
+# summary line of a latency histogram, see LatencyHistogram::dump()
+LATENCY_FIELDS = ["count", "min", "p50", "p99", "p999", "max"]
+
+# what an RX Arduino built with DIVERSITY reports after a file, see reportDiversity()
+DIVERSITY_FIELDS = ["first0", "first1", "duplicates", "missed"]
+
+# must match aggregator.h
+AGGREGATE_FLOWS = 8
+AGGREGATE_MAX_MESSAGE = 30
+AGGREGATE_DEADLINE_US = 10000
+
+# session_caps_t of a negotiated session, see session.h: version, max rate,
+# features, window, file bytes per payload
+SESSION_FIELDS = ["version", "max_rate", "features", "window", "file_bytes"]
+SESSION_RATES = ["250 kbps", "1 Mbps", "2 Mbps"]
+SESSION_HARQ = 1 << 0
+SESSION_LZMA = 1 << 2
+
+# discovery channel and address of RENDEZVOUS in main.cpp, see rendezvous.h;
+# private links stay clear of the channel, and of the address's pattern
+RENDEZVOUS_CHANNEL = 81
+RENDEZVOUS_ADDRESS = 0xB91396C7
+PRIVATE_CHANNELS = range(2, RENDEZVOUS_CHANNEL - 1)  # 2-79, as plan_site.py's --band
+PRIVATE_BAD_BYTES = {0x00, 0x55, 0xAA, 0xFF}
 
 # All numbers 0-9 as strings, used for input error handling
 NUMBERS = {str(x) for x in range(10)}
@@ -142,6 +242,79 @@ def chunkGenerator(data):
     yield data[i + MAX_HEX_CHUNK_BYTES:len(data)]
 
 
+def sendFile(ser, extension, data, stopped=None):
+    """
+    Sends a file through a TX Arduino that is already configured, as
+    send_hex.py does: the extension, then the file a chunk at a time with a
+    handshake before every chunk.  The Arduino takes the next file the same
+    way once this one is out.
+
+    Params:
+        ser:
+            Our initiallized pyserial serial port
+
+        extension, data:
+            as buildFile in send_hex.py gives them
+
+        stopped:
+            threading.Event, if set between chunks the transfer is preempted
+
+    Outputs:
+        bool: whether the whole file went out
+    """
+    handshake(ser)
+    writeData(ser, extension)
+
+    for c in chunkGenerator(data):
+        if stopped is not None and stopped.is_set():
+            sendControl(ser, CONTROL_PREEMPT)
+            return False
+
+        handshake(ser)
+        writeData(ser, len(c).to_bytes(1, byteorder=ENDIANESS) + c)
+
+    return True
+
+
+def escape(data):
+    """
+    Escapes TX_CHAR and ESCAPE_CHAR in data for the Arduino, which undoes it
+    (ControlReader in control_reader.h).
+
+    Params:
+        data:
+            bytes
+
+    Outputs:
+        bytes: data as it goes over serial
+    """
+    escaped = bytearray()
+    for b in bytes(data):
+        if b in (ord(TX_CHAR), ord(ESCAPE_CHAR)):
+            escaped.extend([ord(ESCAPE_CHAR), b ^ ESCAPE_XOR])
+        else:
+            escaped.append(b)
+
+    return bytes(escaped)
+
+
+def writeData(ser, data):
+    """
+    Sends data the Arduino reads with its serial_io (configuration, shaping,
+    extensions, chunks and so on), escaped so that a command sent with
+    sendControl is never mistaken for it, nor it for a command.  The virtual
+    channels of SerialMux are not escaped.
+
+    Params:
+        ser:
+            Our initiallized pyserial serial port
+
+        data:
+            bytes
+    """
+    ser.write(escape(data))
+
+
 def enableTX(ser):
     """
     Signals to the Arduino to enable TX mode of the nRF chip.
@@ -156,6 +329,285 @@ def enableTX(ser):
     ser.write(TX_BYTE)
 
 
+def compressFile(data):
+    """
+    Compresses a file on the computer for the Arduinos to pass through untouched.
+    The xz stream is sent as Ascii85, which is denser than hex and, unlike raw
+    bytes, never contains HANDSHAKE_CHAR, END_CHAR, TX_CHAR or NUL, all of which
+    mean something on the way to the receiving computer.
+
+    Params:
+        data:
+            bytes: contents of the file
+
+    Outputs:
+        bytes: the compressed file to send, or None if it would not be smaller
+    """
+    packed = lzma.compress(data, format=lzma.FORMAT_XZ, check=lzma.CHECK_CRC32, filters=COMPRESS_FILTERS)
+    encoded = base64.a85encode(packed)
+
+    return encoded if len(encoded) < len(data) else None
+
+
+def compressCsv(data):
+    """
+    Compresses CSV telemetry, columns of slowly changing numbers, as
+    compressFile does but by way of csv_codec first: deltas of the readings
+    compress much better than the text of them.  The receiving computer gets
+    the file back byte for byte.
+
+    Params:
+        data:
+            bytes: contents of the file
+
+    Outputs:
+        bytes: the compressed file to send, or None if it would not be smaller
+    """
+    columns = encodeCsv(data)
+    if columns is None:
+        return None
+    packed = lzma.compress(columns, format=lzma.FORMAT_XZ, check=lzma.CHECK_CRC32, filters=COMPRESS_FILTERS)
+    encoded = base64.a85encode(packed)
+
+    return encoded if len(encoded) < len(data) else None
+
+
+class StreamDecompressor:
+    """
+    Undoes compressFile as the file arrives, one payload at a time, so the
+    whole compressed file never has to be held.  An Ascii85 group is 5 chars
+    ('z' alone for 4 zero bytes) and payloads cut groups anywhere, so the
+    incomplete tail of each payload waits for the next one.
+    """
+
+    def __init__(self):
+        self.pending = ""
+        self.xz = lzma.LZMADecompressor(format=lzma.FORMAT_XZ)
+
+    def feed(self, text):
+        """
+        Params:
+            text:
+                string: next data received
+
+        Outputs:
+            bytes: the file data it completes
+        """
+        self.pending += text
+
+        end = 0
+        while end < len(self.pending):
+            group = 1 if self.pending[end] == 'z' else 5
+            if end + group > len(self.pending):
+                break
+            end += group
+
+        complete, self.pending = self.pending[:end], self.pending[end:]
+        return self.xz.decompress(base64.a85decode(complete)) if complete else b""
+
+    def flush(self):
+        """
+        Decodes the short group the file ends with.
+
+        Outputs:
+            bytes: the rest of the file
+        """
+        tail, self.pending = self.pending, ""
+        data = self.xz.decompress(base64.a85decode(tail)) if tail else b""
+
+        if not self.xz.eof:
+            raise ValueError("compressed file ended early, payloads were lost")
+        return data
+
+
+class StreamCsvDecompressor(StreamDecompressor):
+    """
+    Undoes compressCsv as the file arrives, a block of lines at a time.
+    """
+
+    def __init__(self):
+        super().__init__()
+        self.columns = CsvDecoder()
+
+    def feed(self, text):
+        return self.columns.feed(super().feed(text))
+
+    def flush(self):
+        data = self.columns.feed(super().flush())
+        return data + self.columns.flush()
+
+
+def streamDecoder(extension):
+    """
+    Tells how a received file was encoded from the mark before its extension.
+
+    Params:
+        extension:
+            string: the extension as received
+
+    Outputs:
+        (string, decoder): the extension itself, and a StreamDecompressor or
+        StreamCsvDecompressor for the file's data, None if it came as is
+    """
+    if extension.startswith(COMPRESSED_MARK):
+        return extension[len(COMPRESSED_MARK):], StreamDecompressor()
+    if extension.startswith(CSV_MARK):
+        return extension[len(CSV_MARK):], StreamCsvDecompressor()
+    return extension, None
+
+
+def sendControl(ser, command):
+    """
+    Sends a control command to the Arduino, which it acts on within a
+    millisecond whatever it is doing.  TX_CHAR TX_CHAR_REPS times with the
+    line quiet around it raises the at_cmd interrupt on the Arduino
+    (enableControl() in serial_io), which wakes it if it is not reading
+    serial, and the command byte follows once it has.  Data goes out with
+    writeData, which never holds TX_CHAR, so a command may be sent at any
+    time, e.g. from a signal handler in the middle of a file; the data sent
+    before it is kept.
+
+    Params:
+        ser:
+            Our initiallized pyserial serial port
+
+        command:
+            CONTROL_ABORT, CONTROL_PAUSE, CONTROL_RESUME or CONTROL_PREEMPT
+
+    Outputs:
+        None
+    """
+    ser.flush()
+    time.sleep(AT_CMD_IDLE_SEC)
+    ser.write(AT_CMD_BYTES)
+    ser.flush()
+    time.sleep(AT_CMD_IDLE_SEC)
+    ser.write(bytearray([ord(command)]))
+    ser.flush()
+
+
+class SerialMux:
+    """
+    Virtual channels over the serial link to a TX Arduino built with
+    SERIAL_MUX (startMux() in serial_io).  Every frame is a channel byte, a
+    length byte and up to MUX_MAX_FRAME bytes, so control, telemetry and
+    MUX_DATA_STREAMS files share the link.  A data stream only sends what
+    the Arduino gave it credit for, so whatever else is going on, control
+    and stats get through within a frame.
+
+    A thread reads what the Arduino sends; every method may be called from
+    any thread, e.g. stats from a monitor while a file is being written.
+    """
+
+    def __init__(self, ser):
+        self.ser = ser
+        self.lock = threading.Lock()            # one frame at a time on the wire
+        self.changed = threading.Condition()    # credits, acks and stats coming in
+        self.credits = [0] * (MUX_DATA + MUX_DATA_STREAMS)
+        self.closed = [False] * MUX_DATA_STREAMS
+        self.stats = None
+        self.running = True
+
+        handshake(ser)
+        self.reader = threading.Thread(target=self._read, daemon=True)
+        self.reader.start()
+
+    def _sendFrame(self, channel, data):
+        with self.lock:
+            self.ser.write(bytes([channel, len(data)]) + bytes(data))
+
+    def _sendControl(self, *data):
+        self._sendFrame(MUX_CONTROL, [ord(d) if isinstance(d, str) else d for d in data])
+
+    def _read(self):
+        while self.running:
+            header = self.ser.read(2)
+            if len(header) < 2:
+                continue
+            channel, size = header
+            data = self.ser.read(size)
+
+            with self.changed:
+                if channel == MUX_TELEMETRY:
+                    self.stats = dict(zip(MUX_TELEMETRY_FIELDS, struct.unpack(MUX_TELEMETRY_FORMAT, data)))
+                elif channel == MUX_CONTROL and data[:1] == MUX_OP_CREDIT.encode():
+                    self.credits[data[1]] += int.from_bytes(data[2:4], byteorder=ENDIANESS)
+                elif channel == MUX_CONTROL and data[:1] == MUX_OP_CLOSE.encode():
+                    self.closed[data[1]] = True
+                self.changed.notify_all()
+
+    def open(self, stream, extension):
+        """
+        Starts a file on a data stream.
+
+        Params:
+            stream:
+                int: 0 to MUX_DATA_STREAMS - 1
+
+            extension:
+                bytes: file extension, as for the lockstep protocol
+        """
+        with self.changed:
+            self.credits[MUX_DATA + stream] = 0
+            self.closed[stream] = False
+        self._sendControl(MUX_OP_OPEN, stream, *bytes(extension[:EXTENSION_BYTES]))
+
+    def write(self, stream, data):
+        """
+        Sends file data on a data stream, as fast as its credit allows.
+        """
+        channel = MUX_DATA + stream
+        while data:
+            with self.changed:
+                self.changed.wait_for(lambda: self.credits[channel] > 0)
+                size = min(self.credits[channel], MUX_MAX_FRAME, len(data))
+                self.credits[channel] -= size
+            self._sendFrame(channel, data[:size])
+            data = data[size:]
+
+    def close(self, stream, timeout=None):
+        """
+        Ends a file on a data stream and waits until the Arduino has sent it.
+
+        Outputs:
+            bool: False if it was not sent within timeout
+        """
+        self._sendControl(MUX_OP_CLOSE, stream)
+        with self.changed:
+            return self.changed.wait_for(lambda: self.closed[stream], timeout)
+
+    def control(self, command, stream):
+        """
+        Aborts, pauses or resumes the file on a data stream.
+
+        Params:
+            command:
+                CONTROL_ABORT, CONTROL_PAUSE or CONTROL_RESUME
+        """
+        self._sendControl(command, stream)
+
+    def getStats(self, timeout=1):
+        """
+        Asks the Arduino for its stats.
+
+        Outputs:
+            dict: MUX_TELEMETRY_FIELDS, or None if it did not answer in time
+        """
+        with self.changed:
+            self.stats = None
+        self._sendControl(MUX_OP_STATS)
+        with self.changed:
+            self.changed.wait_for(lambda: self.stats is not None, timeout)
+            return self.stats
+
+    def end(self):
+        """
+        Ends the session, the Arduino then waits for a new configuration.
+        """
+        self._sendControl(CONTROL_PREEMPT)
+        self.running = False
+
+
 def getData(ser):
     """
     Gets data sent to the computer from the Arduino over seral.
@@ -178,10 +630,289 @@ def getData(ser):
     return data
 
 
-def setConfig():
+def saveTrace(ser, prefix):
+    """
+    Receives the link trace the Arduino dumps after a file when built with
+    LINK_TRACE, and saves it as csv for replay in the simulator
+    (sim/, --replay).  Each line is "time_us,seq,channel,outcome".
+
+    Params:
+        ser:
+            Our initiallized pyserial serial port
+
+        prefix:
+            string: start of the trace file name, "tx" or "rx"
+
+    Outputs:
+        string: path of the saved trace
+    """
+    handshake(ser)
+    data = getData(ser)
+
+    path = TRACE_PATH + prefix + "-trace-" + str(int(time.time())) + ".csv"
+    with open(path, "w") as f:
+        f.write("time_us,seq,channel,outcome\n")
+        for line in data.splitlines():
+            if line.strip():
+                f.write(line.strip() + "\n")
+
+    return path
+
+
+def parseLatency(data):
+    """
+    Parses the latency histogram the Arduino dumps when built with
+    LATENCY_STAMP: a "count,min,p50,p99,p999,max" line, then a
+    "top_us,count" line per bucket.
+
+    Params:
+        data:
+            string: the dump, as getData returns it
+
+    Outputs:
+        dict: count, min, p50, p99, p999 and max in microseconds, and
+        buckets, a list of (top_us, count)
+    """
+    lines = [line.strip() for line in data.splitlines() if line.strip()]
+    if not lines:
+        return None
+
+    latency = dict(zip(LATENCY_FIELDS, [int(x) for x in lines[0].split(",")]))
+    latency["buckets"] = [tuple(int(x) for x in line.split(",")) for line in lines[1:]]
+    return latency
+
+
+def saveLatency(ser, prefix):
+    """
+    Queries the latency histogram of the file just received from an RX
+    Arduino built with LATENCY_STAMP, and saves its buckets as csv, the
+    same file the simulator writes with --latency-hist.
+
+    Params:
+        ser:
+            Our initiallized pyserial serial port
+
+        prefix:
+            string: start of the histogram file name
+
+    Outputs:
+        (dict, string): the histogram as parseLatency returns it, and the
+        path it was saved to
+    """
+    handshake(ser)
+    latency = parseLatency(getData(ser))
+    if not latency:
+        return None, None
+
+    path = TRACE_PATH + prefix + "-latency-" + str(int(time.time())) + ".csv"
+    with open(path, "w") as f:
+        f.write("top_us,count\n")
+        for top, count in latency["buckets"]:
+            f.write("{0},{1}\n".format(top, count))
+
+    return latency, path
+
+
+def readDiversity(ser):
+    """
+    Queries how the file just received came in to an RX Arduino built with
+    DIVERSITY: the payloads each of its radios had first, the copies it
+    dropped and the payloads neither radio heard.
+
+    Params:
+        ser:
+            Our initiallized pyserial serial port
+
+    Outputs:
+        dict: the DIVERSITY_FIELDS, or None if nothing came
+    """
+    handshake(ser)
+    line = getData(ser).strip()
+    if not line:
+        return None
+    return dict(zip(DIVERSITY_FIELDS, [int(x) for x in line.split(",")]))
+
+
+def sendDeadlines(ser, deadlines):
+    """
+    Opens a message session with a TX Arduino built with AGGREGATE: the
+    longest each flow's messages may wait for others to share a payload.
+
+    Params:
+        ser:
+            Our initiallized pyserial serial port
+
+        deadlines:
+            Microseconds per flow, from flow 0; flows past the list get
+            AGGREGATE_DEADLINE_US and 0 sends a flow's messages right away
+    """
+    handshake(ser)
+    for flow in range(AGGREGATE_FLOWS):
+        deadline = deadlines[flow] if flow < len(deadlines) else AGGREGATE_DEADLINE_US
+        writeData(ser, deadline.to_bytes(4, byteorder=ENDIANESS))
+
+
+def sendMessage(ser, flow, message):
+    """
+    Hands a message of a flow to a TX Arduino in a message session.
+
+    Params:
+        flow:
+            Below AGGREGATE_FLOWS
+
+        message:
+            bytes, 1 to AGGREGATE_MAX_MESSAGE of them
+    """
+    if not 0 <= flow < AGGREGATE_FLOWS or not 0 < len(message) <= AGGREGATE_MAX_MESSAGE:
+        raise ValueError("a message is 1 to {0} bytes of a flow below {1}".format(AGGREGATE_MAX_MESSAGE, AGGREGATE_FLOWS))
+    writeData(ser, bytes([flow, len(message)]) + message)
+
+
+def readMessage(ser):
+    """
+    Reads the next message an RX Arduino built with AGGREGATE split out.
+
+    Outputs:
+        (flow, bytes), or None if the serial port timed out
+    """
+    header = ser.read(2)
+    if len(header) < 2:
+        return None
+    message = ser.read(header[1])
+    if len(message) < header[1]:
+        return None
+    return header[0], message
+
+
+def readSession(ser):
+    """
+    Reads what a TX Arduino built with SESSION_NEGOTIATE agreed on with the
+    receiver, right after the configuration.
+
+    Outputs:
+        dict: the session_caps_t fields, or None without an agreement
+    """
+    session = dict(zip(SESSION_FIELDS, ser.read(len(SESSION_FIELDS))))
+    if not session["version"]:
+        return None
+    return session
+
+
+def describeSession(session):
+    """
+    One line of what a session runs with, for printing.
+    """
+    names = [name for bit, name in ((SESSION_HARQ, "harq"), (SESSION_LZMA, "lzma")) if session["features"] & bit]
+    return "session v{0}: {1}, {2}, {3} byte payloads".format(
+        session["version"], SESSION_RATES[session["max_rate"]], "+".join(names) or "no features",
+        session["file_bytes"])
+
+
+def getShaping():
+    """
+    Packs the airtime caps of a TX link from link_profile.py, in the order
+    setShaping() in serial_io reads them: the link's rate and burst, then
+    those of each of the SHAPING_FLOWS flows.
+
+    Outputs:
+        bytearray: the caps, 4 bytes per number
+    """
+    buckets = [(PROFILE_LINK_RATE, PROFILE_LINK_BURST)]
+    buckets += [PROFILE_FLOW_SHAPING.get(flow, (0, 0)) for flow in range(SHAPING_FLOWS)]
+
+    shaping = bytearray()
+    for rate, burst in buckets:
+        shaping.extend(rate.to_bytes(4, byteorder=ENDIANESS))
+        shaping.extend(burst.to_bytes(4, byteorder=ENDIANESS))
+
+    return shaping
+
+
+def readLinks(path):
+    """
+    Reads the per board configuration, "device,channel,address" per line,
+    where device is the port (/dev/ttyUSB0) or the USB serial number of
+    the board.
+
+    Outputs:
+        dict: device: (channel, address)
+    """
+    configs = {}
+    with open(path) as f:
+        for row in csv.reader(f):
+            if not row or row[0].startswith("#"):
+                continue
+            device, channel, address = [field.strip() for field in row]
+            if not (MIN_CHANNEL <= int(channel) <= MAX_CHANNEL and MIN_ADDRESS <= int(address) <= MAX_ADDRESS):
+                raise ValueError("{0}: bad configuration for {1}".format(path, device))
+            configs[device] = (int(channel), int(address))
+    return configs
+
+
+def linkConfig(device):
+    """
+    Looks the board on port `device' up in the csv LINKS_ENV names, by its
+    port or its USB serial number.
+
+    Outputs:
+        tuple: channel, address, or None if it is not listed
+    """
+    path = os.environ.get(LINKS_ENV)
+    if not device or not path:
+        return None
+
+    configs = readLinks(path)
+    if device in configs:
+        return configs[device]
+
+    from serial.tools import list_ports
+    for info in list_ports.comports():
+        if info.device == device and info.serial_number in configs:
+            return configs[info.serial_number]
+    return None
+
+
+def privateLink(device=None):
+    """
+    The link a TX Arduino built with RENDEZVOUS invites its receiver onto:
+    the board's own from LINKS_ENV, otherwise a random one off the discovery
+    channel.  Addresses of all 0 or 1 bits, or alternating ones, look like
+    the preamble or noise to the receiver and are skipped.
+
+    Outputs:
+        tuple: channel, address, as setConfig
+    """
+    config = linkConfig(device)
+    if not config:
+        rng = random.SystemRandom()
+        address = bytes(rng.choice([b for b in range(256) if b not in PRIVATE_BAD_BYTES]) for _ in range(4))
+        config = (rng.choice(PRIVATE_CHANNELS), int.from_bytes(address, byteorder=ENDIANESS))
+
+    channel, address = config
+    print("\n{0}: inviting onto channel {1} address {2}".format(device, channel, address))
+    return channel.to_bytes(1, byteorder=ENDIANESS), address.to_bytes(4, byteorder=ENDIANESS)
+
+
+def discoveryConfig():
+    """
+    The configuration of an RX Arduino built with RENDEZVOUS, which only
+    listens on the discovery channel until a sender invites it onto a link.
+
+    Outputs:
+        tuple: channel, address, as setConfig
+    """
+    return RENDEZVOUS_CHANNEL.to_bytes(1, byteorder=ENDIANESS), RENDEZVOUS_ADDRESS.to_bytes(4, byteorder=ENDIANESS)
+
+
+def setConfig(device=None):
     """
     Uses user input to configure the channel and address parameters for 
-    communicaiton with Arduino
+    communicaiton with Arduino, unless the board is listed in the csv
+    LINKS_ENV names
+
+    Params:
+        device:
+            the board's port, to look it up in LINKS_ENV
 
     Outputs:
         tuple: channel, address
@@ -189,8 +920,14 @@ def setConfig():
                 int between 0 and 125
             
             address:
-                int between 0 and 10000
+                int, 4 bytes
     """
+    config = linkConfig(device)
+    if config:
+        channel, address = config
+        print("\n{0}: channel {1} address {2} from {3}".format(device, channel, address, os.environ[LINKS_ENV]))
+        return channel.to_bytes(1, byteorder=ENDIANESS), address.to_bytes(4, byteorder=ENDIANESS)
+
     # init pipe and channel to out of bounds
     channel = -1
     address = -1
@@ -0,0 +1,113 @@
+#!/bin/python3
+"""
+Compares the transfer encodings of send_hex.py on CSV telemetry: the bytes
+each sends over the link, how fast the computers encode and decode them,
+and that the receiving computer gets every file back byte for byte.
+
+Params:
+    sys.argv[1:]:
+        CSV files to compare on, the sample telemetry below if none
+
+Sample telemetry, SAMPLE_LINES lines each:
+    weather:
+        a reading a second, milliseconds, of temperature, humidity and
+        pressure from two sensors taking turns
+    imu:
+        accelerations at 100 Hz, noisier and with more digits
+    power:
+        voltage and current every 10 s, lines ending in \\r\\n
+
+"""
+
+
+import sys
+import time
+import random
+from arduino_serial_io import *
+
+SAMPLE_LINES = 20000
+SAMPLE_SEED = 1
+
+# what the receiving computer is fed at once, a payload
+FEED_BYTES = 32
+
+
+def weather(rng):
+    lines = ["time_ms,sensor,temp_c,humidity,pressure_pa"]
+    t, temp, hum, press = 1700000000000, 21.50, 40.0, 101325
+    for i in range(SAMPLE_LINES):
+        t += 1000 + (rng.randint(-3, 3) if rng.random() < 0.1 else 0)
+        temp += rng.choice([-0.01, 0, 0, 0.01])
+        hum += rng.choice([-0.1, 0, 0.1])
+        press += rng.randint(-2, 2)
+        lines.append("{0},s{1},{2:.2f},{3:.1f},{4}".format(t, i % 2, temp, hum, press))
+    return ("\n".join(lines) + "\n").encode()
+
+
+def imu(rng):
+    lines = ["t_ms,ax,ay,az"]
+    for i in range(SAMPLE_LINES):
+        lines.append("{0},{1:.3f},{2:.3f},{3:.3f}".format(
+            i * 10, rng.gauss(0, 0.05), rng.gauss(0, 0.05), 9.81 + rng.gauss(0, 0.05)))
+    return ("\n".join(lines) + "\n").encode()
+
+
+def power(rng):
+    lines = ["timestamp,volts,amps"]
+    volts, amps = 12.600, 1.250
+    for i in range(SAMPLE_LINES):
+        volts += rng.choice([-0.001, 0, 0.001])
+        amps = max(0, amps + rng.choice([-0.005, 0, 0, 0.005]))
+        lines.append("{0},{1:.3f},{2:.3f}".format(1700000000 + 10 * i, volts, amps))
+    return ("\r\n".join(lines) + "\r\n").encode()
+
+
+def decode(encoded, decoder):
+    """
+    Decodes as the receiving computer does, a payload at a time.
+    """
+    text = encoded.decode("ascii")
+    data = bytearray()
+    for i in range(0, len(text), FEED_BYTES):
+        data.extend(decoder.feed(text[i:i + FEED_BYTES]))
+    data.extend(decoder.flush())
+    return bytes(data)
+
+
+def bench(name, data):
+    row = [name, str(len(data))]
+    for encode, decoder in ((compressFile, StreamDecompressor), (compressCsv, StreamCsvDecompressor)):
+        started = time.perf_counter()
+        encoded = encode(data)
+        encoded_sec = time.perf_counter() - started
+        if encoded is None:
+            row.extend(["-", "-", "-"])
+            continue
+
+        started = time.perf_counter()
+        if decode(encoded, decoder()) != data:
+            sys.exit("{0}: {1} did not give the file back".format(name, encode.__name__))
+        decoded_sec = time.perf_counter() - started
+
+        row.append("{0} ({1:.1f}x)".format(len(encoded), len(data) / len(encoded)))
+        row.append("{0:.1f}".format(len(data) / encoded_sec / 1e6))
+        row.append("{0:.1f}".format(len(data) / decoded_sec / 1e6))
+    return row
+
+
+if __name__ == "__main__":
+
+    if len(sys.argv) > 1:
+        files = []
+        for path in sys.argv[1:]:
+            with open(path, "rb") as f:
+                files.append((path, f.read()))
+    else:
+        rng = random.Random(SAMPLE_SEED)
+        files = [(sample.__name__, sample(rng)) for sample in (weather, imu, power)]
+
+    header = ["file", "bytes", "xz", "enc MB/s", "dec MB/s", "csv", "enc MB/s", "dec MB/s"]
+    rows = [header] + [bench(name, data) for name, data in files]
+    widths = [max(len(r[i]) for r in rows) for i in range(len(header))]
+    for r in rows:
+        print("  ".join(c.rjust(w) for c, w in zip(r, widths)))
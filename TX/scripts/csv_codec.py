@@ -0,0 +1,401 @@
+"""
+Columnar codec for CSV telemetry, slowly changing numeric readings a line
+at a time, which general purpose compressors only do moderately well on.
+The file goes in blocks of lines that have the same shape: the same number
+of fields and, field by field, the same number of decimals or text.  Every
+numeric column of a block is stored as scaled integers, by delta or
+delta-of-delta in zigzag varints, or with the delta-of-delta bit packed
+(regular timestamps take a bit a line); text columns store a cell only
+when it differs from the one above.  Decoding gives back the file byte
+for byte, whatever it is: a field only counts as numeric if formatting its
+value again gives the same bytes.
+
+    stream:     block..., varint 0, 1 if the file ends in a newline else 0
+    block:      varint length of the rest, varint rows, varint fields,
+                CSV_CRLF if the lines end in \\r\\n, a kind per field,
+                then the columns
+    kind:       0 for text, decimals + 1 for numbers
+    number:     mode, then the column as that mode stores it
+    text:       per cell varint 0 for the cell above, else length + 1 and
+                the bytes
+"""
+
+import re
+
+CSV_BLOCK_ROWS = 256
+CSV_MAX_DECIMALS = 30
+CSV_MAX_VALUE = 1 << 60  # so that a delta-of-delta fits a 64 bit escape
+
+CSV_CRLF = 1
+
+CSV_MODE_DELTA = 0
+CSV_MODE_DOD = 1
+CSV_MODE_DOD_BITS = 2
+
+# prefix codes of a bit packed delta-of-delta, (prefix, its length, value bits)
+CSV_DOD_CODES = [(0b10, 2, 7), (0b110, 3, 9), (0b1110, 4, 12), (0b1111, 4, 64)]
+
+NUMBER = re.compile(rb"-?(0|[1-9][0-9]*)(\.[0-9]+)?")
+
+
+def zigzag(value):
+    return (value << 1) if value >= 0 else ((-value << 1) - 1)
+
+
+def unzigzag(value):
+    return (value >> 1) if not value & 1 else -((value + 1) >> 1)
+
+
+def putVarint(out, value):
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+
+
+def getVarint(data, pos):
+    """
+    Outputs:
+        (value, position after it); IndexError if the data ends inside it
+    """
+    value = 0
+    shift = 0
+    while True:
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << shift
+        if not byte & 0x80:
+            return value, pos
+        shift += 7
+
+
+def formatNumber(value, decimals):
+    digits = str(abs(value)).rjust(decimals + 1, "0")
+    if decimals:
+        digits = digits[:-decimals] + "." + digits[-decimals:]
+    return ("-" if value < 0 else "") + digits
+
+
+def parseNumber(cell):
+    """
+    Outputs:
+        (scaled value, decimals) if formatting them again gives `cell', else None
+    """
+    if not NUMBER.fullmatch(cell):
+        return None
+    whole, _, fraction = cell.partition(b".")
+    decimals = len(fraction)
+    value = int(whole + fraction)
+    if decimals > CSV_MAX_DECIMALS or abs(value) >= CSV_MAX_VALUE:
+        return None
+    if formatNumber(value, decimals).encode() != cell:  # -0 and the like
+        return None
+    return value, decimals
+
+
+class BitWriter:
+
+    def __init__(self, out):
+        self.out = out
+        self.bits = 0
+        self.count = 0
+
+    def put(self, value, bits):
+        self.bits = (self.bits << bits) | value
+        self.count += bits
+        while self.count >= 8:
+            self.count -= 8
+            self.out.append((self.bits >> self.count) & 0xFF)
+        self.bits &= (1 << self.count) - 1
+
+    def flush(self):
+        if self.count:
+            self.out.append((self.bits << (8 - self.count)) & 0xFF)
+        self.bits = 0
+        self.count = 0
+
+
+class BitReader:
+
+    def __init__(self, data, pos):
+        self.data = data
+        self.pos = pos
+        self.bits = 0
+        self.count = 0
+
+    def get(self, bits):
+        while self.count < bits:
+            self.bits = (self.bits << 8) | self.data[self.pos]
+            self.pos += 1
+            self.count += 8
+        self.count -= bits
+        value = self.bits >> self.count
+        self.bits &= (1 << self.count) - 1
+        return value
+
+
+def putNumbers(out, values):
+    """
+    Stores a numeric column in whichever mode takes the fewest bytes.
+    """
+    deltas = [values[0]] + [b - a for a, b in zip(values, values[1:])]
+    dods = deltas[:2] + [b - a for a, b in zip(deltas[1:], deltas[2:])]
+
+    candidates = []
+    for mode, column in ((CSV_MODE_DELTA, deltas), (CSV_MODE_DOD, dods)):
+        encoded = bytearray([mode])
+        for v in column:
+            putVarint(encoded, zigzag(v))
+        candidates.append(encoded)
+
+    encoded = bytearray([CSV_MODE_DOD_BITS])
+    for v in dods[:2]:
+        putVarint(encoded, zigzag(v))
+    bits = BitWriter(encoded)
+    for v in dods[2:]:
+        if v == 0:
+            bits.put(0, 1)
+            continue
+        z = zigzag(v)
+        for prefix, length, width in CSV_DOD_CODES:
+            if z < (1 << width):
+                bits.put(prefix, length)
+                bits.put(z, width)
+                break
+    bits.flush()
+    candidates.append(encoded)
+
+    out.extend(min(candidates, key=len))
+
+
+def getNumbers(data, pos, rows):
+    mode = data[pos]
+    pos += 1
+
+    column = []
+    head = rows if mode != CSV_MODE_DOD_BITS else min(rows, 2)
+    for _ in range(head):
+        v, pos = getVarint(data, pos)
+        column.append(unzigzag(v))
+
+    if mode == CSV_MODE_DOD_BITS and rows > 2:
+        bits = BitReader(data, pos)
+        for _ in range(rows - 2):
+            if not bits.get(1):
+                column.append(0)
+                continue
+            length = 1
+            while length < 4 and bits.get(1):
+                length += 1
+            width = CSV_DOD_CODES[length - 1][2]
+            column.append(unzigzag(bits.get(width)))
+        pos = bits.pos
+
+    if mode != CSV_MODE_DELTA:
+        for i in range(2, rows):
+            column[i] += column[i - 1]
+    for i in range(1, rows):
+        column[i] += column[i - 1]
+    return column, pos
+
+
+def lineShape(line):
+    """
+    Outputs:
+        (fields, kinds, crlf) of a line, its cells parsed where numeric
+    """
+    crlf = line.endswith(b"\r")
+    cells = (line[:-1] if crlf else line).split(b",")
+    fields = []
+    kinds = []
+    for cell in cells:
+        number = parseNumber(cell)
+        fields.append(number[0] if number else cell)
+        kinds.append(number[1] + 1 if number else 0)
+    return fields, tuple(kinds), crlf
+
+
+def encodeBlock(out, rows, kinds, crlf):
+    body = bytearray()
+    putVarint(body, len(rows))
+    putVarint(body, len(kinds))
+    body.append(CSV_CRLF if crlf else 0)
+    body.extend(kinds)
+
+    for i, kind in enumerate(kinds):
+        cells = [r[i] for r in rows]
+        if kind:
+            putNumbers(body, cells)
+            continue
+        above = None
+        for cell in cells:
+            if cell == above:
+                putVarint(body, 0)
+            else:
+                putVarint(body, len(cell) + 1)
+                body.extend(cell)
+            above = cell
+
+    putVarint(out, len(body))
+    out.extend(body)
+
+
+def decodeBlock(body):
+    rows, pos = getVarint(body, 0)
+    fields, pos = getVarint(body, pos)
+    crlf = body[pos] & CSV_CRLF
+    pos += 1
+    kinds = body[pos:pos + fields]
+    pos += fields
+
+    columns = []
+    for kind in kinds:
+        if kind:
+            values, pos = getNumbers(body, pos, rows)
+            columns.append([formatNumber(v, kind - 1).encode() for v in values])
+            continue
+        cells = []
+        for _ in range(rows):
+            length, pos = getVarint(body, pos)
+            if length:
+                cells.append(bytes(body[pos:pos + length - 1]))
+                pos += length - 1
+            else:
+                cells.append(cells[-1])
+        columns.append(cells)
+
+    end = b"\r\n" if crlf else b"\n"
+    return b"".join(b",".join(cells) + end for cells in zip(*columns))
+
+
+class CsvEncoder:
+    """
+    Encodes a CSV file as it is read, a block at a time.
+    """
+
+    def __init__(self):
+        self.pending = b""
+        self.rows = []
+        self.kinds = None
+        self.crlf = False
+
+    def _flushBlock(self, out):
+        if self.rows:
+            encodeBlock(out, self.rows, self.kinds, self.crlf)
+        self.rows = []
+
+    def feed(self, data):
+        """
+        Params:
+            data:
+                bytes: next part of the file
+
+        Outputs:
+            bytes: the blocks it completes
+        """
+        out = bytearray()
+        lines = (self.pending + data).split(b"\n")
+        self.pending = lines.pop()
+
+        for line in lines:
+            fields, kinds, crlf = lineShape(line)
+            if (kinds, crlf) != (self.kinds, self.crlf) or len(self.rows) == CSV_BLOCK_ROWS:
+                self._flushBlock(out)
+                self.kinds, self.crlf = kinds, crlf
+            self.rows.append(fields)
+        return bytes(out)
+
+    def flush(self):
+        """
+        Outputs:
+            bytes: the rest of the stream, the last line ending it with no
+            newline unless it is empty
+        """
+        out = bytearray()
+        self._flushBlock(out)
+
+        newline = not self.pending
+        if self.pending:
+            fields, kinds, crlf = lineShape(self.pending)
+            encodeBlock(out, [fields], kinds, crlf)
+        putVarint(out, 0)
+        out.append(1 if newline else 0)
+        return bytes(out)
+
+
+class CsvDecoder:
+    """
+    Undoes CsvEncoder as the stream arrives, handing over every block once
+    all of it is there.
+    """
+
+    def __init__(self):
+        self.pending = bytearray()
+        self.done = False
+        self.last = None
+
+    def feed(self, data):
+        """
+        Params:
+            data:
+                bytes: next part of the stream
+
+        Outputs:
+            bytes: the lines of the file it completes
+        """
+        self.pending.extend(data)
+        out = bytearray()
+
+        while not self.done:
+            try:
+                length, pos = getVarint(self.pending, 0)
+                if not length:
+                    newline = self.pending[pos]
+                    self.done = True
+                    # the last line came with a newline the file does not have
+                    if self.last is not None:
+                        out.extend(self.last if newline else self.last[:-1])
+                    self.last = None
+                    del self.pending[:pos + 1]
+                    break
+            except IndexError:
+                break
+            if pos + length > len(self.pending):
+                break
+
+            # a block's last line waits for the end to know its newline
+            if self.last is not None:
+                out.extend(self.last)
+            lines = decodeBlock(self.pending[pos:pos + length])
+            cut = lines.rfind(b"\n", 0, len(lines) - 1) + 1
+            out.extend(lines[:cut])
+            self.last = lines[cut:]
+            del self.pending[:pos + length]
+
+        return bytes(out)
+
+    def flush(self):
+        """
+        Outputs:
+            bytes: nothing, the stream ends itself; ValueError if it did not
+        """
+        if not self.done:
+            raise ValueError("CSV stream ended early, payloads were lost")
+        return b""
+
+
+def encodeCsv(data):
+    """
+    Outputs:
+        bytes: `data' encoded, or None if that would not be smaller
+    """
+    encoder = CsvEncoder()
+    encoded = encoder.feed(data) + encoder.flush()
+    return encoded if len(encoded) < len(data) else None
+
+
+def decodeCsv(encoded):
+    decoder = CsvDecoder()
+    data = decoder.feed(encoded)
+    decoder.flush()
+    return data
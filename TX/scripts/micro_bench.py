@@ -0,0 +1,125 @@
+#!/bin/python3
+"""
+Runs the kernel microbenchmarks on a TX Arduino built with MICRO_BENCHMARK,
+or compares runs saved before, from boards or from the simulator
+(rfsim --micro N).  Every build prints the same lines, see micro_bench.h:
+
+    micro,<build>,<kernel>,<bytes per call>,<calls>,<ticks>,<ticks per second>
+
+Usage:
+    micro_bench.py <port> <baudrate> > esp32.txt
+    rfsim --nodes 2 --micro 1000 > host.txt
+    micro_bench.py esp32.txt host.txt
+
+Params:
+    sys.argv[1], sys.argv[2]:
+        Absolute path of Serial port and its baudrate: the board's lines
+        are printed as they are
+
+    sys.argv[1:]:
+        otherwise files of lines to compare, anything else in them is
+        skipped
+
+Prints, comparing:
+    ns per call and per byte of every kernel in every file, and cycles per
+    byte where the ticks are the CPU's cycles (the ESP32's CCOUNT)
+
+"""
+
+
+import os
+import sys
+import serial
+from arduino_serial_io import *
+
+MICRO_TAG = "micro"
+
+# as micro_bench.h
+MICRO_SERIAL_BYTES = 128
+MICRO_FILL_CHAR = '#'
+
+# builds whose ticks are CPU cycles
+CYCLE_BUILDS = {"esp32"}
+
+
+def parseResults(lines):
+    """
+    Outputs:
+        dict: kernel: (build, bytes per call, calls, ticks, ticks per second)
+    """
+    results = {}
+    for line in lines:
+        fields = line.strip().split(",")
+        if len(fields) != 7 or fields[0] != MICRO_TAG:
+            continue
+        build, kernel = fields[1], fields[2]
+        results[kernel] = (build,) + tuple(int(f) for f in fields[3:])
+    return results
+
+
+def runBoard(port, baudrate):
+    channel, address = setConfig(port)
+
+    # configuring our serial
+    ser = serial.Serial()
+    ser.port = port
+    ser.baudrate = baudrate
+    ser.open()
+
+    flushSerial(ser)
+
+    # sending over our configurations
+    writeData(ser, channel)
+    writeData(ser, address)
+    writeData(ser, getShaping())
+
+    print("\nBenchmarking kernels please wait...", file=sys.stderr)
+
+    # the bytes its serial read kernel takes out of the UART's buffer
+    handshake(ser)
+    ser.write(bytearray([ord(MICRO_FILL_CHAR)] * MICRO_SERIAL_BYTES))
+    print(getData(ser).strip())
+
+    ser.close()
+
+
+def compare(paths):
+    runs = []
+    for path in paths:
+        with open(path) as f:
+            runs.append((os.path.basename(path), parseResults(f)))
+
+    kernels = []
+    for _, results in runs:
+        kernels += [k for k in results if k not in kernels]
+
+    header = ["kernel", "bytes"]
+    for name, _ in runs:
+        header += [name + " ns/call", "ns/byte", "cycles/byte"]
+
+    rows = [header]
+    for kernel in kernels:
+        row = [kernel, "-"]
+        for _, results in runs:
+            if kernel not in results:
+                row += ["-", "-", "-"]
+                continue
+            build, size, calls, ticks, hz = results[kernel]
+            row[1] = str(size)
+            ns = 1e9 * ticks / hz / calls
+            row.append("{0:.1f}".format(ns))
+            row.append("{0:.2f}".format(ns / size))
+            row.append("{0:.2f}".format(ticks / calls / size) if build in CYCLE_BUILDS else "-")
+        rows.append(row)
+
+    widths = [max(len(r[i]) for r in rows) for i in range(len(header))]
+    for r in rows:
+        print("  ".join(c.rjust(w) for c, w in zip(r, widths)))
+
+
+if __name__ == "__main__":
+
+    if len(sys.argv) == 3 and sys.argv[2].isdigit() and not os.path.isfile(sys.argv[1]):
+        runBoard(sys.argv[1], int(sys.argv[2]))
+    else:
+        compare(sys.argv[1:])
@@ -0,0 +1,44 @@
+#!/bin/python3
+"""
+Runs the radio backend benchmark on a TX Arduino built with RADIO_BENCHMARK
+and prints how each backend did.  The RX Arduino has to be receiving
+(rx_interface.sh) on the same channel and address; it saves the benchmark
+payloads as a file of '#'.
+
+Params:
+    sys.argv[1]:
+        Absolute path of Serial port
+
+    sys.argv[2]:
+        Baudrate of Serial port
+"""
+
+
+import sys
+import serial
+from arduino_serial_io import *
+
+
+if __name__ == "__main__":
+
+    channel, address = setConfig(sys.argv[1])
+
+    # configuring our serial
+    ser = serial.Serial()
+    ser.port = sys.argv[1]
+    ser.baudrate = int(sys.argv[2])
+    ser.open()
+
+    flushSerial(ser)
+
+    # sending over our configurations
+    writeData(ser, channel)
+    writeData(ser, address)
+    writeData(ser, getShaping())
+
+    print("\nBenchmarking radio backends please wait...")
+
+    handshake(ser)
+    print(getData(ser))
+
+    ser.close()
@@ -17,23 +17,43 @@ Params:
     sys.argv[4]:
         Plain raw-hex string of file to send
 
+    --xz, --csv:
+        anywhere after the script, send the file xz compressed, or as CSV
+        telemetry encoded by column first, if that is smaller; the default
+        is ENCODING
+
 Sends:
     channel:
         0-125
         
     address:
-        0-10000
+        4 bytes, 0-0xFFFFFFFF
+
+    shaping:
+        Airtime caps of the link and its flows, from link_profile.py
 
     file_extension_bytes:
-        File extension of our sent file
+        File extension of our sent file, after COMPRESSED_MARK or CSV_MARK
+        if the file is compressed
 
     raw_hex_bytes:
-        Raw-hex of our file
+        Raw-hex of our file or, as ENCODING says, the xz compressed file
+        (or CSV telemetry encoded by column first) in Ascii85 if that is
+        smaller
+
+Control:
+    Ctrl-C cancels the transfer and leaves the Arduino ready for the next
+    run, SIGUSR1 pauses it and SIGUSR2 resumes it (kill -USR1 <pid>).
+    With SERIAL_MUX they go over the control channel, and the Arduino's
+    stats are printed while the file goes out.
 
 """
 
 
 import sys
+import time
+import signal
+import threading
 import serial
 from subprocess import check_output
 from arduino_serial_io import *
@@ -41,17 +61,90 @@ from arduino_serial_io import *
 # used to debug communication
 DEBUG = 0
 
+# must match LINK_TRACE in main.cpp
+LINK_TRACE = 0
 
-if __name__ == "__main__":
-    
+# how the computer encodes the file before sending unless --xz or --csv says
+# otherwise: ENCODING_RAW, ENCODING_XZ (compressFile) or ENCODING_CSV
+# (compressCsv, for CSV telemetry, else as xz).  Only receiving computers
+# running this version decode the others.
+ENCODING = ENCODING_RAW
+
+# the flags choosing an encoding
+ENCODING_FLAGS = {"--xz": ENCODING_XZ, "--csv": ENCODING_CSV}
+
+# must match SERIAL_MUX in main.cpp, see SerialMux
+SERIAL_MUX = 0
+
+# with SERIAL_MUX, seconds between stats printed while the file goes out (0 for none)
+MUX_STATS_SEC = 5
+
+# must match SESSION_NEGOTIATE in main.cpp; the file is then only encoded
+# if the session agreed on compression
+SESSION_NEGOTIATE = 0
+
+# must match RENDEZVOUS in main.cpp; the receiver is invited onto a private
+# link instead of the one asked for, see privateLink
+RENDEZVOUS = 0
+
+
+def takeEncoding(argv):
+    """
+    Takes --xz or --csv out of `argv', leaving the positional params.
+
+    Outputs:
+        str: the encoding asked for, ENCODING without a flag
+    """
+    encoding = ENCODING
+    for flag, asked in ENCODING_FLAGS.items():
+        while flag in argv:
+            argv.remove(flag)
+            encoding = asked
+    return encoding
+
+
+def fileExtension(path):
+    """
+    Returns the extension of `path', everything after its first dot.
+    Raises ValueError if it is longer than the EXTENSION_BYTES the Arduino
+    keeps.
+    """
+    extension = path.split('.')[1]
+    if len(extension) > EXTENSION_BYTES:
+        raise ValueError("extension {0} of {1} is longer than the {2} bytes the Arduino keeps".format(
+            extension, path, EXTENSION_BYTES))
+    return extension
+
+
+def buildFile(path, file_data, encoding):
+    """
+    Returns the extension and the contents of the file as they go to the
+    Arduino, encoded as `encoding' says if that is smaller.  The Arduino
+    keeps EXTENSION_BYTES of the extension, a mark included, so a file
+    whose extension only fits without one goes as it is.
+    """
     raw_hex_bytes = bytearray()  # our file to be sent
     file_extension_bytes = bytearray()  # file extension being sent over, used for decoding
     file_extension = []
 
+    extension = fileExtension(path)
+    if len(extension) + len(COMPRESSED_MARK) > EXTENSION_BYTES:
+        encoding = ENCODING_RAW
+
+    # the Arduinos pass compressed data through as is, the mark tells the
+    # receiving computer how to decompress it
+    compressed = compressCsv(file_data) if encoding == ENCODING_CSV else None
+    if compressed is not None:
+        file_extension.append(ord(CSV_MARK))
+    elif encoding != ENCODING_RAW:
+        compressed = compressFile(file_data)
+        if compressed is not None:
+            file_extension.append(ord(COMPRESSED_MARK))
+
     # Translation:
     #   1) .split('.')[1] means take everything after the . of our file path
     #   2) ord converts characters to bytes
-    file_extension.extend(map(ord, sys.argv[3].split('.')[1]))
+    file_extension.extend(map(ord, extension))
 
     # Fill in unused chars with spaces (as bytes), ensuring that our file extension to
     # be sent over has EXTENSION_LEN bytes total
@@ -61,15 +154,58 @@ if __name__ == "__main__":
     # populating our byte arrays
     file_extension_bytes.extend(file_extension)
 
+    if compressed is not None:
+        raw_hex_bytes.extend(compressed)
+    else:
+        raw_hex_bytes.extend(map(ord, str(file_data, 'utf-8')))
+
+    return file_extension_bytes, raw_hex_bytes
+
+
+def sendMux(ser, extension, data):
+    """
+    Sends the file on the first data stream of the virtual channels, with
+    control and stats alongside it.
+    """
+    mux = SerialMux(ser)
+    signal.signal(signal.SIGUSR1, lambda *_: mux.control(CONTROL_PAUSE, 0))
+    signal.signal(signal.SIGUSR2, lambda *_: mux.control(CONTROL_RESUME, 0))
+
+    def monitor():
+        while MUX_STATS_SEC:
+            time.sleep(MUX_STATS_SEC)
+            print(mux.getStats())
+
+    threading.Thread(target=monitor, daemon=True).start()
+
+    try:
+        mux.open(0, extension)
+        mux.write(0, bytes(data))
+        mux.close(0)
+    except KeyboardInterrupt:
+        mux.control(CONTROL_ABORT, 0)
+        mux.end()
+        print("\nTransfer cancelled")
+        ser.close()
+        sys.exit(1)
+
+    print(mux.getStats())
+    mux.end()
+
+
+if __name__ == "__main__":
+
     # get file data here as passing it through argv 
     # may not work
+    encoding = takeEncoding(sys.argv)
     file_data = check_output('cat ' + sys.argv[3], shell=True)
-    
-    file_data = file_data.decode('utf-8')
-    
-    raw_hex_bytes.extend(map(ord, file_data))
+    try:
+        file_extension_bytes, raw_hex_bytes = buildFile(sys.argv[3], file_data, encoding)
+    except ValueError as e:
+        print(e)
+        sys.exit(1)
 
-    channel, address = setConfig()
+    channel, address = privateLink(sys.argv[1]) if RENDEZVOUS else setConfig(sys.argv[1])
 
     print("\nSending file please wait...")
 
@@ -82,28 +218,59 @@ if __name__ == "__main__":
     flushSerial(ser)
 
     # sending over our configurations
-    ser.write(channel)
-    ser.write(address)
-    
-    # initialte communication with the Arduino
-    handshake(ser)
+    writeData(ser, channel)
+    writeData(ser, address)
+    writeData(ser, getShaping())
 
-    # send over the extension and its contents one byte at a time
-    ser.write(file_extension_bytes)
+    if SESSION_NEGOTIATE and not SERIAL_MUX:
+        # the Arduino agrees on the session with the receiver first
+        session = readSession(ser)
+        if session is None:
+            print("No session with the receiver, is it running with SESSION_NEGOTIATE?")
+            ser.close()
+            sys.exit(1)
+        print(describeSession(session))
 
-    # precaution to make sure we are only sending file data over Serial
-    chunks = chunkGenerator(raw_hex_bytes)
-    for c in chunks:
+        if encoding != ENCODING_RAW and not session["features"] & SESSION_LZMA:
+            file_extension_bytes, raw_hex_bytes = buildFile(sys.argv[3], file_data, ENCODING_RAW)
+
+    if SERIAL_MUX:
+        sendMux(ser, file_extension_bytes, raw_hex_bytes)
+        ser.close()
+        sys.exit(0)
+    
+    # pause and resume from another terminal, see Control above
+    signal.signal(signal.SIGUSR1, lambda *_: sendControl(ser, CONTROL_PAUSE))
+    signal.signal(signal.SIGUSR2, lambda *_: sendControl(ser, CONTROL_RESUME))
 
-        # Shake between every transaction to make sure that the Arduino
-        # is ready for our next chunk of data
+    try:
+        # initialte communication with the Arduino
         handshake(ser)
-        total = len(c)
-        total = total.to_bytes(1, byteorder=ENDIANESS)
-        ser.write(total)
-        ser.write(c)
 
-        if DEBUG:
-            printData(ser, '') # output our received file
+        # send over the extension and its contents one byte at a time
+        writeData(ser, file_extension_bytes)
+
+        # precaution to make sure we are only sending file data over Serial
+        chunks = chunkGenerator(raw_hex_bytes)
+        for c in chunks:
+
+            # Shake between every transaction to make sure that the Arduino
+            # is ready for our next chunk of data
+            handshake(ser)
+            total = len(c)
+            total = total.to_bytes(1, byteorder=ENDIANESS)
+
+            writeData(ser, total + c)
+
+            if DEBUG:
+                printData(ser, '') # output our received file
+    except KeyboardInterrupt:
+        sendControl(ser, CONTROL_PREEMPT)
+        print("\nTransfer cancelled")
+        ser.close()
+        sys.exit(1)
+
+    if LINK_TRACE:
+        print("Saved link trace to " + saveTrace(ser, "tx"))
 
     ser.close()
@@ -0,0 +1,77 @@
+#!/bin/python3
+"""
+Sends small messages, telemetry and the like, through a TX Arduino built
+with AGGREGATE to an RX Arduino built with it too (receive_messages.py).
+The Arduino packs the messages of every flow into shared payloads, each
+waiting no longer than its flow's deadline.
+
+Every line on stdin is a message: the flow, a space, then the text.
+
+Params:
+    sys.argv[1]:
+        Absolute path of Serial port
+
+    sys.argv[2]:
+        Baudrate of Serial port
+
+    sys.argv[3:]:
+        Deadline of every flow from flow 0 in microseconds, the rest get
+        AGGREGATE_DEADLINE_US
+
+Sends:
+    channel, address and shaping, as send_hex.py
+
+    deadlines:
+        AGGREGATE_FLOWS of them, 4 bytes each
+
+    messages:
+        flow, length and the bytes of each
+
+Control:
+    Ctrl-C or the end of stdin ends the session, sending what is queued.
+
+"""
+
+
+import sys
+import serial
+from arduino_serial_io import *
+
+
+if __name__ == "__main__":
+
+    deadlines = [int(d) for d in sys.argv[3:]]
+
+    channel, address = setConfig(sys.argv[1])
+
+    # configuring our serial
+    ser = serial.Serial()
+    ser.port = sys.argv[1]
+    ser.baudrate = int(sys.argv[2])
+    ser.open()
+
+    flushSerial(ser)
+
+    # sending over our configurations
+    writeData(ser, channel)
+    writeData(ser, address)
+    writeData(ser, getShaping())
+
+    sendDeadlines(ser, deadlines)
+    print("\nSending one message per line as '<flow> <text>', Ctrl-D to stop...")
+
+    sent = 0
+    try:
+        for line in sys.stdin:
+            flow, _, text = line.rstrip("\n").partition(" ")
+            try:
+                sendMessage(ser, int(flow), text.encode())
+                sent += 1
+            except ValueError as e:
+                print("skipped: {0}".format(e))
+    except KeyboardInterrupt:
+        pass
+
+    sendControl(ser, CONTROL_PREEMPT)
+    print("\nSent {0} messages".format(sent))
+    ser.close()
@@ -0,0 +1,319 @@
+#!/bin/python3
+"""
+Sends many files through several TX Arduinos at once, each one its own
+link.  A single computer encoding the files one after another, as
+send_hex.py does, falls behind as boards are added: xz at its highest
+preset runs at a few MB/s.  Here the files go through stages, each with
+threads of its own and a bounded queue in front of the next:
+
+    read:       maps the file into memory
+    encode:     buildFile, compressed as --xz or --csv says
+    hash:       SHA-256 of the file, to check the received copy against
+
+then one writer per link takes whichever file is ready next and sends it
+as send_hex.py would.  lzma and hashlib let go of the GIL while they work,
+so the threads of a stage really run side by side; the column pass of
+ENCODING_CSV does not, and gains less.  Files do not go out in order.
+
+The Arduinos must be built for the plain lockstep transfer, without
+SERIAL_MUX or SESSION_NEGOTIATE.  There is no erasure coding stage: the
+parity of HARQ_MODE is made on the TX Arduino.
+
+At the end every stage reports its throughput: how many MB/s each thread
+of it did while busy, how many the stage did over the whole run, and how
+long it waited on the queue after it.  A stage that waits is not what
+limits the links.
+
+Params:
+    sys.argv[1]:
+        Serial ports of the TX Arduinos, comma separated, or - for none to
+        measure the computer alone
+
+    sys.argv[2]:
+        Baudrate of the Serial ports
+
+    sys.argv[3:]:
+        Filepaths of the files to send
+
+    --xz, --csv:
+        encoding of the files, as send_hex.py
+
+Sends:
+    channel, address and shaping of each board, as send_hex.py, once
+
+    files:
+        extension and raw-hex of each, as send_hex.py
+
+Control:
+    Ctrl-C stops every link after the chunk it is sending.
+
+"""
+
+
+import os
+import sys
+import mmap
+import time
+import queue
+import hashlib
+import threading
+import serial
+from arduino_serial_io import *
+from send_hex import buildFile, fileExtension, takeEncoding, ENCODING, RENDEZVOUS
+
+# threads of each stage
+READ_WORKERS = 2
+ENCODE_WORKERS = os.cpu_count() or 1
+HASH_WORKERS = 2
+
+# files waiting between two stages, bounding how far ahead the computer reads
+PIPELINE_QUEUE_DEPTH = 8
+
+# ends a queue, one per thread taking from it
+PIPELINE_DONE = None
+
+
+class Stage:
+    """
+    Threads taking work from one queue and putting what they make on the
+    next, keeping count of the bytes and the time they spend.
+    """
+
+    def __init__(self, name, work, workers, source, sink):
+        self.name = name
+        self.work = work
+        self.workers = workers
+        self.source = source
+        self.sink = sink
+
+        self.lock = threading.Lock()
+        self.files = 0
+        self.bytes_in = 0
+        self.bytes_out = 0
+        self.busy_sec = 0.0
+        self.blocked_sec = 0.0
+        self.threads = []
+        self.started = None
+        self.ended = None
+
+    def start(self):
+        self.started = time.perf_counter()
+        self.threads = [threading.Thread(target=self._run, daemon=True) for _ in range(self.workers)]
+        for t in self.threads:
+            t.start()
+
+    def join(self):
+        for t in self.threads:
+            t.join()
+        self.ended = time.perf_counter()
+
+    def _run(self):
+        while True:
+            item = self.source.get()
+            if item is PIPELINE_DONE:
+                return
+
+            started = time.perf_counter()
+            item, size_in, size_out = self.work(item)
+            busy = time.perf_counter() - started
+
+            started = time.perf_counter()
+            self.sink.put(item)
+            blocked = time.perf_counter() - started
+
+            with self.lock:
+                self.files += 1
+                self.bytes_in += size_in
+                self.bytes_out += size_out
+                self.busy_sec += busy
+                self.blocked_sec += blocked
+
+    def report(self):
+        wall = (self.ended or time.perf_counter()) - self.started
+        return [self.name, str(self.workers), str(self.files),
+                "{0:.2f}".format(self.bytes_in / 1e6), "{0:.2f}".format(self.bytes_out / 1e6),
+                "{0:.1f}".format(self.bytes_in / self.busy_sec / 1e6 if self.busy_sec else 0),
+                "{0:.1f}".format(self.bytes_in / wall / 1e6 if wall else 0),
+                "{0:.2f}".format(self.blocked_sec)]
+
+
+def readFile(path):
+    """
+    Params:
+        path:
+            file to send
+
+    Outputs:
+        (path, contents), bytes read, bytes passed on: the contents are a
+        view of the mapping rather than a copy, which keeps the file mapped
+        until the last stage lets go of it
+    """
+    with open(path, "rb") as f:
+        if not os.fstat(f.fileno()).st_size:
+            return (path, b""), 0, 0
+        data = memoryview(mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ))
+    return (path, data), len(data), len(data)
+
+
+def encodeFile(item):
+    path, data = item
+    extension, encoded = buildFile(path, data, ENCODING)
+    return (path, data, extension, encoded), len(data), len(encoded)
+
+
+def hashFile(item):
+    path, data, extension, encoded = item
+    digest = hashlib.sha256(data).hexdigest()
+    return (path, digest, extension, encoded), len(data), len(encoded)
+
+
+class Link:
+    """
+    A TX Arduino sending whichever file is ready next until there are none.
+    """
+
+    def __init__(self, port, baudrate, ready, stopped):
+        self.port = port
+        self.ready = ready
+        self.stopped = stopped
+        self.files = 0
+        self.bytes = 0
+        self.busy_sec = 0.0
+        self.idle_sec = 0.0
+        self.sent = []
+
+        self.ser = None
+        if port is None:
+            return
+
+        channel, address = privateLink(port) if RENDEZVOUS else setConfig(port)
+        self.ser = serial.Serial()
+        self.ser.port = port
+        self.ser.baudrate = baudrate
+        self.ser.open()
+
+        flushSerial(self.ser)
+
+        # the Arduino keeps its configuration from one file to the next
+        writeData(self.ser, channel)
+        writeData(self.ser, address)
+        writeData(self.ser, getShaping())
+
+    def run(self):
+        while not self.stopped.is_set():
+            started = time.perf_counter()
+            item = self.ready.get()
+            self.idle_sec += time.perf_counter() - started
+            if item is PIPELINE_DONE:
+                break
+
+            path, digest, extension, encoded = item
+            started = time.perf_counter()
+            if self.ser is not None and not sendFile(self.ser, extension, encoded, self.stopped):
+                break
+            self.busy_sec += time.perf_counter() - started
+
+            self.files += 1
+            self.bytes += len(encoded)
+            self.sent.append((path, digest))
+
+        if self.ser is not None:
+            self.ser.close()
+
+    def report(self):
+        if self.ser is None:
+            return ["-", str(self.files), "{0:.2f}".format(self.bytes / 1e6), "-", "{0:.2f}".format(self.idle_sec)]
+        return [self.port, str(self.files), "{0:.2f}".format(self.bytes / 1e6),
+                "{0:.1f}".format(self.bytes / self.busy_sec / 1e3 if self.busy_sec else 0),
+                "{0:.2f}".format(self.idle_sec)]
+
+
+def printTable(header, rows):
+    rows = [header] + rows
+    widths = [max(len(r[i]) for r in rows) for i in range(len(header))]
+    for r in rows:
+        print("  ".join(c.rjust(w) for c, w in zip(r, widths)))
+
+
+def endQueue(stage, q, takers):
+    """
+    Ends `q' once every thread of `stage' is done putting on it.
+    """
+    stage.join()
+    for _ in range(takers):
+        q.put(PIPELINE_DONE)
+
+
+if __name__ == "__main__":
+
+    ENCODING = takeEncoding(sys.argv)
+    ports = [None] if sys.argv[1] == "-" else sys.argv[1].split(",")
+    baudrate = int(sys.argv[2])
+    paths = sys.argv[3:]
+
+    # before anything is sent, a worker would only stop at the file
+    try:
+        for path in paths:
+            fileExtension(path)
+    except ValueError as e:
+        print(e)
+        sys.exit(1)
+
+    paths_q = queue.Queue()
+    read_q = queue.Queue(PIPELINE_QUEUE_DEPTH)
+    encoded_q = queue.Queue(PIPELINE_QUEUE_DEPTH)
+    ready_q = queue.Queue(PIPELINE_QUEUE_DEPTH)
+
+    stopped = threading.Event()
+    links = [Link(port, baudrate, ready_q, stopped) for port in ports]
+
+    stages = [Stage("read", readFile, READ_WORKERS, paths_q, read_q),
+              Stage("encode", encodeFile, ENCODE_WORKERS, read_q, encoded_q),
+              Stage("hash", hashFile, HASH_WORKERS, encoded_q, ready_q)]
+    takers = [s.workers for s in stages[1:]] + [len(links)]
+
+    print("\nSending {0} files over {1} links please wait...".format(len(paths), len(links)))
+    started = time.perf_counter()
+
+    for path in paths:
+        paths_q.put(path)
+    for _ in range(READ_WORKERS):
+        paths_q.put(PIPELINE_DONE)
+
+    for s in stages:
+        s.start()
+    enders = [threading.Thread(target=endQueue, args=(s, s.sink, n), daemon=True) for s, n in zip(stages, takers)]
+    writers = [threading.Thread(target=link.run, daemon=True) for link in links]
+    for t in enders + writers:
+        t.start()
+
+    try:
+        for t in writers:
+            while t.is_alive():
+                t.join(0.1)
+    except KeyboardInterrupt:
+        stopped.set()
+        # free writers waiting for a file so they see it
+        for _ in links:
+            try:
+                ready_q.put_nowait(PIPELINE_DONE)
+            except queue.Full:
+                pass
+        for t in writers:
+            t.join()
+        print("\nTransfer cancelled")
+
+    wall = time.perf_counter() - started
+
+    print()
+    for link in links:
+        for path, digest in link.sent:
+            print("{0}  {1}  {2}".format(digest, path, link.port or "-"))
+
+    print("\n{0:.2f} s".format(wall))
+    printTable(["stage", "threads", "files", "MB in", "MB out", "MB/s/thread", "MB/s", "blocked s"],
+               [s.report() for s in stages])
+    print()
+    printTable(["link", "files", "MB", "kB/s", "idle s"], [link.report() for link in links])
+
+    sys.exit(1 if stopped.is_set() else 0)
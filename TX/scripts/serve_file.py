@@ -0,0 +1,93 @@
+#!/bin/python3
+"""
+Serves a file from a TX Arduino built with PULL_MODE to a receiver pulling
+it from several boards at once (pull_file.py).  Run one per board, each with
+a copy of the same file: the channel is the receiver's, the address this
+board's own, and the receiver is given the addresses of all of them.
+
+The Arduino asks for the blocks it is to send as the receiver asks it for
+them, so only the blocks this board sends go over its serial port.
+
+Params:
+    sys.argv[1]:
+        Absolute path of Serial port
+
+    sys.argv[2]:
+        Baudrate of Serial port
+
+    sys.argv[3]:
+        Filepath of file to serve
+
+Sends:
+    channel, address and shaping, as send_hex.py
+
+    file_extension_bytes:
+        File extension of the file
+
+    size:
+        Its size in bytes, 4 bytes
+
+    blocks:
+        PULL_FETCH_BLOCKS blocks whenever the Arduino asks for them
+
+Control:
+    Ctrl-C stops serving and leaves the Arduino ready for the next run.
+
+"""
+
+
+import sys
+import serial
+from arduino_serial_io import *
+
+# must match pull_protocol.h
+PULL_BLOCK_BYTES = 28
+PULL_FETCH_BLOCKS = 8
+PULL_FETCH_CHAR = 'f'
+
+
+if __name__ == "__main__":
+
+    with open(sys.argv[3], "rb") as f:
+        file_data = f.read()
+
+    extension = sys.argv[3].split('.')[-1].encode()
+    file_extension_bytes = extension + b" " * (EXTENSION_LEN - len(extension))
+
+    channel, address = setConfig(sys.argv[1])
+
+    # configuring our serial
+    ser = serial.Serial()
+    ser.port = sys.argv[1]
+    ser.baudrate = int(sys.argv[2])
+    ser.open()
+
+    flushSerial(ser)
+
+    # sending over our configurations
+    writeData(ser, channel)
+    writeData(ser, address)
+    writeData(ser, getShaping())
+
+    handshake(ser)
+    writeData(ser, file_extension_bytes)
+    writeData(ser, len(file_data).to_bytes(4, byteorder=ENDIANESS))
+
+    print("\nServing {0} bytes, Ctrl-C to stop...".format(len(file_data)))
+
+    batch = PULL_FETCH_BLOCKS * PULL_BLOCK_BYTES
+    fetches = 0
+    try:
+        while True:
+            if ser.read(1) != PULL_FETCH_CHAR.encode():
+                continue
+
+            first = int.from_bytes(ser.read(4), byteorder=ENDIANESS)
+            blocks = file_data[first * PULL_BLOCK_BYTES:first * PULL_BLOCK_BYTES + batch]
+            writeData(ser, blocks + bytes(batch - len(blocks)))
+            fetches += 1
+    except KeyboardInterrupt:
+        sendControl(ser, CONTROL_PREEMPT)
+        print("\nServed {0} blocks".format(fetches * PULL_FETCH_BLOCKS))
+
+    ser.close()
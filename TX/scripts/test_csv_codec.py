@@ -0,0 +1,68 @@
+"""
+Tests of csv_codec.py, run with pytest from this directory.  Whatever goes
+in has to come back byte for byte, fed to the decoder whole or a few bytes
+at a time as payloads arrive.
+"""
+
+import random
+
+import pytest
+
+from csv_codec import CsvEncoder, CsvDecoder, encodeCsv, decodeCsv, CSV_BLOCK_ROWS
+
+
+def regular(rows):
+    return b"".join(b"%d,%.2f,%d,ok\n" % (1700000000 + 10 * i, 20 + (i % 7) / 100, i * i) for i in range(rows))
+
+
+FILES = {
+    "empty": b"",
+    "one line, no newline": b"1,2,3",
+    "header then readings": b"time,temp,state\n" + regular(CSV_BLOCK_ROWS * 2 + 3),
+    "crlf": regular(40).replace(b"\n", b"\r\n"),
+    "shapes change": regular(10) + b"a,b\n1.5,-2\n-0.25,3\n" + regular(10),
+    "numbers that do not format back": b"007,1.50,-0,+3,1e5\n" * 20,
+    "irregular timestamps": b"".join(b"%d,%d\n" % (t, t % 3) for t in sorted(random.Random(1).sample(range(10 ** 9), 300))),
+    "large values": b"".join(b"%d\n" % ((1 << 59) - i * 12345678901) for i in range(50)),
+    "not csv": bytes(random.Random(2).getrandbits(8) for _ in range(1000)),
+}
+
+
+def encode(data):
+    encoder = CsvEncoder()
+    return encoder.feed(data) + encoder.flush()
+
+
+@pytest.mark.parametrize("name", FILES)
+def test_round_trip(name):
+    assert decodeCsv(encode(FILES[name])) == FILES[name]
+
+
+@pytest.mark.parametrize("name", FILES)
+def test_round_trip_a_few_bytes_at_a_time(name):
+    encoded = encode(FILES[name])
+    decoder = CsvDecoder()
+    out = b"".join(decoder.feed(encoded[i:i + 7]) for i in range(0, len(encoded), 7))
+    assert out + decoder.flush() == FILES[name]
+
+
+def test_encoder_fed_in_pieces_matches_whole():
+    data = FILES["header then readings"]
+    encoder = CsvEncoder()
+    pieces = b"".join(encoder.feed(data[i:i + 100]) for i in range(0, len(data), 100))
+    assert pieces + encoder.flush() == encode(data)
+
+
+def test_readings_get_smaller():
+    data = FILES["header then readings"]
+    encoded = encodeCsv(data)
+    assert encoded is not None and len(encoded) < len(data) / 4
+    assert encodeCsv(FILES["not csv"]) is None
+
+
+def test_stream_cut_short_is_an_error():
+    encoded = encode(FILES["header then readings"])
+    decoder = CsvDecoder()
+    decoder.feed(encoded[:-1])
+    with pytest.raises(ValueError):
+        decoder.flush()
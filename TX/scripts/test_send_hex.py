@@ -0,0 +1,61 @@
+"""
+Tests of send_hex.py's encoding of a file, run with pytest from this
+directory.  What buildFile gives the Arduino has to come back byte for
+byte through the receiving computer's streamDecoder.
+"""
+
+import pytest
+
+import send_hex
+from arduino_serial_io import (ENCODING_RAW, ENCODING_XZ, ENCODING_CSV, EXTENSION_BYTES,
+                               EXTENSION_LEN, COMPRESSED_MARK, CSV_MARK, streamDecoder)
+
+TELEMETRY = b"".join(b"%d,%.2f,ok\n" % (1700000000 + i, 20 + i / 100) for i in range(500))
+
+
+def receive(extension, data, payload=32):
+    """
+    The receiving computer's side: the extension as the Arduino keeps it,
+    then the data a payload at a time.
+    """
+    extension = extension[:EXTENSION_BYTES].decode().strip()
+    extension, decoder = streamDecoder(extension)
+    if decoder is None:
+        return extension, bytes(data)
+
+    text = bytes(data).decode()
+    out = b""
+    for i in range(0, len(text), payload):
+        out += decoder.feed(text[i:i + payload])
+    return extension, out + decoder.flush()
+
+
+def test_flags_choose_the_encoding():
+    argv = ["send_hex.py", "/dev/ttyUSB0", "--csv", "115200", "log.csv"]
+    assert send_hex.takeEncoding(argv) == ENCODING_CSV
+    assert argv == ["send_hex.py", "/dev/ttyUSB0", "115200", "log.csv"]
+
+    assert send_hex.takeEncoding(["send_hex.py", "--xz"]) == ENCODING_XZ
+    assert send_hex.takeEncoding(["send_hex.py"]) == send_hex.ENCODING == ENCODING_RAW
+
+
+@pytest.mark.parametrize("encoding, mark", [(ENCODING_RAW, ""), (ENCODING_XZ, COMPRESSED_MARK),
+                                            (ENCODING_CSV, CSV_MARK)])
+def test_encodings_come_back(encoding, mark):
+    extension, data = send_hex.buildFile("telemetry.csv", TELEMETRY, encoding)
+
+    assert len(extension) == EXTENSION_LEN
+    assert extension.decode().startswith(mark + "csv")
+    assert receive(extension, data) == ("csv", TELEMETRY)
+
+
+def test_extension_the_mark_pushes_over_goes_raw():
+    name = "f." + "x" * EXTENSION_BYTES
+    extension, data = send_hex.buildFile(name, TELEMETRY, ENCODING_XZ)
+
+    assert receive(extension, data) == ("x" * EXTENSION_BYTES, TELEMETRY)
+
+
+def test_extension_too_long_is_rejected():
+    with pytest.raises(ValueError):
+        send_hex.buildFile("f." + "x" * (EXTENSION_BYTES + 1), TELEMETRY, ENCODING_RAW)
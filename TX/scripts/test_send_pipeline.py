@@ -0,0 +1,109 @@
+"""
+Tests of send_pipeline.py, run with pytest from this directory.  Several
+files go through the stages and out of one Link, on one open port, to a
+board stand-in that takes them as the TX main's loop() does.
+"""
+
+import hashlib
+import queue
+import threading
+
+import arduino_serial_io
+import send_pipeline
+from arduino_serial_io import HANDSHAKE_BYTE, MAX_HEX_CHUNK_BYTES, ENCODING_RAW, ESCAPE_CHAR, ESCAPE_XOR, TX_CHAR
+
+
+class FakeBoard:
+    """
+    Serial port of a TX Arduino: answers every handshake with its own and
+    splits what comes between them into files, a file being its extension
+    and then chunks up to the first one shorter than MAX_HEX_CHUNK_BYTES.
+    Escaped bytes are taken back as the board's ControlReader does.
+    """
+
+    def __init__(self):
+        self.replies = b""
+        self.frame = None
+        self.files = []       # (extension, data)
+        self.extension = None
+        self.data = b""
+
+    @property
+    def in_waiting(self):
+        return len(self.replies)
+
+    def read(self, size):
+        data, self.replies = self.replies[:size], self.replies[size:]
+        return data
+
+    def write(self, data):
+        if bytes(data) == bytes(HANDSHAKE_BYTE):
+            self._endFrame()
+            self.frame = b""
+            self.replies += HANDSHAKE_BYTE
+            return
+        self.frame += bytes(data)
+
+    def close(self):
+        self._endFrame()
+
+    def _endFrame(self):
+        if self.frame is None:
+            return
+        frame, self.frame = self.frame, None
+        assert TX_CHAR.encode() not in frame
+        frame = self._unescape(frame)
+        if self.extension is None:
+            self.extension = frame
+            return
+
+        size = frame[0]
+        assert size == len(frame) - 1
+        self.data += frame[1:]
+        if size < MAX_HEX_CHUNK_BYTES:
+            self.files.append((self.extension, self.data))
+            self.extension, self.data = None, b""
+
+    @staticmethod
+    def _unescape(frame):
+        data = bytearray()
+        escaped = False
+        for b in frame:
+            if escaped:
+                data.append(b ^ ESCAPE_XOR)
+                escaped = False
+            elif b == ord(ESCAPE_CHAR):
+                escaped = True
+            else:
+                data.append(b)
+        return bytes(data)
+
+
+def test_files_back_to_back_on_one_link(tmp_path, monkeypatch):
+    monkeypatch.setattr(send_pipeline, "ENCODING", ENCODING_RAW)
+
+    contents = {"a.txt": b"0123456789abcdef" * 40,
+                "b.hex": bytes(range(200)).hex().encode(),
+                "c.txt": b"x" * MAX_HEX_CHUNK_BYTES,
+                "e.txt": b"~}~~}}" * 100,
+                "d.txt": b""}
+    ready = queue.Queue()
+    for name, data in contents.items():
+        path = tmp_path / name
+        path.write_bytes(data)
+        item, _, _ = send_pipeline.readFile(str(path))
+        item, _, _ = send_pipeline.encodeFile(item)
+        item, _, _ = send_pipeline.hashFile(item)
+        ready.put(item)
+    ready.put(send_pipeline.PIPELINE_DONE)
+
+    link = send_pipeline.Link(None, 0, ready, threading.Event())
+    board = FakeBoard()
+    link.ser = board
+    link.run()
+
+    assert link.files == len(contents)
+    assert [(e.decode().strip(), d) for e, d in board.files] == \
+        [(name.split(".")[1], data) for name, data in contents.items()]
+    assert [digest for _, digest in link.sent] == \
+        [hashlib.sha256(data).hexdigest() for data in contents.values()]
@@ -0,0 +1,119 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "aggregator.h"
+
+
+uint8_t
+splitAggregate(const char * payload, aggregate_deliver_f deliver, void * ctx)
+{
+  /* check the whole payload before handing anything over */
+  uint8_t count = 0;
+  uint8_t offset = 1;
+  while (offset < AGGREGATE_PAYLOAD_BYTES && payload[offset]) {
+    uint8_t size = AggregateLength::get(payload + offset);
+    if (offset + 1 + size > AGGREGATE_PAYLOAD_BYTES) return 0;
+    offset += 1 + size;
+    ++count;
+  }
+
+  offset = 1;
+  for (uint8_t i = 0; i < count; ++i) {
+    uint8_t size = AggregateLength::get(payload + offset);
+    deliver(ctx, AggregateFlow::get(payload + offset), payload + offset + AggregateHeader::BYTES, size);
+    offset += AggregateHeader::BYTES + size;
+  }
+  return count;
+}
+
+
+Aggregator::Aggregator(Radio & radio) : radio(radio) {}
+
+
+void
+Aggregator::begin()
+{
+  memset(payload, 0, sizeof(payload));
+  payload[0] = AGGREGATE_CHAR;
+  fill = 1;
+  queued = 0;
+  payloads = 0;
+  messages = 0;
+  lost = 0;
+
+  for (uint8_t flow = 0; flow < AGGREGATE_FLOWS; ++flow) deadlines[flow] = AGGREGATE_DEADLINE_US;
+}
+
+
+void
+Aggregator::setDeadline(uint8_t flow, uint32_t deadline_us)
+{
+  if (flow < AGGREGATE_FLOWS) deadlines[flow] = deadline_us;
+}
+
+
+bool
+Aggregator::add(uint8_t flow, const char * message, uint8_t size)
+{
+  if (flow >= AGGREGATE_FLOWS || !size || size > AGGREGATE_MAX_MESSAGE) return false;
+
+  if (fill + 1 + size > AGGREGATE_PAYLOAD_BYTES) flush();
+
+  /* the payload leaves by the earliest deadline of the messages in it */
+  uint32_t message_due = micros() + deadlines[flow];
+  if (!queued || (int32_t) (message_due - due) < 0) due = message_due;
+
+  AggregateLength::put(payload + fill, size);
+  AggregateFlow::put(payload + fill, flow);
+  memcpy(payload + fill + AggregateHeader::BYTES, message, size);
+  fill += AggregateHeader::BYTES + size;
+  ++queued;
+
+  /* no room left for even a byte */
+  if (fill + 2 > AGGREGATE_PAYLOAD_BYTES) flush();
+  else poll();
+  return true;
+}
+
+
+void
+Aggregator::poll()
+{
+  if (queued && (int32_t) (micros() - due) >= 0) flush();
+}
+
+
+void
+Aggregator::flush()
+{
+  if (!queued) return;
+
+  if (!radio.write(payload, AGGREGATE_PAYLOAD_BYTES)) lost += queued;
+  ++payloads;
+  messages += queued;
+
+  memset(payload + 1, 0, sizeof(payload) - 1);
+  fill = 1;
+  queued = 0;
+}
+
+
+/* -----Getters----- */
+
+uint32_t
+Aggregator::getPayloads()
+{
+  return payloads;
+}
+
+uint32_t
+Aggregator::getMessages()
+{
+  return messages;
+}
+
+uint32_t
+Aggregator::getLost()
+{
+  return lost;
+}
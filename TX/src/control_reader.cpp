@@ -0,0 +1,85 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "control_reader.h"
+
+ControlReader::ControlReader(control_read_f read, void * ctx) : source(read), ctx(ctx)
+{
+}
+
+
+bool
+ControlReader::available(void)
+{
+  while (!count && pending == CONTROL_NONE && pull()) {}
+  return count > 0;
+}
+
+
+int
+ControlReader::read(void)
+{
+  if (!available()) return -1;
+
+  uint8_t curr_byte = held[head];
+  head = (head + 1) % CONTROL_HOLD_BYTES;
+  --count;
+  return curr_byte;
+}
+
+
+bool
+ControlReader::seekCommand(void)
+{
+  while (pending == CONTROL_NONE && count < CONTROL_HOLD_BYTES && pull()) {}
+  return pending != CONTROL_NONE;
+}
+
+
+char
+ControlReader::command(void)
+{
+  return pending;
+}
+
+
+char
+ControlReader::takeCommand(void)
+{
+  char taken = pending;
+  pending = CONTROL_NONE;
+  return taken;
+}
+
+
+void
+ControlReader::clear(void)
+{
+  head = count = 0;
+  escaped = false;
+}
+
+
+bool
+ControlReader::pull(void)
+{
+  int curr_byte = source(ctx);
+  if (curr_byte < 0) return false;
+
+  if (escaped) {
+    escaped = false;
+    curr_byte ^= CONTROL_ESCAPE_XOR;
+  } else if (curr_byte == TX_CHAR) {
+    at_chars = true;
+    return true;
+  } else if (at_chars) {
+    at_chars = false;
+    pending = (char) curr_byte;
+    return true;
+  } else if (curr_byte == CONTROL_ESCAPE) {
+    escaped = true;
+    return true;
+  }
+
+  held[(head + count++) % CONTROL_HOLD_BYTES] = (uint8_t) curr_byte;
+  return true;
+}
@@ -0,0 +1,111 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "latency_stamp.h"
+
+/* -----LatencyClock----- */
+
+LatencyClock::LatencyClock(Radio & radio) : radio(radio) {}
+
+
+bool
+LatencyClock::sync(uint8_t * address, uint8_t * receiver)
+{
+  char payload[LATENCY_PAYLOAD_BYTES] {};
+  char answer[LATENCY_PAYLOAD_BYTES];
+  bool synced {false};
+  uint32_t best {UINT32_MAX};
+
+  payload[0] = LATENCY_SYNC_CHAR;
+  memcpy(payload + LATENCY_REPLY_OFFSET, address, LATENCY_ADDRESS_BYTES);
+  radio.openReadingPipe(LATENCY_READING_PIPE, address);
+
+  for (uint8_t round = 0; round < LATENCY_SYNC_ROUNDS; ++round) {
+    radio.stopListening();
+    radio.openWritingPipe(receiver);
+
+    LatencyRound::put(payload, round);
+    uint32_t sent = micros();
+    LatencySent::put(payload, sent);
+    if (!radio.write(payload, LATENCY_PAYLOAD_BYTES)) continue;
+    radio.startListening();
+
+    while (micros() - sent < LATENCY_SYNC_TIMEOUT_US) {
+      if (!radio.available()) continue;
+
+      uint32_t back = micros();
+      radio.read(answer, LATENCY_PAYLOAD_BYTES);
+
+      /* a late answer of an earlier round does not count */
+      if (answer[0] != LATENCY_SYNC_CHAR || LatencyRound::get(answer) != round ||
+          LatencySent::get(answer) != sent) continue;
+
+      uint32_t got = LatencyGot::get(answer);
+      uint32_t answered = LatencyAnswered::get(answer);
+
+      /* the time on the air both ways, the receiver's own time taken out */
+      uint32_t trip = (back - sent) - (answered - got);
+      if (trip < best) {
+        best = trip;
+        offset = ((int32_t) (got - sent) + (int32_t) (answered - back)) / 2;
+        round_trip = trip;
+        synced = true;
+      }
+      break;
+    }
+  }
+
+  radio.stopListening();
+  radio.openWritingPipe(receiver);
+  return synced;
+}
+
+
+void
+LatencyClock::stamp(char * payload)
+{
+  LatencyStamp::put(payload, micros() + offset);
+}
+
+
+int32_t
+LatencyClock::getOffset(void)
+{
+  return offset;
+}
+
+
+uint32_t
+LatencyClock::getRoundTrip(void)
+{
+  return round_trip;
+}
+
+
+/* -----Receiver----- */
+
+void
+answerLatencySync(Radio & radio, const char * payload, uint32_t got, uint8_t * address)
+{
+  char answer[LATENCY_PAYLOAD_BYTES] {};
+  answer[0] = LATENCY_SYNC_CHAR;
+  LatencyRound::put(answer, LatencyRound::get(payload));
+  LatencySent::put(answer, LatencySent::get(payload));
+  LatencyGot::put(answer, got);
+
+  radio.stopListening();
+  radio.openWritingPipe((uint8_t *) payload + LATENCY_REPLY_OFFSET);
+  LatencyAnswered::put(answer, micros());
+  radio.write(answer, LATENCY_PAYLOAD_BYTES);
+
+  /* writing took over pipe 0 for the ACK */
+  radio.openReadingPipe(0, address);
+  radio.startListening();
+}
+
+
+int32_t
+latencyOf(const char * payload, uint32_t got)
+{
+  return (int32_t) (got - LatencyStamp::get(payload));
+}
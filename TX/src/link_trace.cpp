@@ -0,0 +1,71 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "link_trace.h"
+#include "serial_io.h"
+
+LinkTrace::LinkTrace() {}
+
+
+void
+LinkTrace::record(uint16_t seq, uint8_t channel, uint8_t outcome)
+{
+  trace_record_t & r = records[head];
+  r.time_us = micros();
+  r.seq = seq;
+  r.channel = channel;
+  r.outcome = outcome;
+
+  head = (head + 1) % TRACE_RECORDS;
+
+  if (size < TRACE_RECORDS) {
+    size++;
+  } else {
+    overwritten++;
+  }
+}
+
+
+uint32_t
+LinkTrace::getSize(void)
+{
+  return size;
+}
+
+
+uint32_t
+LinkTrace::getOverwritten(void)
+{
+  return overwritten;
+}
+
+
+void
+LinkTrace::clear(void)
+{
+  head = 0;
+  size = 0;
+  overwritten = 0;
+}
+
+
+void
+LinkTrace::dump(void)
+{
+  /* the oldest record sits `size' slots behind the head */
+  uint32_t i = (head + TRACE_RECORDS - size) % TRACE_RECORDS;
+
+  for (uint32_t n = 0; n < size; ++n) {
+    const trace_record_t & r = records[i];
+    Serial.print(r.time_us);
+    Serial.print(',');
+    Serial.print(r.seq);
+    Serial.print(',');
+    Serial.print(r.channel);
+    Serial.print(',');
+    Serial.println(r.outcome);
+
+    i = (i + 1) % TRACE_RECORDS;
+  }
+
+  Serial.print(HANDSHAKE_CHAR);
+}
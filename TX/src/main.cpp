@@ -1,41 +1,762 @@
 #include <Arduino.h>
 #include <SPI.h>
 #include <stdint.h>
-#include <RF24.h>
 #include "serial_io.h"
+#include "link_trace.h"
+#include "link_profile.h"
+#include "radio.h"
+#include "rf24_radio.h"
+#include "nrf24_radio.h"
+#include "radio_bench.h"
+#include "micro_bench.h"
+#include "rate_shaper.h"
+#include "payload_packer.h"
+#include "pull_server.h"
+#include "harq.h"
+#include "latency_stamp.h"
+#include "session.h"
+#include "rendezvous.h"
+#include "diversity.h"
+#include "aggregator.h"
+#include "route.h"
 
 #define CE 26
 #define CSN 25
 #define DEBUG 0
+#define LINK_TRACE 0  // record per-packet outcomes and dump them after every file
+#define RADIO_BACKEND RADIO_RF24  // or RADIO_NRF24 for our own driver
+#define RADIO_BENCHMARK 0  // compare the backends instead of sending files, see scripts/radio_bench.py
+#define MICRO_BENCHMARK 0  // time the firmware's kernels instead of sending files, see scripts/micro_bench.py
+#define SERIAL_MUX 0  // virtual channels instead of lockstep serial, see SerialIO::startMux()
+#define PULL_MODE 0  // serve a file to a receiver pulling it from several boards, see pull_protocol.h
+#define HARQ_MODE PROFILE_HARQ  // send files by hybrid ARQ instead of ACKs, see harq.h
+#define LATENCY_STAMP 0  // stamp payloads for the receiver's latency histogram, see latency_stamp.h
+#define CONTINUOUS_TX 0  // keep CE high and the TX FIFO fed through a file, see Radio::writeFast()
+#define SESSION_NEGOTIATE 0  // agree on rate and features with the receiver before every file, see session.h
+#define RENDEZVOUS 0  // invite an idle receiver onto the configured link before every file, see rendezvous.h
+#define DIVERSITY 0  // number payloads and send them blind to both radios of a DIVERSITY receiver, see diversity.h
+#define AGGREGATE 0  // pack the computer's small messages of several flows into payloads instead of sending files, see aggregator.h
+#define RELAY_MODE 0  // relay a mesh's payloads toward its sink, and the computer's own, instead of sending files, see route.h
+
+/* the modes that run loop() on their own, then what each of them leaves out */
+#if RADIO_BENCHMARK + MICRO_BENCHMARK + SERIAL_MUX + PULL_MODE + AGGREGATE + RELAY_MODE > 1
+#error "RADIO_BENCHMARK, MICRO_BENCHMARK, SERIAL_MUX, PULL_MODE, AGGREGATE and RELAY_MODE each take over loop(), pick one"
+#endif
+
+#if (RADIO_BENCHMARK || MICRO_BENCHMARK) && (HARQ_MODE || LATENCY_STAMP || CONTINUOUS_TX || SESSION_NEGOTIATE || RENDEZVOUS || DIVERSITY || LINK_TRACE)
+#error "the benchmarks send no files, turn the transfer features off"
+#endif
+
+#if (PULL_MODE || AGGREGATE || RELAY_MODE) && (HARQ_MODE || LATENCY_STAMP || CONTINUOUS_TX || SESSION_NEGOTIATE || RENDEZVOUS || DIVERSITY || LINK_TRACE)
+#error "PULL_MODE, AGGREGATE and RELAY_MODE send no files through sendPayload(), turn the transfer features off"
+#endif
+
+#if SERIAL_MUX && (HARQ_MODE || SESSION_NEGOTIATE || RENDEZVOUS || DIVERSITY || LINK_TRACE)
+#error "SERIAL_MUX streams its files without the hybrid ARQ, a session, a rendezvous, DIVERSITY or a trace dump"
+#endif
+
+#if HARQ_MODE && !SESSION_NEGOTIATE && (LATENCY_STAMP || CONTINUOUS_TX || DIVERSITY || LINK_TRACE)
+#error "every file goes by hybrid ARQ, which sends its own payloads: negotiate the session or turn HARQ_MODE off"
+#endif
+
+#if LATENCY_STAMP && DIVERSITY
+#error "the latency stamp and the sequence number of DIVERSITY both take the end of a payload"
+#endif
+
+#if DIVERSITY && CONTINUOUS_TX
+#error "DIVERSITY sends every payload blind on two channels, there is no FIFO to keep fed"
+#endif
+
+#if HARQ_MODE && (PROFILE_HARQ_WINDOW < 1 || PROFILE_HARQ_WINDOW > HARQ_GROUP_BLOCKS)
+#error "PROFILE_HARQ_WINDOW is 1 to HARQ_GROUP_BLOCKS blocks"
+#endif
+
+#if LATENCY_STAMP
+#define PAYLOAD_FILE_BYTES LATENCY_FILE_BYTES
+#elif DIVERSITY
+#define PAYLOAD_FILE_BYTES DIVERSITY_FILE_BYTES
+#else
+#define PAYLOAD_FILE_BYTES FIFO_SIZE_BYTES
+#endif
 
 // /* create an instance of the radio */
-RF24 radio(CE, CSN);
+#if RADIO_BACKEND == RADIO_NRF24
+NRF24Radio backend(CE, CSN);
+#else
+RF24Radio backend(CE, CSN);
+#endif
+Radio & radio = backend;
 SerialIO io;
+RateShaper shaper;
+/* the file's payloads are charged to SHAPER_FLOW_FILE, or the SERIAL_MUX stream's flow */
+uint8_t file_flow {SHAPER_FLOW_FILE};
+/* the exchanges before a file and aggregated payloads, charged as they are written */
+ShapedRadio control_radio(radio, shaper, SHAPER_FLOW_CONTROL);
+ShapedRadio message_radio(radio, shaper, SHAPER_FLOW_MESSAGES);
+PayloadPacker packer(PAYLOAD_FILE_BYTES);
+#if SERIAL_MUX
+mux_telemetry_t telemetry {};
+#endif
+#if PULL_MODE
+PullServer server(radio);
+/* the blocks last fetched from the computer, PULL_FETCH_BLOCKS from fetched_first */
+char fetched[PULL_FETCH_BLOCKS * PULL_BLOCK_BYTES];
+uint32_t fetched_first {PULL_INFO_BLOCK};
+#endif
+#if HARQ_MODE
+HarqSender harq(radio);
+/* the group of blocks being filled from serial, PROFILE_HARQ_WINDOW of them */
+char group[PROFILE_HARQ_WINDOW * HARQ_BLOCK_BYTES];
+uint16_t group_fill {0};
+#endif
+#if LINK_TRACE
+LinkTrace trace;
+uint16_t seq {0};
+#endif
+#if LATENCY_STAMP
+LatencyClock latency(control_radio);
+#endif
+#if DIVERSITY
+DiversitySender diversity(radio);
+#endif
+#if AGGREGATE
+Aggregator aggregator(message_radio);
+#endif
+#if RELAY_MODE
+Router router(message_radio);
+#endif
+/* what the receiver and we agreed on for the current file */
+session_caps_t session {};
+
+
+/*
+ * Whether the file goes by hybrid ARQ, which a negotiated session only
+ * does when the receiver does it too
+ */
+bool useHarq() {
+  return SESSION_NEGOTIATE ? (session.features & SESSION_HARQ) : HARQ_MODE;
+}
+
+
+#if HARQ_MODE
+/*
+ * Waits for the link's airtime cap before every payload of the transfer
+ */
+void paceHarq(void * ctx) {
+  (void) ctx;
+  while (shaper.waitUs(SHAPER_FLOW_FILE, FIFO_SIZE_BYTES) && !io.checkControl()) {}
+  shaper.consume(SHAPER_FLOW_FILE, FIFO_SIZE_BYTES);
+}
+
+
+/*
+ * Sends the group filled so far, zero padded to whole blocks, until it gets
+ * across or the computer stops the transfer
+ */
+void sendGroup() {
+  uint8_t count = (group_fill + HARQ_BLOCK_BYTES - 1) / HARQ_BLOCK_BYTES;
+  memset(group + group_fill, 0, count * HARQ_BLOCK_BYTES - group_fill);
+
+  while (!harq.sendGroup(group, count)) {
+    if (io.checkControl()) break;
+  }
+  group_fill = 0;
+}
+
+
+/*
+ * Starts a file: the reports come back to the configured address turned
+ * around, and the extension goes first, in a zero padded block of its own
+ */
+void startHarq() {
+  uint8_t reply[ADDRESS_BYTES];
+  io.getReplyAddress(reply);
+  harq.begin(reply, io.getAddressBytes(), PROFILE_HARQ_SCHEME, PROFILE_HARQ_PARITY, paceHarq, nullptr);
+
+  memset(group, 0, HARQ_BLOCK_BYTES);
+  memcpy(group, io.getExtension(), EXTENSION_BYTES);
+  group_fill = HARQ_BLOCK_BYTES;
+}
+
+
+/*
+ * Ends the file after its last group, the only one that may be short
+ */
+void finishHarq() {
+  uint8_t last_size = HARQ_BLOCK_BYTES;
+  if (group_fill) {
+    if (group_fill % HARQ_BLOCK_BYTES) last_size = group_fill % HARQ_BLOCK_BYTES;
+    sendGroup();
+  }
+  harq.end(last_size);
+}
+#endif
+
+
+/*
+ * Sends one FIFO worth of data once the link's airtime cap allows it and,
+ * when tracing, records how it went
+ */
+void sendPayload(const void * buf) {
+  /* wait for tokens, but not through a control command */
+  while (shaper.waitUs(file_flow, FIFO_SIZE_BYTES) && !io.checkControl()) {}
+  if (io.checkControl()) return;
+
+#if LATENCY_STAMP
+  /* the time it goes on the air, in the receiver's clock, goes with it */
+  char stamped[FIFO_SIZE_BYTES];
+  memcpy(stamped, buf, FIFO_SIZE_BYTES);
+  latency.stamp(stamped);
+  buf = stamped;
+#endif
+
+#if DIVERSITY
+  /* nothing comes back, the receiver keeps whichever copy it hears first */
+  diversity.send((const char *) buf);
+  bool acked = true;
+#elif CONTINUOUS_TX
+  /* queued behind the payloads still in the FIFO, whose drops it reports */
+  bool acked = radio.writeFast(buf, FIFO_SIZE_BYTES);
+#else
+  bool acked = radio.write(buf, FIFO_SIZE_BYTES);
+#endif
+  shaper.consume(file_flow, FIFO_SIZE_BYTES);
+
+#if SERIAL_MUX
+  ++telemetry.payloads;
+  telemetry.lost += !acked;
+  telemetry.retries += radio.getARC();
+#endif
+
+#if LINK_TRACE
+  uint8_t outcome = (radio.getARC() & TRACE_ARC_MASK) | (acked ? TRACE_TX_DS : TRACE_MAX_RT);
+  trace.record(seq++, io.getChannel(), outcome);
+#else
+  (void) acked;
+#endif
+}
+
+
+/*
+ * Sends a payload the packer has ready, until the transfer is stopped
+ */
+bool sendPacked(void * ctx, const char * payload) {
+  (void) ctx;
+  sendPayload(payload);
+  return !io.transferStopped();
+}
+
+
+/*
+ * Sends file bytes as they come in from serial, in full payloads only.  What
+ * does not fill a payload waits in the packer for the next chunk.
+ */
+void sendFileData(const char * data, uint32_t size) {
+#if HARQ_MODE
+  /* by the group instead, each goes once it is full */
+  while (useHarq() && size && !io.transferStopped()) {
+    uint32_t room = sizeof(group) - group_fill;
+    uint32_t taken = (size < room) ? size : room;
+    memcpy(group + group_fill, data, taken);
+    group_fill += taken;
+    data += taken;
+    size -= taken;
+
+    if (group_fill == sizeof(group)) sendGroup();
+  }
+  if (useHarq()) return;
+#endif
+
+  if (!io.transferStopped()) packer.pack(data, size, sendPacked, NULL);
+}
+
+
+/*
+ * Signifies to the other Arduino that the file is over, and how many of
+ * the last payload's bytes belong to it
+ */
+void sendEnd(uint8_t last_size) {
+  io.END_TX_CHUNK[END_LENGTH_OFFSET] = last_size;
+#if DIVERSITY
+  /* blind as well, and the receiver waits for good without it */
+  shaper.pace(file_flow, FIFO_SIZE_BYTES);
+  diversity.send(io.END_TX_CHUNK, DIVERSITY_END_COPIES);
+#else
+  sendPayload(io.END_TX_CHUNK);
+#endif
+}
+
+
+/*
+ * Sends the true final payload, the only one that may be short, and
+ * signifies that we are done to the other Arduino
+ */
+void finishFile() {
+#if HARQ_MODE
+  if (useHarq()) {
+    finishHarq();
+    return;
+  }
+#endif
+
+  uint8_t last_size = PAYLOAD_FILE_BYTES;
+  if (packer.getSize()) {
+    last_size = packer.getSize();
+    sendPayload(packer.getPayload());
+    packer.clear();
+  }
+  sendEnd(last_size);
+
+#if CONTINUOUS_TX
+  /* back to standby-I once the last of the file is out */
+  radio.txStandBy();
+#endif
+}
+
+
+/*
+ * Ends the current file early: the receiving side finishes its partial
+ * file, all of it full payloads
+ */
+void abandonFile() {
+#if HARQ_MODE
+  /* whatever the receiver has of the group goes out as it is */
+  if (useHarq()) {
+    harq.end(HARQ_BLOCK_BYTES);
+    group_fill = 0;
+    return;
+  }
+#endif
+
+  io.END_TX_CHUNK[END_LENGTH_OFFSET] = PAYLOAD_FILE_BYTES;
+  const char * end = io.END_TX_CHUNK;
+#if LATENCY_STAMP
+  /* on a copy, as sendPayload() does, END_TX_CHUNK goes out with every file */
+  char stamped[FIFO_SIZE_BYTES];
+  memcpy(stamped, end, FIFO_SIZE_BYTES);
+  latency.stamp(stamped);
+  end = stamped;
+#endif
+
+  /* the transfer is stopped, so this waits out the file's cap without looking at control */
+  shaper.pace(file_flow, FIFO_SIZE_BYTES);
+#if DIVERSITY
+  diversity.send(end, DIVERSITY_END_COPIES);
+#else
+  radio.write(end, FIFO_SIZE_BYTES);
+#endif
+  packer.clear();
+}
+
+
+/*
+ * Gives up on the current file after the computer aborted or preempted it
+ */
+void stopTransfer() {
+  abandonFile();
+
+#if LINK_TRACE
+  trace.clear();
+  seq = 0;
+#endif
+
+  io.softReset();
+}
+
+
+/*
+ * Brings the radio up as a transmitter with the configured channel and
+ * address and the link profile
+ */
+void configureRadio(Radio & r) {
+  r.begin();
+  r.setAddressWidth(ADDRESS_BYTES);
+  r.setChannel(io.getChannel());
+  r.openWritingPipe(io.getAddressBytes());
+  r.setPALevel(PROFILE_PA_LEVEL);
+  r.setDataRate(PROFILE_DATA_RATE);
+  r.setRetries(PROFILE_RETRY_DELAY, PROFILE_RETRY_COUNT);
+  r.stopListening();
+}
+
+
+#if LATENCY_STAMP
+/*
+ * Aligns with the receiver's clock before a file.  The receiver answers
+ * to the configured address turned around, as with HARQ_MODE.
+ */
+void syncLatency() {
+  uint8_t reply[ADDRESS_BYTES];
+  io.getReplyAddress(reply);
+  latency.sync(reply, io.getAddressBytes());
+}
+#endif
+
+
+#if RENDEZVOUS
+/*
+ * Invites an idle receiver onto the configured link until one joins or the
+ * computer gives up on the file.  The join comes back to the configured
+ * address turned around.
+ *
+ * Outputs:
+ *  false if the computer gave up
+ */
+bool invite() {
+  uint8_t reply[ADDRESS_BYTES];
+  io.getReplyAddress(reply);
+
+  while (!inviteReceiver(control_radio, io.getChannel(), io.getAddressBytes(), reply)) {
+    if (io.checkControl()) return false;
+  }
+  return true;
+}
+#endif
+
+
+#if SESSION_NEGOTIATE
+/*
+ * Agrees with the receiver on the rate and features of the next file and
+ * tells the computer, which only compresses the file if the receiving one
+ * takes it.  The receiver answers to the configured address turned around.
+ *
+ * Outputs:
+ *  false if there is no agreement, sent as version 0
+ */
+bool negotiate() {
+  session_caps_t ours {SESSION_VERSION, PROFILE_DATA_RATE, SESSION_LZMA, PROFILE_HARQ_WINDOW, PAYLOAD_FILE_BYTES};
+  if (HARQ_MODE) ours.features |= SESSION_HARQ;
+
+  uint8_t reply[ADDRESS_BYTES];
+  io.getReplyAddress(reply);
+  session = openSession(control_radio, reply, io.getAddressBytes(), ours);
+
+  Serial.write((const uint8_t *) &session, SESSION_CAPS_BYTES);
+  return session.version != 0;
+}
+#endif
+
+
+#if SERIAL_MUX
+/*
+ * Runs a session over the virtual channels: the files of the data streams
+ * go out one after the other, each in its order of arrival, while control
+ * and telemetry keep flowing.  Returns once the computer ends the session.
+ */
+void runMux() {
+  int8_t active {-1};  // stream on the air
+  char data[FIFO_SIZE_BYTES];
+
+  io.setTelemetry(&telemetry);
+  io.startMux();
+
+  while (!io.transferStopped()) {
+    io.pollMux();
+
+    /* the next stream with a file takes the air, its extension first */
+    if (active < 0) {
+      for (uint8_t i = 0; i < MUX_DATA_STREAMS && active < 0; ++i) {
+        mux_stream_state_e state = io.getStreamState(i);
+        if (state == MUX_STREAM_ABORTED) {
+          io.finishStream(i);
+        } else if (state != MUX_STREAM_IDLE && !io.streamPaused(i)) {
+          active = i;
+          file_flow = i ? SHAPER_FLOW_STREAM : SHAPER_FLOW_FILE;
+#if LATENCY_STAMP
+          syncLatency();
+#endif
+          packer.fill(io.getStreamExtension(i), EXTENSION_BYTES);
+          sendPayload(packer.getPayload());
+          packer.clear();
+        }
+      }
+      continue;
+    }
+
+    /* the state before reading, so a closing stream is empty once nothing is read */
+    mux_stream_state_e state = io.getStreamState(active);
+    if (state == MUX_STREAM_ABORTED) {
+      abandonFile();
+      io.finishStream(active);
+      active = -1;
+      continue;
+    }
+    if (io.streamPaused(active)) continue;
+
+    uint16_t size = io.readStream(active, data, FIFO_SIZE_BYTES);
+    if (size) {
+      sendFileData(data, size);
+    } else if (state == MUX_STREAM_CLOSING) {
+      finishFile();
+      io.finishStream(active);
+      active = -1;
+    }
+  }
+
+  /* the session ended in the middle of a file */
+  if (active >= 0) abandonFile();
+  file_flow = SHAPER_FLOW_FILE;
+}
+#endif
+
+
+#if PULL_MODE
+/*
+ * Reads a block for the server, fetching PULL_FETCH_BLOCKS of them at once
+ * from the computer: PULL_FETCH_CHAR and the first block's index go up,
+ * the blocks (zero padded past the end of the file) come back
+ */
+bool readBlock(void * ctx, uint32_t block, char * data) {
+  (void) ctx;
+  uint32_t first = block - block % PULL_FETCH_BLOCKS;
+
+  if (first != fetched_first) {
+    uint32_serial_u index;
+    index.num = first;
+    fetched_first = PULL_INFO_BLOCK;
+
+    Serial.print(PULL_FETCH_CHAR);
+    Serial.write(index.bytes, sizeof(index.bytes));
+    io.setFromSerial(fetched, sizeof(fetched));
+    if (io.transferStopped()) return false;
+    fetched_first = first;
+  }
+
+  memcpy(data, fetched + (block - first) * PULL_BLOCK_BYTES, PULL_BLOCK_BYTES);
+  return true;
+}
+
+
+/*
+ * Serves the file the computer describes (extension, then its size) to
+ * pulls until the computer ends the session.  The radio listens on the
+ * configured address, on the channel of the receiver.
+ */
+void servePull() {
+  uint32_serial_u size;
+
+  io.handshake();
+  io.setExtension();
+  io.setFromSerial(size.bytes, sizeof(size.bytes));
+  if (io.transferStopped()) return;
+
+  fetched_first = PULL_INFO_BLOCK;
+  server.begin(io.getAddressBytes(), size.num, io.getExtension(), readBlock, nullptr);
+
+  while (!io.checkControl()) {
+    if (!server.poll()) continue;
+
+    /* wait for tokens, but not through a control command */
+    while (shaper.waitUs(SHAPER_FLOW_FILE, FIFO_SIZE_BYTES) && !io.checkControl()) {}
+    if (io.transferStopped()) break;
+
+    server.sendNext();
+    shaper.consume(SHAPER_FLOW_FILE, FIFO_SIZE_BYTES);
+  }
+}
+#endif
+
+
+#if AGGREGATE
+/*
+ * Sends the computer's messages to the receiver until the computer ends the
+ * session.  It sends the deadline of every flow first, 4 bytes each, then
+ * every message as its flow, its length and its bytes; messages wait in the
+ * aggregator for others to share a payload until their flow's deadline.
+ */
+void sendMessages() {
+  io.handshake();
+  aggregator.begin();
+  for (uint8_t flow = 0; flow < AGGREGATE_FLOWS; ++flow) {
+    uint32_serial_u deadline;
+    io.setFromSerial(deadline.bytes, sizeof(deadline.bytes));
+    aggregator.setDeadline(flow, deadline.num);
+  }
+
+  char message[AGGREGATE_MAX_MESSAGE];
+  while (!io.checkControl()) {
+    aggregator.poll();
+    if (!io.available()) continue;
+
+    uint8_t header[2];
+    io.setFromSerial(header, sizeof(header));
+
+    /* the computer never sends longer messages, drop what is past it */
+    uint8_t size = (header[1] < AGGREGATE_MAX_MESSAGE) ? header[1] : AGGREGATE_MAX_MESSAGE;
+    io.setFromSerial(message, size);
+    for (uint8_t i = size; i < header[1]; ++i) {
+      char skip;
+      io.setFromSerial(&skip, 1);
+    }
+    if (io.transferStopped()) break;
+
+    aggregator.add(header[0], message, size);
+  }
+  aggregator.flush();
+}
+#endif
+
+
+#if RELAY_MODE
+/*
+ * Relays the mesh's payloads toward its sink until the computer ends the
+ * session, sending the computer's own on the way, ROUTE_DATA_BYTES each; a
+ * board that only relays gets none.  The configured address is the mesh's,
+ * its lowest byte our id.
+ */
+void relay() {
+  char data[ROUTE_DATA_BYTES];
+  uint8_t * mesh = io.getAddressBytes();
+
+  io.handshake();
+  router.begin(mesh[0], mesh, false, PROFILE_DATA_RATE, nullptr, nullptr);
+
+  while (!io.checkControl()) {
+    router.step();
+    if (!io.available()) continue;
+
+    io.setFromSerial(data, sizeof(data));
+    if (io.transferStopped()) break;
+    router.send(data);
+  }
+}
+#endif
+
+
+#if RADIO_BENCHMARK
+/*
+ * Sends the same transfer through every backend and reports how each did
+ */
+void benchmarkBackends() {
+  RF24Radio rf24(CE, CSN);
+  NRF24Radio nrf24(CE, CSN);
+  Radio * radios[] {&rf24, &nrf24};
+
+  io.handshake();
+
+  for (Radio * r : radios) {
+    configureRadio(*r);
+    printBenchResult(*r, benchmarkRadio(*r, BENCH_PAYLOADS));
+  }
+
+  /* let the receiving side finish its file, the last payload was full */
+  io.END_TX_CHUNK[END_LENGTH_OFFSET] = FIFO_SIZE_BYTES;
+  radios[1]->write(io.END_TX_CHUNK, FIFO_SIZE_BYTES);
+
+  Serial.print(HANDSHAKE_CHAR);
+}
+#endif
+
+
+#if MICRO_BENCHMARK
+/*
+ * Times the kernels once the computer asks, see micro_bench.h
+ */
+void benchmarkKernels() {
+  io.handshake();
+
+  MicroBench bench(CE, CSN);
+  bench.run(MICRO_CALLS);
+
+  Serial.print(HANDSHAKE_CHAR);
+}
+#endif
 
 
 void setup() {
   SPI.begin();
+#if SERIAL_MUX
+  Serial.setRxBufferSize(MUX_SERIAL_BUFFER);
+#endif
   Serial.begin(BAUD_RATE);
+  io.enableControl();  // without it a transfer always runs to the end
 }
 
 
 void loop() {
+  /* a new session brings its airtime caps right after the configuration */
+  bool new_session = io.getBoardState() == CONFIG;
   io.setConfig();
-  radio.begin();
-  radio.setAddressWidth(ADDRESS_BYTES);
-  radio.setChannel(io.getChannel());
-  radio.openWritingPipe(io.getAddressBytes());
-  radio.setPALevel(RF24_PA_HIGH);
-  radio.setDataRate(RF24_250KBPS);
-  radio.setRetries(15, 15);
-  radio.stopListening();
+  if (new_session) {
+    io.setShaping();
+    shaper.configure(io.getShaping());
+  }
+
+#if RADIO_BENCHMARK
+  benchmarkBackends();
+  return;
+#endif
+
+#if MICRO_BENCHMARK
+  benchmarkKernels();
+  return;
+#endif
+
+  configureRadio(radio);
+
+#if SERIAL_MUX
+  runMux();
+  io.softReset();
+  return;
+#endif
+
+#if PULL_MODE
+  servePull();
+  io.softReset();
+  return;
+#endif
+
+#if AGGREGATE
+  sendMessages();
+  io.softReset();
+  return;
+#endif
+
+#if RELAY_MODE
+  relay();
+  io.softReset();
+  return;
+#endif
+
+#if RENDEZVOUS
+  /* the files of the lockstep transfer only */
+  if (!invite()) {
+    io.softReset();
+    return;
+  }
+#endif
+
+#if SESSION_NEGOTIATE
+  /* the files of the lockstep transfer only */
+  if (!negotiate()) {
+    io.softReset();
+    return;
+  }
+#endif
 
   io.handshake();
   io.setExtension();
+  if (io.transferStopped()) {
+    stopTransfer();
+    return;
+  }
 
-  /* Send extension */
-  radio.write(io.getExtension(), FIFO_SIZE_BYTES);
-  delay(10);
+#if LATENCY_STAMP
+  syncLatency();
+#endif
+
+#if HARQ_MODE
+  if (useHarq()) startHarq();
+#endif
+  if (!useHarq()) {
+#if DIVERSITY
+    diversity.begin(io.getChannel(), diversityChannel(io.getChannel()));
+#endif
+    /* Send extension, in a payload of its own */
+    packer.fill(io.getExtension(), EXTENSION_BYTES);
+    sendPayload(packer.getPayload());
+    packer.clear();
+  }
 
   // radio.write(io.getExtension(), FIFO_SIZE_BYTES);
   // delay(1000);
@@ -49,42 +770,38 @@ void loop() {
 
   /*
   * We keep filling and sending our chunks until we do not have enough bytes to
-  * full our entire chunk array, at which point we break the while loop,
-  * reset our array, and send the reamining bit of our file
+  * full our entire chunk array, at which point we break the while loop and
+  * send the reamining bit of our file.  Payloads run across chunk boundaries,
+  * so every one of them is full until the very last
   */
-  while (io.getFileChunkSize() == MAX_CHUNK_CHARS) {
+  while (io.getFileChunkSize() == MAX_CHUNK_CHARS && !io.transferStopped()) {
     io.setFileChunk();
-
-    // TODO: make this a function
-    char * curr_chunk = io.getFileChunk();
-   
-    int i {0};
-    while (i < MAX_CHUNK_CHARS - FIFO_SIZE_BYTES) {
-      radio.write(curr_chunk + i, FIFO_SIZE_BYTES);
-      delay(10);
-      i += FIFO_SIZE_BYTES;
-    }
+    sendFileData(io.getFileChunk(), io.getFileChunkSize());
 
     io.handshake();  // shake between every transaction
     io.setFileChunkSize();
   }
+  if (io.transferStopped()) {
+    stopTransfer();
+    return;
+  }
   io.emptyFileChunk();
   io.setFileChunk();
-
-
-  char * curr_chunk = io.getFileChunk();
-
-  int i {0};
-  while (i < MAX_CHUNK_CHARS - FIFO_SIZE_BYTES) {
-    radio.write(curr_chunk + i, FIFO_SIZE_BYTES);
-    delay(10);
-    i += FIFO_SIZE_BYTES;
+  sendFileData(io.getFileChunk(), io.getFileChunkSize());
+  if (io.transferStopped()) {
+    stopTransfer();
+    return;
   }
 
-  /* Signify that we are done to the other Arduino */
-  radio.write(io.END_TX_CHUNK, FIFO_SIZE_BYTES);
-  delay(10);
- 
+  finishFile();
+
+#if LINK_TRACE
+  /* hand the outcomes of this file to the computer */
+  io.handshake();
+  trace.dump();
+  trace.clear();
+  seq = 0;
+#endif
 
   io.softReset();
 }
\ No newline at end of file
@@ -0,0 +1,285 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "micro_bench.h"
+#include "aggregator.h"
+
+#if defined(ESP32)
+#define MICRO_BUILD "esp32"
+typedef uint32_t micro_ticks_t;   // CCOUNT, wraps after 2^32 cycles
+#else
+#include <chrono>
+#define MICRO_BUILD "host"
+typedef uint64_t micro_ticks_t;
+#endif
+
+#define MICRO_CRC_POLYNOMIAL 0x1021   // CRC-16-CCITT, the nRF24L01+'s own 2 byte CRC
+#define MICRO_CRC_INIT 0xFFFF
+#define MICRO_MESSAGE_BYTES 6         // of the aggregate split, telemetry sized
+#define MICRO_DIGITS 20               // of a uint64_t
+
+
+static inline micro_ticks_t
+microTicks()
+{
+#if defined(ESP32)
+  return ESP.getCycleCount();
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+
+static uint32_t
+microTickHz()
+{
+#if defined(ESP32)
+  return ESP.getCpuFreqMHz() * 1000000UL;
+#else
+  return 1000000000UL;
+#endif
+}
+
+
+static void
+countMessage(void * ctx, uint8_t flow, const char * message, uint8_t size)
+{
+  *(uint32_t *) ctx += flow + size + (uint8_t) message[0];
+}
+
+
+MicroBench::MicroBench(uint8_t ce, uint8_t csn) : driver(ce, csn)
+{
+  driver.begin();
+  /* CE low, so what is uploaded stays in the TX FIFO */
+  driver.setToTransmitter();
+
+  memset(payload, MICRO_FILL_CHAR, sizeof(payload));
+  for (uint32_t i = 0; i < sizeof(blocks); ++i) blocks[i] = (uint8_t) (i * 7 + 1);
+}
+
+
+void
+MicroBench::run(uint32_t calls)
+{
+  print(serialRead());
+  print(spiUpload(calls));
+  print(spiStatus(calls));
+  print(registerRead(calls));
+  print(registerWrite(calls));
+  print(crc16(calls));
+  print(erasureEncode(calls));
+  print(erasureDecode(calls));
+  print(headerPack(calls));
+  print(aggregateSplit(calls));
+}
+
+
+/* -----Kernels----- */
+
+micro_result_t
+MicroBench::spiUpload(uint32_t calls)
+{
+  /* a FLUSH_TX every time the FIFO is full is part of the cost */
+  micro_ticks_t start = microTicks();
+  for (uint32_t i = 0; i < calls; ++i) {
+    driver.uploadPayload(payload, MICRO_PAYLOAD_BYTES);
+    if ((i + 1) % MICRO_TX_FIFO_SLOTS == 0) driver.flushTXPayload();
+  }
+  micro_ticks_t ticks = microTicks() - start;
+
+  driver.flushTXPayload();
+  return micro_result_t {"spi_upload", MICRO_PAYLOAD_BYTES, calls, ticks};
+}
+
+
+micro_result_t
+MicroBench::spiStatus(uint32_t calls)
+{
+  uint32_t folded {0};
+  micro_ticks_t start = microTicks();
+  for (uint32_t i = 0; i < calls; ++i) {
+    folded += driver.status();
+  }
+  micro_ticks_t ticks = microTicks() - start;
+
+  sink = sink + folded;
+  return micro_result_t {"spi_status", 1, calls, ticks};
+}
+
+
+micro_result_t
+MicroBench::registerRead(uint32_t calls)
+{
+  uint32_t folded {0};
+  micro_ticks_t start = microTicks();
+  for (uint32_t i = 0; i < calls; ++i) {
+    folded += driver.getRegister(nRF24Module::RF_CH);
+  }
+  micro_ticks_t ticks = microTicks() - start;
+
+  sink = sink + folded;
+  return micro_result_t {"register_read", 2, calls, ticks};
+}
+
+
+micro_result_t
+MicroBench::registerWrite(uint32_t calls)
+{
+  uint8_t channel = driver.getRegister(nRF24Module::RF_CH);
+
+  micro_ticks_t start = microTicks();
+  for (uint32_t i = 0; i < calls; ++i) {
+    driver.setRegister(nRF24Module::RF_CH, channel);
+  }
+  micro_ticks_t ticks = microTicks() - start;
+
+  return micro_result_t {"register_write", 2, calls, ticks};
+}
+
+
+micro_result_t
+MicroBench::serialRead(void)
+{
+  /* only what is already in the buffer, not the wire */
+  while (Serial.available() < MICRO_SERIAL_BYTES) {}
+
+  uint32_t folded {0};
+  micro_ticks_t start = microTicks();
+  for (uint32_t i = 0; i < MICRO_SERIAL_BYTES; ++i) {
+    folded += Serial.read();
+  }
+  micro_ticks_t ticks = microTicks() - start;
+
+  sink = sink + folded;
+  return micro_result_t {"serial_read", MICRO_SERIAL_BYTES, 1, ticks};
+}
+
+
+micro_result_t
+MicroBench::crc16(uint32_t calls)
+{
+  uint32_t folded {0};
+  micro_ticks_t start = microTicks();
+  for (uint32_t i = 0; i < calls; ++i) {
+    uint16_t crc {MICRO_CRC_INIT};
+    for (uint8_t j = 0; j < MICRO_PAYLOAD_BYTES; ++j) {
+      crc ^= (uint16_t) ((uint8_t) payload[j] << 8);
+      for (uint8_t b = 0; b < 8; ++b) {
+        crc = (crc & 0x8000) ? (uint16_t) ((crc << 1) ^ MICRO_CRC_POLYNOMIAL) : (uint16_t) (crc << 1);
+      }
+    }
+    folded += crc;
+  }
+  micro_ticks_t ticks = microTicks() - start;
+
+  sink = sink + folded;
+  return micro_result_t {"crc16", MICRO_PAYLOAD_BYTES, calls, ticks};
+}
+
+
+micro_result_t
+MicroBench::erasureEncode(uint32_t calls)
+{
+  /* a parity block of a full hybrid ARQ group */
+  micro_ticks_t start = microTicks();
+  for (uint32_t i = 0; i < calls; ++i) {
+    code.encode(blocks, HARQ_GROUP_BLOCKS, i % ERASURE_MAX_PARITY, HARQ_BLOCK_BYTES, symbols[HARQ_GROUP_BLOCKS]);
+  }
+  micro_ticks_t ticks = microTicks() - start;
+
+  sink = sink + symbols[HARQ_GROUP_BLOCKS][0];
+  return micro_result_t {"erasure_encode", HARQ_GROUP_BLOCKS * HARQ_BLOCK_BYTES, calls, ticks};
+}
+
+
+micro_result_t
+MicroBench::erasureDecode(uint32_t calls)
+{
+  /* the group's first block lost and repaired from the first parity block */
+  memcpy(symbols, blocks, sizeof(blocks));
+  code.encode(blocks, HARQ_GROUP_BLOCKS, 0, HARQ_BLOCK_BYTES, symbols[HARQ_GROUP_BLOCKS]);
+  uint32_t have = (((uint32_t) 1 << (HARQ_GROUP_BLOCKS + 1)) - 1) & ~(uint32_t) 1;
+
+  uint32_t folded {0};
+  micro_ticks_t start = microTicks();
+  for (uint32_t i = 0; i < calls; ++i) {
+    folded += code.decode(&symbols[0][0], have, HARQ_GROUP_BLOCKS, HARQ_BLOCK_BYTES);
+  }
+  micro_ticks_t ticks = microTicks() - start;
+
+  sink = sink + folded + (memcmp(symbols[0], blocks, HARQ_BLOCK_BYTES) != 0);
+  return micro_result_t {"erasure_decode", HARQ_GROUP_BLOCKS * HARQ_BLOCK_BYTES, calls, ticks};
+}
+
+
+micro_result_t
+MicroBench::headerPack(uint32_t calls)
+{
+  uint32_t folded {0};
+  micro_ticks_t start = microTicks();
+  for (uint32_t i = 0; i < calls; ++i) {
+    HarqGroup::put(payload, i);
+    HarqIndex::put(payload, i >> 3);
+    HarqCount::put(payload, i);
+    folded += HarqGroup::get(payload) + HarqIndex::get(payload) + HarqCount::get(payload);
+  }
+  micro_ticks_t ticks = microTicks() - start;
+
+  memset(payload, MICRO_FILL_CHAR, sizeof(payload));
+  sink = sink + folded;
+  return micro_result_t {"header_pack", HarqHeader::BYTES, calls, ticks};
+}
+
+
+micro_result_t
+MicroBench::aggregateSplit(uint32_t calls)
+{
+  char aggregate[AGGREGATE_PAYLOAD_BYTES] {AGGREGATE_CHAR};
+  uint8_t fill {1};
+  for (uint8_t flow = 0; fill + AggregateHeader::BYTES + MICRO_MESSAGE_BYTES <= AGGREGATE_PAYLOAD_BYTES; ++flow) {
+    AggregateLength::put(aggregate + fill, MICRO_MESSAGE_BYTES);
+    AggregateFlow::put(aggregate + fill, flow);
+    memset(aggregate + fill + AggregateHeader::BYTES, MICRO_FILL_CHAR, MICRO_MESSAGE_BYTES);
+    fill += AggregateHeader::BYTES + MICRO_MESSAGE_BYTES;
+  }
+
+  uint32_t folded {0};
+  micro_ticks_t start = microTicks();
+  for (uint32_t i = 0; i < calls; ++i) {
+    folded += splitAggregate(aggregate, countMessage, &folded);
+  }
+  micro_ticks_t ticks = microTicks() - start;
+
+  sink = sink + folded;
+  return micro_result_t {"aggregate_split", AGGREGATE_PAYLOAD_BYTES, calls, ticks};
+}
+
+
+/* -----Output----- */
+
+void
+MicroBench::print(const micro_result_t & result)
+{
+  /* Print has no 64 bit numbers on every core */
+  char digits[MICRO_DIGITS + 1];
+  uint8_t at = MICRO_DIGITS;
+  uint64_t ticks = result.ticks;
+  digits[at] = '\0';
+  do {
+    digits[--at] = (char) ('0' + ticks % 10);
+    ticks /= 10;
+  } while (ticks);
+
+  Serial.print("micro," MICRO_BUILD ",");
+  Serial.print(result.kernel);
+  Serial.print(',');
+  Serial.print(result.bytes);
+  Serial.print(',');
+  Serial.print(result.calls);
+  Serial.print(',');
+  Serial.print(digits + at);
+  Serial.print(',');
+  Serial.println(microTickHz());
+}
@@ -0,0 +1,76 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "payload_packer.h"
+
+PayloadPacker::PayloadPacker(uint8_t capacity) : capacity(capacity)
+{
+  clear();
+}
+
+
+void
+PayloadPacker::pack(const char * data, uint32_t size, packer_send_f send, void * ctx)
+{
+  while (size) {
+    /* no room for a trailer, and nothing held to go ahead of it */
+    if (capacity == FIFO_SIZE_BYTES && !this->size && size >= FIFO_SIZE_BYTES) {
+      if (!send(ctx, data)) return;
+      data += FIFO_SIZE_BYTES;
+      size -= FIFO_SIZE_BYTES;
+      continue;
+    }
+
+    uint32_t taken = fill(data, size);
+    data += taken;
+    size -= taken;
+
+    if (full()) {
+      bool more = send(ctx, payload);
+      clear();
+      if (!more) return;
+    }
+  }
+}
+
+
+uint32_t
+PayloadPacker::fill(const char * data, uint32_t size)
+{
+  uint32_t room = capacity - this->size;
+  uint32_t taken = (size < room) ? size : room;
+
+  memcpy(payload + this->size, data, taken);
+  this->size += taken;
+
+  return taken;
+}
+
+
+bool
+PayloadPacker::full(void)
+{
+  return size == capacity;
+}
+
+
+char *
+PayloadPacker::getPayload(void)
+{
+  return payload;
+}
+
+
+uint8_t
+PayloadPacker::getSize(void)
+{
+  return size;
+}
+
+
+void
+PayloadPacker::clear(void)
+{
+  memset(payload, 0, sizeof(payload));
+  size = 0;
+}
@@ -0,0 +1,83 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "radio_bench.h"
+
+#define BENCH_PAYLOAD_BYTES 32
+
+
+bench_result_t
+benchmarkRadio(Radio & radio, uint32_t payloads)
+{
+    bench_result_t result {};
+    char payload[BENCH_PAYLOAD_BYTES];
+    memset(payload, BENCH_FILL_CHAR, sizeof(payload));
+
+    /* SPI cost on its own, no air time involved */
+    uint32_t start = micros();
+    for (uint32_t i = 0; i < BENCH_SPI_POLLS; ++i) {
+        radio.available();
+    }
+    result.spi_us = (float) (micros() - start) / BENCH_SPI_POLLS;
+
+    uint32_t write_total_us {0};
+    start = micros();
+
+    for (uint32_t i = 0; i < payloads; ++i) {
+        uint32_t t = micros();
+        bool acked = radio.write(payload, BENCH_PAYLOAD_BYTES);
+        t = micros() - t;
+
+        write_total_us += t;
+        if (t > result.write_max_us) result.write_max_us = t;
+        result.retransmits += radio.getARC();
+        if (acked) result.acked++;
+    }
+
+    uint32_t elapsed_us = micros() - start;
+
+    result.payloads = payloads;
+    result.write_avg_us = payloads ? (float) write_total_us / payloads : 0;
+    result.goodput_bps = elapsed_us ? 8.0f * BENCH_PAYLOAD_BYTES * result.acked * 1e6f / elapsed_us : 0;
+
+    /*
+     * A drop is reported once per MAX_RT, and takes what was queued behind
+     * it too, so the burst goodput is an upper bound
+     */
+    start = micros();
+    for (uint32_t i = 0; i < payloads; ++i) {
+        result.burst_drops += !radio.writeFast(payload, BENCH_PAYLOAD_BYTES);
+    }
+    result.burst_drops += !radio.txStandBy();
+    elapsed_us = micros() - start;
+
+    uint32_t burst_sent = payloads - ((result.burst_drops < payloads) ? result.burst_drops : payloads);
+    result.burst_goodput_bps = elapsed_us ? 8.0f * BENCH_PAYLOAD_BYTES * burst_sent * 1e6f / elapsed_us : 0;
+    return result;
+}
+
+
+void
+printBenchResult(Radio & radio, const bench_result_t & result)
+{
+    Serial.print(radio.name());
+    Serial.print(": spi ");
+    Serial.print(result.spi_us);
+    Serial.print(" us/transaction, write ");
+    Serial.print(result.write_avg_us);
+    Serial.print(" us avg ");
+    Serial.print(result.write_max_us);
+    Serial.print(" us max, acked ");
+    Serial.print(result.acked);
+    Serial.print('/');
+    Serial.print(result.payloads);
+    Serial.print(", retransmits ");
+    Serial.print(result.retransmits);
+    Serial.print(", goodput ");
+    Serial.print(result.goodput_bps);
+    Serial.print(" bps, burst ");
+    Serial.print(result.burst_goodput_bps);
+    Serial.print(" bps (");
+    Serial.print(result.burst_drops);
+    Serial.println(" drops)");
+}
@@ -0,0 +1,89 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "rate_shaper.h"
+
+RateShaper::RateShaper() {}
+
+
+void
+RateShaper::configure(shaping_config_t * config)
+{
+  link.configure(config->link.rate.num, config->link.burst.num);
+
+  for (uint8_t i = 0; i < SHAPING_FLOWS; ++i) {
+    flows[i].configure(config->flows[i].rate.num, config->flows[i].burst.num);
+  }
+}
+
+
+uint32_t
+RateShaper::waitUs(uint8_t flow, uint32_t bytes)
+{
+  uint32_t link_us = link.waitUs(bytes);
+  uint32_t flow_us = flows[flow % SHAPING_FLOWS].waitUs(bytes);
+
+  return (link_us > flow_us) ? link_us : flow_us;
+}
+
+
+void
+RateShaper::consume(uint8_t flow, uint32_t bytes)
+{
+  link.consume(bytes);
+  flows[flow % SHAPING_FLOWS].consume(bytes);
+}
+
+
+void
+RateShaper::pace(uint8_t flow, uint32_t bytes)
+{
+  while (uint32_t wait = waitUs(flow, bytes)) delayMicroseconds(wait);
+  consume(flow, bytes);
+}
+
+
+/* -----ShapedRadio----- */
+
+ShapedRadio::ShapedRadio(Radio & radio, RateShaper & shaper, uint8_t flow)
+  : radio(radio), shaper(shaper), flow(flow) {}
+
+
+void
+ShapedRadio::pace(uint8_t len)
+{
+  shaper.pace(flow, len);
+}
+
+
+bool
+ShapedRadio::write(const void * buf, uint8_t len)
+{
+  pace(len);
+  return radio.write(buf, len);
+}
+
+
+bool
+ShapedRadio::writeFast(const void * buf, uint8_t len)
+{
+  pace(len);
+  return radio.writeFast(buf, len);
+}
+
+
+void ShapedRadio::begin() { radio.begin(); }
+void ShapedRadio::setAddressWidth(uint8_t aw) { radio.setAddressWidth(aw); }
+void ShapedRadio::setChannel(uint8_t channel) { radio.setChannel(channel); }
+void ShapedRadio::setDataRate(radio_data_rate_e rate) { radio.setDataRate(rate); }
+void ShapedRadio::setPALevel(radio_pa_level_e level) { radio.setPALevel(level); }
+void ShapedRadio::setRetries(uint8_t delay, uint8_t count) { radio.setRetries(delay, count); }
+void ShapedRadio::setAutoAck(bool enable) { radio.setAutoAck(enable); }
+void ShapedRadio::openWritingPipe(uint8_t * address) { radio.openWritingPipe(address); }
+void ShapedRadio::openReadingPipe(uint8_t pipe, uint8_t * address) { radio.openReadingPipe(pipe, address); }
+void ShapedRadio::startListening() { radio.startListening(); }
+void ShapedRadio::stopListening() { radio.stopListening(); }
+bool ShapedRadio::txStandBy() { return radio.txStandBy(); }
+bool ShapedRadio::available() { return radio.available(); }
+void ShapedRadio::read(void * buf, uint8_t len) { radio.read(buf, len); }
+uint8_t ShapedRadio::getARC() { return radio.getARC(); }
+const char * ShapedRadio::name() { return radio.name(); }
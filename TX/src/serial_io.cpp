@@ -1,9 +1,64 @@
 #include <Arduino.h>
 #include <stdint.h>
+#include <string.h>
+#include <esp_intr_alloc.h>
+#include <driver/periph_ctrl.h>
+#include <rom/gpio.h>
+#include <soc/gpio_sig_map.h>
 #include "serial_io.h"
+#include "control_reader.h"
 #include "esp32AtCmdUART.h"
 
-SerialIO::SerialIO() {}
+/* set by controlISR(), cleared once the command has been read */
+static volatile bool control_pending {false};
+static intr_handle_t control_handle {NULL};
+
+
+/*
+ * What the computer sends, for the ControlReader
+ */
+static int
+readSerial(void * ctx)
+{
+  (void) ctx;
+  return Serial.read();
+}
+
+/* every read of the computer's data and commands goes through it */
+static ControlReader control(readSerial, NULL);
+
+
+/*
+ * Flags a control command from the computer.  UART1 also receives a copy
+ * of all the data, which nothing reads, so its FIFO is emptied whenever it
+ * fills up.
+ */
+static void IRAM_ATTR
+controlISR(void * arg)
+{
+  (void) arg;
+  uint32_t status = UART_INT_ST_REG;
+
+  UART_AT_CMD_CONF0_REG |= (1 << UART_RXFIFO_RST_BIT);
+  UART_AT_CMD_CONF0_REG &= ~(1 << UART_RXFIFO_RST_BIT);
+  UART_INT_CLR_REG = status;
+
+  if (status & (1 << UART_AT_CMD_CHAR_DET_INT_ST_BIT)) {
+    control_pending = true;
+  }
+}
+
+
+SerialIO::SerialIO()
+{
+  shaping.link.rate.num = PROFILE_LINK_RATE;
+  shaping.link.burst.num = PROFILE_LINK_BURST;
+
+  for (uint8_t i = 0; i < SHAPING_FLOWS; ++i) {
+    shaping.flows[i].rate.num = SHAPING_UNLIMITED;
+    shaping.flows[i].burst.num = 0;
+  }
+}
 
 /* -----Getters----- */
 
@@ -33,6 +88,12 @@ SerialIO::getAddressNum(void)
   return input_address.num;
 }
 
+void
+SerialIO::getReplyAddress(uint8_t * reply)
+{
+  for (uint8_t i = 0; i < ADDRESS_BYTES; ++i) reply[i] = ~input_address.bytes[i];
+}
+
 
 uint8_t 
 SerialIO::getChannel(void) 
@@ -41,6 +102,13 @@ SerialIO::getChannel(void)
 }
 
 
+shaping_config_t *
+SerialIO::getShaping(void)
+{
+  return &shaping;
+}
+
+
 char *
 SerialIO::getFileChunk(void)
 {
@@ -65,9 +133,15 @@ SerialIO::getExpectedRadioState()
 /* -----Setters----- */
 
 void
-SerialIO::setFromSerial(char * toSet, uint32_t size) 
+SerialIO::setFromSerial(char * toSet, uint32_t size)
+{
+  setFromSerial((uint8_t *) toSet, size);
+}
+
+
+void
+SerialIO::setFromSerial(uint8_t * toSet, uint32_t size)
 {
-  char curr_char;
   uint32_t sent_bytes {0};
 
   /*
@@ -75,33 +149,16 @@ SerialIO::setFromSerial(char * toSet, uint32_t size)
    * setting state until the computer sends over data, but that
    * may not happen instantly.  We also want to break out of
    * the innermost loop the second that we have all the data 
-   * we need.
+   * we need.  A command may come in anywhere among the bytes, and is
+   * acted on before reading on.
    */
-  while (sent_bytes < size) {
-    while (sent_bytes < size && Serial.available()) {
-      curr_char = (char) (Serial.read());
-      *toSet = curr_char;
-      toSet++;
-      sent_bytes++;
-    }
-  }
-}
-
-
-void
-SerialIO::setFromSerial(uint8_t * toSet, uint32_t size) 
-{
-  uint8_t curr_byte;
-  uint32_t sent_bytes {0};
-
-  /* For 2 loop reasoning, see setFromSerial(char *, uint32_t)  */
-  while (sent_bytes < size) {
-    while (sent_bytes < size && Serial.available()) {
-      curr_byte = (uint8_t) (Serial.read());
-      *toSet = curr_byte;
+  while (sent_bytes < size && !transfer_stopped) {
+    while (sent_bytes < size && control.available()) {
+      *toSet = (uint8_t) (control.read());
       toSet++;
       sent_bytes++;
     }
+    if (control.command() != CONTROL_NONE) handleControl();
   }
 }
 
@@ -120,6 +177,10 @@ SerialIO::setConfig()
       setFromSerial(&input_channel, (uint32_t) CHANNEL_BYTES);
       setFromSerial(input_address.bytes, (uint32_t) ADDRESS_BYTES);
       board_state = READY;
+
+      /* commands sent before this configuration were flushed with it */
+      control_pending = false;
+      transfer_stopped = false;
       break;
     
     default:
@@ -129,6 +190,27 @@ SerialIO::setConfig()
 }
 
 
+void
+SerialIO::setLink(uint8_t channel, const uint8_t * address)
+{
+  input_channel = channel;
+  memcpy(input_address.bytes, address, ADDRESS_BYTES);
+}
+
+
+void
+SerialIO::setShaping()
+{
+  setFromSerial(shaping.link.rate.bytes, (uint32_t) sizeof(uint32_t));
+  setFromSerial(shaping.link.burst.bytes, (uint32_t) sizeof(uint32_t));
+
+  for (uint8_t i = 0; i < SHAPING_FLOWS; ++i) {
+    setFromSerial(shaping.flows[i].rate.bytes, (uint32_t) sizeof(uint32_t));
+    setFromSerial(shaping.flows[i].burst.bytes, (uint32_t) sizeof(uint32_t));
+  }
+}
+
+
 void
 SerialIO::setExtension()
 {
@@ -176,6 +258,7 @@ SerialIO::softReset()
   emptyFileChunk();
   emptyFileExtension();
   next_chunk_size = 0;
+  transfer_stopped = false;
 }
 
 
@@ -187,12 +270,16 @@ SerialIO::handshake()
   char curr_char {'a'}; // arbirary initiallization != HANDSHAKE_CHAR
 
   /* For 2 loop reasoning, see setFromSerial(char *, uint32_t)  */
-  while (curr_char != HANDSHAKE_CHAR) {
-    while (curr_char != HANDSHAKE_CHAR && Serial.available()) {
-      curr_char = (char) (Serial.read());
+  while (curr_char != HANDSHAKE_CHAR && !transfer_stopped) {
+    while (curr_char != HANDSHAKE_CHAR && control.available()) {
+      curr_char = (char) (control.read());
     }
+    if (control.command() != CONTROL_NONE) handleControl();
   }
 
+  /* the computer gave up on the transfer instead */
+  if (transfer_stopped) return;
+
   /* now tell the computer that we are ready too */
   Serial.print(HANDSHAKE_CHAR);
 }
@@ -206,8 +293,10 @@ SerialIO::flushSerial()
   
   /* For 2 loop reasoning, see setFromSerial(char *, uint32_t)  */
   while (serial_flush_count < FLUSH_COUNT) {
-    while (serial_flush_count < FLUSH_COUNT && Serial.available()) {
-      curr_byte = (uint8_t) (Serial.read());
+    /* commands sent before the configuration are flushed with the rest */
+    control.takeCommand();
+    while (serial_flush_count < FLUSH_COUNT && control.available()) {
+      curr_byte = (uint8_t) (control.read());
       if (curr_byte == FLUSH_CONST) {
         serial_flush_count++;
       } else {
@@ -232,6 +321,93 @@ SerialIO::configAtCmdCharInterrupt(char c, uint8_t reps)
 }
 
 
+bool
+SerialIO::enableControl()
+{
+  /* UART1 listens on Serial's RX pin, at Serial's baud rate */
+  periph_module_enable(PERIPH_UART1_MODULE);
+  uint32_t clkdiv = ((APB_CYCLES_PER_US * 1000000) << 4) / BAUD_RATE;
+  UART_AT_CMD_CLKDIV_REG = ((clkdiv & 0xf) << UART_CLKDIV_FRAG_BIT) | ((clkdiv >> 4) & UART_CLKDIV_MASK);
+  gpio_matrix_in(AT_CMD_RX_PIN, U1RXD_IN_IDX, false);
+
+  configAtCmdCharInterrupt(TX_CHAR, TX_CHAR_REPS);
+  UART_AT_CMD_PRECNT_REG = (AT_CMD_IDLE_US * APB_CYCLES_PER_US) & UART_PRE_IDLE_NUM_MASK;
+  UART_AT_CMD_POSTCNT_REG = (AT_CMD_IDLE_US * APB_CYCLES_PER_US) & UART_POST_IDLE_NUM_MASK;
+  UART_AT_CMD_GAPTOUT_REG = (AT_CMD_GAP_US * APB_CYCLES_PER_US) & UART_RX_GAP_TOUT_MASK;
+
+  clearInterruptUART(UART_AT_CMD_CHAR_DET_INT_CLR_BIT);
+  clearInterruptUART(UART_RXFIFO_FULL_INT_BIT);
+
+  if (esp_intr_alloc(AT_CMD_UART_INTR_SOURCE, ESP_INTR_FLAG_IRAM, controlISR, NULL, &control_handle) != ESP_OK) {
+    return false;
+  }
+
+  UART_INT_ENA_REG |= (1 << UART_AT_CMD_CHAR_DET_INT_ENA_BIT) | (1 << UART_RXFIFO_FULL_INT_BIT);
+  return true;
+}
+
+
+bool
+SerialIO::checkControl()
+{
+  /* with the virtual channels up, control comes in on MUX_CONTROL instead */
+  if (mux_enabled) {
+    control_pending = false;
+    pollMux();
+  } else if (control_pending ? control.seekCommand() : control.command() != CONTROL_NONE) {
+    handleControl();
+  }
+  return transfer_stopped;
+}
+
+
+bool
+SerialIO::available()
+{
+  return control.available();
+}
+
+
+bool
+SerialIO::transferStopped()
+{
+  return transfer_stopped;
+}
+
+
+void
+SerialIO::handleControl()
+{
+  char command = control.takeCommand();
+
+  /* a paused transfer waits for the next command */
+  while (command == CONTROL_PAUSE) {
+    while (!control.seekCommand()) {}
+    command = control.takeCommand();
+  }
+
+  /* the at_cmd interrupt of every command so far has fired by now */
+  control_pending = false;
+
+  switch (command) {
+  case CONTROL_PREEMPT:
+    board_state = CONFIG;
+    serial_state = FLUSHING;
+    transfer_stopped = true;
+    control.clear();
+    break;
+
+  case CONTROL_ABORT:
+    transfer_stopped = true;
+    control.clear();
+    break;
+
+  default:  // CONTROL_RESUME, or anything we do not know
+    break;
+  }
+}
+
+
 /* ------Arduino -> Computer----- */
 
 void
@@ -255,9 +431,226 @@ SerialIO::send(char * data)
   Serial.print(HANDSHAKE_CHAR);
 }
 
+void
+SerialIO::send(const char * data, uint32_t size) 
+{
+  Serial.write((const uint8_t *) data, size);
+  Serial.print(HANDSHAKE_CHAR);
+}
+
 void
 SerialIO::send(char data) 
 {
   Serial.print(data);
   Serial.print(HANDSHAKE_CHAR);
 }
+
+
+/* -----Virtual Channels----- */
+
+void
+SerialIO::startMux()
+{
+  handshake();
+  if (transfer_stopped) return;
+
+  for (uint8_t i = 0; i < MUX_DATA_STREAMS; ++i) {
+    memset(&streams[i], 0, sizeof(mux_stream_t));
+  }
+  mux_received = 0;
+  mux_enabled = true;
+}
+
+
+void
+SerialIO::pollMux()
+{
+  while (mux_enabled && Serial.available()) {
+    uint8_t curr_byte = (uint8_t) (Serial.read());
+
+    if (mux_received < MUX_HEADER_BYTES) {
+      mux_header[mux_received++] = curr_byte;
+    } else {
+      /* the computer never sends more than MUX_MAX_FRAME, drop it if it does */
+      if (mux_received - MUX_HEADER_BYTES < MUX_MAX_FRAME) {
+        mux_frame[mux_received - MUX_HEADER_BYTES] = (char) curr_byte;
+      }
+      ++mux_received;
+    }
+
+    uint8_t size = mux_header[1];
+    if (mux_received >= MUX_HEADER_BYTES && mux_received == MUX_HEADER_BYTES + size) {
+      mux_received = 0;
+      handleFrame(mux_header[0], mux_frame, (size < MUX_MAX_FRAME) ? size : MUX_MAX_FRAME);
+    }
+  }
+}
+
+
+void
+SerialIO::handleFrame(uint8_t channel, const char * data, uint8_t size)
+{
+  if (channel == MUX_CONTROL) {
+    handleMuxControl(data, size);
+    return;
+  }
+  if (channel < MUX_DATA || channel >= MUX_CHANNELS) return;
+
+  mux_stream_t * stream = &streams[channel - MUX_DATA];
+  if (stream->state != MUX_STREAM_OPEN) return;
+
+  /* within its credit there is always room */
+  for (uint8_t i = 0; i < size && stream->count < MUX_STREAM_BYTES; ++i) {
+    stream->buffer[(stream->head + stream->count++) % MUX_STREAM_BYTES] = data[i];
+  }
+}
+
+
+void
+SerialIO::handleMuxControl(const char * data, uint8_t size)
+{
+  if (!size) return;
+
+  /* ops on a stream carry it in the second byte */
+  mux_stream_t * stream {NULL};
+  if (size >= 2 && (uint8_t) data[1] < MUX_DATA_STREAMS) {
+    stream = &streams[(uint8_t) data[1]];
+  }
+
+  switch (data[0]) {
+  case MUX_OP_STATS:
+    if (telemetry) {
+      for (uint8_t i = 0; i < MUX_DATA_STREAMS; ++i) {
+        telemetry->queued[i] = streams[i].count;
+      }
+      sendFrame(MUX_TELEMETRY, telemetry, sizeof(mux_telemetry_t));
+    }
+    break;
+
+  case MUX_OP_OPEN:
+    if (stream && stream->state == MUX_STREAM_IDLE) {
+      memset(stream->extension, 0, EXTENSION_BYTES);
+      memcpy(stream->extension, data + 2, (size - 2 < EXTENSION_BYTES) ? size - 2 : EXTENSION_BYTES);
+      stream->head = stream->count = stream->freed = 0;
+      stream->paused = false;
+      stream->state = MUX_STREAM_OPEN;
+      sendCredit(MUX_DATA + data[1], MUX_STREAM_BYTES);
+    }
+    break;
+
+  case MUX_OP_CLOSE:
+    if (stream && stream->state == MUX_STREAM_OPEN) stream->state = MUX_STREAM_CLOSING;
+    break;
+
+  case CONTROL_ABORT:
+    if (stream && stream->state != MUX_STREAM_IDLE) {
+      stream->count = 0;
+      stream->state = MUX_STREAM_ABORTED;
+    }
+    break;
+
+  case CONTROL_PAUSE:
+    if (stream) stream->paused = true;
+    break;
+
+  case CONTROL_RESUME:
+    if (stream) stream->paused = false;
+    break;
+
+  case CONTROL_PREEMPT:
+    mux_enabled = false;
+    board_state = CONFIG;
+    serial_state = FLUSHING;
+    transfer_stopped = true;
+    break;
+
+  default:  // anything we do not know
+    break;
+  }
+}
+
+
+uint16_t
+SerialIO::readStream(uint8_t stream, char * data, uint16_t size)
+{
+  mux_stream_t * s = &streams[stream];
+  uint16_t taken {0};
+
+  while (taken < size && s->count) {
+    data[taken++] = s->buffer[s->head];
+    s->head = (s->head + 1) % MUX_STREAM_BYTES;
+    --s->count;
+  }
+
+  /* credit in frames worth, or whatever is left once the buffer is empty */
+  s->freed += taken;
+  if (s->state == MUX_STREAM_OPEN && (s->freed >= MUX_MAX_FRAME || (s->freed && !s->count))) {
+    sendCredit(MUX_DATA + stream, s->freed);
+    s->freed = 0;
+  }
+  return taken;
+}
+
+
+void
+SerialIO::finishStream(uint8_t stream)
+{
+  char ack[2] {MUX_OP_CLOSE, (char) stream};
+
+  memset(&streams[stream], 0, sizeof(mux_stream_t));
+  sendFrame(MUX_CONTROL, ack, sizeof(ack));
+}
+
+
+mux_stream_state_e
+SerialIO::getStreamState(uint8_t stream)
+{
+  return streams[stream].state;
+}
+
+
+bool
+SerialIO::streamPaused(uint8_t stream)
+{
+  return streams[stream].paused;
+}
+
+
+char *
+SerialIO::getStreamExtension(uint8_t stream)
+{
+  return streams[stream].extension;
+}
+
+
+uint16_t
+SerialIO::streamQueued(uint8_t stream)
+{
+  return streams[stream].count;
+}
+
+
+void
+SerialIO::setTelemetry(mux_telemetry_t * stats)
+{
+  telemetry = stats;
+}
+
+
+void
+SerialIO::sendFrame(uint8_t channel, const void * data, uint8_t size)
+{
+  uint8_t header[MUX_HEADER_BYTES] {channel, size};
+
+  Serial.write(header, MUX_HEADER_BYTES);
+  Serial.write((const uint8_t *) data, size);
+}
+
+
+void
+SerialIO::sendCredit(uint8_t channel, uint16_t bytes)
+{
+  char credit[4] {MUX_OP_CREDIT, (char) channel, (char) (bytes & 0xff), (char) (bytes >> 8)};
+
+  sendFrame(MUX_CONTROL, credit, sizeof(credit));
+}
@@ -0,0 +1,151 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+#include "session.h"
+
+/* caps in payloads, field by field as session_caps_t */
+static void
+putCaps(char * payload, const session_caps_t & caps)
+{
+  SessionVersion::put(payload, caps.version);
+  SessionMaxRate::put(payload, caps.max_rate);
+  SessionFeatures::put(payload, caps.features);
+  SessionWindow::put(payload, caps.window);
+  SessionFileBytes::put(payload, caps.file_bytes);
+}
+
+static session_caps_t
+getCaps(const char * payload)
+{
+  session_caps_t caps;
+  caps.version = SessionVersion::get(payload);
+  caps.max_rate = SessionMaxRate::get(payload);
+  caps.features = SessionFeatures::get(payload);
+  caps.window = SessionWindow::get(payload);
+  caps.file_bytes = SessionFileBytes::get(payload);
+  return caps;
+}
+
+
+session_caps_t
+sessionAgree(const session_caps_t & a, const session_caps_t & b)
+{
+  session_caps_t agreed {};
+
+  /* another layout of the payloads, nothing to talk about */
+  if (a.version != b.version || a.file_bytes != b.file_bytes) return agreed;
+
+  agreed.version = a.version;
+  agreed.max_rate = (a.max_rate < b.max_rate) ? a.max_rate : b.max_rate;
+  agreed.features = a.features & b.features & ~SESSION_ENCRYPTION;
+  agreed.window = (a.window < b.window) ? a.window : b.window;
+  agreed.file_bytes = a.file_bytes;
+
+  /* the groups of either end have to line up */
+  if (a.window != b.window) agreed.features &= ~SESSION_HARQ;
+  return agreed;
+}
+
+
+/* -----Sender----- */
+
+session_caps_t
+openSession(Radio & radio, uint8_t * address, uint8_t * receiver, const session_caps_t & ours)
+{
+  char payload[SESSION_PAYLOAD_BYTES] {};
+  char answer[SESSION_PAYLOAD_BYTES];
+  session_caps_t agreed {};
+  bool answered {false};
+
+  radio.setDataRate((radio_data_rate_e) SESSION_BASE_RATE);
+  radio.openReadingPipe(SESSION_READING_PIPE, address);
+
+  payload[0] = SESSION_CHAR;
+  SessionType::put(payload, SESSION_OFFER);
+  memcpy(payload + SESSION_REPLY_OFFSET, address, SESSION_ADDRESS_BYTES);
+  putCaps(payload, ours);
+
+  for (uint8_t tries = 0; tries < SESSION_TRIES && !answered; ++tries) {
+    radio.stopListening();
+    radio.openWritingPipe(receiver);
+    if (!radio.write(payload, SESSION_PAYLOAD_BYTES)) continue;
+    radio.startListening();
+
+    uint32_t sent = micros();
+    while (micros() - sent < SESSION_TIMEOUT_US) {
+      if (!radio.available()) continue;
+      radio.read(answer, SESSION_PAYLOAD_BYTES);
+      if (answer[0] != SESSION_CHAR || SessionType::get(answer) != SESSION_ANSWER) continue;
+
+      agreed = sessionAgree(ours, getCaps(answer));
+      answered = true;
+      break;
+    }
+  }
+
+  radio.stopListening();
+  radio.openWritingPipe(receiver);
+  if (!agreed.version) return agreed;
+
+  /* the receiver changes rate once it has this, even if its ACK is lost */
+  SessionType::put(payload, SESSION_CONFIRM);
+  radio.write(payload, SESSION_PAYLOAD_BYTES);
+  radio.setDataRate((radio_data_rate_e) agreed.max_rate);
+
+  /* so only an ACK at the new rate tells that both are there */
+  SessionType::put(payload, SESSION_CHECK);
+  uint32_t start = micros();
+  bool checked {false};
+  do {
+    checked = radio.write(payload, SESSION_PAYLOAD_BYTES);
+  } while (!checked && micros() - start < SESSION_CHECK_TX_US);
+
+  if (!checked) {
+    radio.setDataRate((radio_data_rate_e) SESSION_BASE_RATE);
+    agreed.version = 0;
+  }
+  return agreed;
+}
+
+
+/* -----Receiver----- */
+
+bool
+answerSession(Radio & radio, const char * payload, uint8_t * address,
+              const session_caps_t & ours, session_caps_t & agreed)
+{
+  if (SessionType::get(payload) == SESSION_CONFIRM) return agreed.version != 0;
+  if (SessionType::get(payload) != SESSION_OFFER) return false;
+
+  agreed = sessionAgree(ours, getCaps(payload));
+
+  /* our caps go back either way, the sender works out the same agreement */
+  char answer[SESSION_PAYLOAD_BYTES] {};
+  answer[0] = SESSION_CHAR;
+  SessionType::put(answer, SESSION_ANSWER);
+  putCaps(answer, ours);
+
+  radio.stopListening();
+  radio.openWritingPipe((uint8_t *) payload + SESSION_REPLY_OFFSET);
+  radio.write(answer, SESSION_PAYLOAD_BYTES);
+
+  /* writing took over pipe 0 for the ACK */
+  radio.openReadingPipe(0, address);
+  radio.startListening();
+  return false;
+}
+
+
+bool
+checkSession(Radio & radio)
+{
+  char payload[SESSION_PAYLOAD_BYTES];
+
+  uint32_t start = micros();
+  while (micros() - start < SESSION_CHECK_US) {
+    if (!radio.available()) continue;
+    radio.read(payload, SESSION_PAYLOAD_BYTES);
+    if (payload[0] == SESSION_CHAR && SessionType::get(payload) == SESSION_CHECK) return true;
+  }
+  return false;
+}
@@ -0,0 +1,58 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include "token_bucket.h"
+
+#define MICRO_BYTES 1000000ULL   // tokens per byte
+
+
+TokenBucket::TokenBucket() {}
+
+
+void
+TokenBucket::configure(uint32_t rate, uint32_t burst)
+{
+  this->rate = rate;
+  if (burst < BUCKET_MIN_BURST) burst = BUCKET_MIN_BURST;
+  capacity = burst * MICRO_BYTES;
+  tokens = capacity;
+  last_us = micros();
+}
+
+
+void
+TokenBucket::refill(void)
+{
+  uint32_t now = micros();
+
+  /* unsigned difference, so the wrap of micros() does not matter */
+  uint64_t added = (uint64_t) (now - last_us) * rate;
+  last_us = now;
+
+  tokens = (capacity - tokens < added) ? capacity : tokens + added;
+}
+
+
+uint32_t
+TokenBucket::waitUs(uint32_t bytes)
+{
+  if (rate == BUCKET_UNLIMITED) return 0;
+
+  refill();
+
+  uint64_t needed = bytes * MICRO_BYTES;
+  if (needed > capacity) needed = capacity;
+  if (tokens >= needed) return 0;
+
+  /* round up, waking early would only mean asking again */
+  return (needed - tokens + rate - 1) / rate;
+}
+
+
+void
+TokenBucket::consume(uint32_t bytes)
+{
+  if (rate == BUCKET_UNLIMITED) return;
+
+  uint64_t needed = bytes * MICRO_BYTES;
+  tokens = (tokens < needed) ? 0 : tokens - needed;
+}
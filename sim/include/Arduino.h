@@ -0,0 +1,81 @@
+/*
+ *  Host-native stand-in for the parts of the Arduino core that the
+ *  firmware uses. It lets the TX/RX sources (the nRF24 driver in
+ *  particular) compile unchanged for the simulator.
+ *
+ *  Every call is routed to the SimBoard of the node whose firmware is
+ *  currently running, and every call costs that node some virtual time,
+ *  so busy-wait loops in the firmware advance the simulation clock the
+ *  same way they burn cycles on the ESP32.
+ */
+
+#pragma once
+
+#ifndef _SIM_ARDUINO_H_
+#define _SIM_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef uint8_t byte;
+
+#define HIGH            0x1
+#define LOW             0x0
+
+/* pin modes use the values of the esp32 Arduino core */
+#define INPUT           0x01
+#define OUTPUT          0x03
+#define INPUT_PULLUP    0x05
+
+#define DEC 10
+#define HEX 16
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+unsigned long micros(void);
+unsigned long millis(void);
+
+/* the core's random(), from one generator for the whole site so runs repeat */
+long random(long howbig);
+/* the scenario seeds it with --seed */
+void randomSeed(unsigned long seed);
+
+/*
+ *  Serial writes land in the node's output buffer and reads come from
+ *  the node's input buffer (see SimBoard), so a simulated host can talk
+ *  to the firmware the same way the Python scripts do.
+ */
+class HardwareSerial
+{
+public:
+    void begin(unsigned long baud);
+    int available(void);
+    int read(void);
+    int peek(void);
+    void flush(void);
+
+    size_t write(uint8_t c);
+    size_t write(const uint8_t * buf, size_t size);
+
+    size_t print(const char * s);
+    size_t print(char c);
+    size_t print(unsigned char n, int base = DEC);
+    size_t print(int n, int base = DEC);
+    size_t print(unsigned int n, int base = DEC);
+    size_t print(long n, int base = DEC);
+    size_t print(unsigned long n, int base = DEC);
+    size_t print(double n, int digits = 2);
+
+    size_t println(void);
+    template <typename T>
+    size_t println(T value) { size_t n = print(value); return n + println(); }
+};
+
+extern HardwareSerial Serial;
+
+#endif /* _SIM_ARDUINO_H_ */
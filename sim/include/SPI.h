@@ -0,0 +1,52 @@
+/*
+ *  Host-native stand-in for the Arduino SPI library. Bytes are clocked
+ *  into whichever simulated nRF24L01+ on the current node has its CSN
+ *  pin held low, and each byte costs the node 8 SCK periods plus the
+ *  per-byte driver overhead of the esp32 SPI HAL.
+ */
+
+#pragma once
+
+#ifndef _SIM_SPI_H_
+#define _SIM_SPI_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LSBFIRST 0
+#define MSBFIRST 1
+
+#define SPI_MODE0 0
+#define SPI_MODE1 1
+#define SPI_MODE2 2
+#define SPI_MODE3 3
+
+class SPISettings
+{
+public:
+    SPISettings(uint32_t clock = 1000000, uint8_t bitOrder = MSBFIRST, uint8_t dataMode = SPI_MODE0)
+        : clock_(clock), bitOrder_(bitOrder), dataMode_(dataMode) {}
+
+    uint32_t clock_;
+    uint8_t bitOrder_;
+    uint8_t dataMode_;
+};
+
+class SPIClass
+{
+public:
+    void begin(void);
+    void end(void);
+
+    void beginTransaction(SPISettings settings);
+    void endTransaction(void);
+
+    uint8_t transfer(uint8_t data);
+    uint16_t transfer16(uint16_t data);
+    void transferBytes(const uint8_t * out, uint8_t * in, uint32_t size);
+    void writeBytes(const uint8_t * data, uint32_t size);
+};
+
+extern SPIClass SPI;
+
+#endif /* _SIM_SPI_H_ */
@@ -0,0 +1,247 @@
+/*
+ *  Register-level model of the nRF24L01+ for the simulator.
+ *
+ *  The model sits behind the SPI and pin stand-ins, so the firmware's
+ *  own driver code talks to it exactly as it would to the real chip:
+ *  commands and register addresses come from nRF24L01.h and the state
+ *  machine follows section 6.1 of the data sheet (power down, standby-I,
+ *  standby-II, TX/RX settling, TX and RX) including Enhanced ShockBurst
+ *  auto-acknowledgement, retransmission, PID duplicate detection and the
+ *  OBSERVE_TX counters.
+ *
+ *  Anything that goes over the air is handed to the RfMedium, which
+ *  decides which receivers hear it.
+ */
+
+#pragma once
+
+#ifndef _NRF24_CHIP_H_
+#define _NRF24_CHIP_H_
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <deque>
+#include <functional>
+#include <vector>
+
+#include "nRF24L01.h"
+#include "sim_kernel.h"
+#include "rf_medium.h"
+
+/* timings from section 6.1.7 of the data sheet */
+#define T_PD2STBY_NS    (1500 * NS_PER_US)
+#define T_STBY2A_NS     (130 * NS_PER_US)
+
+/* both FIFOs are three payloads deep */
+#define FIFO_DEPTH 3
+
+/* STATUS register bits */
+#define STATUS_RX_DR        6
+#define STATUS_TX_DS        5
+#define STATUS_MAX_RT       4
+#define STATUS_RX_P_NO_MASK 0x0E
+#define STATUS_TX_FULL      0
+#define RX_P_NO_EMPTY       0x07
+
+/* FIFO_STATUS register bits */
+#define FIFO_TX_REUSE   6
+#define FIFO_TX_FULL    5
+#define FIFO_TX_EMPTY   4
+#define FIFO_RX_FULL    1
+#define FIFO_RX_EMPTY   0
+
+/* register file size, covers everything up to FEATURE */
+#define N_REGISTERS 0x1E
+
+namespace rfsim {
+
+    typedef enum
+    {
+        POWER_DOWN,
+        STANDBY_I,
+        STANDBY_II,
+        TX_SETTLING,
+        TX_ACTIVE,
+        TX_WAIT_ACK,
+        RX_SETTLING,
+        RX_ACTIVE,
+        RX_SEND_ACK,
+    } chip_state_e;
+
+    typedef struct
+    {
+        std::vector<uint8_t> data;
+        /* RX: pipe it arrived on, TX: ack payload pipe or -1 for a data payload */
+        int8_t pipe;
+        bool noAck;
+    } fifo_entry_t;
+
+    typedef struct
+    {
+        uint64_t txAttempts;
+        uint64_t txDelivered;
+        uint64_t txMaxRt;
+        uint64_t rxPackets;
+        uint64_t rxDuplicates;
+        uint64_t rxOverflows;
+        uint64_t acksSent;
+        sim_time_t airtimeNs;
+    } chip_stats_t;
+
+    class Nrf24Chip
+    {
+    public:
+        Nrf24Chip(Kernel & kernel, RfMedium & medium);
+
+        /* -----pin interface, driven by the SPI/pin stand-ins----- */
+        void setCE(bool high);
+        void setCSN(bool high);
+        uint8_t transfer(uint8_t mosi);
+
+        /* -----medium interface----- */
+
+        /*
+         *  radioIndex
+         *
+         *  Description:
+         *      Index of this chip in the medium it is attached to.
+         */
+        uint32_t radioIndex() const;
+        void setRadioIndex(uint32_t index);
+
+        uint8_t channel() const;
+        uint32_t dataRateBps() const;
+        double txPowerDbm() const;
+        uint8_t addressWidth() const;
+
+        /*
+         *  listening
+         *
+         *  Description:
+         *      Whether the receiver is on, either as a PRX or as a PTX
+         *      waiting for an acknowledgement.
+         */
+        bool listening() const;
+
+        /*
+         *  acceptsAddress
+         *
+         *  args:
+         *      pkt (const air_packet_t &)
+         *
+         *  Description:
+         *      Returns the pipe `pkt' is addressed to or -1 when the
+         *      address does not match an enabled pipe. A PTX waiting for
+         *      an ACK only accepts ACKs on pipe 0.
+         */
+        int8_t acceptsAddress(const air_packet_t & pkt) const;
+
+        /*
+         *  onAirPacket
+         *
+         *  args:
+         *      pkt (const air_packet_t &)
+         *
+         *  Description:
+         *      Called by the medium when `pkt' was received intact.
+         */
+        void onAirPacket(const air_packet_t & pkt);
+
+        /*
+         *  onChange
+         *
+         *  args:
+         *      fn (std::function<void()>)
+         *
+         *  Description:
+         *      Calls `fn' after every event of the chip, its own timers
+         *      and the packets the medium hands it: the only times its
+         *      STATUS can change without the firmware doing anything.
+         */
+        void onChange(std::function<void()> fn);
+
+        /*
+         *  busy
+         *
+         *  Description:
+         *      Whether the chip is settling, transmitting, or waiting for
+         *      or sending an ACK, states with a timer pending that end on
+         *      their own.
+         */
+        bool busy() const;
+
+        /* -----introspection, used by the simulator only----- */
+        chip_state_e state() const;
+        const chip_stats_t & stats() const;
+        uint8_t peekRegister(uint8_t r) const;
+        /* STATUS as the next command would shift it out */
+        uint8_t peekStatus() const;
+
+    private:
+        Kernel & kernel_;
+        RfMedium & medium_;
+        uint32_t radioIndex_;
+
+        uint8_t regs_[N_REGISTERS];
+        uint8_t rxAddrP0_[MAX_ADDRESS_WIDTH];
+        uint8_t rxAddrP1_[MAX_ADDRESS_WIDTH];
+        uint8_t txAddr_[MAX_ADDRESS_WIDTH];
+
+        std::deque<fifo_entry_t> txFifo_;
+        std::deque<fifo_entry_t> rxFifo_;
+
+        chip_state_e state_;
+        bool ce_;
+        bool csn_;
+        /* bumped to invalidate pending timers when the state changes */
+        uint64_t generation_;
+
+        /* in-flight SPI command */
+        uint8_t cmd_;
+        uint32_t byteIndex_;
+        std::vector<uint8_t> spiIn_;
+
+        /* Enhanced ShockBurst bookkeeping */
+        uint8_t pid_;
+        bool pidFresh_;
+        uint8_t retries_;
+        bool reuse_;
+        uint8_t lastRxPid_[N_PIPES + 1];
+        std::vector<uint8_t> lastRxPayload_[N_PIPES + 1];
+        air_packet_t pendingAck_;
+        /* pipe whose ACK payload rides on pendingAck_, -1 for none */
+        int8_t pendingAckPipe_;
+
+        chip_stats_t stats_;
+        std::function<void()> changed_;
+
+        uint8_t statusRegister() const;
+        uint8_t fifoStatusRegister() const;
+        uint8_t readRegisterByte(uint8_t r, uint32_t i) const;
+        void commitRegisterWrite(uint8_t r, const std::vector<uint8_t> & bytes);
+        void endCommand();
+
+        bool hasTxPayload() const;
+        bool maxRtPending() const;
+        bool primaryRx() const;
+        bool dynamicPayload(uint8_t pipe) const;
+        bool autoAck(uint8_t pipe) const;
+        uint8_t crcBytes() const;
+        sim_time_t airtime(uint32_t payloadBytes) const;
+
+        void setState(chip_state_e s);
+        void after(sim_time_t dt, void (Nrf24Chip::*fn)());
+        void receive(const air_packet_t & pkt);
+        void evaluate();
+        void poweredUp();
+        void settled();
+        void startTransmission();
+        void transmissionDone();
+        void ackTimeout();
+        void packetFinished();
+        void sendAck(uint8_t pipe, const air_packet_t & pkt);
+        void transmitAck();
+        void ackSent();
+    };
+}; // rfsim
+#endif /* _NRF24_CHIP_H_ */
@@ -0,0 +1,229 @@
+/*
+ *  Shared 2.4 GHz spectrum for the simulator.
+ *
+ *  Every chip attached to the medium has a position. A transmission is
+ *  heard by a receiver when
+ *
+ *      - the receiver was listening on the same RF_CH at the same air
+ *        data rate when the preamble arrived and was not already locked
+ *        onto another packet,
+ *      - the received power (TX power minus log-distance path loss and
+ *        per-link shadowing) is above the sensitivity for the data rate,
+ *      - the signal to interference plus noise ratio, less any fade of
+ *        the link on that channel, stays above the capture threshold
+ *        for the whole packet. Interference is the sum of every other
+ *        transmission overlapping the packet in time, weighted by how
+ *        much of the receiver's bandwidth it covers (2 Mbps occupies
+ *        2 MHz, the other rates 1 MHz).
+ *
+ *  A stronger packet overlapping a weaker one is therefore received
+ *  (capture effect) and equal-power collisions on the same channel lose
+ *  both packets.
+ */
+
+#pragma once
+
+#ifndef _RF_MEDIUM_H_
+#define _RF_MEDIUM_H_
+
+#include <stdint.h>
+#include <deque>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "sim_kernel.h"
+#include "trace_replay.h"
+
+namespace rfsim {
+
+    class Nrf24Chip;
+
+    /* what goes over the air, the preamble and CRC are implied */
+    typedef struct
+    {
+        std::vector<uint8_t> address;
+        std::vector<uint8_t> payload;
+        uint8_t pid;
+        bool noAck;
+        bool isAck;
+    } air_packet_t;
+
+    typedef struct
+    {
+        uint64_t id;
+        uint32_t src;
+        air_packet_t pkt;
+        uint8_t channel;
+        uint32_t rateBps;
+        double powerDbm;
+        sim_time_t start;
+        sim_time_t addressEnd;
+        sim_time_t end;
+        /* outcome taken from a field trace: -1 none, 0 delivered, 1 lost */
+        int8_t replay;
+    } transmission_t;
+
+    typedef struct
+    {
+        /* log-distance path loss: refLossDb at 1 m, then 10 * n * log10(d) */
+        double refLossDb;
+        double pathLossExponent;
+        /* standard deviation of the fixed per-link shadowing term */
+        double shadowingSigmaDb;
+        double noiseFloorDbm;
+        /* SINR needed to decode a packet */
+        double captureThresholdDb;
+        /* chance any packet, ACKs included, is lost on top of the model, for loss sweeps */
+        double randomLoss;
+        /*
+         *  multipath fades, fadingDb deep (0 for none) and fadingMs long
+         *  on average, a FADE_DUTY of the time; every link fades on every
+         *  channel apart from the others
+         */
+        double fadingDb;
+        double fadingMs;
+        uint64_t seed;
+    } medium_config_t;
+
+    typedef struct
+    {
+        uint64_t transmissions;
+        uint64_t delivered;
+        /* delivered although another transmission overlapped it */
+        uint64_t captured;
+        /* lost at a receiver that had locked onto it */
+        uint64_t collisions;
+        /* arrived while the receiver was busy with another packet */
+        uint64_t missedBusy;
+        /* lost because the replayed trace says so */
+        uint64_t replayLost;
+        /* lost to randomLoss */
+        uint64_t randomLost;
+        /* lost to a fade, heard without it */
+        uint64_t fadeLost;
+    } medium_stats_t;
+
+    /*
+     *  Per-link loss override. Used for links whose loss is measured
+     *  rather than derived from positions.
+     */
+    typedef struct
+    {
+        uint32_t a;
+        uint32_t b;
+        double lossDb;
+    } link_loss_t;
+
+    /* a link on a channel, faded or not until the next change */
+    typedef struct
+    {
+        bool faded;
+        sim_time_t until;
+    } fade_state_t;
+
+    typedef struct
+    {
+        const TraceReplay * trace;
+        /* next attempt of the trace to use */
+        uint64_t next;
+    } replay_link_t;
+
+    medium_config_t defaultMediumConfig();
+
+    class RfMedium
+    {
+    public:
+        RfMedium(Kernel & kernel, const medium_config_t & config);
+
+        /*
+         *  attach
+         *
+         *  args:
+         *      chip (Nrf24Chip *)
+         *      x, y (double) position in meters
+         *
+         *  Description:
+         *      Registers a radio with the medium and returns its index.
+         */
+        uint32_t attach(Nrf24Chip * chip, double x, double y);
+
+        void setLinkLoss(uint32_t a, uint32_t b, double lossDb);
+        double linkLossDb(uint32_t a, uint32_t b) const;
+
+        /*
+         *  transmit
+         *
+         *  args:
+         *      src      (uint32_t) radio index of the sender
+         *      pkt      (const air_packet_t &)
+         *      duration (sim_time_t) airtime of the whole packet
+         *
+         *  Description:
+         *      Puts `pkt' on the air starting now. Reception is resolved
+         *      when the packet ends.
+         */
+        void transmit(uint32_t src, const air_packet_t & pkt, sim_time_t duration);
+
+        /*
+         *  setReplay
+         *
+         *  args:
+         *      src    (uint32_t) radio index of the sender
+         *      trace  (const TraceReplay *)
+         *      offset (uint64_t) attempt of the trace to start at
+         *
+         *  Description:
+         *      Packets `src' sends are delivered or lost as the trace
+         *      says rather than by the radio model. ACKs still go
+         *      through the model. Receivers must still be listening and
+         *      not locked onto another packet.
+         */
+        void setReplay(uint32_t src, const TraceReplay * trace, uint64_t offset);
+
+        /*
+         *  powerAtDbm
+         *
+         *  args:
+         *      rx (uint32_t)
+         *
+         *  Description:
+         *      Total in-band power seen by radio `rx' right now, used for
+         *      the RPD (carrier detect) register.
+         */
+        double powerAtDbm(uint32_t rx) const;
+
+        const medium_stats_t & stats() const;
+        uint32_t radios() const;
+
+        static double sensitivityDbm(uint32_t rateBps);
+        static double bandwidthMHz(uint32_t rateBps);
+        static double channelOverlap(uint8_t txCh, uint32_t txRate, uint8_t rxCh, uint32_t rxRate);
+
+    private:
+        Kernel & kernel_;
+        medium_config_t config_;
+        medium_stats_t stats_;
+
+        std::vector<Nrf24Chip *> chips_;
+        std::vector<double> x_;
+        std::vector<double> y_;
+        /* id of the transmission each radio is locked onto, 0 for none */
+        std::vector<uint64_t> lockedOn_;
+        mutable std::unordered_map<uint64_t, double> lossCache_;
+        std::unordered_map<uint32_t, replay_link_t> replays_;
+        std::unordered_map<uint64_t, fade_state_t> fades_;
+        std::mt19937_64 rng_;
+
+        /* transmissions still on the air or recent enough to overlap one that is */
+        std::deque<transmission_t> air_;
+        uint64_t nextId_;
+
+        const transmission_t * find(uint64_t id) const;
+        void addressDone(uint64_t id);
+        void resolve(uint64_t id);
+        void prune();
+        bool faded(uint32_t a, uint32_t b, uint8_t channel);
+    };
+}; // rfsim
+#endif /* _RF_MEDIUM_H_ */
@@ -0,0 +1,111 @@
+/*
+ *  One simulated Feather: the pins, SPI bus and Serial port that the
+ *  Arduino stand-ins act on while this board's firmware is running.
+ *
+ *  Radios are wired to the board by their CE and CSN pins, so firmware
+ *  constructing nRF24Module::nRF24(CE, CSN) ends up talking to the
+ *  matching Nrf24Chip. Several radios can share the SPI bus.
+ *
+ *  Firmware spinning on STATUS (the driver's writeSPI() waiting for
+ *  TX_DS or MAX_RT) reads it once every few microseconds, each read a
+ *  context switch as soon as other nodes have events that close. Once a
+ *  lone NOP follows a lone NOP with nothing in between and reads the
+ *  same STATUS from a busy chip, the firmware is parked until the chip's
+ *  next event instead, and resumes at the first read it would have made
+ *  after it, so the spinning costs the same virtual time.
+ */
+
+#pragma once
+
+#ifndef _SIM_BOARD_H_
+#define _SIM_BOARD_H_
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "sim_kernel.h"
+#include "nrf24_chip.h"
+
+/* cost of the esp32 Arduino core calls, in virtual nanoseconds */
+#define DIGITAL_WRITE_NS        150
+#define MICROS_CALL_NS          50
+#define SPI_BYTE_OVERHEAD_NS    500
+#define SPI_TRANSACTION_NS      1000
+#define SERIAL_CALL_NS          200
+
+/* stands in for the SPI clock until the firmware starts a transaction */
+#define DEFAULT_SPI_CLOCK_HZ 1000000
+
+namespace rfsim {
+
+    typedef struct
+    {
+        Nrf24Chip * chip;
+        uint8_t cePin;
+        uint8_t csnPin;
+    } radio_wiring_t;
+
+    class SimBoard
+    {
+    public:
+        SimBoard(Kernel & kernel);
+
+        /*
+         *  attachRadio
+         *
+         *  args:
+         *      chip    (Nrf24Chip *)
+         *      cePin   (uint8_t)
+         *      csnPin  (uint8_t)
+         *
+         *  Description:
+         *      Wires `chip' to the board's SPI bus and the given pins.
+         */
+        void attachRadio(Nrf24Chip * chip, uint8_t cePin, uint8_t csnPin);
+
+        /* -----called by the Arduino stand-ins----- */
+        void pinWrite(uint8_t pin, uint8_t level);
+        uint8_t pinRead(uint8_t pin) const;
+        void spiClock(uint32_t hz);
+        uint8_t spiTransfer(uint8_t out);
+
+        int serialAvailable() const;
+        int serialRead();
+        int serialPeek() const;
+        void serialWrite(const char * data, size_t size);
+
+        /* -----host side of the Serial port----- */
+        void hostWrite(const uint8_t * data, size_t size);
+        std::string & hostOutput();
+
+        Kernel & kernel();
+
+    private:
+        Kernel & kernel_;
+        std::vector<radio_wiring_t> radios_;
+        uint8_t pins_[64];
+        uint32_t spiClockHz_;
+
+        /* spotting a STATUS spin, see above */
+        sim_time_t selectedAt_;
+        sim_time_t deselectedAt_;
+        uint32_t transactionBytes_;
+        bool transactionNop_;
+        bool lastWasPoll_;
+        sim_time_t pollAt_;
+        uint8_t pollStatus_;
+        /* the spinning firmware, its last read before parking and the reads' period */
+        process_t * parked_;
+        sim_time_t parkedAt_;
+        sim_time_t pollPeriod_;
+
+        void awaitStatus(Nrf24Chip * chip);
+        void chipChanged();
+
+        std::deque<uint8_t> serialIn_;
+        std::string serialOut_;
+    };
+}; // rfsim
+#endif /* _SIM_BOARD_H_ */
@@ -0,0 +1,239 @@
+/*
+ *  Discrete-event kernel for the rfsling network simulator.
+ *
+ *  Time is virtual and measured in nanoseconds. Two kinds of things
+ *  happen on the timeline:
+ *
+ *      events    - short callbacks (a packet leaving the air, a chip
+ *                  finishing its PLL settling, ...)
+ *
+ *      processes - one per node, running the node's firmware as a
+ *                  coroutine. Firmware is ordinary blocking Arduino code;
+ *                  every Arduino/SPI call advances the process' local
+ *                  clock, and the process is suspended whenever its clock
+ *                  runs past the next pending event. A node therefore
+ *                  never observes radio state that other nodes have not
+ *                  finished producing, while nodes that have nothing to
+ *                  wait for run ahead without a context switch.
+ *
+ *  Firmware only ever interacts with other nodes through the radio
+ *  model, whose events are never skipped over. A process may however run
+ *  up to a lookahead ahead of other processes: anything another node
+ *  starts can only be delivered after at least one packet airtime, so
+ *  with the lookahead set to the shortest packet airtime deliveries stay
+ *  exact, and only carrier sense/preamble lock decisions can be off by
+ *  at most the lookahead. A lookahead of 0 gives strict ordering.
+ *
+ *  Coroutines use ucontext, so everything runs on one host thread and a
+ *  run is fully deterministic for a given seed.
+ */
+
+#pragma once
+
+#ifndef _SIM_KERNEL_H_
+#define _SIM_KERNEL_H_
+
+#include <stdint.h>
+#include <ucontext.h>
+#include <functional>
+#include <queue>
+#include <vector>
+#include <memory>
+
+namespace rfsim {
+
+    /* virtual time in nanoseconds */
+    typedef uint64_t sim_time_t;
+
+    #define NS_PER_US 1000ull
+    #define NS_PER_MS 1000000ull
+    #define NS_PER_S  1000000000ull
+
+    /* stack given to each firmware coroutine */
+    #define PROCESS_STACK_BYTES (128 * 1024)
+
+    class SimBoard;
+
+    typedef struct
+    {
+        sim_time_t time;
+        /* insertion order, keeps same-time events FIFO and runs deterministic */
+        uint64_t seq;
+        /* resumes a process rather than acting on the radio model */
+        bool resume;
+        std::function<void()> action;
+    } event_t;
+
+    struct EventLater
+    {
+        bool operator()(const event_t & a, const event_t & b) const
+        {
+            return a.time != b.time ? a.time > b.time : a.seq > b.seq;
+        }
+    };
+
+    typedef struct
+    {
+        ucontext_t ctx;
+        std::vector<char> stack;
+        std::function<void()> body;
+        /* board whose pins/SPI/Serial the firmware drives */
+        SimBoard * board;
+        /* how far this process has run on the virtual timeline */
+        sim_time_t local;
+        bool finished;
+        /* suspended with no resume pending until someone calls wake() */
+        bool parked;
+    } process_t;
+
+    class Kernel
+    {
+    public:
+        Kernel();
+        ~Kernel();
+
+        /*
+         *  active
+         *
+         *  Description:
+         *      Returns the kernel that is currently running. The Arduino
+         *      stand-ins use this to find the node they are acting for.
+         */
+        static Kernel * active();
+
+        /*
+         *  schedule
+         *
+         *  args:
+         *      at      (sim_time_t)
+         *      action  (std::function<void()>)
+         *
+         *  Description:
+         *      Runs `action' once the timeline reaches `at'. Times in the
+         *      past are clamped to now.
+         */
+        void schedule(sim_time_t at, std::function<void()> action);
+
+        /*
+         *  spawn
+         *
+         *  args:
+         *      board   (SimBoard *)
+         *      body    (std::function<void()>)
+         *      start   (sim_time_t)
+         *
+         *  Description:
+         *      Creates a firmware coroutine bound to `board' that starts
+         *      running `body' at time `start'.
+         */
+        void spawn(SimBoard * board, std::function<void()> body, sim_time_t start);
+
+        /*
+         *  run
+         *
+         *  args:
+         *      until (sim_time_t)
+         *
+         *  Description:
+         *      Processes events and processes in time order until the
+         *      timeline reaches `until' or there is nothing left to do.
+         */
+        void run(sim_time_t until);
+
+        /*
+         *  now
+         *
+         *  Description:
+         *      The current virtual time. Inside a firmware coroutine this
+         *      is the coroutine's local clock.
+         */
+        sim_time_t now() const;
+
+        /*
+         *  advance
+         *
+         *  args:
+         *      dt (sim_time_t)
+         *
+         *  Description:
+         *      Charges `dt' of virtual time to the running coroutine and
+         *      suspends it if that carries it past the next pending event.
+         *      Called outside a coroutine it does nothing.
+         */
+        void advance(sim_time_t dt);
+
+        /*
+         *  park
+         *
+         *  Description:
+         *      Suspends the running coroutine with no resume scheduled, for
+         *      firmware spinning on state only an event can change: instead
+         *      of a context switch every spin it waits for wake().
+         */
+        void park();
+
+        /*
+         *  wake
+         *
+         *  args:
+         *      p   (process_t *)
+         *      at  (sim_time_t)
+         *
+         *  Description:
+         *      Resumes parked coroutine `p' at `at', no earlier than now,
+         *      its clock moved on to it as though it had spun until then.
+         *      Does nothing unless `p' is parked.
+         */
+        void wake(process_t * p, sim_time_t at);
+
+        /*
+         *  current
+         *
+         *  Description:
+         *      The running coroutine, or nullptr while an event runs.
+         */
+        process_t * current() const;
+
+        /*
+         *  setLookahead
+         *
+         *  args:
+         *      lookahead (sim_time_t)
+         *
+         *  Description:
+         *      How far a process may run past other processes' pending
+         *      resumes, see above. Should not exceed the shortest airtime
+         *      of anything that can be transmitted.
+         */
+        void setLookahead(sim_time_t lookahead);
+
+        uint64_t eventsProcessed() const;
+        uint64_t contextSwitches() const;
+
+    private:
+        static Kernel * active_;
+        static void trampoline();
+
+        void push(sim_time_t at, bool resume, std::function<void()> action);
+        sim_time_t horizon() const;
+        void resume(process_t * p);
+        void yield();
+
+        typedef std::priority_queue<sim_time_t, std::vector<sim_time_t>, std::greater<sim_time_t>> time_heap_t;
+
+        std::priority_queue<event_t, std::vector<event_t>, EventLater> queue_;
+        /* pending times split by kind, to find the horizon of a process */
+        time_heap_t hardware_;
+        time_heap_t resumes_;
+        sim_time_t lookahead_;
+        sim_time_t until_;
+        std::vector<std::unique_ptr<process_t>> processes_;
+        ucontext_t mainCtx_;
+        process_t * current_;
+        sim_time_t now_;
+        uint64_t seq_;
+        uint64_t events_;
+        uint64_t switches_;
+    };
+}; // rfsim
+#endif /* _SIM_KERNEL_H_ */
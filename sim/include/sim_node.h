@@ -0,0 +1,335 @@
+/*
+ *  A simulated rfsling node: one board, one nRF24L01+ and a firmware
+ *  image that drives the radio through the in-house nRF24Module driver.
+ *
+ *  Nodes are sources, sinks or relays. Sources stamp every payload with
+ *  their flow id, a sequence number and the send time, so sinks can
+ *  account deliveries and latency per flow end to end, across relays.
+ *  In a pull the sink drives instead: it fetches one file from several
+ *  sources holding copies of it, running the mains' PullClient and
+ *  PullServer (pull_protocol.h). Routers of a mesh relay toward its sink
+ *  along the cheapest path they know of (route.h). Message sources
+ *  stamp every message with its send time instead and pack them into
+ *  payloads through the TX main's Aggregator (aggregator.h).
+ */
+
+#pragma once
+
+#ifndef _SIM_NODE_H_
+#define _SIM_NODE_H_
+
+#include <Arduino.h>
+#include <stdint.h>
+#include <random>
+#include <vector>
+
+#include "nRF24L01.h"
+#include "harq.h"
+#include "route.h"
+#include "diversity.h"
+#include "aggregator.h"
+#include "latency_histogram.h"
+#include "sim_kernel.h"
+#include "sim_board.h"
+#include "nrf24_chip.h"
+#include "rf_medium.h"
+
+/* same wiring and address width as the TX/RX mains */
+#define SIM_CE_PIN          26
+#define SIM_CSN_PIN         25
+/* the RX main's second radio with DIVERSITY */
+#define SIM_CE2_PIN         27
+#define SIM_CSN2_PIN        33
+#define SIM_ADDRESS_BYTES   4
+
+/* the RPD needs 170 us in RX mode before it is valid */
+#define RPD_SETTLE_US 170
+#define CSMA_MAX_ATTEMPTS 6
+
+/* serial link of the mains: BAUD_RATE, and a USB round trip per handshake */
+#define SERIAL_BAUD 115200
+#define SERIAL_TURNAROUND_US 1000
+
+/* payload header written by sources: flow, sequence, send time */
+#define HDR_FLOW_OFFSET 0
+#define HDR_SEQ_OFFSET  2
+#define HDR_TIME_OFFSET 6
+#define HDR_BYTES       10
+
+/* message sources stamp the send time first, and cycle through this many flows of the aggregator */
+#define MSG_TIME_OFFSET 0
+#define MSG_MIN_BYTES   4
+#define SIM_MESSAGE_FLOWS 4
+/* the RX buffer of the TX main's UART, messages arriving with it full are lost */
+#define SERIAL_RX_BUFFER 256
+
+namespace rfsim {
+
+    typedef enum
+    {
+        ROLE_SOURCE,
+        ROLE_SINK,
+        ROLE_RELAY,
+        /* a source running the TX main's radio backend benchmark */
+        ROLE_BENCH,
+        /* a TX main timing the firmware's kernels (micro_bench.h) */
+        ROLE_MICRO_BENCH,
+        /* a TX main serving a file to pulls, flow is its source number */
+        ROLE_PULL_SOURCE,
+        /* an RX main pulling a file from every ROLE_PULL_SOURCE */
+        ROLE_PULL_SINK,
+        /* a source and a sink running the mains' hybrid ARQ transfer (harq.h) */
+        ROLE_HARQ_SOURCE,
+        ROLE_HARQ_SINK,
+        /* a node of a routed mesh (route.h): its sink, a source or a relay */
+        ROLE_ROUTER,
+        /* a source and a sink of the mains' DIVERSITY, the sink with a second radio (diversity.h) */
+        ROLE_DIVERSITY_SOURCE,
+        ROLE_DIVERSITY_SINK,
+        /* a source and a sink of the mains' AGGREGATE, small messages from the source's computer */
+        ROLE_AGGREGATE_SOURCE,
+        ROLE_AGGREGATE_SINK,
+    } node_role_e;
+
+    typedef enum
+    {
+        /* send as soon as traffic is due */
+        MAC_ALOHA,
+        /* listen before talk using the RPD, binary exponential backoff */
+        MAC_CSMA,
+        /* only send inside the node's slot of a fixed frame */
+        MAC_TDMA,
+    } mac_policy_e;
+
+    typedef struct
+    {
+        node_role_e role;
+        double x;
+        double y;
+        /* flow originated by a source */
+        uint16_t flow;
+        /* where sinks and relays listen */
+        uint8_t rxChannel;
+        uint32_t rxAddress;
+        /* where sources and relays send */
+        uint8_t txChannel;
+        uint32_t txAddress;
+        nRF24Module::data_rate rate;
+        mac_policy_e mac;
+        /* mean gap between payloads of a source, 0 for saturated */
+        uint32_t intervalUs;
+        uint32_t csmaBackoffUs;
+        uint32_t tdmaSlot;
+        uint32_t tdmaSlots;
+        uint32_t tdmaSlotUs;
+        /* latest point in the slot at which a payload may still start */
+        uint32_t tdmaGuardUs;
+        /* ask for ACKs and retransmit, as the mains do through RF24 */
+        bool autoAck;
+        /* queue payloads with CE held high, as the TX main's CONTINUOUS_TX */
+        bool continuousTx;
+        /*
+         *  meet on the discovery channel first, as the mains' RENDEZVOUS:
+         *  sinks wait there for their link, sources invite them onto theirs
+         */
+        bool rendezvous;
+        uint8_t retryDelay;
+        uint8_t retryCount;
+        nRF24Module::pa_level paLevel;
+        /*
+         *  File bytes a source gets per serial chunk, 0 for a plain
+         *  stream. With chunks a source sends like the TX main: a fixed
+         *  intervalUs after every payload and a serial handshake plus
+         *  chunk transfer between chunks.
+         */
+        uint32_t chunkBytes;
+        /* the TX main's token bucket (token_bucket.h), bytes per second, 0 for none */
+        uint32_t shapeRate;
+        uint32_t shapeBurst;
+        /* payloads a ROLE_BENCH node sends */
+        uint32_t benchPayloads;
+        /* calls per kernel of a ROLE_MICRO_BENCH node */
+        uint32_t microCalls;
+        /* size of the file a pull fetches, and the sources' addresses */
+        uint32_t pullBytes;
+        std::vector<uint32_t> pullSources;
+        /* scheme of the HARQ roles, the data blocks per group and the parity per group of HARQ_FEC */
+        harq_mode_e harqMode;
+        uint8_t harqParity;
+        uint8_t harqWindow;
+        /* a ROLE_ROUTER is the mesh's sink, or originates its flow; txAddress is the mesh's */
+        bool routeSink;
+        bool routeSource;
+        /* channel of the second radio of the DIVERSITY roles, the link's own for one copy */
+        uint8_t pairedChannel;
+        /*
+         *  size of the messages of the AGGREGATE roles, intervalUs apart on
+         *  average but no closer than the serial link brings them, and the
+         *  deadline of every flow of the aggregator
+         */
+        uint32_t messageBytes;
+        uint32_t messageDeadlineUs;
+        /* how often an idle receiver polls STATUS for a payload */
+        uint32_t pollUs;
+        sim_time_t startAt;
+    } node_config_t;
+
+    typedef struct
+    {
+        uint32_t src;
+        uint32_t dst;
+        uint8_t channel;
+        uint64_t sent;
+        uint64_t delivered;
+        uint64_t bytes;
+        uint64_t latencySumUs;
+        uint64_t latencyMaxUs;
+        /* the RX main's histogram of the same delays (LATENCY_STAMP) */
+        LatencyHistogram latency {};
+    } flow_stats_t;
+
+    /* where a ROLE_ROUTER routes, and what it made of the traffic */
+    typedef struct
+    {
+        uint8_t parent;
+        uint16_t cost;
+        uint32_t dropped;
+        uint32_t duplicates;
+        uint32_t parentChanges;
+    } route_stats_t;
+
+    /* what a ROLE_DIVERSITY_SINK made of the copies, as the RX main reports it */
+    typedef struct
+    {
+        uint32_t first[DIVERSITY_RADIOS];
+        uint32_t duplicates;
+        uint32_t missed;
+    } diversity_stats_t;
+
+    /* what a ROLE_AGGREGATE_SOURCE's aggregator sent: payloads, the messages in them */
+    typedef struct
+    {
+        uint32_t payloads;
+        uint32_t messages;
+    } aggregate_stats_t;
+
+    class SimNode
+    {
+    public:
+        SimNode(Kernel & kernel, RfMedium & medium, uint32_t id, const node_config_t & config,
+                std::vector<flow_stats_t> & flows, uint64_t seed);
+
+        /*
+         *  start
+         *
+         *  Description:
+         *      Boots the node's firmware at config.startAt.
+         */
+        void start();
+
+        uint32_t id() const;
+        const node_config_t & config() const;
+        Nrf24Chip & chip();
+        /* the second radio of a ROLE_DIVERSITY_SINK, on the medium only then */
+        Nrf24Chip & secondChip();
+        SimBoard & board();
+        uint64_t forwarded() const;
+
+        /* virtual time a ROLE_PULL_SINK had the whole file, 0 before */
+        sim_time_t pullDoneAt() const;
+
+        /*
+         *  virtual time a rendezvous node had its radio up on the discovery
+         *  channel, and a sink was welcomed onto its source's link, 0 before
+         */
+        sim_time_t rendezvousAt() const;
+        sim_time_t pairedAt() const;
+
+        /* the link a rendezvous sink was welcomed onto, any source's */
+        uint32_t pairedAddress() const;
+
+        const route_stats_t & routeStats() const;
+        const diversity_stats_t & diversityStats() const;
+
+        const aggregate_stats_t & aggregateStats() const;
+
+    private:
+        Kernel & kernel_;
+        uint32_t id_;
+        node_config_t config_;
+        std::vector<flow_stats_t> & flows_;
+        std::mt19937 rng_;
+
+        SimBoard board_;
+        Nrf24Chip chip_;
+        Nrf24Chip second_;
+        uint64_t forwarded_;
+        sim_time_t pullDoneAt_;
+        sim_time_t rendezvousAt_;
+        sim_time_t pairedAt_;
+        uint32_t pairedAddress_;
+        /* batch of blocks a pull source last fetched from its computer */
+        uint32_t pullBatch_;
+        /* blocks a ROLE_HARQ_SINK has had, in order */
+        uint64_t harqBlocks_;
+        route_stats_t routeStats_;
+        diversity_stats_t diversityStats_;
+        aggregate_stats_t aggregateStats_;
+
+        void sourceFirmware();
+        void sinkFirmware();
+        void relayFirmware();
+        void benchFirmware();
+        void microBenchFirmware();
+        void pullSourceFirmware();
+        void pullSinkFirmware();
+        void harqSourceFirmware();
+        void harqSinkFirmware();
+        void routerFirmware();
+        void diversitySourceFirmware();
+        void diversitySinkFirmware();
+        void aggregateSourceFirmware();
+        void aggregateSinkFirmware();
+
+        /*
+         *  inviteSink / joinSource
+         *
+         *  args:
+         *      channel (uint8_t / uint8_t &) the link, set by joinSource
+         *      address (uint8_t *) SIM_ADDRESS_BYTES, set by joinSource
+         *
+         *  Description:
+         *      The rendezvous of the mains (rendezvous.h): a source invites
+         *      until a sink joins its link, a sink listens on the discovery
+         *      channel until it has joined one.
+         */
+        void inviteSink(uint8_t channel, uint8_t * address);
+        void joinSource(uint8_t & channel, uint8_t * address);
+
+        static bool pullRead(void * ctx, uint32_t block, char * data);
+        static void harqDeliver(void * ctx, const char * data, uint8_t size);
+        static void routeDeliver(void * ctx, uint8_t origin, const char * data);
+        static void messageDeliver(void * ctx, uint8_t flow, const char * message, uint8_t size);
+
+        /*
+         *  waitForTurn
+         *
+         *  args:
+         *      radio (nRF24Module::nRF24 &)
+         *
+         *  Description:
+         *      Blocks until the MAC policy allows the next payload out.
+         *      Leaves the radio configured as a transmitter.
+         */
+        void waitForTurn(nRF24Module::nRF24 & radio);
+
+        void listen(nRF24Module::nRF24 & radio, uint8_t channel, uint8_t * address);
+        bool payloadReady(nRF24Module::nRF24 & radio);
+        /* accounts a payload that reached a sink, `bytes' of it the flow's */
+        void deliver(const uint8_t * payload, uint32_t bytes);
+    };
+
+    /* little endian, same layout SerialIO uses for the configured address */
+    void addressBytes(uint32_t address, uint8_t * out);
+}; // rfsim
+#endif /* _SIM_NODE_H_ */
@@ -0,0 +1,194 @@
+/*
+ *  Builds a site out of SimNodes, runs it and reports the results.
+ *
+ *  Topologies:
+ *      pairs   - nodes/2 independent TX/RX pairs scattered over the site,
+ *                the layout of many operators sharing one room
+ *      star    - every source sends to one sink per channel at the centre,
+ *                a collection point
+ *      chain   - one source, nodes-2 relays and one sink in a line, each
+ *                hop on the next channel of the plan
+ *      pull    - one sink pulling a file from nodes-1 sources around it,
+ *                all on the first channel of the plan
+ *      mesh    - routers on a square grid --distance apart, all on the
+ *                first channel: the sink in one corner, sources along the
+ *                far side, relays between, routing by ETX (route.h)
+ *
+ *  With harq the pairs run the mains' hybrid ARQ transfer (harq.h)
+ *  instead of streaming. With rendezvous the pairs meet on the discovery
+ *  channel first (rendezvous.h), booting in any order. With diversity
+ *  the pairs run the mains' DIVERSITY (diversity.h): every sink has a
+ *  second radio with the same path loss, fading apart from the first.
+ *  With messages the pairs run the mains' AGGREGATE (aggregator.h),
+ *  packing small messages into shared payloads. A
+ *  fade takes the busiest relay of a mesh out from under its routes
+ *  partway through.
+ *
+ *  Links are spread over the channel plan round robin. With TDMA the
+ *  links sharing a channel split a frame into equal slots.
+ */
+
+#pragma once
+
+#ifndef _SIM_SCENARIO_H_
+#define _SIM_SCENARIO_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <memory>
+#include <vector>
+
+#include "sim_kernel.h"
+#include "rf_medium.h"
+#include "sim_node.h"
+#include "trace_replay.h"
+
+namespace rfsim {
+
+    typedef enum
+    {
+        TOPOLOGY_PAIRS,
+        TOPOLOGY_STAR,
+        TOPOLOGY_CHAIN,
+        TOPOLOGY_PULL,
+        TOPOLOGY_MESH,
+    } topology_e;
+
+    typedef enum
+    {
+        DIVERSITY_OFF,
+        /* both radios of a sink on the link's channel, one copy of every payload */
+        DIVERSITY_SAME,
+        /* the second on diversityChannel(), a copy on each */
+        DIVERSITY_PAIRED,
+    } diversity_e;
+
+    typedef struct
+    {
+        topology_e topology;
+        uint32_t nodes;
+        /* side of the square site in meters */
+        double areaM;
+        /* TX to RX distance of a pair, hop length of a chain */
+        double linkDistanceM;
+        std::vector<uint8_t> channels;
+        nRF24Module::data_rate rate;
+        mac_policy_e mac;
+        uint32_t intervalUs;
+        uint32_t csmaBackoffUs;
+        /* 0 picks a slot that fits one payload */
+        uint32_t tdmaSlotUs;
+        bool autoAck;
+        /* sources keep CE high and the TX FIFO fed (nRF24::writeFastSPI) */
+        bool continuousTx;
+        /* pairs set up their link over the air, sinks boot before or after their source */
+        bool rendezvous;
+        uint8_t retryDelay;
+        uint8_t retryCount;
+        nRF24Module::pa_level paLevel;
+        /* 0 streams, otherwise sources send files like the TX main */
+        uint32_t chunkBytes;
+        /* TX main airtime cap, bytes per second (0 for none) and burst bytes */
+        uint32_t shapeRate;
+        uint32_t shapeBurst;
+        /* sources run the radio backend benchmark with this many payloads instead */
+        uint32_t benchPayloads;
+        /* the first source times the firmware's kernels this many calls each instead */
+        uint32_t microCalls;
+        /* size of the file of a pull */
+        uint32_t pullBytes;
+        /* pairs run the hybrid ARQ transfer in harqMode, in groups of harqWindow blocks, harqParity per group for HARQ_FEC */
+        bool harq;
+        harq_mode_e harqMode;
+        uint8_t harqParity;
+        uint8_t harqWindow;
+        /* at fadeAt seconds (0 for never) every link of the busiest relay of a mesh loses fadeDb more */
+        double fadeAt;
+        double fadeDb;
+        /* pairs run the mains' DIVERSITY */
+        diversity_e diversity;
+        /* pairs run the mains' AGGREGATE with messages this big (0 for off), each flow with the deadline */
+        uint32_t messageBytes;
+        uint32_t messageDeadlineUs;
+        double seconds;
+        uint64_t seed;
+        medium_config_t medium;
+        /* field trace replayed on the first hop of every flow, nullptr for none */
+        const TraceReplay * replay;
+    } scenario_config_t;
+
+    scenario_config_t defaultScenarioConfig();
+
+    class Scenario
+    {
+    public:
+        Scenario(const scenario_config_t & config);
+
+        /*
+         *  run
+         *
+         *  Description:
+         *      Boots every node and runs the site for config.seconds of
+         *      virtual time. Returns the wall clock time it took.
+         */
+        double run();
+
+        /*
+         *  report
+         *
+         *  args:
+         *      out     (FILE *)
+         *      perFlow (bool) also list every flow
+         *      csv     (bool) machine readable output
+         *
+         *  Description:
+         *      Prints delivery, goodput and latency per flow and in total,
+         *      plus what happened on the medium.
+         */
+        void report(FILE * out, bool perFlow, bool csv);
+
+        /*
+         *  writeLatency
+         *
+         *  args:
+         *      path    (const char *)
+         *
+         *  Description:
+         *      Writes the latency histogram of every flow together as
+         *      csv, "top_us,count" per bucket, the same file
+         *      receive_hex.py saves from an RX main built with
+         *      LATENCY_STAMP. Returns false if it could not be written.
+         */
+        bool writeLatency(const char * path);
+
+    private:
+        scenario_config_t config_;
+        Kernel kernel_;
+        RfMedium medium_;
+        std::vector<std::unique_ptr<SimNode>> nodes_;
+        std::vector<flow_stats_t> flows_;
+        double wallSeconds_;
+
+        /* the relay a fade hit, and the flows' totals when it did and a second later */
+        uint32_t fadedNode_;
+        uint64_t fadedForwarded_;
+        std::vector<flow_stats_t> atFade_;
+        std::vector<flow_stats_t> afterFade_;
+
+        void buildPairs(std::mt19937 & rng, node_config_t base);
+        void buildStar(std::mt19937 & rng, node_config_t base);
+        void buildChain(std::mt19937 & rng, node_config_t base);
+        void buildPull(std::mt19937 & rng, node_config_t base);
+        void buildMesh(std::mt19937 & rng, node_config_t base);
+        void fade();
+        void reportMesh(FILE * out, bool perFlow);
+        uint32_t addNode(const node_config_t & config);
+        uint32_t airtimeUs() const;
+        uint32_t slotUs() const;
+    };
+
+    const char * rateName(nRF24Module::data_rate rate);
+    const char * macName(mac_policy_e mac);
+    const char * topologyName(topology_e topology);
+}; // rfsim
+#endif /* _SIM_SCENARIO_H_ */
@@ -0,0 +1,69 @@
+/*
+ *  Replays link traces recorded in the field (LINK_TRACE in the mains)
+ *  instead of deriving loss from the radio model.
+ *
+ *  A TX record says how a payload went: acknowledged after ARC
+ *  retransmits, or given up on (MAX_RT) after ARC + 1 attempts. The trace
+ *  is unrolled into the sequence of attempts that were lost or got
+ *  through, and every transmission a replayed link puts on the air takes
+ *  the next outcome of that sequence, wrapping around at the end. The
+ *  real loss pattern, bursts included, is therefore applied to whatever
+ *  protocol the simulated firmware runs.
+ *
+ *  RX records carry no loss information and are skipped.
+ */
+
+#pragma once
+
+#ifndef _TRACE_REPLAY_H_
+#define _TRACE_REPLAY_H_
+
+#include <stdint.h>
+#include <vector>
+
+/* outcome byte of a trace record, as written by LinkTrace */
+#define TRACE_ARC_MASK 0x0F
+#define TRACE_TX_DS    (1 << 4)
+#define TRACE_MAX_RT   (1 << 5)
+#define TRACE_RX       (1 << 6)
+
+namespace rfsim {
+
+    class TraceReplay
+    {
+    public:
+        TraceReplay();
+
+        /*
+         *  load
+         *
+         *  args:
+         *      path (const char *) csv saved by saveTrace()
+         *
+         *  Description:
+         *      Reads "time_us,seq,channel,outcome" lines. Returns false if
+         *      the file cannot be read or holds no TX records.
+         */
+        bool load(const char * path);
+
+        /*
+         *  attemptLost
+         *
+         *  args:
+         *      n (uint64_t)
+         *
+         *  Description:
+         *      Whether the n-th attempt of the trace was lost.
+         */
+        bool attemptLost(uint64_t n) const;
+
+        uint64_t attempts() const;
+        uint64_t payloads() const;
+        double attemptLossRate() const;
+
+    private:
+        std::vector<bool> lost_;
+        uint64_t payloads_;
+    };
+}; // rfsim
+#endif /* _TRACE_REPLAY_H_ */
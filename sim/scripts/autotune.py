@@ -0,0 +1,247 @@
+#!/bin/python3
+"""
+Searches the link settings of a site in the simulator and writes the best
+profile for the boards and computers to load.
+
+The site is either described (link distance, path loss, other links
+sharing the room) or given as a field trace recorded with LINK_TRACE, in
+which case the trace's loss pattern is replayed and the data rate and PA
+level it was recorded at are kept.
+
+Besides the radio and serial settings it tries the hybrid ARQ transfer
+(HARQ_MODE) in each of its schemes, group sizes and, with fixed parity,
+parity per group.
+
+The search is coordinate descent starting from the current profile: each
+knob in turn is swept with the others fixed and the best value kept,
+until a full round changes nothing. Every point is averaged over a few
+seeds of virtual time, so a search takes seconds.
+
+Usage:
+    autotune.py [--trace FILE] [--distance M] [--links N] ...
+                [--objective goodput|latency] [--write]
+
+Without --write the profile is only printed.
+"""
+
+import argparse
+import csv
+import io
+import os
+import subprocess
+import sys
+
+REPO = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+
+# where the simulator ends up with `pio run', or build it by hand
+RFSIM_PATHS = [
+    os.path.join(REPO, "sim", ".pio", "build", "native", "program"),
+    os.path.join(REPO, "sim", "rfsim"),
+]
+
+# knob: (rfsim option, candidate values)
+SEARCH_SPACE = {
+    "chunk": ("--chunk-bytes", [32, 64, 96, 128, 160, 192, 224]),
+    "rate": ("--rate", ["250k", "1m", "2m"]),
+    "pa": ("--pa", ["min", "low", "high", "max"]),
+    "retry_delay": ("--retry-delay", list(range(16))),
+    "retry_count": ("--retries", list(range(16))),
+    "link_rate": ("--shape-rate", [1600, 3200, 6400, 12800, 25600, 0]),
+    # files by hybrid ARQ (HARQ_MODE) instead of ACKs, and its group and parity
+    "harq": ("--harq", ["off", "hybrid", "arq", "fec"]),
+    "harq_window": ("--harq-window", [4, 8, 12, 16]),
+    "harq_parity": ("--harq-parity", [1, 2, 4, 6, 8]),
+}
+
+# what the mains shipped with, see include/link_profile.h
+DEFAULT_PROFILE = {
+    "chunk": 224,
+    "rate": "250k",
+    "pa": "high",
+    "retry_delay": 15,
+    "retry_count": 15,
+    "link_rate": 3200,
+    "harq": "off",
+    "harq_window": 16,
+    "harq_parity": 4,
+}
+
+RADIO_RATES = {"250k": "RADIO_250KBPS", "1m": "RADIO_1MBPS", "2m": "RADIO_2MBPS"}
+RADIO_PA_LEVELS = {"min": "RADIO_PA_MIN", "low": "RADIO_PA_LOW", "high": "RADIO_PA_HIGH", "max": "RADIO_PA_MAX"}
+HARQ_SCHEMES = {"hybrid": "HARQ_HYBRID", "arq": "HARQ_ARQ", "fec": "HARQ_FEC"}
+
+# knobs that only matter with the hybrid ARQ transfer, and with fixed parity
+HARQ_KNOBS = {"harq_window": ("hybrid", "arq", "fec"), "harq_parity": ("fec",)}
+
+# rounds of coordinate descent before giving up on converging
+MAX_ROUNDS = 4
+
+
+def findRfsim(path):
+    """
+    Returns the simulator binary to run, exits when there is none.
+    """
+    for p in [path] if path else RFSIM_PATHS:
+        if p and os.access(p, os.X_OK):
+            return p
+    sys.exit("rfsim not found, build it in sim/ (see sim/README.md) or pass --rfsim")
+
+
+def simulate(args, profile, seed):
+    """
+    Runs one configuration and returns the total row of the csv report.
+    """
+    cmd = [
+        args.rfsim, "--csv", "--ack", "--interval-us", "0",
+        "--nodes", str(2 * args.links),
+        "--area", str(args.area),
+        "--distance", str(args.distance),
+        "--channels", args.channels,
+        "--path-loss-exp", str(args.path_loss_exp),
+        "--shadowing", str(args.shadowing),
+        "--seconds", str(args.seconds),
+        "--seed", str(seed),
+    ]
+    if args.trace:
+        cmd += ["--replay", args.trace]
+
+    for knob, (option, _) in SEARCH_SPACE.items():
+        if knob == "harq" and profile[knob] == "off":
+            continue
+        if knob in HARQ_KNOBS and profile["harq"] not in HARQ_KNOBS[knob]:
+            continue
+        cmd += [option, str(profile[knob])]
+
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    for row in csv.DictReader(io.StringIO(out)):
+        if row["flow"] == "total":
+            return row
+    raise RuntimeError("no total row from " + " ".join(cmd))
+
+
+def score(args, profile, cache):
+    """
+    Averages a configuration over the seeds. Higher is better; settings
+    that lose payloads (and so corrupt files) rank below every setting
+    that meets --min-pdr. Returns the rank and (pdr, goodput, latency).
+    """
+    # knobs the transfer does not use give the same runs
+    key = tuple(sorted((k, v) for k, v in profile.items()
+                       if k not in HARQ_KNOBS or profile["harq"] in HARQ_KNOBS[k]))
+    if key in cache:
+        return cache[key]
+
+    pdr = goodput = latency = 0.0
+    for seed in range(1, args.seeds + 1):
+        row = simulate(args, profile, seed)
+        pdr += float(row["pdr"]) / args.seeds
+        goodput += float(row["goodput_bps"]) / args.seeds
+        latency += float(row["avg_latency_us"]) / args.seeds
+
+    if args.objective == "goodput":
+        value = goodput
+    else:
+        value = -latency if goodput > 0 else float("-inf")
+
+    rank = (pdr >= args.min_pdr, pdr if pdr < args.min_pdr else 0.0, value)
+    cache[key] = (rank, (pdr, goodput, latency))
+    return cache[key]
+
+
+def search(args):
+    """
+    Coordinate descent over SEARCH_SPACE from DEFAULT_PROFILE.
+    """
+    profile = dict(DEFAULT_PROFILE)
+    cache = {}
+
+    # a trace is only valid for the rate and power it was recorded at
+    knobs = [k for k in SEARCH_SPACE if not (args.trace and k in ("rate", "pa"))]
+
+    best, report = score(args, profile, cache)
+    for _ in range(MAX_ROUNDS):
+        changed = False
+        for knob in knobs:
+            for value in SEARCH_SPACE[knob][1]:
+                candidate = dict(profile, **{knob: value})
+                rank, candidateReport = score(args, candidate, cache)
+                if rank > best:
+                    best, report, profile, changed = rank, candidateReport, candidate, True
+        if not changed:
+            break
+
+    return profile, report, len(cache)
+
+
+def writeProfile(profile):
+    """
+    Rewrites link_profile.h and link_profile.py of both mains.
+    """
+    for side in ("TX", "RX"):
+        header = os.path.join(REPO, side, "include", "link_profile.h")
+        with open(header) as f:
+            lines = f.readlines()
+
+        values = {
+            "PROFILE_CHUNK_CHARS": str(profile["chunk"]),
+            "PROFILE_DATA_RATE": RADIO_RATES[profile["rate"]],
+            "PROFILE_PA_LEVEL": RADIO_PA_LEVELS[profile["pa"]],
+            "PROFILE_RETRY_DELAY": str(profile["retry_delay"]),
+            "PROFILE_RETRY_COUNT": str(profile["retry_count"]),
+            "PROFILE_LINK_RATE": str(profile["link_rate"]),
+            "PROFILE_HARQ": "0" if profile["harq"] == "off" else "1",
+            "PROFILE_HARQ_SCHEME": HARQ_SCHEMES.get(profile["harq"], "HARQ_HYBRID"),
+            "PROFILE_HARQ_PARITY": str(profile["harq_parity"]),
+            "PROFILE_HARQ_WINDOW": str(profile["harq_window"]),
+        }
+
+        # keep the layout and comments, only swap the values
+        with open(header, "w") as f:
+            for line in lines:
+                parts = line.split()
+                if len(parts) >= 3 and parts[0] == "#define" and parts[1] in values:
+                    old = parts[2]
+                    line = line.replace(" " + old, " " + values[parts[1]].ljust(len(old)), 1)
+                f.write(line)
+
+        script = os.path.join(REPO, side, "scripts", "link_profile.py")
+        with open(script) as f:
+            lines = f.readlines()
+        with open(script, "w") as f:
+            for line in lines:
+                if line.startswith("PROFILE_CHUNK_CHARS"):
+                    line = "PROFILE_CHUNK_CHARS = {0}\n".format(profile["chunk"])
+                elif line.startswith("PROFILE_LINK_RATE"):
+                    line = "PROFILE_LINK_RATE = {0}\n".format(profile["link_rate"])
+                f.write(line)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Search link settings for a site in the simulator.")
+    parser.add_argument("--rfsim", help="simulator binary")
+    parser.add_argument("--trace", help="field trace to replay (logs/tx-trace-*.csv)")
+    parser.add_argument("--distance", type=float, default=5.0, help="TX to RX distance in meters")
+    parser.add_argument("--links", type=int, default=1, help="links sharing the site")
+    parser.add_argument("--area", type=float, default=30.0, help="side of the site in meters")
+    parser.add_argument("--channels", default="76", help="channel plan, RF_CH values")
+    parser.add_argument("--path-loss-exp", type=float, default=3.0)
+    parser.add_argument("--shadowing", type=float, default=4.0)
+    parser.add_argument("--objective", choices=["goodput", "latency"], default="goodput")
+    parser.add_argument("--min-pdr", type=float, default=1.0, help="delivery a profile must reach")
+    parser.add_argument("--seconds", type=float, default=5.0, help="virtual time per run")
+    parser.add_argument("--seeds", type=int, default=3, help="runs averaged per point")
+    parser.add_argument("--write", action="store_true", help="write the profile to TX/ and RX/")
+    args = parser.parse_args()
+
+    args.rfsim = findRfsim(args.rfsim)
+
+    profile, (pdr, goodput, latency), runs = search(args)
+
+    print("best profile after {0} configurations ({1}):".format(runs, args.objective))
+    for knob, value in profile.items():
+        print("  {0:18} {1}".format(knob, value))
+    print("pdr {0:.4f} goodput {1:.0f} bps avg latency {2:.0f} us".format(pdr, goodput, latency))
+
+    if args.write:
+        writeProfile(profile)
+        print("written to TX/ and RX/ include/link_profile.h and scripts/link_profile.py, flash both boards")
@@ -0,0 +1,87 @@
+#!/bin/python3
+"""
+Compares the transfer schemes across a sweep of packet loss in the
+simulator: the mains' ACKed stream, and the hybrid ARQ transfer (harq.h)
+as pure selective repeat, as fixed parity without feedback and as hybrid.
+
+Every point is one saturated link averaged over a few seeds. Goodput only
+counts blocks that arrived intact, so what fixed parity could not repair
+does not count.
+
+Usage:
+    harq_sweep.py [--loss 0,0.05,0.1,0.2,0.3] [--rate 2m] [--parity 4] ...
+"""
+
+import argparse
+import csv
+import io
+import os
+import subprocess
+import sys
+
+REPO = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+
+# where the simulator ends up with `pio run', or build it by hand
+RFSIM_PATHS = [
+    os.path.join(REPO, "sim", ".pio", "build", "native", "program"),
+    os.path.join(REPO, "sim", "rfsim"),
+]
+
+# scheme: rfsim options
+SCHEMES = {
+    "ack": ["--ack", "--retry-delay", "1"],
+    "arq": ["--harq", "arq"],
+    "fec": ["--harq", "fec"],
+    "hybrid": ["--harq", "hybrid"],
+}
+
+
+def findRfsim(path):
+    """
+    Returns the simulator binary to run, exits when there is none.
+    """
+    for p in [path] if path else RFSIM_PATHS:
+        if p and os.access(p, os.X_OK):
+            return p
+    sys.exit("rfsim not found, build it in sim/ (see sim/README.md) or pass --rfsim")
+
+
+def goodput(args, scheme, loss):
+    """
+    Goodput of a scheme at a loss, in bps, averaged over the seeds.
+    """
+    total = 0.0
+    for seed in range(1, args.seeds + 1):
+        cmd = [
+            args.rfsim, "--csv", "--nodes", "2", "--interval-us", "0",
+            "--rate", args.rate,
+            "--harq-parity", str(args.parity),
+            "--loss", str(loss),
+            "--seconds", str(args.seconds),
+            "--seed", str(seed),
+        ] + SCHEMES[scheme]
+
+        out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+        rows = [row for row in csv.DictReader(io.StringIO(out)) if row["flow"] == "total"]
+        if not rows:
+            raise RuntimeError("no total row from " + " ".join(cmd))
+        total += float(rows[0]["goodput_bps"]) / args.seeds
+    return total
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Goodput of ARQ, FEC and hybrid ARQ across packet loss.")
+    parser.add_argument("--rfsim", help="simulator binary")
+    parser.add_argument("--loss", default="0,0.05,0.1,0.2,0.3", help="packet loss to sweep, comma separated")
+    parser.add_argument("--rate", choices=["250k", "1m", "2m"], default="2m")
+    parser.add_argument("--parity", type=int, default=4, help="parity blocks per group of 16 with fec")
+    parser.add_argument("--seconds", type=float, default=5.0, help="virtual time per run")
+    parser.add_argument("--seeds", type=int, default=3, help="runs averaged per point")
+    args = parser.parse_args()
+
+    args.rfsim = findRfsim(args.rfsim)
+
+    print("{0:>6}".format("loss") + "".join("{0:>10}".format(s) for s in SCHEMES) + "  (goodput, kbps)")
+    for loss in [float(l) for l in args.loss.split(",")]:
+        row = [goodput(args, scheme, loss) / 1000 for scheme in SCHEMES]
+        print("{0:>6.2f}".format(loss) + "".join("{0:>10.0f}".format(g) for g in row))
@@ -0,0 +1,292 @@
+#!/bin/python3
+"""
+Plans the channels and addresses of a site with many TX/RX pairs and
+writes the configuration of every board.
+
+Channels: a link at 2 Mbps occupies 2 MHz, so links next to each other
+are spaced by the occupied bandwidth plus --guard MHz and spread over
+the band, away from the Wi-Fi channels given with --avoid-wifi. When
+that leaves fewer channels than links, the spacing shrinks down to 1 MHz
+first, since a neighbour that overlaps by half still costs less than one
+on the same channel; past that, links share channels round robin and
+only their addresses keep them apart. The default band ends 2 MHz
+below channel 81, where boards built with RENDEZVOUS meet.
+
+Addresses: every link gets a random 32 bit address that keeps the
+receiver's correlator honest: many bit transitions, no long runs, no
+byte that looks like the 0x55/0xAA preamble or like noise (0x00/0xFF),
+and far in Hamming distance from every other address and from the
+addresses turned around (~address), which the reports of HARQ_MODE and
+the sync of LATENCY_STAMP come back to.
+
+Writes, under --out:
+    site.csv        link, channel, address, tx and rx board
+    tx-links.csv    "device,channel,address" of the TX boards
+    rx-links.csv    "device,channel,address" of the RX boards
+
+The TX scripts take their configuration from tx-links.csv when
+RFSLING_LINKS names it, rx_daemon.py from --links rx-links.csv.
+
+Usage:
+    plan_site.py --links N [--rate 2m] [--band 2-79] [--avoid-wifi 1,6,11]
+                 [--boards FILE] [--out DIR] [--simulate]
+
+--boards is a csv of "tx_device,rx_device" per link, port or USB serial
+number; without it the devices are left as tx<N>/rx<N> to fill in.
+"""
+
+import argparse
+import csv
+import io
+import os
+import random
+import subprocess
+import sys
+
+REPO = os.path.abspath(os.path.join(os.path.dirname(__file__), "..", ".."))
+
+# where the simulator ends up with `pio run', or build it by hand
+RFSIM_PATHS = [
+    os.path.join(REPO, "sim", ".pio", "build", "native", "program"),
+    os.path.join(REPO, "sim", "rfsim"),
+]
+
+# RF_CH n is 2400 + n MHz
+BASE_MHZ = 2400
+MAX_CHANNEL = 125
+
+# MHz a link occupies at each rate, as bandwidthMHz in rf_medium.cpp
+RATE_BANDWIDTH_MHZ = {"250k": 1, "1m": 1, "2m": 2}
+
+# Wi-Fi channel n is centered on 2407 + 5n MHz, 22 MHz wide
+WIFI_BASE_MHZ = 2407
+WIFI_SPACING_MHZ = 5
+WIFI_HALF_WIDTH_MHZ = 11
+
+# address quality, over the 32 bits
+MIN_TRANSITIONS = 14
+MAX_RUN = 3
+MIN_DISTANCE = 10
+BAD_BYTES = (0x00, 0xFF, 0x55, 0xAA)
+
+# random addresses tried before the distance asked of them is relaxed
+TRIES_PER_DISTANCE = 20000
+
+
+def findRfsim(path):
+    """
+    Returns the simulator binary to run, exits when there is none.
+    """
+    for p in [path] if path else RFSIM_PATHS:
+        if p and os.access(p, os.X_OK):
+            return p
+    sys.exit("rfsim not found, build it in sim/ (see sim/README.md) or pass --rfsim")
+
+
+def allowedChannels(args):
+    """
+    Channels of the band a link fits in whole, clear of the Wi-Fi channels.
+    """
+    low, high = [int(c) for c in args.band.split("-")]
+    half = RATE_BANDWIDTH_MHZ[args.rate] / 2
+    wifi = [WIFI_BASE_MHZ + WIFI_SPACING_MHZ * int(w) for w in args.avoid_wifi.split(",") if w]
+
+    channels = []
+    for channel in range(max(low, 0), min(high, MAX_CHANNEL) + 1):
+        mhz = BASE_MHZ + channel
+        if any(abs(mhz - center) < WIFI_HALF_WIDTH_MHZ + half for center in wifi):
+            continue
+        channels.append(channel)
+    return channels
+
+
+def spacedChannels(allowed, spacing):
+    """
+    As many channels `spacing' MHz apart as fit, from the bottom.
+    """
+    channels = []
+    for channel in allowed:
+        if not channels or channel - channels[-1] >= spacing:
+            channels.append(channel)
+    return channels
+
+
+def planChannels(args):
+    """
+    Spreads the links over channels spaced by the occupied bandwidth and
+    the guard, closer if they do not fit. Returns the channel of every link.
+    """
+    allowed = allowedChannels(args)
+    if not allowed:
+        sys.exit("no channel left in {0} at {1}".format(args.band, args.rate))
+
+    spacing = RATE_BANDWIDTH_MHZ[args.rate] + args.guard
+    channels = spacedChannels(allowed, spacing)
+    while len(channels) < args.links and spacing > 1:
+        spacing -= 1
+        channels = spacedChannels(allowed, spacing)
+    if spacing < RATE_BANDWIDTH_MHZ[args.rate] + args.guard:
+        print("{0} links need channels {1} MHz apart".format(args.links, spacing), file=sys.stderr)
+
+    # with room to spare, take evenly spread ones for the widest gaps
+    if args.links < len(channels):
+        if args.links == 1:
+            channels = [channels[len(channels) // 2]]
+        else:
+            step = (len(channels) - 1) / (args.links - 1)
+            channels = [channels[round(i * step)] for i in range(args.links)]
+    else:
+        print("{0} links on {1} channels: links share channels".format(args.links, len(channels)), file=sys.stderr)
+
+    return [channels[i % len(channels)] for i in range(args.links)]
+
+
+def addressScore(address):
+    """
+    Returns whether a 32 bit address is fit for a data pipe on its own.
+    """
+    bits = [(address >> i) & 1 for i in range(32)]
+    transitions = sum(bits[i] != bits[i + 1] for i in range(31))
+
+    run = longest = 1
+    for i in range(1, 32):
+        run = run + 1 if bits[i] == bits[i - 1] else 1
+        longest = max(longest, run)
+
+    octets = [(address >> (8 * i)) & 0xFF for i in range(4)]
+    return transitions >= MIN_TRANSITIONS and longest <= MAX_RUN and not any(o in BAD_BYTES for o in octets)
+
+
+def planAddresses(args):
+    """
+    Picks an address per link, each at least MIN_DISTANCE bits from every
+    other and from every other turned around. Returns them in link order.
+    """
+    rng = random.Random(args.seed)
+    addresses = []
+    distance = MIN_DISTANCE
+    tries = 0
+
+    while len(addresses) < args.links:
+        address = rng.getrandbits(32)
+        tries += 1
+        if tries > TRIES_PER_DISTANCE:
+            distance -= 1
+            tries = 0
+            print("relaxing address distance to {0} bits".format(distance), file=sys.stderr)
+
+        if not addressScore(address):
+            continue
+        taken = addresses + [~a & 0xFFFFFFFF for a in addresses]
+        if all(bin(address ^ a).count("1") >= distance for a in taken):
+            addresses.append(address)
+
+    return addresses
+
+
+def readBoards(path, links):
+    """
+    Reads "tx_device,rx_device" per link, filling the missing ones.
+    """
+    boards = []
+    if path:
+        with open(path) as f:
+            for row in csv.reader(f):
+                if not row or row[0].startswith("#"):
+                    continue
+                boards.append((row[0].strip(), row[1].strip()))
+    for i in range(len(boards), links):
+        boards.append(("tx{0}".format(i), "rx{0}".format(i)))
+    return boards[:links]
+
+
+def writePlan(args, channels, addresses, boards):
+    """
+    Writes site.csv and the per board configurations under --out.
+    """
+    os.makedirs(args.out, exist_ok=True)
+    header = "# plan_site.py --links {0} --rate {1} --band {2} --guard {3} --seed {4}\n".format(
+        args.links, args.rate, args.band, args.guard, args.seed)
+
+    with open(os.path.join(args.out, "site.csv"), "w") as f:
+        f.write("link,channel,address,address_hex,tx_device,rx_device\n")
+        for i, (channel, address, (tx, rx)) in enumerate(zip(channels, addresses, boards)):
+            f.write("{0},{1},{2},0x{2:08X},{3},{4}\n".format(i, channel, address, tx, rx))
+
+    for side, column in (("tx", 0), ("rx", 1)):
+        with open(os.path.join(args.out, side + "-links.csv"), "w") as f:
+            f.write(header)
+            for channel, address, devices in zip(channels, addresses, boards):
+                f.write("{0},{1},{2}\n".format(devices[column], channel, address))
+
+
+def simulate(args, channels):
+    """
+    Total goodput and delivery of the site in the simulator, all links
+    saturated with ACKs, as (goodput_bps, pdr).
+    """
+    goodput = pdr = 0.0
+    for seed in range(1, args.seeds + 1):
+        cmd = [
+            args.rfsim, "--csv", "--ack", "--interval-us", "0",
+            "--nodes", str(2 * args.links),
+            "--area", str(args.area),
+            "--rate", args.rate,
+            "--channels", ",".join(str(c) for c in channels),
+            "--seconds", str(args.seconds),
+            "--seed", str(seed),
+        ]
+        out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+        for row in csv.DictReader(io.StringIO(out)):
+            if row["flow"] == "total":
+                goodput += float(row["goodput_bps"]) / args.seeds
+                pdr += float(row["pdr"]) / args.seeds
+    return goodput, pdr
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description="Plan channels and addresses for many links.")
+    parser.add_argument("--links", type=int, required=True, help="TX/RX pairs at the site")
+    parser.add_argument("--rate", choices=list(RATE_BANDWIDTH_MHZ), default="2m", help="air data rate")
+    parser.add_argument("--band", default="2-79", help="RF_CH range to use, inside the 2.4 GHz ISM band at any rate and below RENDEZVOUS_CHANNEL")
+    parser.add_argument("--avoid-wifi", default="", help="Wi-Fi channels in use, as 1,6,11")
+    parser.add_argument("--guard", type=int, default=1, help="MHz left between neighbouring links")
+    parser.add_argument("--boards", help="csv of tx_device,rx_device per link")
+    parser.add_argument("--out", default="plan", help="directory to write the plan to")
+    parser.add_argument("--seed", type=int, default=1, help="seed of the address search")
+    parser.add_argument("--simulate", action="store_true", help="compare the plan with naive ones in the simulator")
+    parser.add_argument("--area", type=float, default=30.0, help="side of the site in meters, with --simulate")
+    parser.add_argument("--seconds", type=float, default=5.0, help="virtual time per run")
+    parser.add_argument("--seeds", type=int, default=3, help="runs averaged per plan")
+    parser.add_argument("--rfsim", help="simulator binary")
+    args = parser.parse_args()
+
+    if args.links < 1:
+        sys.exit("--links must be at least 1")
+
+    channels = planChannels(args)
+    addresses = planAddresses(args)
+    boards = readBoards(args.boards, args.links)
+    writePlan(args, channels, addresses, boards)
+
+    for i, (channel, address) in enumerate(zip(channels, addresses)):
+        print("link {0:3d}: channel {1:3d} address 0x{2:08X}".format(i, channel, address))
+    print("\nwrote {0}/site.csv, tx-links.csv and rx-links.csv".format(args.out))
+    print("TX: RFSLING_LINKS={0}/tx-links.csv python3 send_hex.py <port> ...".format(args.out))
+    print("RX: python3 rx_daemon.py --links {0}/rx-links.csv".format(args.out))
+
+    if args.simulate:
+        args.rfsim = findRfsim(args.rfsim)
+
+        # the simulator places the links itself and gives them its own
+        # addresses, so this compares the channels only
+        allowed = allowedChannels(args)
+        plans = {
+            "one channel": [allowed[0]],
+            "consecutive": [allowed[i % len(allowed)] for i in range(args.links)],
+            "planned": channels,
+        }
+        print("\n{0:12s} {1:>14s} {2:>8s}".format("plan", "goodput_kbps", "pdr"))
+        for name, plan in plans.items():
+            goodput, pdr = simulate(args, plan)
+            print("{0:12s} {1:14.1f} {2:8.4f}".format(name, goodput / 1000, pdr))
@@ -0,0 +1,256 @@
+#include <Arduino.h>
+#include <SPI.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <random>
+
+#include "sim_kernel.h"
+#include "sim_board.h"
+
+using namespace rfsim;
+
+HardwareSerial Serial;
+SPIClass SPI;
+
+/*
+ * The board of the firmware that is running. Firmware only ever runs
+ * inside a kernel process, so this is never null when called from it.
+ */
+static SimBoard *
+board()
+{
+    return Kernel::active()->current()->board;
+}
+
+static void
+charge(sim_time_t ns)
+{
+    Kernel::active()->advance(ns);
+}
+
+/* -----pins and time----- */
+
+void
+pinMode(uint8_t pin, uint8_t mode)
+{
+    (void) pin;
+    (void) mode;
+    charge(DIGITAL_WRITE_NS);
+}
+
+void
+digitalWrite(uint8_t pin, uint8_t val)
+{
+    charge(DIGITAL_WRITE_NS);
+    board()->pinWrite(pin, val);
+}
+
+int
+digitalRead(uint8_t pin)
+{
+    charge(DIGITAL_WRITE_NS);
+    return board()->pinRead(pin);
+}
+
+void
+delay(uint32_t ms)
+{
+    charge(ms * NS_PER_MS);
+}
+
+void
+delayMicroseconds(uint32_t us)
+{
+    charge(us * NS_PER_US);
+}
+
+unsigned long
+micros(void)
+{
+    charge(MICROS_CALL_NS);
+    return Kernel::active()->now() / NS_PER_US;
+}
+
+unsigned long
+millis(void)
+{
+    charge(MICROS_CALL_NS);
+    return Kernel::active()->now() / NS_PER_MS;
+}
+
+static std::mt19937 rng(1);
+
+long
+random(long howbig)
+{
+    if (howbig <= 0) return 0;
+    return std::uniform_int_distribution<long>(0, howbig - 1)(rng);
+}
+
+void
+randomSeed(unsigned long seed)
+{
+    rng.seed(seed);
+}
+
+/* -----SPI----- */
+
+void
+SPIClass::begin(void)
+{
+}
+
+void
+SPIClass::end(void)
+{
+}
+
+void
+SPIClass::beginTransaction(SPISettings settings)
+{
+    charge(SPI_TRANSACTION_NS);
+    board()->spiClock(settings.clock_);
+}
+
+void
+SPIClass::endTransaction(void)
+{
+}
+
+uint8_t
+SPIClass::transfer(uint8_t data)
+{
+    return board()->spiTransfer(data);
+}
+
+uint16_t
+SPIClass::transfer16(uint16_t data)
+{
+    /* MSB first, like the esp32 core with MSBFIRST */
+    uint16_t hi = board()->spiTransfer(data >> 8);
+    uint16_t lo = board()->spiTransfer(data & 0xFF);
+    return (hi << 8) | lo;
+}
+
+void
+SPIClass::transferBytes(const uint8_t * out, uint8_t * in, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        uint8_t b = board()->spiTransfer(out ? out[i] : 0xFF);
+        if (in) in[i] = b;
+    }
+}
+
+void
+SPIClass::writeBytes(const uint8_t * data, uint32_t size)
+{
+    transferBytes(data, nullptr, size);
+}
+
+/* -----Serial----- */
+
+void
+HardwareSerial::begin(unsigned long baud)
+{
+    (void) baud;
+}
+
+int
+HardwareSerial::available(void)
+{
+    charge(SERIAL_CALL_NS);
+    return board()->serialAvailable();
+}
+
+int
+HardwareSerial::read(void)
+{
+    charge(SERIAL_CALL_NS);
+    return board()->serialRead();
+}
+
+int
+HardwareSerial::peek(void)
+{
+    charge(SERIAL_CALL_NS);
+    return board()->serialPeek();
+}
+
+void
+HardwareSerial::flush(void)
+{
+}
+
+size_t
+HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t
+HardwareSerial::write(const uint8_t * buf, size_t size)
+{
+    charge(SERIAL_CALL_NS);
+    board()->serialWrite((const char *) buf, size);
+    return size;
+}
+
+size_t
+HardwareSerial::print(const char * s)
+{
+    return write((const uint8_t *) s, strlen(s));
+}
+
+size_t
+HardwareSerial::print(char c)
+{
+    return write((uint8_t) c);
+}
+
+size_t
+HardwareSerial::print(unsigned char n, int base)
+{
+    return print((unsigned long) n, base);
+}
+
+size_t
+HardwareSerial::print(int n, int base)
+{
+    return print((long) n, base);
+}
+
+size_t
+HardwareSerial::print(unsigned int n, int base)
+{
+    return print((unsigned long) n, base);
+}
+
+size_t
+HardwareSerial::print(long n, int base)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lx" : "%ld", n);
+    return print(buf);
+}
+
+size_t
+HardwareSerial::print(unsigned long n, int base)
+{
+    char buf[24];
+    snprintf(buf, sizeof(buf), base == HEX ? "%lx" : "%lu", n);
+    return print(buf);
+}
+
+size_t
+HardwareSerial::print(double n, int digits)
+{
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%.*f", digits, n);
+    return print(buf);
+}
+
+size_t
+HardwareSerial::println(void)
+{
+    return print("\r\n");
+}
@@ -0,0 +1,27 @@
+/*
+ *  Firmware sources built unchanged against the stand-ins in include/:
+ *  the driver, its Radio backend, the backend and kernel benchmarks, the TX
+ *  main's payload packer, the token bucket of the rate shaper, both ends of
+ *  a pull and of the hybrid ARQ transfer, the rendezvous of both mains, the
+ *  diversity reception and message aggregation of both mains and the RX
+ *  main's latency histogram, and the routing of both mains' RELAY_MODE.
+ *  The TX copies are used, the RX ones are identical.
+ */
+
+/* ahead of the driver, whose register names take serial_io.h's board states */
+#include "../../TX/src/payload_packer.cpp"
+#include "../../TX/src/nRF24L01.cpp"
+#include "../../TX/src/nrf24_radio.cpp"
+#include "../../TX/src/radio_bench.cpp"
+#include "../../TX/src/micro_bench.cpp"
+#include "../../TX/src/token_bucket.cpp"
+#include "../../TX/src/pull_scheduler.cpp"
+#include "../../TX/src/pull_client.cpp"
+#include "../../TX/src/pull_server.cpp"
+#include "../../TX/src/erasure_code.cpp"
+#include "../../TX/src/harq.cpp"
+#include "../../TX/src/latency_histogram.cpp"
+#include "../../TX/src/rendezvous.cpp"
+#include "../../TX/src/diversity.cpp"
+#include "../../TX/src/aggregator.cpp"
+#include "../../TX/src/route.cpp"
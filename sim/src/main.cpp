@@ -0,0 +1,307 @@
+/*
+ *  rfsim: discrete-event simulator for sites with many rfsling links.
+ *
+ *  Every node runs the in-house nRF24 driver against a register-level
+ *  model of the nRF24L01+, and all radios share one spectrum with path
+ *  loss, collisions, capture and cross-channel interference. Use it to
+ *  compare channel plans, CSMA/TDMA and relay layouts before deploying
+ *  them; run with --help for the options.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "sim_scenario.h"
+
+using namespace rfsim;
+using namespace nRF24Module;
+
+static void
+usage(const char * prog)
+{
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --topology pairs|star|chain|pull|mesh\n"
+        "                                site layout (pairs)\n"
+        "  --nodes N                     number of nodes (20)\n"
+        "  --area M                      side of the square site in meters (30)\n"
+        "  --distance M                  pair distance / hop length in meters (5)\n"
+        "  --channels C[,C...]           channel plan, RF_CH values (76)\n"
+        "  --rate 250k|1m|2m             air data rate (250k)\n"
+        "  --mac aloha|csma|tdma         medium access (aloha)\n"
+        "  --interval-us US              mean gap between payloads, 0 saturates (20000)\n"
+        "  --backoff-us US               CSMA initial backoff window (1000)\n"
+        "  --slot-us US                  TDMA slot length, 0 fits one payload (0)\n"
+        "  --ack                         ask for ACKs and retransmit\n"
+        "  --continuous                  sources keep CE high and the TX FIFO fed\n"
+        "                                instead of one payload per CE pulse\n"
+        "  --rendezvous                  pairs meet on the discovery channel first,\n"
+        "                                sinks boot before or after their source\n"
+        "  --retry-delay N               ACK wait of (N + 1) * 250 us, 0-15 (15)\n"
+        "  --retries N                   retransmits per payload, 0-15 (15)\n"
+        "  --pa min|low|high|max         TX output power (max)\n"
+        "  --chunk-bytes N               send files in N byte serial chunks like the\n"
+        "                                TX main, --interval-us after every payload (0)\n"
+        "  --shape-rate BPS              sources cap their airtime with the TX main's\n"
+        "                                token bucket, file bytes per second (0, none)\n"
+        "  --shape-burst BYTES           bytes the token bucket lets through at once (96)\n"
+        "  --bench N                     sources run the TX main's radio backend\n"
+        "                                benchmark with N payloads instead\n"
+        "  --micro N                     the first source times the firmware's kernels\n"
+        "                                N calls each instead, as MICRO_BENCHMARK\n"
+        "  --pull-bytes N                size of the file the pull topology fetches (65536)\n"
+        "  --harq hybrid|arq|fec         pairs run the mains' hybrid ARQ transfer, or\n"
+        "                                it as plain selective repeat or fixed parity\n"
+        "  --harq-parity N               parity blocks per group with fec (4)\n"
+        "  --harq-window N               data blocks per group, up to 16 (16)\n"
+        "  --diversity same|paired       pairs run the mains' DIVERSITY, the sinks with a\n"
+        "                                second radio on the link's or the paired channel\n"
+        "  --messages BYTES              pairs run the mains' AGGREGATE with BYTES byte\n"
+        "                                messages, --interval-us apart at most the serial\n"
+        "                                link's pace (0, off)\n"
+        "  --message-deadline-us US      longest a message waits to share a payload, 0\n"
+        "                                sends every message alone (10000)\n"
+        "  --fade-at S                   the busiest relay of a mesh fades S seconds in\n"
+        "  --fade-db DB                  loss it adds to every link of the relay (30)\n"
+        "  --seconds S                   virtual time to simulate (10)\n"
+        "  --seed N                      random seed (1)\n"
+        "  --path-loss-exp N             log-distance exponent (3.0)\n"
+        "  --shadowing DB                per-link shadowing sigma (4.0)\n"
+        "  --capture-db DB               SINR needed to decode (10.0)\n"
+        "  --loss P                      lose every packet with chance P on top (0)\n"
+        "  --fading DB                   links fade this much deeper 10%% of the time,\n"
+        "                                each channel apart (0)\n"
+        "  --fading-ms MS                mean length of a fade (20)\n"
+        "  --replay FILE                 replay a field link trace on every flow\n"
+        "  --latency-hist FILE           write the latency histogram, as receive_hex.py\n"
+        "                                saves it from an RX main with LATENCY_STAMP\n"
+        "  --flows                       list every flow\n"
+        "  --csv                         machine readable output\n",
+        prog);
+}
+
+static bool
+parseHarq(const char * arg, harq_mode_e & out)
+{
+    if (!strcmp(arg, "hybrid")) out = HARQ_HYBRID;
+    else if (!strcmp(arg, "arq")) out = HARQ_ARQ;
+    else if (!strcmp(arg, "fec")) out = HARQ_FEC;
+    else return false;
+    return true;
+}
+
+static bool
+parseDiversity(const char * arg, diversity_e & out)
+{
+    if (!strcmp(arg, "same")) out = DIVERSITY_SAME;
+    else if (!strcmp(arg, "paired")) out = DIVERSITY_PAIRED;
+    else return false;
+    return true;
+}
+
+static bool
+parseChannels(const char * arg, std::vector<uint8_t> & out)
+{
+    out.clear();
+    char * copy = strdup(arg);
+    for (char * tok = strtok(copy, ","); tok; tok = strtok(nullptr, ",")) {
+        int ch = atoi(tok);
+        if (ch < 0 || ch > NUM_CHANNELS) {
+            free(copy);
+            return false;
+        }
+        out.push_back(ch);
+    }
+    free(copy);
+    return !out.empty();
+}
+
+static bool
+parseRate(const char * arg, data_rate & out)
+{
+    if (!strcmp(arg, "250k")) out = DATA_RATE_250KBPS;
+    else if (!strcmp(arg, "1m")) out = DATA_RATE_1MBPS;
+    else if (!strcmp(arg, "2m")) out = DATA_RATE_2MBPS;
+    else return false;
+    return true;
+}
+
+static bool
+parseMac(const char * arg, mac_policy_e & out)
+{
+    if (!strcmp(arg, "aloha")) out = MAC_ALOHA;
+    else if (!strcmp(arg, "csma")) out = MAC_CSMA;
+    else if (!strcmp(arg, "tdma")) out = MAC_TDMA;
+    else return false;
+    return true;
+}
+
+static bool
+parsePALevel(const char * arg, pa_level & out)
+{
+    if (!strcmp(arg, "min")) out = PA_LEVEL_MIN;
+    else if (!strcmp(arg, "low")) out = PA_LEVEL_LOW;
+    else if (!strcmp(arg, "high")) out = PA_LEVEL_HIGH;
+    else if (!strcmp(arg, "max")) out = PA_LEVEL_MAX;
+    else return false;
+    return true;
+}
+
+static bool
+parseTopology(const char * arg, topology_e & out)
+{
+    if (!strcmp(arg, "pairs")) out = TOPOLOGY_PAIRS;
+    else if (!strcmp(arg, "star")) out = TOPOLOGY_STAR;
+    else if (!strcmp(arg, "chain")) out = TOPOLOGY_CHAIN;
+    else if (!strcmp(arg, "pull")) out = TOPOLOGY_PULL;
+    else if (!strcmp(arg, "mesh")) out = TOPOLOGY_MESH;
+    else return false;
+    return true;
+}
+
+int
+main(int argc, char ** argv)
+{
+    enum {
+        OPT_TOPOLOGY = 256, OPT_NODES, OPT_AREA, OPT_DISTANCE, OPT_CHANNELS, OPT_RATE, OPT_MAC,
+        OPT_INTERVAL, OPT_BACKOFF, OPT_SLOT, OPT_ACK, OPT_CONTINUOUS, OPT_RENDEZVOUS, OPT_RETRY_DELAY, OPT_RETRIES, OPT_PA, OPT_CHUNK, OPT_SHAPE_RATE, OPT_SHAPE_BURST,
+        OPT_BENCH, OPT_MICRO, OPT_PULL_BYTES, OPT_HARQ, OPT_HARQ_PARITY, OPT_HARQ_WINDOW, OPT_DIVERSITY, OPT_MESSAGES, OPT_MESSAGE_DEADLINE, OPT_FADE_AT, OPT_FADE_DB, OPT_SECONDS, OPT_SEED, OPT_PLE, OPT_SHADOWING, OPT_CAPTURE, OPT_LOSS, OPT_FADING, OPT_FADING_MS, OPT_REPLAY, OPT_LATENCY_HIST, OPT_FLOWS, OPT_CSV, OPT_HELP,
+    };
+
+    static const struct option options[] = {
+        {"topology",      required_argument, nullptr, OPT_TOPOLOGY},
+        {"nodes",         required_argument, nullptr, OPT_NODES},
+        {"area",          required_argument, nullptr, OPT_AREA},
+        {"distance",      required_argument, nullptr, OPT_DISTANCE},
+        {"channels",      required_argument, nullptr, OPT_CHANNELS},
+        {"rate",          required_argument, nullptr, OPT_RATE},
+        {"mac",           required_argument, nullptr, OPT_MAC},
+        {"interval-us",   required_argument, nullptr, OPT_INTERVAL},
+        {"backoff-us",    required_argument, nullptr, OPT_BACKOFF},
+        {"slot-us",       required_argument, nullptr, OPT_SLOT},
+        {"ack",           no_argument,       nullptr, OPT_ACK},
+        {"continuous",    no_argument,       nullptr, OPT_CONTINUOUS},
+        {"rendezvous",    no_argument,       nullptr, OPT_RENDEZVOUS},
+        {"retry-delay",   required_argument, nullptr, OPT_RETRY_DELAY},
+        {"retries",       required_argument, nullptr, OPT_RETRIES},
+        {"pa",            required_argument, nullptr, OPT_PA},
+        {"chunk-bytes",   required_argument, nullptr, OPT_CHUNK},
+        {"shape-rate",    required_argument, nullptr, OPT_SHAPE_RATE},
+        {"shape-burst",   required_argument, nullptr, OPT_SHAPE_BURST},
+        {"bench",         required_argument, nullptr, OPT_BENCH},
+        {"micro",         required_argument, nullptr, OPT_MICRO},
+        {"pull-bytes",    required_argument, nullptr, OPT_PULL_BYTES},
+        {"harq",          required_argument, nullptr, OPT_HARQ},
+        {"harq-parity",   required_argument, nullptr, OPT_HARQ_PARITY},
+        {"harq-window",   required_argument, nullptr, OPT_HARQ_WINDOW},
+        {"diversity",     required_argument, nullptr, OPT_DIVERSITY},
+        {"messages",      required_argument, nullptr, OPT_MESSAGES},
+        {"message-deadline-us", required_argument, nullptr, OPT_MESSAGE_DEADLINE},
+        {"fade-at",       required_argument, nullptr, OPT_FADE_AT},
+        {"fade-db",       required_argument, nullptr, OPT_FADE_DB},
+        {"seconds",       required_argument, nullptr, OPT_SECONDS},
+        {"seed",          required_argument, nullptr, OPT_SEED},
+        {"path-loss-exp", required_argument, nullptr, OPT_PLE},
+        {"shadowing",     required_argument, nullptr, OPT_SHADOWING},
+        {"capture-db",    required_argument, nullptr, OPT_CAPTURE},
+        {"loss",          required_argument, nullptr, OPT_LOSS},
+        {"fading",        required_argument, nullptr, OPT_FADING},
+        {"fading-ms",     required_argument, nullptr, OPT_FADING_MS},
+        {"replay",        required_argument, nullptr, OPT_REPLAY},
+        {"latency-hist",  required_argument, nullptr, OPT_LATENCY_HIST},
+        {"flows",         no_argument,       nullptr, OPT_FLOWS},
+        {"csv",           no_argument,       nullptr, OPT_CSV},
+        {"help",          no_argument,       nullptr, OPT_HELP},
+        {nullptr, 0, nullptr, 0},
+    };
+
+    scenario_config_t config = defaultScenarioConfig();
+    TraceReplay replay;
+    bool perFlow = false;
+    bool csv = false;
+    const char * latencyPath = nullptr;
+    bool ok = true;
+    int opt;
+
+    while (ok && (opt = getopt_long(argc, argv, "", options, nullptr)) != -1) {
+        switch (opt) {
+        case OPT_TOPOLOGY:  ok = parseTopology(optarg, config.topology); break;
+        case OPT_NODES:     config.nodes = strtoul(optarg, nullptr, 10); break;
+        case OPT_AREA:      config.areaM = atof(optarg); break;
+        case OPT_DISTANCE:  config.linkDistanceM = atof(optarg); break;
+        case OPT_CHANNELS:  ok = parseChannels(optarg, config.channels); break;
+        case OPT_RATE:      ok = parseRate(optarg, config.rate); break;
+        case OPT_MAC:       ok = parseMac(optarg, config.mac); break;
+        case OPT_INTERVAL:  config.intervalUs = strtoul(optarg, nullptr, 10); break;
+        case OPT_BACKOFF:   config.csmaBackoffUs = strtoul(optarg, nullptr, 10); break;
+        case OPT_SLOT:      config.tdmaSlotUs = strtoul(optarg, nullptr, 10); break;
+        case OPT_ACK:       config.autoAck = true; break;
+        case OPT_CONTINUOUS: config.continuousTx = true; break;
+        case OPT_RENDEZVOUS: config.rendezvous = true; break;
+        case OPT_RETRY_DELAY: config.retryDelay = strtoul(optarg, nullptr, 10) & 0x0F; break;
+        case OPT_RETRIES:   config.retryCount = strtoul(optarg, nullptr, 10) & 0x0F; break;
+        case OPT_PA:        ok = parsePALevel(optarg, config.paLevel); break;
+        case OPT_CHUNK:     config.chunkBytes = strtoul(optarg, nullptr, 10); break;
+        case OPT_SHAPE_RATE: config.shapeRate = strtoul(optarg, nullptr, 10); break;
+        case OPT_SHAPE_BURST: config.shapeBurst = strtoul(optarg, nullptr, 10); break;
+        case OPT_BENCH:     config.benchPayloads = strtoul(optarg, nullptr, 10); break;
+        case OPT_MICRO:     config.microCalls = strtoul(optarg, nullptr, 10); break;
+        case OPT_PULL_BYTES: config.pullBytes = strtoul(optarg, nullptr, 10); break;
+        case OPT_HARQ:      config.harq = parseHarq(optarg, config.harqMode); ok = config.harq; break;
+        case OPT_HARQ_PARITY: config.harqParity = strtoul(optarg, nullptr, 10); break;
+        case OPT_HARQ_WINDOW:
+            config.harqWindow = strtoul(optarg, nullptr, 10);
+            ok = config.harqWindow >= 1 && config.harqWindow <= HARQ_GROUP_BLOCKS;
+            break;
+        case OPT_DIVERSITY: ok = parseDiversity(optarg, config.diversity); break;
+        case OPT_MESSAGES:  config.messageBytes = strtoul(optarg, nullptr, 10); break;
+        case OPT_MESSAGE_DEADLINE: config.messageDeadlineUs = strtoul(optarg, nullptr, 10); break;
+        case OPT_FADE_AT:   config.fadeAt = atof(optarg); break;
+        case OPT_FADE_DB:   config.fadeDb = atof(optarg); break;
+        case OPT_SECONDS:   config.seconds = atof(optarg); break;
+        case OPT_SEED:      config.seed = config.medium.seed = strtoull(optarg, nullptr, 10); break;
+        case OPT_PLE:       config.medium.pathLossExponent = atof(optarg); break;
+        case OPT_SHADOWING: config.medium.shadowingSigmaDb = atof(optarg); break;
+        case OPT_CAPTURE:   config.medium.captureThresholdDb = atof(optarg); break;
+        case OPT_LOSS:      config.medium.randomLoss = atof(optarg); break;
+        case OPT_FADING:    config.medium.fadingDb = atof(optarg); break;
+        case OPT_FADING_MS: config.medium.fadingMs = atof(optarg); break;
+        case OPT_REPLAY:
+            ok = replay.load(optarg);
+            if (!ok) fprintf(stderr, "%s: no TX records in %s\n", argv[0], optarg);
+            config.replay = &replay;
+            break;
+        case OPT_LATENCY_HIST: latencyPath = optarg; break;
+        case OPT_FLOWS:     perFlow = true; break;
+        case OPT_CSV:       csv = true; break;
+        default:            ok = false; break;
+        }
+    }
+
+    /* mesh ids are the lowest address byte, up to the broadcast one */
+    if (config.topology == TOPOLOGY_MESH && config.nodes > ROUTE_BROADCAST) ok = false;
+
+    /* messages carry their send time */
+    if (config.messageBytes && (config.messageBytes < MSG_MIN_BYTES || config.messageBytes > AGGREGATE_MAX_MESSAGE)) {
+        ok = false;
+    }
+
+    if (!ok || config.nodes < 2 || config.seconds <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Scenario scenario(config);
+    scenario.run();
+    scenario.report(stdout, perFlow, csv);
+
+    if (latencyPath && !scenario.writeLatency(latencyPath)) {
+        fprintf(stderr, "%s: cannot write %s\n", argv[0], latencyPath);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,706 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "nrf24_chip.h"
+
+using namespace rfsim;
+using namespace nRF24Module;
+
+/* ARD is in steps of 250 us, counted from the end of a transmission */
+#define ARD_STEP_NS (250 * NS_PER_US)
+
+/* the RPD bit is set when the in-band power is above -64 dBm */
+#define RPD_THRESHOLD_DBM -64.0
+
+Nrf24Chip::Nrf24Chip(Kernel & kernel, RfMedium & medium)
+    : kernel_(kernel), medium_(medium), radioIndex_(0), state_(POWER_DOWN),
+      ce_(false), csn_(true), generation_(0), cmd_(NOP), byteIndex_(0),
+      pid_(0), pidFresh_(true), retries_(0), reuse_(false),
+      pendingAckPipe_(-1)
+{
+    /* reset values, section 9 of the data sheet */
+    memset(regs_, 0, sizeof(regs_));
+    regs_[CONFIG]       = 0x08;
+    regs_[EN_AA]        = 0x3F;
+    regs_[EN_RXADDR]    = 0x03;
+    regs_[SETUP_AW]     = 0x03;
+    regs_[SETUP_RETR]   = 0x03;
+    regs_[RF_CH]        = 0x02;
+    regs_[RF_SETUP]     = 0x0E;
+    regs_[STATUS]       = 0x0E;
+    regs_[RX_ADDR_P2]   = 0xC3;
+    regs_[RX_ADDR_P3]   = 0xC4;
+    regs_[RX_ADDR_P4]   = 0xC5;
+    regs_[RX_ADDR_P5]   = 0xC6;
+
+    memset(rxAddrP0_, 0xE7, sizeof(rxAddrP0_));
+    memset(rxAddrP1_, 0xC2, sizeof(rxAddrP1_));
+    memset(txAddr_, 0xE7, sizeof(txAddr_));
+
+    memset(lastRxPid_, 0xFF, sizeof(lastRxPid_));
+    memset(&stats_, 0, sizeof(stats_));
+}
+
+/* -----pin interface----- */
+
+void
+Nrf24Chip::setCE(bool high)
+{
+    if (high == ce_) return;
+    ce_ = high;
+    evaluate();
+}
+
+void
+Nrf24Chip::setCSN(bool high)
+{
+    if (high == csn_) return;
+    csn_ = high;
+
+    /* the command is executed on the rising edge of CSN */
+    if (csn_ && byteIndex_ > 0) endCommand();
+    byteIndex_ = 0;
+}
+
+uint8_t
+Nrf24Chip::transfer(uint8_t mosi)
+{
+    /* MISO is tri-stated while the chip is not selected */
+    if (csn_) return 0xFF;
+
+    uint8_t miso = 0;
+
+    if (byteIndex_ == 0) {
+        /* the STATUS register is shifted out while the command is shifted in */
+        cmd_ = mosi;
+        spiIn_.clear();
+        miso = statusRegister();
+    } else if (cmd_ < W_REGISTER) {
+        miso = readRegisterByte(cmd_ & REGISTER_MASK, byteIndex_ - 1);
+    } else if (cmd_ == R_RX_PAYLOAD) {
+        if (!rxFifo_.empty() && byteIndex_ - 1 < rxFifo_.front().data.size()) {
+            miso = rxFifo_.front().data[byteIndex_ - 1];
+        }
+    } else if (cmd_ == R_RX_PL_WID) {
+        miso = rxFifo_.empty() ? 0 : rxFifo_.front().data.size();
+    } else {
+        spiIn_.push_back(mosi);
+    }
+
+    byteIndex_++;
+    return miso;
+}
+
+void
+Nrf24Chip::endCommand()
+{
+    if (cmd_ < W_REGISTER) {
+        /* reads have no side effects */
+    } else if (cmd_ < (W_REGISTER << 1)) {
+        commitRegisterWrite(cmd_ & REGISTER_MASK, spiIn_);
+    } else if (cmd_ == R_RX_PAYLOAD) {
+        if (byteIndex_ > 1 && !rxFifo_.empty()) rxFifo_.pop_front();
+    } else if (cmd_ == W_TX_PAYLOAD || cmd_ == W_TX_PAYLOAD_NO_ACK) {
+        /* W_TX_PAYLOAD_NO_ACK is only executed when EN_DYN_ACK is set */
+        bool noAck = cmd_ == W_TX_PAYLOAD_NO_ACK;
+        bool enabled = !noAck || (regs_[FEATURE] & (1 << EN_DYN_ACK));
+
+        if (enabled && !spiIn_.empty() && txFifo_.size() < FIFO_DEPTH) {
+            if (spiIn_.size() > FIFO_SZ) spiIn_.resize(FIFO_SZ);
+            txFifo_.push_back(fifo_entry_t {spiIn_, -1, noAck});
+            reuse_ = false;
+        }
+    } else if ((cmd_ & 0xF8) == W_ACK_PAYLOAD) {
+        if ((regs_[FEATURE] & (1 << EN_ACK_PAY)) && !spiIn_.empty() && txFifo_.size() < FIFO_DEPTH) {
+            if (spiIn_.size() > FIFO_SZ) spiIn_.resize(FIFO_SZ);
+            txFifo_.push_back(fifo_entry_t {spiIn_, (int8_t) (cmd_ & 0x07), false});
+        }
+    } else if (cmd_ == FLUSH_TX) {
+        txFifo_.clear();
+        reuse_ = false;
+        pidFresh_ = true;
+    } else if (cmd_ == FLUSH_RX) {
+        rxFifo_.clear();
+    } else if (cmd_ == REUSE_TX_PL) {
+        reuse_ = true;
+    }
+
+    evaluate();
+}
+
+/* -----registers----- */
+
+uint8_t
+Nrf24Chip::statusRegister() const
+{
+    uint8_t pipe = rxFifo_.empty() ? RX_P_NO_EMPTY : rxFifo_.front().pipe;
+    uint8_t full = txFifo_.size() >= FIFO_DEPTH ? 1 : 0;
+    return (regs_[STATUS] & 0x70) | (pipe << 1) | (full << STATUS_TX_FULL);
+}
+
+uint8_t
+Nrf24Chip::fifoStatusRegister() const
+{
+    return (reuse_ << FIFO_TX_REUSE)
+        | ((txFifo_.size() >= FIFO_DEPTH) << FIFO_TX_FULL)
+        | (txFifo_.empty() << FIFO_TX_EMPTY)
+        | ((rxFifo_.size() >= FIFO_DEPTH) << FIFO_RX_FULL)
+        | (rxFifo_.empty() << FIFO_RX_EMPTY);
+}
+
+uint8_t
+Nrf24Chip::readRegisterByte(uint8_t r, uint32_t i) const
+{
+    /* the multi-byte address registers are read LSByte first */
+    switch (r) {
+    case RX_ADDR_P0:
+        return i < MAX_ADDRESS_WIDTH ? rxAddrP0_[i] : 0;
+    case RX_ADDR_P1:
+        return i < MAX_ADDRESS_WIDTH ? rxAddrP1_[i] : 0;
+    case TX_ADDR:
+        return i < MAX_ADDRESS_WIDTH ? txAddr_[i] : 0;
+    default:
+        break;
+    }
+
+    if (i > 0) return 0;
+
+    switch (r) {
+    case STATUS:
+        return statusRegister();
+    case FIFO_STATUS:
+        return fifoStatusRegister();
+    case CD:
+        return listening() && medium_.powerAtDbm(radioIndex_) > RPD_THRESHOLD_DBM;
+    default:
+        return r < N_REGISTERS ? regs_[r] : 0;
+    }
+}
+
+void
+Nrf24Chip::commitRegisterWrite(uint8_t r, const std::vector<uint8_t> & bytes)
+{
+    if (bytes.empty() || r >= N_REGISTERS) return;
+
+    uint8_t old = regs_[r];
+
+    switch (r) {
+    case RX_ADDR_P0:
+        memcpy(rxAddrP0_, bytes.data(), bytes.size() < MAX_ADDRESS_WIDTH ? bytes.size() : MAX_ADDRESS_WIDTH);
+        break;
+    case RX_ADDR_P1:
+        memcpy(rxAddrP1_, bytes.data(), bytes.size() < MAX_ADDRESS_WIDTH ? bytes.size() : MAX_ADDRESS_WIDTH);
+        break;
+    case TX_ADDR:
+        memcpy(txAddr_, bytes.data(), bytes.size() < MAX_ADDRESS_WIDTH ? bytes.size() : MAX_ADDRESS_WIDTH);
+        break;
+    case STATUS:
+        /* interrupt flags are cleared by writing 1 */
+        regs_[STATUS] &= ~(bytes[0] & 0x70);
+        break;
+    case OBSERVE_TX:
+    case CD:
+    case FIFO_STATUS:
+        /* read only */
+        break;
+    case RF_CH:
+        regs_[RF_CH] = bytes[0] & 0x7F;
+        /* PLOS_CNT is reset by writing RF_CH */
+        regs_[OBSERVE_TX] &= 0x0F;
+        break;
+    case CONFIG:
+        regs_[CONFIG] = bytes[0];
+        if (!(old & (1 << PWR_UP)) && (bytes[0] & (1 << PWR_UP))) {
+            setState(POWER_DOWN);
+            after(T_PD2STBY_NS, &Nrf24Chip::poweredUp);
+        } else if (!(bytes[0] & (1 << PWR_UP))) {
+            setState(POWER_DOWN);
+        }
+        break;
+    default:
+        regs_[r] = bytes[0];
+        break;
+    }
+}
+
+uint8_t
+Nrf24Chip::peekRegister(uint8_t r) const
+{
+    return readRegisterByte(r, 0);
+}
+
+uint8_t
+Nrf24Chip::peekStatus() const
+{
+    return statusRegister();
+}
+
+/* -----air interface----- */
+
+uint32_t
+Nrf24Chip::radioIndex() const
+{
+    return radioIndex_;
+}
+
+void
+Nrf24Chip::setRadioIndex(uint32_t index)
+{
+    radioIndex_ = index;
+}
+
+uint8_t
+Nrf24Chip::channel() const
+{
+    return regs_[RF_CH] & 0x7F;
+}
+
+uint32_t
+Nrf24Chip::dataRateBps() const
+{
+    /* RF_DR_LOW takes precedence, '11' is reserved */
+    if (regs_[RF_SETUP] & (1 << RF_DR_1)) return 250000;
+    if (regs_[RF_SETUP] & (1 << RF_DR_0)) return 2000000;
+    return 1000000;
+}
+
+double
+Nrf24Chip::txPowerDbm() const
+{
+    /* '00' = -18 dBm up to '11' = 0 dBm in 6 dB steps */
+    return -18.0 + 6.0 * ((regs_[RF_SETUP] >> RF_PWR_0) & 0x03);
+}
+
+uint8_t
+Nrf24Chip::addressWidth() const
+{
+    uint8_t aw = regs_[SETUP_AW] & 0x03;
+    /* '00' is illegal */
+    return aw ? aw + 2 : 0;
+}
+
+bool
+Nrf24Chip::listening() const
+{
+    return state_ == RX_ACTIVE || state_ == TX_WAIT_ACK;
+}
+
+int8_t
+Nrf24Chip::acceptsAddress(const air_packet_t & pkt) const
+{
+    uint8_t aw = addressWidth();
+    if (aw == 0 || pkt.address.size() != aw) return -1;
+
+    if (state_ == TX_WAIT_ACK) {
+        return pkt.isAck && memcmp(pkt.address.data(), rxAddrP0_, aw) == 0 ? 0 : -1;
+    }
+
+    if (pkt.isAck) return -1;
+
+    for (uint8_t pipe = 0; pipe <= N_PIPES; ++pipe) {
+        if (!(regs_[EN_RXADDR] & (1 << pipe))) continue;
+
+        if (pipe == 0) {
+            if (memcmp(pkt.address.data(), rxAddrP0_, aw) == 0) return pipe;
+            continue;
+        }
+
+        /* pipes 2-5 only own their LSByte and share the rest with pipe 1 */
+        uint8_t lsb = pipe == 1 ? rxAddrP1_[0] : regs_[RX_ADDR_P0 + pipe];
+        if (pkt.address[0] == lsb && memcmp(pkt.address.data() + 1, rxAddrP1_ + 1, aw - 1) == 0) {
+            return pipe;
+        }
+    }
+
+    return -1;
+}
+
+void
+Nrf24Chip::onAirPacket(const air_packet_t & pkt)
+{
+    receive(pkt);
+    if (changed_) changed_();
+}
+
+void
+Nrf24Chip::onChange(std::function<void()> fn)
+{
+    changed_ = std::move(fn);
+}
+
+bool
+Nrf24Chip::busy() const
+{
+    return state_ == TX_SETTLING || state_ == TX_ACTIVE || state_ == TX_WAIT_ACK
+        || state_ == RX_SETTLING || state_ == RX_SEND_ACK;
+}
+
+void
+Nrf24Chip::receive(const air_packet_t & pkt)
+{
+    if (pkt.isAck) {
+        if (state_ != TX_WAIT_ACK) return;
+
+        regs_[STATUS] |= (1 << STATUS_TX_DS);
+        stats_.txDelivered++;
+
+        /* ACK payloads land in the RX FIFO as pipe 0 */
+        if (!pkt.payload.empty() && rxFifo_.size() < FIFO_DEPTH) {
+            rxFifo_.push_back(fifo_entry_t {pkt.payload, 0, false});
+            regs_[STATUS] |= (1 << STATUS_RX_DR);
+        }
+
+        packetFinished();
+        return;
+    }
+
+    if (state_ != RX_ACTIVE) return;
+
+    int8_t pipe = acceptsAddress(pkt);
+    if (pipe < 0) return;
+
+    /* with static payload widths anything else fails the CRC check */
+    if (!dynamicPayload(pipe)) {
+        uint8_t width = regs_[RX_PW_P0 + pipe];
+        if (width == 0 || width != pkt.payload.size()) return;
+    }
+
+    bool ack = !pkt.noAck && autoAck(pipe);
+
+    /* same PID and CRC as the last packet: a retransmission, ack and drop it */
+    if (pkt.pid == lastRxPid_[pipe] && pkt.payload == lastRxPayload_[pipe]) {
+        stats_.rxDuplicates++;
+        if (ack) sendAck(pipe, pkt);
+        return;
+    }
+
+    /* no room in the RX FIFO: dropped and not acknowledged */
+    if (rxFifo_.size() >= FIFO_DEPTH) {
+        stats_.rxOverflows++;
+        return;
+    }
+
+    rxFifo_.push_back(fifo_entry_t {pkt.payload, pipe, false});
+    regs_[STATUS] |= (1 << STATUS_RX_DR);
+    lastRxPid_[pipe] = pkt.pid;
+    lastRxPayload_[pipe] = pkt.payload;
+    stats_.rxPackets++;
+
+    if (ack) sendAck(pipe, pkt);
+}
+
+chip_state_e
+Nrf24Chip::state() const
+{
+    return state_;
+}
+
+const chip_stats_t &
+Nrf24Chip::stats() const
+{
+    return stats_;
+}
+
+/* -----state machine----- */
+
+bool
+Nrf24Chip::hasTxPayload() const
+{
+    for (const fifo_entry_t & e : txFifo_) {
+        if (e.pipe < 0) return true;
+    }
+    return false;
+}
+
+bool
+Nrf24Chip::maxRtPending() const
+{
+    return regs_[STATUS] & (1 << STATUS_MAX_RT);
+}
+
+bool
+Nrf24Chip::primaryRx() const
+{
+    return regs_[CONFIG] & (1 << PRIM_RX);
+}
+
+bool
+Nrf24Chip::dynamicPayload(uint8_t pipe) const
+{
+    return (regs_[FEATURE] & (1 << EN_DPL)) && (regs_[DYNPD] & (1 << pipe));
+}
+
+bool
+Nrf24Chip::autoAck(uint8_t pipe) const
+{
+    return regs_[EN_AA] & (1 << pipe);
+}
+
+uint8_t
+Nrf24Chip::crcBytes() const
+{
+    /* auto acknowledgement forces the CRC on */
+    if (!(regs_[CONFIG] & (1 << EN_CRC)) && !(regs_[EN_AA] & 0x3F)) return 0;
+    return (regs_[CONFIG] & (1 << CRCO)) ? 2 : 1;
+}
+
+sim_time_t
+Nrf24Chip::airtime(uint32_t payloadBytes) const
+{
+    /* preamble, address, 9 bit packet control field, payload, CRC */
+    uint64_t bits = 8 + 8 * addressWidth() + 9 + 8 * payloadBytes + 8 * crcBytes();
+    return bits * NS_PER_S / dataRateBps();
+}
+
+void
+Nrf24Chip::setState(chip_state_e s)
+{
+    state_ = s;
+    generation_++;
+}
+
+void
+Nrf24Chip::after(sim_time_t dt, void (Nrf24Chip::*fn)())
+{
+    uint64_t gen = generation_;
+    kernel_.schedule(kernel_.now() + dt, [this, gen, fn]() {
+        if (gen != generation_) return;
+        (this->*fn)();
+        if (changed_) changed_();
+    });
+}
+
+void
+Nrf24Chip::evaluate()
+{
+    switch (state_) {
+    case STANDBY_I:
+        if (!ce_) return;
+        if (primaryRx()) {
+            setState(RX_SETTLING);
+            after(T_STBY2A_NS, &Nrf24Chip::settled);
+        } else if (hasTxPayload() && !maxRtPending()) {
+            setState(TX_SETTLING);
+            after(T_STBY2A_NS, &Nrf24Chip::settled);
+        } else {
+            setState(STANDBY_II);
+        }
+        break;
+
+    case STANDBY_II:
+        if (!ce_ || primaryRx()) {
+            setState(STANDBY_I);
+            evaluate();
+        } else if (hasTxPayload() && !maxRtPending()) {
+            setState(TX_SETTLING);
+            after(T_STBY2A_NS, &Nrf24Chip::settled);
+        }
+        break;
+
+    case RX_SETTLING:
+    case RX_ACTIVE:
+        if (!ce_ || !primaryRx()) {
+            setState(STANDBY_I);
+            evaluate();
+        }
+        break;
+
+    default:
+        /*
+         * POWER_DOWN waits for PWR_UP, and a packet (or ACK) that has
+         * started always runs to completion regardless of CE
+         */
+        break;
+    }
+}
+
+void
+Nrf24Chip::poweredUp()
+{
+    setState(STANDBY_I);
+    evaluate();
+}
+
+void
+Nrf24Chip::settled()
+{
+    if (state_ == RX_SETTLING) {
+        setState(RX_ACTIVE);
+        evaluate();
+    } else {
+        startTransmission();
+    }
+}
+
+void
+Nrf24Chip::startTransmission()
+{
+    const fifo_entry_t * entry = nullptr;
+    for (const fifo_entry_t & e : txFifo_) {
+        if (e.pipe < 0) {
+            entry = &e;
+            break;
+        }
+    }
+
+    if (!entry) {
+        setState(ce_ ? STANDBY_II : STANDBY_I);
+        evaluate();
+        return;
+    }
+
+    /* a new payload gets a new PID and resets ARC_CNT */
+    if (pidFresh_) {
+        pid_ = (pid_ + 1) & 0x03;
+        pidFresh_ = false;
+        retries_ = 0;
+        regs_[OBSERVE_TX] &= 0xF0;
+    }
+
+    air_packet_t pkt;
+    pkt.address.assign(txAddr_, txAddr_ + addressWidth());
+    pkt.payload = entry->data;
+    pkt.pid = pid_;
+    pkt.noAck = entry->noAck;
+    pkt.isAck = false;
+
+    sim_time_t duration = airtime(pkt.payload.size());
+
+    setState(TX_ACTIVE);
+    stats_.txAttempts++;
+    stats_.airtimeNs += duration;
+    medium_.transmit(radioIndex_, pkt, duration);
+    after(duration, &Nrf24Chip::transmissionDone);
+}
+
+void
+Nrf24Chip::transmissionDone()
+{
+    bool noAck = true;
+    for (const fifo_entry_t & e : txFifo_) {
+        if (e.pipe < 0) {
+            noAck = e.noAck;
+            break;
+        }
+    }
+
+    if (noAck || !autoAck(0)) {
+        regs_[STATUS] |= (1 << STATUS_TX_DS);
+        stats_.txDelivered++;
+        packetFinished();
+        return;
+    }
+
+    /* listen on pipe 0 for the ACK until the retransmit delay runs out */
+    setState(TX_WAIT_ACK);
+    after(ARD_STEP_NS * ((regs_[SETUP_RETR] >> ARD_0) + 1), &Nrf24Chip::ackTimeout);
+}
+
+void
+Nrf24Chip::ackTimeout()
+{
+    uint8_t arc = regs_[SETUP_RETR] & 0x0F;
+
+    if (retries_ < arc) {
+        retries_++;
+        regs_[OBSERVE_TX] = (regs_[OBSERVE_TX] & 0xF0) | retries_;
+        startTransmission();
+        return;
+    }
+
+    /* out of retries, the payload stays in the FIFO until flushed */
+    uint8_t plos = regs_[OBSERVE_TX] >> 4;
+    if (plos < 0x0F) plos++;
+    regs_[OBSERVE_TX] = (plos << 4) | (regs_[OBSERVE_TX] & 0x0F);
+    regs_[STATUS] |= (1 << STATUS_MAX_RT);
+    stats_.txMaxRt++;
+
+    setState(ce_ ? STANDBY_II : STANDBY_I);
+    evaluate();
+}
+
+void
+Nrf24Chip::packetFinished()
+{
+    if (!reuse_) {
+        for (auto it = txFifo_.begin(); it != txFifo_.end(); ++it) {
+            if (it->pipe < 0) {
+                txFifo_.erase(it);
+                break;
+            }
+        }
+        pidFresh_ = true;
+    }
+
+    /*
+     * CE still high with more to send: next packet without PLL settling,
+     * unless the synthesizer was turned around to receive an ACK
+     */
+    if (ce_ && !primaryRx() && hasTxPayload() && !maxRtPending()) {
+        if (state_ == TX_WAIT_ACK) {
+            setState(TX_SETTLING);
+            after(T_STBY2A_NS, &Nrf24Chip::settled);
+            return;
+        }
+        startTransmission();
+        return;
+    }
+
+    setState(ce_ ? STANDBY_II : STANDBY_I);
+    evaluate();
+}
+
+void
+Nrf24Chip::sendAck(uint8_t pipe, const air_packet_t & pkt)
+{
+    pendingAck_.address = pkt.address;
+    pendingAck_.payload.clear();
+    pendingAck_.pid = pkt.pid;
+    pendingAck_.noAck = true;
+    pendingAck_.isAck = true;
+    pendingAckPipe_ = -1;
+
+    if (regs_[FEATURE] & (1 << EN_ACK_PAY)) {
+        for (const fifo_entry_t & e : txFifo_) {
+            if (e.pipe == pipe) {
+                pendingAck_.payload = e.data;
+                pendingAckPipe_ = pipe;
+                break;
+            }
+        }
+    }
+
+    /* the PRX turns around to TX mode before sending the ACK */
+    setState(RX_SEND_ACK);
+    after(T_STBY2A_NS, &Nrf24Chip::transmitAck);
+}
+
+void
+Nrf24Chip::transmitAck()
+{
+    sim_time_t duration = airtime(pendingAck_.payload.size());
+
+    stats_.acksSent++;
+    stats_.airtimeNs += duration;
+    medium_.transmit(radioIndex_, pendingAck_, duration);
+    after(duration, &Nrf24Chip::ackSent);
+}
+
+void
+Nrf24Chip::ackSent()
+{
+    if (pendingAckPipe_ >= 0) {
+        /* the ACK payload is gone, which the PRX sees as TX_DS */
+        for (auto it = txFifo_.begin(); it != txFifo_.end(); ++it) {
+            if (it->pipe == pendingAckPipe_) {
+                txFifo_.erase(it);
+                break;
+            }
+        }
+        regs_[STATUS] |= (1 << STATUS_TX_DS);
+    }
+
+    setState(ce_ && primaryRx() ? RX_ACTIVE : STANDBY_I);
+    evaluate();
+}
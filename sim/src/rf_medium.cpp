@@ -0,0 +1,336 @@
+#include <stdint.h>
+#include <math.h>
+#include <random>
+
+#include "rf_medium.h"
+#include "nrf24_chip.h"
+
+using namespace rfsim;
+
+/*
+ * Transmissions are kept around this long after they end so that packets
+ * that overlapped them can still be resolved. Longer than any packet.
+ */
+#define AIR_HISTORY_NS (10 * NS_PER_MS)
+
+/* anything weaker is treated as no signal at all */
+#define NO_SIGNAL_DBM -200.0
+
+/* share of the time a link spends in a fade */
+#define FADE_DUTY 0.1
+
+static double
+dbmToMw(double dbm)
+{
+    return pow(10.0, dbm / 10.0);
+}
+
+static double
+mwToDbm(double mw)
+{
+    return mw > 0 ? 10.0 * log10(mw) : NO_SIGNAL_DBM;
+}
+
+medium_config_t
+rfsim::defaultMediumConfig()
+{
+    medium_config_t config;
+    /* free space loss at 1 m for 2.44 GHz */
+    config.refLossDb = 40.2;
+    /* indoors with some clutter */
+    config.pathLossExponent = 3.0;
+    config.shadowingSigmaDb = 4.0;
+    config.noiseFloorDbm = -104.0;
+    /* nRF24L01+ co-channel C/I is 7-12 dB depending on rate */
+    config.captureThresholdDb = 10.0;
+    config.randomLoss = 0.0;
+    config.fadingDb = 0.0;
+    config.fadingMs = 20.0;
+    config.seed = 1;
+    return config;
+}
+
+RfMedium::RfMedium(Kernel & kernel, const medium_config_t & config)
+    : kernel_(kernel), config_(config), stats_(), rng_(config.seed), nextId_(1)
+{
+}
+
+uint32_t
+RfMedium::attach(Nrf24Chip * chip, double x, double y)
+{
+    uint32_t index = chips_.size();
+    chips_.push_back(chip);
+    x_.push_back(x);
+    y_.push_back(y);
+    lockedOn_.push_back(0);
+    chip->setRadioIndex(index);
+    return index;
+}
+
+void
+RfMedium::setLinkLoss(uint32_t a, uint32_t b, double lossDb)
+{
+    uint64_t key = a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+    lossCache_[key] = lossDb;
+}
+
+double
+RfMedium::linkLossDb(uint32_t a, uint32_t b) const
+{
+    uint64_t key = a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+    auto it = lossCache_.find(key);
+    if (it != lossCache_.end()) return it->second;
+
+    double dx = x_[a] - x_[b];
+    double dy = y_[a] - y_[b];
+    double d = sqrt(dx * dx + dy * dy);
+    if (d < 1.0) d = 1.0;
+
+    double loss = config_.refLossDb + 10.0 * config_.pathLossExponent * log10(d);
+
+    /* shadowing is fixed per link and reproducible for a given seed */
+    if (config_.shadowingSigmaDb > 0) {
+        std::mt19937_64 rng(config_.seed ^ (key * 0x9E3779B97F4A7C15ull));
+        std::normal_distribution<double> shadow(0.0, config_.shadowingSigmaDb);
+        loss += shadow(rng);
+    }
+
+    lossCache_[key] = loss;
+    return loss;
+}
+
+void
+RfMedium::transmit(uint32_t src, const air_packet_t & pkt, sim_time_t duration)
+{
+    Nrf24Chip * chip = chips_[src];
+
+    prune();
+
+    transmission_t tx;
+    tx.id = nextId_++;
+    tx.src = src;
+    tx.pkt = pkt;
+    tx.channel = chip->channel();
+    tx.rateBps = chip->dataRateBps();
+    tx.powerDbm = chip->txPowerDbm();
+    tx.start = kernel_.now();
+    tx.addressEnd = tx.start + (8 + 8 * pkt.address.size()) * NS_PER_S / tx.rateBps;
+    tx.end = tx.start + duration;
+    tx.replay = -1;
+
+    auto replay = replays_.find(src);
+    if (replay != replays_.end() && !pkt.isAck) {
+        replay_link_t & link = replay->second;
+        tx.replay = link.trace->attemptLost(link.next++) ? 1 : 0;
+    }
+
+    air_.push_back(tx);
+    stats_.transmissions++;
+
+    /* receivers that hear the preamble lock onto this packet */
+    for (uint32_t r = 0; r < chips_.size(); ++r) {
+        if (r == src) continue;
+
+        Nrf24Chip * rx = chips_[r];
+        if (!rx->listening() || rx->channel() != tx.channel || rx->dataRateBps() != tx.rateBps) continue;
+        if (tx.powerDbm - linkLossDb(src, r) < sensitivityDbm(tx.rateBps)) continue;
+
+        if (lockedOn_[r]) {
+            stats_.missedBusy++;
+            continue;
+        }
+        lockedOn_[r] = tx.id;
+    }
+
+    uint64_t id = tx.id;
+    kernel_.schedule(tx.addressEnd, [this, id]() { addressDone(id); });
+    kernel_.schedule(tx.end, [this, id]() { resolve(id); });
+}
+
+void
+RfMedium::setReplay(uint32_t src, const TraceReplay * trace, uint64_t offset)
+{
+    replays_[src] = replay_link_t {trace, offset};
+}
+
+double
+RfMedium::powerAtDbm(uint32_t rx) const
+{
+    sim_time_t now = kernel_.now();
+    Nrf24Chip * chip = chips_[rx];
+    double mw = 0;
+
+    for (const transmission_t & tx : air_) {
+        if (tx.src == rx || tx.start > now || tx.end <= now) continue;
+        double f = channelOverlap(tx.channel, tx.rateBps, chip->channel(), chip->dataRateBps());
+        if (f <= 0) continue;
+        mw += dbmToMw(tx.powerDbm - linkLossDb(tx.src, rx)) * f;
+    }
+
+    return mwToDbm(mw);
+}
+
+const medium_stats_t &
+RfMedium::stats() const
+{
+    return stats_;
+}
+
+uint32_t
+RfMedium::radios() const
+{
+    return chips_.size();
+}
+
+double
+RfMedium::sensitivityDbm(uint32_t rateBps)
+{
+    /* section 5.3 of the data sheet */
+    if (rateBps <= 250000) return -94.0;
+    if (rateBps <= 1000000) return -85.0;
+    return -82.0;
+}
+
+double
+RfMedium::bandwidthMHz(uint32_t rateBps)
+{
+    /* 2 Mbps needs 2 MHz, which is why channels must be 2 MHz apart then */
+    return rateBps > 1000000 ? 2.0 : 1.0;
+}
+
+double
+RfMedium::channelOverlap(uint8_t txCh, uint32_t txRate, uint8_t rxCh, uint32_t rxRate)
+{
+    double txHalf = bandwidthMHz(txRate) / 2;
+    double rxHalf = bandwidthMHz(rxRate) / 2;
+
+    double lo = fmax(txCh - txHalf, rxCh - rxHalf);
+    double hi = fmin(txCh + txHalf, rxCh + rxHalf);
+    if (hi <= lo) return 0;
+
+    /* fraction of the transmitter's energy that falls in the receiver's band */
+    return (hi - lo) / (2 * txHalf);
+}
+
+const transmission_t *
+RfMedium::find(uint64_t id) const
+{
+    for (auto it = air_.rbegin(); it != air_.rend(); ++it) {
+        if (it->id == id) return &*it;
+    }
+    return nullptr;
+}
+
+void
+RfMedium::addressDone(uint64_t id)
+{
+    const transmission_t * tx = find(id);
+    if (!tx) return;
+
+    /* receivers drop the packet as soon as the address does not match */
+    for (uint32_t r = 0; r < chips_.size(); ++r) {
+        if (lockedOn_[r] != id) continue;
+        if (!chips_[r]->listening() || chips_[r]->acceptsAddress(tx->pkt) < 0) lockedOn_[r] = 0;
+    }
+}
+
+void
+RfMedium::resolve(uint64_t id)
+{
+    const transmission_t * found = find(id);
+    if (!found) return;
+
+    /* copied, delivering a packet can put an ACK on the air */
+    transmission_t tx = *found;
+
+    for (uint32_t r = 0; r < chips_.size(); ++r) {
+        if (lockedOn_[r] != id) continue;
+        lockedOn_[r] = 0;
+
+        Nrf24Chip * rx = chips_[r];
+        if (!rx->listening() || rx->channel() != tx.channel) continue;
+
+        if (tx.replay == 1) {
+            stats_.replayLost++;
+            continue;
+        }
+        if (tx.replay == 0) {
+            stats_.delivered++;
+            rx->onAirPacket(tx.pkt);
+            continue;
+        }
+
+        if (config_.randomLoss > 0 && std::uniform_real_distribution<double>(0, 1)(rng_) < config_.randomLoss) {
+            stats_.randomLost++;
+            continue;
+        }
+
+        double signal = tx.powerDbm - linkLossDb(tx.src, r);
+        double fade = (config_.fadingDb > 0 && faded(tx.src, r, tx.channel)) ? config_.fadingDb : 0;
+        double interference = dbmToMw(config_.noiseFloorDbm);
+        bool overlapped = false;
+
+        for (const transmission_t & other : air_) {
+            if (other.id == tx.id || other.src == r) continue;
+            if (other.end <= tx.start || other.start >= tx.end) continue;
+
+            double f = channelOverlap(other.channel, other.rateBps, tx.channel, tx.rateBps);
+            if (f <= 0) continue;
+
+            interference += dbmToMw(other.powerDbm - linkLossDb(other.src, r)) * f;
+            overlapped = true;
+        }
+
+        double sinr = signal - mwToDbm(interference);
+        if (sinr - fade < config_.captureThresholdDb) {
+            if (sinr < config_.captureThresholdDb) {
+                stats_.collisions++;
+            } else {
+                stats_.fadeLost++;
+            }
+            continue;
+        }
+
+        stats_.delivered++;
+        if (overlapped) stats_.captured++;
+        rx->onAirPacket(tx.pkt);
+    }
+}
+
+bool
+RfMedium::faded(uint32_t a, uint32_t b, uint8_t channel)
+{
+    uint64_t lo = a < b ? a : b;
+    uint64_t hi = a < b ? b : a;
+    uint64_t key = (lo << 40) | (hi << 16) | channel;
+
+    /* fades and the gaps between them last exponentially long */
+    double fadeNs = config_.fadingMs * NS_PER_MS;
+    double gapNs = fadeNs * (1 - FADE_DUTY) / FADE_DUTY;
+    sim_time_t now = kernel_.now();
+
+    auto it = fades_.find(key);
+    if (it == fades_.end()) {
+        bool faded = std::uniform_real_distribution<double>(0, 1)(rng_) < FADE_DUTY;
+        double mean = faded ? fadeNs : gapNs;
+        sim_time_t until = now + (sim_time_t) std::exponential_distribution<double>(1 / mean)(rng_);
+        it = fades_.emplace(key, fade_state_t {faded, until}).first;
+    }
+
+    fade_state_t & f = it->second;
+    while (f.until <= now) {
+        f.faded = !f.faded;
+        double mean = f.faded ? fadeNs : gapNs;
+        f.until += 1 + (sim_time_t) std::exponential_distribution<double>(1 / mean)(rng_);
+    }
+    return f.faded;
+}
+
+void
+RfMedium::prune()
+{
+    sim_time_t now = kernel_.now();
+    while (!air_.empty() && air_.front().end + AIR_HISTORY_NS < now) {
+        air_.pop_front();
+    }
+}
@@ -0,0 +1,165 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "sim_board.h"
+
+using namespace rfsim;
+
+SimBoard::SimBoard(Kernel & kernel)
+    : kernel_(kernel), spiClockHz_(DEFAULT_SPI_CLOCK_HZ),
+      selectedAt_(0), deselectedAt_(0), transactionBytes_(0), transactionNop_(false),
+      lastWasPoll_(false), pollAt_(0), pollStatus_(0),
+      parked_(nullptr), parkedAt_(0), pollPeriod_(0)
+{
+    memset(pins_, 0, sizeof(pins_));
+}
+
+void
+SimBoard::attachRadio(Nrf24Chip * chip, uint8_t cePin, uint8_t csnPin)
+{
+    radios_.push_back(radio_wiring_t {chip, cePin, csnPin});
+    /* CSN idles high */
+    pins_[csnPin] = 1;
+    chip->onChange([this]() { chipChanged(); });
+}
+
+void
+SimBoard::pinWrite(uint8_t pin, uint8_t level)
+{
+    if (pin >= sizeof(pins_)) return;
+    pins_[pin] = level;
+
+    for (radio_wiring_t & r : radios_) {
+        if (r.cePin == pin) r.chip->setCE(level);
+        if (r.csnPin == pin) {
+            r.chip->setCSN(level);
+
+            if (!level) {
+                selectedAt_ = kernel_.now();
+                transactionBytes_ = 0;
+            } else {
+                deselectedAt_ = kernel_.now();
+                lastWasPoll_ = transactionBytes_ == 1 && transactionNop_;
+            }
+        }
+    }
+}
+
+uint8_t
+SimBoard::pinRead(uint8_t pin) const
+{
+    return pin < sizeof(pins_) ? pins_[pin] : 0;
+}
+
+void
+SimBoard::spiClock(uint32_t hz)
+{
+    if (hz) spiClockHz_ = hz;
+}
+
+uint8_t
+SimBoard::spiTransfer(uint8_t out)
+{
+    kernel_.advance(8 * NS_PER_S / spiClockHz_ + SPI_BYTE_OVERHEAD_NS);
+
+    Nrf24Chip * selected = nullptr;
+    uint32_t count = 0;
+    for (radio_wiring_t & r : radios_) {
+        if (!pins_[r.csnPin]) {
+            selected = r.chip;
+            count++;
+        }
+    }
+
+    bool nop = transactionBytes_ == 0 && out == nRF24Module::NOP;
+    if (nop && count == 1) awaitStatus(selected);
+
+    /* MISO is pulled up, a selected chip drives it */
+    uint8_t in = 0xFF;
+    for (radio_wiring_t & r : radios_) {
+        if (!pins_[r.csnPin]) in = r.chip->transfer(out);
+    }
+
+    if (transactionBytes_ == 0) transactionNop_ = nop;
+    if (nop) pollStatus_ = in;
+    transactionBytes_++;
+    return in;
+}
+
+void
+SimBoard::awaitStatus(Nrf24Chip * chip)
+{
+    sim_time_t now = kernel_.now();
+
+    /* only the CSN write between this read and the last one */
+    bool spinning = lastWasPoll_ && selectedAt_ - deselectedAt_ == DIGITAL_WRITE_NS && now > pollAt_;
+
+    if (spinning) {
+        pollPeriod_ = now - pollAt_;
+        while (chip->busy() && chip->peekStatus() == pollStatus_) {
+            parked_ = kernel_.current();
+            parkedAt_ = kernel_.now();
+            kernel_.park();
+        }
+    }
+    pollAt_ = kernel_.now();
+}
+
+void
+SimBoard::chipChanged()
+{
+    if (!parked_) return;
+
+    /* a read at the very time of the event still sees the chip as it was */
+    sim_time_t now = kernel_.now();
+    sim_time_t polls = (now >= parkedAt_ ? (now - parkedAt_) / pollPeriod_ : 0) + 1;
+
+    process_t * p = parked_;
+    parked_ = nullptr;
+    kernel_.wake(p, parkedAt_ + polls * pollPeriod_);
+}
+
+int
+SimBoard::serialAvailable() const
+{
+    return serialIn_.size();
+}
+
+int
+SimBoard::serialRead()
+{
+    if (serialIn_.empty()) return -1;
+    uint8_t c = serialIn_.front();
+    serialIn_.pop_front();
+    return c;
+}
+
+int
+SimBoard::serialPeek() const
+{
+    return serialIn_.empty() ? -1 : serialIn_.front();
+}
+
+void
+SimBoard::serialWrite(const char * data, size_t size)
+{
+    serialOut_.append(data, size);
+}
+
+void
+SimBoard::hostWrite(const uint8_t * data, size_t size)
+{
+    serialIn_.insert(serialIn_.end(), data, data + size);
+}
+
+std::string &
+SimBoard::hostOutput()
+{
+    return serialOut_;
+}
+
+Kernel &
+SimBoard::kernel()
+{
+    return kernel_;
+}
@@ -0,0 +1,191 @@
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "sim_kernel.h"
+
+using namespace rfsim;
+
+Kernel * Kernel::active_ = nullptr;
+
+Kernel::Kernel()
+    : lookahead_(0), until_(0), current_(nullptr), now_(0), seq_(0), events_(0), switches_(0)
+{
+}
+
+Kernel::~Kernel()
+{
+    if (active_ == this) active_ = nullptr;
+}
+
+Kernel *
+Kernel::active()
+{
+    return active_;
+}
+
+void
+Kernel::schedule(sim_time_t at, std::function<void()> action)
+{
+    push(at, false, std::move(action));
+}
+
+void
+Kernel::spawn(SimBoard * board, std::function<void()> body, sim_time_t start)
+{
+    processes_.emplace_back(new process_t);
+    process_t * p = processes_.back().get();
+
+    p->stack.resize(PROCESS_STACK_BYTES);
+    p->body = std::move(body);
+    p->board = board;
+    p->local = start;
+    p->finished = false;
+    p->parked = false;
+
+    getcontext(&p->ctx);
+    p->ctx.uc_stack.ss_sp = p->stack.data();
+    p->ctx.uc_stack.ss_size = p->stack.size();
+    /* when the body returns we land back in run() */
+    p->ctx.uc_link = &mainCtx_;
+    makecontext(&p->ctx, &Kernel::trampoline, 0);
+
+    push(start, true, [this, p]() { resume(p); });
+}
+
+void
+Kernel::trampoline()
+{
+    process_t * p = active_->current_;
+    p->body();
+    p->finished = true;
+}
+
+void
+Kernel::run(sim_time_t until)
+{
+    active_ = this;
+    until_ = until;
+
+    while (!queue_.empty() && queue_.top().time <= until) {
+        /* copy out before popping, the action may schedule more events */
+        event_t ev = queue_.top();
+        queue_.pop();
+
+        /* events run in time order, so this is always the earliest of its kind */
+        if (ev.resume) {
+            resumes_.pop();
+        } else {
+            hardware_.pop();
+        }
+
+        now_ = ev.time;
+        ev.action();
+        events_++;
+    }
+
+    if (now_ < until) now_ = until;
+}
+
+sim_time_t
+Kernel::now() const
+{
+    return current_ ? current_->local : now_;
+}
+
+void
+Kernel::advance(sim_time_t dt)
+{
+    if (!current_) return;
+
+    current_->local += dt;
+
+    /* something else has to happen first, step aside until it has */
+    if (current_->local > horizon()) yield();
+}
+
+void
+Kernel::park()
+{
+    process_t * p = current_;
+    if (!p) return;
+
+    p->parked = true;
+    swapcontext(&p->ctx, &mainCtx_);
+}
+
+void
+Kernel::wake(process_t * p, sim_time_t at)
+{
+    if (!p->parked) return;
+    p->parked = false;
+
+    if (at < now()) at = now();
+    p->local = at;
+    push(at, true, [this, p]() { resume(p); });
+}
+
+process_t *
+Kernel::current() const
+{
+    return current_;
+}
+
+void
+Kernel::setLookahead(sim_time_t lookahead)
+{
+    lookahead_ = lookahead;
+}
+
+uint64_t
+Kernel::eventsProcessed() const
+{
+    return events_;
+}
+
+uint64_t
+Kernel::contextSwitches() const
+{
+    return switches_;
+}
+
+void
+Kernel::push(sim_time_t at, bool resume, std::function<void()> action)
+{
+    if (at < now()) at = now();
+
+    queue_.push(event_t {at, seq_++, resume, std::move(action)});
+    if (resume) {
+        resumes_.push(at);
+    } else {
+        hardware_.push(at);
+    }
+}
+
+sim_time_t
+Kernel::horizon() const
+{
+    /* a process with nothing else left to wait for still stops at the end of the run */
+    sim_time_t h = until_;
+    if (!hardware_.empty() && hardware_.top() < h) h = hardware_.top();
+    if (!resumes_.empty() && resumes_.top() + lookahead_ < h) h = resumes_.top() + lookahead_;
+    return h;
+}
+
+void
+Kernel::resume(process_t * p)
+{
+    if (p->finished) return;
+
+    current_ = p;
+    switches_++;
+    swapcontext(&mainCtx_, &p->ctx);
+    current_ = nullptr;
+}
+
+void
+Kernel::yield()
+{
+    process_t * p = current_;
+    push(p->local, true, [this, p]() { resume(p); });
+    swapcontext(&p->ctx, &mainCtx_);
+}
@@ -0,0 +1,829 @@
+#include <Arduino.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "sim_node.h"
+#include "nrf24_radio.h"
+#include "radio_bench.h"
+#include "micro_bench.h"
+#include "token_bucket.h"
+#include "pull_client.h"
+#include "pull_server.h"
+#include "rendezvous.h"
+#include "route.h"
+#include "diversity.h"
+#include "aggregator.h"
+
+using namespace rfsim;
+using namespace nRF24Module;
+
+void
+rfsim::addressBytes(uint32_t address, uint8_t * out)
+{
+    for (int i = 0; i < SIM_ADDRESS_BYTES; ++i) {
+        out[i] = (address >> (8 * i)) & 0xFF;
+    }
+}
+
+SimNode::SimNode(Kernel & kernel, RfMedium & medium, uint32_t id, const node_config_t & config,
+                 std::vector<flow_stats_t> & flows, uint64_t seed)
+    : kernel_(kernel), id_(id), config_(config), flows_(flows), rng_(seed ^ (id * 2654435761u)),
+      board_(kernel), chip_(kernel, medium), second_(kernel, medium), forwarded_(0),
+      pullDoneAt_(0), rendezvousAt_(0), pairedAt_(0), pairedAddress_(0), pullBatch_(UINT32_MAX), harqBlocks_(0),
+      routeStats_ {ROUTE_NONE, ROUTE_COST_MAX, 0, 0, 0}, diversityStats_ {}, aggregateStats_ {}
+{
+    medium.attach(&chip_, config.x, config.y);
+    board_.attachRadio(&chip_, SIM_CE_PIN, SIM_CSN_PIN);
+
+    /* a few centimetres off, the scenario gives it the first one's path loss */
+    if (config.role == ROLE_DIVERSITY_SINK) {
+        medium.attach(&second_, config.x, config.y);
+        board_.attachRadio(&second_, SIM_CE2_PIN, SIM_CSN2_PIN);
+    }
+}
+
+void
+SimNode::start()
+{
+    switch (config_.role) {
+    case ROLE_SOURCE:
+        kernel_.spawn(&board_, [this]() { sourceFirmware(); }, config_.startAt);
+        break;
+    case ROLE_SINK:
+        kernel_.spawn(&board_, [this]() { sinkFirmware(); }, config_.startAt);
+        break;
+    case ROLE_RELAY:
+        kernel_.spawn(&board_, [this]() { relayFirmware(); }, config_.startAt);
+        break;
+    case ROLE_BENCH:
+        kernel_.spawn(&board_, [this]() { benchFirmware(); }, config_.startAt);
+        break;
+    case ROLE_MICRO_BENCH:
+        kernel_.spawn(&board_, [this]() { microBenchFirmware(); }, config_.startAt);
+        break;
+    case ROLE_PULL_SOURCE:
+        kernel_.spawn(&board_, [this]() { pullSourceFirmware(); }, config_.startAt);
+        break;
+    case ROLE_PULL_SINK:
+        kernel_.spawn(&board_, [this]() { pullSinkFirmware(); }, config_.startAt);
+        break;
+    case ROLE_HARQ_SOURCE:
+        kernel_.spawn(&board_, [this]() { harqSourceFirmware(); }, config_.startAt);
+        break;
+    case ROLE_HARQ_SINK:
+        kernel_.spawn(&board_, [this]() { harqSinkFirmware(); }, config_.startAt);
+        break;
+    case ROLE_ROUTER:
+        kernel_.spawn(&board_, [this]() { routerFirmware(); }, config_.startAt);
+        break;
+    case ROLE_DIVERSITY_SOURCE:
+        kernel_.spawn(&board_, [this]() { diversitySourceFirmware(); }, config_.startAt);
+        break;
+    case ROLE_DIVERSITY_SINK:
+        kernel_.spawn(&board_, [this]() { diversitySinkFirmware(); }, config_.startAt);
+        break;
+    case ROLE_AGGREGATE_SOURCE:
+        kernel_.spawn(&board_, [this]() { aggregateSourceFirmware(); }, config_.startAt);
+        break;
+    case ROLE_AGGREGATE_SINK:
+        kernel_.spawn(&board_, [this]() { aggregateSinkFirmware(); }, config_.startAt);
+        break;
+    }
+}
+
+uint32_t
+SimNode::id() const
+{
+    return id_;
+}
+
+const node_config_t &
+SimNode::config() const
+{
+    return config_;
+}
+
+Nrf24Chip &
+SimNode::chip()
+{
+    return chip_;
+}
+
+Nrf24Chip &
+SimNode::secondChip()
+{
+    return second_;
+}
+
+SimBoard &
+SimNode::board()
+{
+    return board_;
+}
+
+uint64_t
+SimNode::forwarded() const
+{
+    return forwarded_;
+}
+
+sim_time_t
+SimNode::pullDoneAt() const
+{
+    return pullDoneAt_;
+}
+
+sim_time_t
+SimNode::rendezvousAt() const
+{
+    return rendezvousAt_;
+}
+
+sim_time_t
+SimNode::pairedAt() const
+{
+    return pairedAt_;
+}
+
+uint32_t
+SimNode::pairedAddress() const
+{
+    return pairedAddress_;
+}
+
+const route_stats_t &
+SimNode::routeStats() const
+{
+    return routeStats_;
+}
+
+const diversity_stats_t &
+SimNode::diversityStats() const
+{
+    return diversityStats_;
+}
+
+const aggregate_stats_t &
+SimNode::aggregateStats() const
+{
+    return aggregateStats_;
+}
+
+/* -----firmware----- */
+
+/* time the computer takes to hand a chunk over, see SerialIO::setFileChunk */
+static uint32_t
+serialChunkUs(uint32_t chunkBytes)
+{
+    /* chunk size byte, handshake both ways, 10 bits per byte on the wire */
+    uint64_t bytes = chunkBytes + 1 + 2;
+    return bytes * 10 * 1000000 / SERIAL_BAUD + SERIAL_TURNAROUND_US;
+}
+
+void
+SimNode::sourceFirmware()
+{
+    uint8_t address[SIM_ADDRESS_BYTES];
+    addressBytes(config_.txAddress, address);
+    if (config_.rendezvous) inviteSink(config_.txChannel, address);
+
+    nRF24 radio(SIM_CE_PIN, SIM_CSN_PIN);
+    radio.begin();
+    radio.setAddressWidth(SIM_ADDRESS_BYTES);
+    radio.setChannel(config_.txChannel);
+    radio.setDataRate(config_.rate);
+    radio.setPALevel(config_.paLevel);
+    radio.setRetries(config_.retryDelay, config_.retryCount);
+    radio.setAutoAck(config_.autoAck);
+    radio.setToTransmitter();
+    radio.setWritingAddress(address);
+
+    std::uniform_int_distribution<uint32_t> jitter(config_.intervalUs / 2, config_.intervalUs + config_.intervalUs / 2);
+    uint32_t chunkPayloads = config_.chunkBytes / FIFO_SZ;
+    uint8_t payload[FIFO_SZ];
+    uint32_t seq = 0;
+
+    TokenBucket shaper;
+    shaper.configure(config_.shapeRate, config_.shapeBurst);
+
+    while (true) {
+        if (chunkPayloads) {
+            if (seq % chunkPayloads == 0) delayMicroseconds(serialChunkUs(config_.chunkBytes));
+        } else if (config_.intervalUs) {
+            delayMicroseconds(jitter(rng_));
+        }
+
+        while (uint32_t wait = shaper.waitUs(FIFO_SZ)) delayMicroseconds(wait);
+
+        /* carrier sense and slots only hold for a payload that goes right away */
+        if (config_.continuousTx && config_.mac != MAC_ALOHA) radio.txStandBy();
+        waitForTurn(radio);
+
+        uint32_t now = micros();
+        memset(payload, 0xA5, sizeof(payload));
+        memcpy(payload + HDR_FLOW_OFFSET, &config_.flow, sizeof(config_.flow));
+        memcpy(payload + HDR_SEQ_OFFSET, &seq, sizeof(seq));
+        memcpy(payload + HDR_TIME_OFFSET, &now, sizeof(now));
+
+        if (config_.continuousTx) {
+            radio.writeFastSPI((char *) payload, FIFO_SZ);
+        } else {
+            radio.writeSPI((char *) payload, FIFO_SZ);
+        }
+        shaper.consume(FIFO_SZ);
+        flows_[config_.flow].sent++;
+        seq++;
+
+        if (chunkPayloads) delayMicroseconds(config_.intervalUs);
+    }
+}
+
+void
+SimNode::sinkFirmware()
+{
+    uint8_t address[SIM_ADDRESS_BYTES];
+    uint8_t channel = config_.rxChannel;
+    addressBytes(config_.rxAddress, address);
+    if (config_.rendezvous) joinSource(channel, address);
+
+    nRF24 radio(SIM_CE_PIN, SIM_CSN_PIN);
+    radio.begin();
+    radio.setAddressWidth(SIM_ADDRESS_BYTES);
+    radio.setDataRate(config_.rate);
+    listen(radio, channel, address);
+
+    uint8_t payload[FIFO_SZ];
+
+    while (true) {
+        if (payloadReady(radio)) {
+            radio.readSPI(payload, FIFO_SZ);
+            deliver(payload, FIFO_SZ);
+        } else {
+            delayMicroseconds(config_.pollUs);
+        }
+    }
+}
+
+void
+SimNode::relayFirmware()
+{
+    uint8_t rxAddress[SIM_ADDRESS_BYTES];
+    uint8_t txAddress[SIM_ADDRESS_BYTES];
+    addressBytes(config_.rxAddress, rxAddress);
+    addressBytes(config_.txAddress, txAddress);
+
+    nRF24 radio(SIM_CE_PIN, SIM_CSN_PIN);
+    radio.begin();
+    radio.setAddressWidth(SIM_ADDRESS_BYTES);
+    radio.setDataRate(config_.rate);
+    listen(radio, config_.rxChannel, rxAddress);
+
+    uint8_t payload[FIFO_SZ];
+
+    while (true) {
+        if (!payloadReady(radio)) {
+            delayMicroseconds(config_.pollUs);
+            continue;
+        }
+
+        radio.readSPI(payload, FIFO_SZ);
+
+        /* half duplex: anything arriving while forwarding is lost */
+        radio.setToTransmitter();
+        radio.setChannel(config_.txChannel);
+        radio.setWritingAddress(txAddress);
+        waitForTurn(radio);
+        radio.writeSPI((char *) payload, FIFO_SZ);
+        forwarded_++;
+
+        /* setWritingAddress also took over pipe 0, so set it back up */
+        listen(radio, config_.rxChannel, rxAddress);
+    }
+}
+
+/* the file a pull source serves, every byte a function of where it is */
+#define PULL_FILE_BYTE(offset) ((uint8_t) ((offset) * 31 + 7))
+
+/*
+ *  the driver's enums carry register bits, the Radio ones are plain
+ */
+static radio_data_rate_e
+radioRate(const node_config_t & config)
+{
+    return config.rate == DATA_RATE_2MBPS ? RADIO_2MBPS
+         : config.rate == DATA_RATE_1MBPS ? RADIO_1MBPS : RADIO_250KBPS;
+}
+
+/*
+ *  as configureRadio() in the mains
+ */
+static void
+configureRadio(NRF24Radio & radio, const node_config_t & config, uint8_t channel)
+{
+    radio.begin();
+    radio.setAddressWidth(SIM_ADDRESS_BYTES);
+    radio.setChannel(channel);
+    radio.setPALevel((radio_pa_level_e) (config.paLevel >> RF_PWR_0));
+    radio.setDataRate(radioRate(config));
+    radio.setRetries(config.retryDelay, config.retryCount);
+}
+
+void
+SimNode::inviteSink(uint8_t channel, uint8_t * address)
+{
+    uint8_t reply[SIM_ADDRESS_BYTES];
+    for (int i = 0; i < SIM_ADDRESS_BYTES; ++i) reply[i] = ~address[i];
+
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, RENDEZVOUS_CHANNEL);
+    rendezvousAt_ = kernel_.now();
+
+    /* as invite() in the TX main */
+    while (!inviteReceiver(radio, channel, address, reply)) {}
+}
+
+void
+SimNode::joinSource(uint8_t & channel, uint8_t * address)
+{
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, RENDEZVOUS_CHANNEL);
+    listenForInvite(radio);
+    rendezvousAt_ = kernel_.now();
+
+    /* as waitForInvite() in the RX main */
+    char payload[FIFO_SZ];
+    while (true) {
+        if (!radio.available()) {
+            delayMicroseconds(config_.pollUs);
+            continue;
+        }
+        radio.read(payload, FIFO_SZ);
+        if (payload[0] == RENDEZVOUS_CHAR && joinSender(radio, payload, channel, address)) break;
+    }
+    pairedAt_ = kernel_.now();
+    for (int i = 0; i < SIM_ADDRESS_BYTES; ++i) pairedAddress_ |= (uint32_t) address[i] << (8 * i);
+}
+
+void
+SimNode::benchFirmware()
+{
+    uint8_t address[SIM_ADDRESS_BYTES];
+    addressBytes(config_.txAddress, address);
+
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, config_.txChannel);
+    radio.openWritingPipe(address);
+    radio.stopListening();
+
+    printBenchResult(radio, benchmarkRadio(radio, config_.benchPayloads));
+}
+
+void
+SimNode::microBenchFirmware()
+{
+    /* what micro_bench.py sends after the handshake */
+    std::vector<uint8_t> bytes(MICRO_SERIAL_BYTES, MICRO_FILL_CHAR);
+    board_.hostWrite(bytes.data(), bytes.size());
+
+    MicroBench bench(SIM_CE_PIN, SIM_CSN_PIN);
+    bench.run(config_.microCalls);
+}
+
+bool
+SimNode::pullRead(void * ctx, uint32_t block, char * data)
+{
+    SimNode * node = (SimNode *) ctx;
+
+    /* a serial round trip per batch, as the TX main fetches blocks */
+    if (block / PULL_FETCH_BLOCKS != node->pullBatch_) {
+        node->pullBatch_ = block / PULL_FETCH_BLOCKS;
+        delayMicroseconds(serialChunkUs(PULL_FETCH_BLOCKS * PULL_BLOCK_BYTES));
+    }
+
+    uint32_t offset = block * PULL_BLOCK_BYTES;
+    for (uint32_t i = 0; i < PULL_BLOCK_BYTES; ++i) {
+        data[i] = offset + i < node->config_.pullBytes ? PULL_FILE_BYTE(offset + i) : 0;
+    }
+    return true;
+}
+
+void
+SimNode::pullSourceFirmware()
+{
+    uint8_t address[SIM_ADDRESS_BYTES];
+    addressBytes(config_.txAddress, address);
+
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, config_.txChannel);
+
+    TokenBucket shaper;
+    shaper.configure(config_.shapeRate, config_.shapeBurst);
+
+    PullServer server(radio);
+    server.begin(address, config_.pullBytes, "bin", pullRead, this);
+
+    while (true) {
+        if (!server.poll()) {
+            delayMicroseconds(config_.pollUs);
+            continue;
+        }
+
+        while (uint32_t wait = shaper.waitUs(FIFO_SZ)) delayMicroseconds(wait);
+        server.sendNext();
+        shaper.consume(FIFO_SZ);
+        flows_[config_.flow].sent++;
+    }
+}
+
+void
+SimNode::pullSinkFirmware()
+{
+    uint8_t address[SIM_ADDRESS_BYTES];
+    uint8_t sources[PULL_MAX_SOURCES][PULL_ADDRESS_BYTES];
+    addressBytes(config_.rxAddress, address);
+
+    uint8_t count = config_.pullSources.size() < PULL_MAX_SOURCES ? config_.pullSources.size() : PULL_MAX_SOURCES;
+    for (uint8_t s = 0; s < count; ++s) {
+        addressBytes(config_.pullSources[s], sources[s]);
+    }
+
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, config_.rxChannel);
+
+    /* the sim keeps no file, the scheduler's counts are the stats */
+    PullClient client(radio);
+    client.begin(address, count, sources, [](void *, uint32_t, const char *, uint8_t) {}, nullptr);
+
+    while (!client.describe()) delayMicroseconds(config_.pollUs);
+
+    PullScheduler & scheduler = client.getScheduler();
+    bool more = true;
+    while (more) {
+        more = client.step();
+        if (more) delayMicroseconds(config_.pollUs);
+
+        /* source s serves flow s */
+        for (uint8_t s = 0; s < count; ++s) {
+            flows_[s].delivered = scheduler.getSource(s)->fresh;
+            flows_[s].bytes = (uint64_t) scheduler.getSource(s)->fresh * PULL_BLOCK_BYTES;
+        }
+    }
+    pullDoneAt_ = kernel_.now();
+}
+
+/* block n of the stream a HARQ source sends, so the sink can check what it got */
+static void
+harqBlock(uint64_t n, char * out)
+{
+    for (uint32_t i = 0; i < HARQ_BLOCK_BYTES; ++i) {
+        out[i] = (char) (n * 31 + i * 7 + 1);
+    }
+}
+
+void
+SimNode::harqSourceFirmware()
+{
+    /* reports come back to the link address turned around */
+    uint8_t address[SIM_ADDRESS_BYTES];
+    uint8_t receiver[SIM_ADDRESS_BYTES];
+    addressBytes(~config_.txAddress, address);
+    addressBytes(config_.txAddress, receiver);
+
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, config_.txChannel);
+
+    TokenBucket shaper;
+    shaper.configure(config_.shapeRate, config_.shapeBurst);
+
+    HarqSender sender(radio);
+    sender.begin(address, receiver, config_.harqMode, config_.harqParity, [](void * ctx) {
+        TokenBucket * shaper = (TokenBucket *) ctx;
+        while (uint32_t wait = shaper->waitUs(FIFO_SZ)) delayMicroseconds(wait);
+        shaper->consume(FIFO_SZ);
+    }, &shaper);
+
+    char blocks[HARQ_GROUP_BLOCKS * HARQ_BLOCK_BYTES];
+    uint64_t next = 0;
+
+    while (true) {
+        for (uint32_t j = 0; j < config_.harqWindow; ++j) {
+            harqBlock(next + j, blocks + j * HARQ_BLOCK_BYTES);
+        }
+
+        /* blocks of the file, so the pdr is what arrived intact and parity only costs goodput */
+        while (!sender.sendGroup(blocks, config_.harqWindow)) {}
+        flows_[config_.flow].sent += config_.harqWindow;
+        next += config_.harqWindow;
+    }
+}
+
+void
+SimNode::harqDeliver(void * ctx, const char * data, uint8_t size)
+{
+    SimNode * node = (SimNode *) ctx;
+    char expected[HARQ_BLOCK_BYTES];
+    harqBlock(node->harqBlocks_++, expected);
+
+    /* blocks HARQ_FEC could not recover come as zeros, they are not goodput */
+    if (memcmp(data, expected, size)) return;
+
+    flow_stats_t & f = node->flows_[node->config_.flow];
+    f.delivered++;
+    f.bytes += size;
+}
+
+void
+SimNode::harqSinkFirmware()
+{
+    uint8_t address[SIM_ADDRESS_BYTES];
+    addressBytes(config_.rxAddress, address);
+
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, config_.rxChannel);
+
+    HarqReceiver receiver(radio);
+    receiver.begin(address, harqDeliver, this);
+
+    while (receiver.step()) {
+        delayMicroseconds(config_.pollUs);
+    }
+}
+
+void
+SimNode::routeDeliver(void * ctx, uint8_t origin, const char * data)
+{
+    (void) origin;
+    ((SimNode *) ctx)->deliver((const uint8_t *) data, ROUTE_DATA_BYTES);
+}
+
+void
+SimNode::routerFirmware()
+{
+    uint8_t mesh[SIM_ADDRESS_BYTES];
+    addressBytes(config_.txAddress, mesh);
+
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, config_.txChannel);
+
+    Router router(radio);
+    router.begin(id_, mesh, config_.routeSink, radioRate(config_), routeDeliver, this);
+
+    std::uniform_int_distribution<uint32_t> jitter(config_.intervalUs / 2, config_.intervalUs + config_.intervalUs / 2);
+    uint32_t nextSend = micros() + jitter(rng_);
+    uint8_t payload[ROUTE_DATA_BYTES];
+    uint32_t seq = 0;
+
+    while (true) {
+        router.step();
+
+        if (config_.routeSource && (int32_t) (micros() - nextSend) >= 0) {
+            uint32_t now = micros();
+            memset(payload, 0xA5, sizeof(payload));
+            memcpy(payload + HDR_FLOW_OFFSET, &config_.flow, sizeof(config_.flow));
+            memcpy(payload + HDR_SEQ_OFFSET, &seq, sizeof(seq));
+            memcpy(payload + HDR_TIME_OFFSET, &now, sizeof(now));
+
+            router.send((const char *) payload);
+            flows_[config_.flow].sent++;
+            seq++;
+            nextSend = now + jitter(rng_);
+        } else {
+            delayMicroseconds(config_.pollUs);
+        }
+
+        forwarded_ = router.getForwarded();
+        routeStats_ = route_stats_t {router.getParent(), router.getCost(), router.getDropped(),
+                                     router.getDuplicates(), router.getParentChanges()};
+    }
+}
+
+void
+SimNode::diversitySourceFirmware()
+{
+    uint8_t address[SIM_ADDRESS_BYTES];
+    addressBytes(config_.txAddress, address);
+
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, config_.txChannel);
+    radio.openWritingPipe(address);
+
+    /* as the TX main's sendPayload() with DIVERSITY */
+    DiversitySender sender(radio);
+    sender.begin(config_.txChannel, config_.pairedChannel);
+
+    std::uniform_int_distribution<uint32_t> jitter(config_.intervalUs / 2, config_.intervalUs + config_.intervalUs / 2);
+    char payload[FIFO_SZ];
+    uint32_t seq = 0;
+
+    TokenBucket shaper;
+    shaper.configure(config_.shapeRate, config_.shapeBurst);
+
+    while (true) {
+        if (config_.intervalUs) delayMicroseconds(jitter(rng_));
+        while (uint32_t wait = shaper.waitUs(FIFO_SZ)) delayMicroseconds(wait);
+
+        uint32_t now = micros();
+        memset(payload, 0xA5, sizeof(payload));
+        memcpy(payload + HDR_FLOW_OFFSET, &config_.flow, sizeof(config_.flow));
+        memcpy(payload + HDR_SEQ_OFFSET, &seq, sizeof(seq));
+        memcpy(payload + HDR_TIME_OFFSET, &now, sizeof(now));
+
+        sender.send(payload);
+        shaper.consume(FIFO_SZ);
+        flows_[config_.flow].sent++;
+        seq++;
+    }
+}
+
+void
+SimNode::diversitySinkFirmware()
+{
+    uint8_t address[SIM_ADDRESS_BYTES];
+    addressBytes(config_.rxAddress, address);
+
+    NRF24Radio first(SIM_CE_PIN, SIM_CSN_PIN);
+    NRF24Radio second(SIM_CE2_PIN, SIM_CSN2_PIN);
+    configureRadio(first, config_, config_.rxChannel);
+    configureRadio(second, config_, config_.pairedChannel);
+
+    /* as the RX main's receive loop with DIVERSITY */
+    DiversityReceiver receiver(first, second);
+    receiver.begin(config_.rxChannel, config_.pairedChannel, address);
+
+    char payload[FIFO_SZ];
+
+    while (true) {
+        if (!receiver.available()) {
+            delayMicroseconds(config_.pollUs);
+            continue;
+        }
+
+        receiver.read(payload);
+        deliver((const uint8_t *) payload, DIVERSITY_FILE_BYTES);
+
+        for (uint8_t i = 0; i < DIVERSITY_RADIOS; ++i) diversityStats_.first[i] = receiver.getFirst(i);
+        diversityStats_.duplicates = receiver.getDuplicates();
+        diversityStats_.missed = receiver.getMissed();
+    }
+}
+
+void
+SimNode::aggregateSourceFirmware()
+{
+    uint8_t address[SIM_ADDRESS_BYTES];
+    addressBytes(config_.txAddress, address);
+
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, config_.txChannel);
+    radio.openWritingPipe(address);
+    radio.stopListening();
+
+    /* as the TX main's sendMessages() */
+    Aggregator aggregator(radio);
+    aggregator.begin();
+    for (uint8_t flow = 0; flow < AGGREGATE_FLOWS; ++flow) aggregator.setDeadline(flow, config_.messageDeadlineUs);
+
+    /* every message is its flow, its length and its bytes on the serial link */
+    uint32_t serialUs = (2 + config_.messageBytes) * 10 * 1000000ull / SERIAL_BAUD;
+    uint32_t backlogUs = SERIAL_RX_BUFFER / (2 + config_.messageBytes) * serialUs;
+    std::uniform_int_distribution<uint32_t> jitter(config_.intervalUs / 2, config_.intervalUs + config_.intervalUs / 2);
+
+    char message[AGGREGATE_MAX_MESSAGE];
+    memset(message, 0xA5, sizeof(message));
+    uint32_t arrives = micros();
+    uint32_t seq = 0;
+
+    while (true) {
+        if ((int32_t) (micros() - arrives) < 0) {
+            aggregator.poll();
+            aggregateStats_ = aggregate_stats_t {aggregator.getPayloads(), aggregator.getMessages()};
+            delayMicroseconds(config_.pollUs);
+            continue;
+        }
+
+        /* the UART buffer overflowed while the radio held us up */
+        if (micros() - arrives > backlogUs) {
+            flows_[config_.flow].sent++;
+            arrives += std::max(serialUs, config_.intervalUs ? jitter(rng_) : 0);
+            continue;
+        }
+
+        memcpy(message + MSG_TIME_OFFSET, &arrives, sizeof(arrives));
+        aggregator.add(seq % SIM_MESSAGE_FLOWS, message, config_.messageBytes);
+        aggregateStats_ = aggregate_stats_t {aggregator.getPayloads(), aggregator.getMessages()};
+        flows_[config_.flow].sent++;
+        seq++;
+        arrives += std::max(serialUs, config_.intervalUs ? jitter(rng_) : 0);
+    }
+}
+
+void
+SimNode::aggregateSinkFirmware()
+{
+    uint8_t address[SIM_ADDRESS_BYTES];
+    addressBytes(config_.rxAddress, address);
+
+    NRF24Radio radio(SIM_CE_PIN, SIM_CSN_PIN);
+    configureRadio(radio, config_, config_.rxChannel);
+    radio.openReadingPipe(0, address);
+    radio.startListening();
+
+    /* as the RX main's receiveMessages() */
+    char payload[AGGREGATE_PAYLOAD_BYTES];
+
+    while (true) {
+        if (!radio.available()) {
+            delayMicroseconds(config_.pollUs);
+            continue;
+        }
+
+        radio.read(payload, AGGREGATE_PAYLOAD_BYTES);
+        if (payload[0] == AGGREGATE_CHAR) splitAggregate(payload, messageDeliver, this);
+    }
+}
+
+void
+SimNode::messageDeliver(void * ctx, uint8_t flow, const char * message, uint8_t size)
+{
+    (void) flow;
+    SimNode * node = (SimNode *) ctx;
+
+    uint32_t sentAt;
+    memcpy(&sentAt, message + MSG_TIME_OFFSET, sizeof(sentAt));
+
+    uint32_t latency = (uint32_t) micros() - sentAt;
+    flow_stats_t & f = node->flows_[node->config_.flow];
+    f.delivered++;
+    f.bytes += size;
+    f.latencySumUs += latency;
+    if (latency > f.latencyMaxUs) f.latencyMaxUs = latency;
+    f.latency.record(latency);
+}
+
+void
+SimNode::waitForTurn(nRF24 & radio)
+{
+    switch (config_.mac) {
+    case MAC_ALOHA:
+        break;
+
+    case MAC_CSMA:
+        for (uint32_t attempt = 0; attempt < CSMA_MAX_ATTEMPTS; ++attempt) {
+            radio.setToReceiver();
+            delayMicroseconds(RPD_SETTLE_US);
+            bool busy = radio.carrierDetected();
+            radio.setToTransmitter();
+            if (!busy) break;
+
+            std::uniform_int_distribution<uint32_t> backoff(0, config_.csmaBackoffUs << attempt);
+            delayMicroseconds(backoff(rng_));
+        }
+        break;
+
+    case MAC_TDMA: {
+        uint64_t frame = (uint64_t) config_.tdmaSlots * config_.tdmaSlotUs;
+        uint64_t slotStart = (uint64_t) config_.tdmaSlot * config_.tdmaSlotUs;
+        uint64_t pos = micros() % frame;
+
+        if (pos < slotStart || pos > slotStart + config_.tdmaGuardUs) {
+            delayMicroseconds((slotStart + frame - pos) % frame);
+        }
+        break;
+    }
+    }
+}
+
+void
+SimNode::listen(nRF24 & radio, uint8_t channel, uint8_t * address)
+{
+    radio.setChannel(channel);
+    radio.setReadingPipeAddr(0, address);
+    radio.setToReceiver();
+}
+
+bool
+SimNode::payloadReady(nRF24 & radio)
+{
+    /* RX_P_NO reads '111' while the RX FIFO is empty */
+    return (radio.status() & STATUS_RX_P_NO_MASK) != STATUS_RX_P_NO_MASK;
+}
+
+void
+SimNode::deliver(const uint8_t * payload, uint32_t bytes)
+{
+    uint16_t flow;
+    uint32_t sentAt;
+    memcpy(&flow, payload + HDR_FLOW_OFFSET, sizeof(flow));
+    memcpy(&sentAt, payload + HDR_TIME_OFFSET, sizeof(sentAt));
+
+    /* stray payloads from another flow sharing the address */
+    if (flow >= flows_.size()) return;
+
+    uint32_t latency = (uint32_t) micros() - sentAt;
+    flow_stats_t & f = flows_[flow];
+    f.delivered++;
+    f.bytes += bytes;
+    f.latencySumUs += latency;
+    if (latency > f.latencyMaxUs) f.latencyMaxUs = latency;
+    f.latency.record(latency);
+}
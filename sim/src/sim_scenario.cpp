@@ -0,0 +1,742 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+
+#include "Arduino.h"
+#include "sim_scenario.h"
+#include "link_profile.h"
+
+using namespace rfsim;
+using namespace nRF24Module;
+
+/* sources boot after the sinks, staggered so they do not start in lockstep */
+#define SOURCE_BOOT_MIN_NS  (10 * NS_PER_MS)
+#define SOURCE_BOOT_SPAN_NS (10 * NS_PER_MS)
+
+/* with a rendezvous the sinks boot anywhere in this, before or after their source */
+#define RENDEZVOUS_BOOT_SPAN_NS (40 * NS_PER_MS)
+
+/* how long after a fade the routes count as settling */
+#define FADE_SETTLE_NS NS_PER_S
+
+/* sinks sharing a channel in a star are spread this far around the centre */
+#define STAR_SINK_SPREAD_M 0.5
+
+/* TDMA slack per slot on top of the payload airtime and PLL settling */
+#define TDMA_SLOT_MARGIN_US 500
+
+/* 1 byte preamble, 4 byte address, 9 bit PCF, 32 byte payload, 1 byte CRC */
+#define PAYLOAD_AIR_BITS (8 + 8 * SIM_ADDRESS_BYTES + 9 + 8 * FIFO_SZ + 8)
+
+/* an ACK is the same frame without a payload, the shortest thing on the air */
+#define ACK_AIR_BITS (8 + 8 * SIM_ADDRESS_BYTES + 9 + 8)
+
+static uint32_t
+rateBps(data_rate rate)
+{
+    switch (rate) {
+    case DATA_RATE_250KBPS:
+        return 250000;
+    case DATA_RATE_2MBPS:
+        return 2000000;
+    default:
+        return 1000000;
+    }
+}
+
+/* multiplying by an odd constant is a bijection, so links never share an address */
+static uint32_t
+linkAddress(uint32_t link)
+{
+    return 0xC5A50000u ^ (link * 0x9E3779B1u);
+}
+
+scenario_config_t
+rfsim::defaultScenarioConfig()
+{
+    scenario_config_t config;
+    config.topology = TOPOLOGY_PAIRS;
+    config.nodes = 20;
+    config.areaM = 30.0;
+    config.linkDistanceM = 5.0;
+    /* the mains default to the middle of the band */
+    config.channels = {76};
+    config.rate = DATA_RATE_250KBPS;
+    config.mac = MAC_ALOHA;
+    config.intervalUs = 20000;
+    config.csmaBackoffUs = 1000;
+    config.tdmaSlotUs = 0;
+    config.autoAck = false;
+    config.continuousTx = false;
+    config.rendezvous = false;
+    /* what the TX main asks RF24 for */
+    config.retryDelay = 15;
+    config.retryCount = 15;
+    config.paLevel = PA_LEVEL_MAX;
+    config.chunkBytes = 0;
+    config.shapeRate = 0;
+    config.shapeBurst = PROFILE_LINK_BURST;
+    config.benchPayloads = 0;
+    config.microCalls = 0;
+    config.pullBytes = 65536;
+    config.harq = false;
+    config.harqMode = HARQ_HYBRID;
+    config.harqParity = 4;
+    config.harqWindow = HARQ_GROUP_BLOCKS;
+    config.fadeAt = 0;
+    config.fadeDb = 30.0;
+    config.diversity = DIVERSITY_OFF;
+    config.messageBytes = 0;
+    config.messageDeadlineUs = AGGREGATE_DEADLINE_US;
+    config.seconds = 10.0;
+    config.seed = 1;
+    config.medium = defaultMediumConfig();
+    config.replay = nullptr;
+    return config;
+}
+
+Scenario::Scenario(const scenario_config_t & config)
+    : config_(config), medium_(kernel_, config.medium), wallSeconds_(0), fadedNode_(UINT32_MAX), fadedForwarded_(0)
+{
+    std::mt19937 rng(config_.seed);
+    randomSeed(config_.seed);
+
+    node_config_t base;
+    base.role = ROLE_SINK;
+    base.x = 0;
+    base.y = 0;
+    base.flow = 0;
+    base.rxChannel = config_.channels[0];
+    base.rxAddress = 0;
+    base.txChannel = config_.channels[0];
+    base.txAddress = 0;
+    base.rate = config_.rate;
+    base.mac = config_.mac;
+    base.intervalUs = config_.intervalUs;
+    base.csmaBackoffUs = config_.csmaBackoffUs;
+    base.tdmaSlot = 0;
+    base.tdmaSlots = 1;
+    base.tdmaSlotUs = slotUs();
+    base.tdmaGuardUs = TDMA_SLOT_MARGIN_US / 2;
+    base.autoAck = config_.autoAck;
+    base.continuousTx = config_.continuousTx;
+    base.rendezvous = config_.rendezvous;
+    base.retryDelay = config_.retryDelay;
+    base.retryCount = config_.retryCount;
+    base.paLevel = config_.paLevel;
+    base.chunkBytes = config_.chunkBytes;
+    base.shapeRate = config_.shapeRate;
+    base.shapeBurst = config_.shapeBurst;
+    base.benchPayloads = config_.benchPayloads;
+    base.microCalls = config_.microCalls;
+    base.pullBytes = config_.pullBytes;
+    base.harqMode = config_.harqMode;
+    base.harqParity = config_.harqParity;
+    base.harqWindow = config_.harqWindow;
+    base.routeSink = false;
+    base.routeSource = false;
+    base.pairedChannel = config_.channels[0];
+    base.messageBytes = config_.messageBytes;
+    base.messageDeadlineUs = config_.messageDeadlineUs;
+    /* the RX FIFO holds three payloads, polling once per payload never overflows it */
+    base.pollUs = airtimeUs();
+    base.startAt = 0;
+
+    kernel_.setLookahead((sim_time_t) ACK_AIR_BITS * NS_PER_S / rateBps(config_.rate));
+
+    switch (config_.topology) {
+    case TOPOLOGY_PAIRS:
+        buildPairs(rng, base);
+        break;
+    case TOPOLOGY_STAR:
+        buildStar(rng, base);
+        break;
+    case TOPOLOGY_CHAIN:
+        buildChain(rng, base);
+        break;
+    case TOPOLOGY_PULL:
+        buildPull(rng, base);
+        break;
+    case TOPOLOGY_MESH:
+        buildMesh(rng, base);
+        break;
+    }
+}
+
+uint32_t
+Scenario::airtimeUs() const
+{
+    return (uint64_t) PAYLOAD_AIR_BITS * 1000000 / rateBps(config_.rate);
+}
+
+uint32_t
+Scenario::slotUs() const
+{
+    if (config_.tdmaSlotUs) return config_.tdmaSlotUs;
+    return airtimeUs() + T_STBY2A_NS / NS_PER_US + TDMA_SLOT_MARGIN_US;
+}
+
+uint32_t
+Scenario::addNode(const node_config_t & config)
+{
+    uint32_t id = nodes_.size();
+    nodes_.emplace_back(new SimNode(kernel_, medium_, id, config, flows_, config_.seed));
+    return id;
+}
+
+void
+Scenario::buildPairs(std::mt19937 & rng, node_config_t base)
+{
+    std::uniform_real_distribution<double> pos(0, config_.areaM);
+    std::uniform_real_distribution<double> angle(0, 2 * M_PI);
+    std::uniform_int_distribution<sim_time_t> boot(0, SOURCE_BOOT_SPAN_NS);
+    std::uniform_int_distribution<sim_time_t> sinkBoot(0, RENDEZVOUS_BOOT_SPAN_NS);
+
+    uint32_t pairs = config_.nodes / 2;
+    uint32_t nch = config_.channels.size();
+
+    for (uint32_t i = 0; i < pairs; ++i) {
+        uint8_t ch = config_.channels[i % nch];
+        uint32_t address = linkAddress(i);
+        double a = angle(rng);
+
+        node_config_t src = base;
+        src.role = config_.harq ? ROLE_HARQ_SOURCE : config_.benchPayloads ? ROLE_BENCH : ROLE_SOURCE;
+        if (config_.diversity != DIVERSITY_OFF) src.role = ROLE_DIVERSITY_SOURCE;
+        if (config_.messageBytes) src.role = ROLE_AGGREGATE_SOURCE;
+        if (config_.microCalls && i == 0) src.role = ROLE_MICRO_BENCH;
+        src.x = pos(rng);
+        src.y = pos(rng);
+        src.flow = i;
+        src.txChannel = ch;
+        src.txAddress = address;
+        src.tdmaSlot = i / nch;
+        src.tdmaSlots = (pairs + nch - 1) / nch;
+        src.startAt = SOURCE_BOOT_MIN_NS + boot(rng);
+
+        node_config_t dst = base;
+        dst.role = config_.harq ? ROLE_HARQ_SINK : ROLE_SINK;
+        if (config_.diversity != DIVERSITY_OFF) dst.role = ROLE_DIVERSITY_SINK;
+        if (config_.messageBytes) dst.role = ROLE_AGGREGATE_SINK;
+        dst.flow = i;
+        dst.x = src.x + config_.linkDistanceM * cos(a);
+        dst.y = src.y + config_.linkDistanceM * sin(a);
+        dst.rxChannel = ch;
+        dst.rxAddress = address;
+        if (config_.rendezvous) dst.startAt = sinkBoot(rng);
+
+        src.pairedChannel = (config_.diversity == DIVERSITY_PAIRED) ? diversityChannel(ch) : ch;
+        dst.pairedChannel = src.pairedChannel;
+
+        flows_.push_back(flow_stats_t {0, 0, ch, 0, 0, 0, 0, 0});
+        flows_.back().src = addNode(src);
+        flows_.back().dst = addNode(dst);
+    }
+
+    /*
+     *  A second radio a few centimetres from the first shares its path
+     *  loss and shadowing, only the fades of the medium are its own
+     */
+    for (const flow_stats_t & f : flows_) {
+        SimNode & dst = *nodes_[f.dst];
+        if (dst.config().role != ROLE_DIVERSITY_SINK) continue;
+
+        uint32_t first = dst.chip().radioIndex();
+        uint32_t second = dst.secondChip().radioIndex();
+        for (uint32_t r = 0; r < medium_.radios(); ++r) {
+            if (r != first && r != second) medium_.setLinkLoss(second, r, medium_.linkLossDb(first, r));
+        }
+    }
+}
+
+void
+Scenario::buildStar(std::mt19937 & rng, node_config_t base)
+{
+    std::uniform_real_distribution<double> pos(0, config_.areaM);
+    std::uniform_int_distribution<sim_time_t> boot(0, SOURCE_BOOT_SPAN_NS);
+
+    uint32_t nch = config_.channels.size();
+    if (nch >= config_.nodes) nch = config_.nodes / 2;
+    if (nch == 0) nch = 1;
+
+    std::vector<uint32_t> sinks;
+    for (uint32_t c = 0; c < nch; ++c) {
+        node_config_t dst = base;
+        dst.role = ROLE_SINK;
+        dst.x = config_.areaM / 2 + STAR_SINK_SPREAD_M * cos(2 * M_PI * c / nch);
+        dst.y = config_.areaM / 2 + STAR_SINK_SPREAD_M * sin(2 * M_PI * c / nch);
+        dst.rxChannel = config_.channels[c];
+        dst.rxAddress = linkAddress(c);
+        sinks.push_back(addNode(dst));
+    }
+
+    uint32_t sources = config_.nodes - nch;
+    for (uint32_t i = 0; i < sources; ++i) {
+        uint32_t c = i % nch;
+
+        node_config_t src = base;
+        src.role = config_.benchPayloads ? ROLE_BENCH : ROLE_SOURCE;
+        src.x = pos(rng);
+        src.y = pos(rng);
+        src.flow = i;
+        src.txChannel = config_.channels[c];
+        src.txAddress = linkAddress(c);
+        src.tdmaSlot = i / nch;
+        src.tdmaSlots = (sources + nch - 1) / nch;
+        src.startAt = SOURCE_BOOT_MIN_NS + boot(rng);
+
+        flows_.push_back(flow_stats_t {0, sinks[c], src.txChannel, 0, 0, 0, 0, 0});
+        flows_.back().src = addNode(src);
+    }
+}
+
+void
+Scenario::buildChain(std::mt19937 & rng, node_config_t base)
+{
+    (void) rng;
+
+    uint32_t nch = config_.channels.size();
+    uint32_t hops = config_.nodes - 1;
+
+    /* neighbouring hops hear each other, so TDMA rotates three slots */
+    base.tdmaSlots = 3;
+
+    flows_.push_back(flow_stats_t {0, 0, config_.channels[0], 0, 0, 0, 0, 0});
+
+    for (uint32_t k = 0; k < config_.nodes; ++k) {
+        node_config_t n = base;
+        n.x = k * config_.linkDistanceM;
+        n.y = config_.areaM / 2;
+        n.tdmaSlot = k % 3;
+
+        if (k > 0) {
+            n.rxChannel = config_.channels[(k - 1) % nch];
+            n.rxAddress = linkAddress(k - 1);
+        }
+        if (k < hops) {
+            n.txChannel = config_.channels[k % nch];
+            n.txAddress = linkAddress(k);
+        }
+
+        if (k == 0) {
+            n.role = config_.benchPayloads ? ROLE_BENCH : ROLE_SOURCE;
+            n.startAt = SOURCE_BOOT_MIN_NS;
+            flows_[0].src = addNode(n);
+        } else if (k == hops) {
+            n.role = ROLE_SINK;
+            flows_[0].dst = addNode(n);
+        } else {
+            n.role = ROLE_RELAY;
+            addNode(n);
+        }
+    }
+}
+
+void
+Scenario::buildPull(std::mt19937 & rng, node_config_t base)
+{
+    std::uniform_int_distribution<sim_time_t> boot(0, SOURCE_BOOT_SPAN_NS);
+
+    uint8_t ch = config_.channels[0];
+    uint32_t sources = config_.nodes - 1;
+
+    /* the sink boots last, once every source is listening */
+    node_config_t dst = base;
+    dst.role = ROLE_PULL_SINK;
+    dst.x = config_.areaM / 2;
+    dst.y = config_.areaM / 2;
+    dst.rxChannel = ch;
+    dst.rxAddress = linkAddress(sources);
+    dst.startAt = SOURCE_BOOT_MIN_NS + SOURCE_BOOT_SPAN_NS;
+
+    for (uint32_t i = 0; i < sources; ++i) {
+        node_config_t src = base;
+        src.role = ROLE_PULL_SOURCE;
+        src.x = dst.x + config_.linkDistanceM * cos(2 * M_PI * i / sources);
+        src.y = dst.y + config_.linkDistanceM * sin(2 * M_PI * i / sources);
+        src.flow = i;
+        src.txChannel = ch;
+        src.txAddress = linkAddress(i);
+        /* sources retransmitting in step collide again, stagger their ARD as the datasheet advises */
+        src.retryDelay = (config_.retryDelay + 16 - i % 16) & 0x0F;
+        src.startAt = boot(rng);
+        dst.pullSources.push_back(src.txAddress);
+
+        flows_.push_back(flow_stats_t {0, 0, ch, 0, 0, 0, 0, 0});
+        flows_.back().src = addNode(src);
+    }
+
+    uint32_t sink = addNode(dst);
+    for (flow_stats_t & f : flows_) {
+        f.dst = sink;
+    }
+}
+
+void
+Scenario::buildMesh(std::mt19937 & rng, node_config_t base)
+{
+    std::uniform_int_distribution<sim_time_t> boot(0, SOURCE_BOOT_SPAN_NS);
+    uint32_t side = (uint32_t) ceil(sqrt((double) config_.nodes));
+
+    base.role = ROLE_ROUTER;
+    base.rxChannel = config_.channels[0];
+    base.txChannel = config_.channels[0];
+    base.txAddress = linkAddress(0);
+
+    for (uint32_t k = 0; k < config_.nodes; ++k) {
+        node_config_t n = base;
+        n.x = (k % side) * config_.linkDistanceM;
+        n.y = (k / side) * config_.linkDistanceM;
+        n.routeSink = k == 0;
+        n.routeSource = k > 0 && k % side == side - 1;
+        n.flow = flows_.size();
+        n.startAt = boot(rng);
+
+        uint32_t id = addNode(n);
+        if (n.routeSource) flows_.push_back(flow_stats_t {id, 0, n.txChannel, 0, 0, 0, 0, 0});
+    }
+}
+
+void
+Scenario::fade()
+{
+    atFade_ = flows_;
+
+    /* the relay carrying the most, the one static routes would lose the most with */
+    for (std::unique_ptr<SimNode> & n : nodes_) {
+        if (n->config().routeSink || n->config().routeSource || n->forwarded() <= fadedForwarded_) continue;
+        fadedNode_ = n->id();
+        fadedForwarded_ = n->forwarded();
+    }
+    if (fadedNode_ == UINT32_MAX) return;
+
+    uint32_t faded = nodes_[fadedNode_]->chip().radioIndex();
+    for (std::unique_ptr<SimNode> & n : nodes_) {
+        uint32_t other = n->chip().radioIndex();
+        if (other != faded) medium_.setLinkLoss(faded, other, medium_.linkLossDb(faded, other) + config_.fadeDb);
+    }
+}
+
+double
+Scenario::run()
+{
+    if (config_.replay) {
+        /* spread the flows over the trace so they do not lose in lockstep */
+        uint64_t attempts = config_.replay->attempts();
+        for (uint32_t i = 0; i < flows_.size(); ++i) {
+            uint32_t radio = nodes_[flows_[i].src]->chip().radioIndex();
+            medium_.setReplay(radio, config_.replay, attempts * i / flows_.size());
+        }
+    }
+
+    for (std::unique_ptr<SimNode> & n : nodes_) {
+        n->start();
+    }
+
+    if (config_.topology == TOPOLOGY_MESH && config_.fadeAt > 0) {
+        sim_time_t at = (sim_time_t) (config_.fadeAt * NS_PER_S);
+        kernel_.schedule(at, [this]() { fade(); });
+        kernel_.schedule(at + FADE_SETTLE_NS, [this]() { afterFade_ = flows_; });
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    kernel_.run((sim_time_t) (config_.seconds * NS_PER_S));
+    auto end = std::chrono::steady_clock::now();
+
+    wallSeconds_ = std::chrono::duration<double>(end - begin).count();
+    return wallSeconds_;
+}
+
+void
+Scenario::report(FILE * out, bool perFlow, bool csv)
+{
+    uint64_t sent = 0;
+    uint64_t delivered = 0;
+    uint64_t bytes = 0;
+    uint64_t latencySum = 0;
+    uint64_t latencyMax = 0;
+    LatencyHistogram hist;
+
+    if (csv) fprintf(out, "flow,src,dst,channel,sent,delivered,pdr,goodput_bps,avg_latency_us,max_latency_us,"
+                          "p50_latency_us,p99_latency_us,p999_latency_us\n");
+
+    if (!csv) {
+        fprintf(out, "rfsim: %zu nodes, %zu flows, topology %s, %zu channels, mac %s, %s\n",
+                nodes_.size(), flows_.size(), topologyName(config_.topology), config_.channels.size(),
+                macName(config_.mac), rateName(config_.rate));
+        fprintf(out, "virtual %.3f s in %.3f s wall (%.1fx real time), %llu events, %llu context switches\n\n",
+                config_.seconds, wallSeconds_, wallSeconds_ > 0 ? config_.seconds / wallSeconds_ : 0.0,
+                (unsigned long long) kernel_.eventsProcessed(), (unsigned long long) kernel_.contextSwitches());
+        if (perFlow) {
+            fprintf(out, "%6s %5s %5s %4s %9s %10s %6s %12s %11s %11s %11s\n",
+                    "flow", "src", "dst", "ch", "sent", "delivered", "pdr", "goodput_bps", "avg_lat_us", "max_lat_us",
+                    "p99_lat_us");
+        }
+    }
+
+    for (uint32_t i = 0; i < flows_.size(); ++i) {
+        const flow_stats_t & f = flows_[i];
+        sent += f.sent;
+        delivered += f.delivered;
+        bytes += f.bytes;
+        latencySum += f.latencySumUs;
+        if (f.latencyMaxUs > latencyMax) latencyMax = f.latencyMaxUs;
+        hist.merge(f.latency);
+
+        if (!perFlow) continue;
+
+        double pdr = f.sent ? (double) f.delivered / f.sent : 0;
+        double goodput = 8.0 * f.bytes / config_.seconds;
+        double latency = f.delivered ? (double) f.latencySumUs / f.delivered : 0;
+
+        fprintf(out, csv ? "%u,%u,%u,%u,%llu,%llu,%.4f,%.0f,%.0f,%llu,"
+                         : "%6u %5u %5u %4u %9llu %10llu %6.3f %12.0f %11.0f %11llu",
+                i, f.src, f.dst, f.channel, (unsigned long long) f.sent, (unsigned long long) f.delivered,
+                pdr, goodput, latency, (unsigned long long) f.latencyMaxUs);
+        if (csv) {
+            fprintf(out, "%u,%u,%u\n", f.latency.percentile(0.5f), f.latency.percentile(0.99f),
+                    f.latency.percentile(0.999f));
+        } else {
+            fprintf(out, " %11u\n", f.latency.percentile(0.99f));
+        }
+    }
+
+    double pdr = sent ? (double) delivered / sent : 0;
+    double goodput = 8.0 * bytes / config_.seconds;
+    double latency = delivered ? (double) latencySum / delivered : 0;
+
+    if (csv) {
+        fprintf(out, "total,,,,%llu,%llu,%.4f,%.0f,%.0f,%llu,%u,%u,%u\n",
+                (unsigned long long) sent, (unsigned long long) delivered, pdr, goodput, latency,
+                (unsigned long long) latencyMax, hist.percentile(0.5f), hist.percentile(0.99f),
+                hist.percentile(0.999f));
+        return;
+    }
+
+    /* what the benchmarks printed on their Serial ports */
+    for (std::unique_ptr<SimNode> & n : nodes_) {
+        if (n->config().role != ROLE_BENCH) continue;
+        fprintf(out, "bench node %u: %s", n->id(), n->board().hostOutput().c_str());
+    }
+
+    /* already a line per kernel, as the board prints them */
+    for (std::unique_ptr<SimNode> & n : nodes_) {
+        if (n->config().role != ROLE_MICRO_BENCH) continue;
+        fputs(n->board().hostOutput().c_str(), out);
+    }
+
+    for (std::unique_ptr<SimNode> & n : nodes_) {
+        if (n->config().role != ROLE_PULL_SINK) continue;
+
+        sim_time_t took = n->pullDoneAt() - n->config().startAt;
+        if (n->pullDoneAt()) {
+            fprintf(out, "pull node %u: %u bytes from %zu sources in %.3f s, %.0f bps\n",
+                    n->id(), config_.pullBytes, n->config().pullSources.size(),
+                    (double) took / NS_PER_S, 8.0 * config_.pullBytes * NS_PER_S / took);
+        } else {
+            fprintf(out, "pull node %u: incomplete after %.3f s\n", n->id(), config_.seconds);
+        }
+    }
+
+    if (config_.rendezvous) {
+        /*
+         *  from the later of the two radios coming up to the sink on the
+         *  link; a sink pairs with whichever source welcomes it first
+         */
+        uint32_t paired = 0;
+        double setupSum = 0;
+        double setupMax = 0;
+        for (const flow_stats_t & f : flows_) {
+            const SimNode & dst = *nodes_[f.dst];
+            if (!dst.pairedAt()) continue;
+
+            const SimNode * src = nullptr;
+            for (const flow_stats_t & g : flows_) {
+                if (nodes_[g.src]->config().txAddress == dst.pairedAddress()) src = nodes_[g.src].get();
+            }
+
+            sim_time_t up = std::max(src->rendezvousAt(), dst.rendezvousAt());
+            double setup = (double) (dst.pairedAt() - up) / NS_PER_MS;
+            setupSum += setup;
+            setupMax = std::max(setupMax, setup);
+            ++paired;
+        }
+        fprintf(out, "rendezvous: %u of %zu pairs, setup avg %.2f ms max %.2f ms\n",
+                paired, flows_.size(), paired ? setupSum / paired : 0, setupMax);
+    }
+
+    if (config_.diversity != DIVERSITY_OFF) {
+        /* whichever radio the receiver read first gets the payload, the other's copy is a duplicate */
+        uint64_t first[DIVERSITY_RADIOS] {};
+        uint64_t duplicates = 0;
+        uint64_t missed = 0;
+        for (const flow_stats_t & f : flows_) {
+            const diversity_stats_t & d = nodes_[f.dst]->diversityStats();
+            for (uint32_t i = 0; i < DIVERSITY_RADIOS; ++i) first[i] += d.first[i];
+            duplicates += d.duplicates;
+            missed += d.missed;
+        }
+        fprintf(out, "diversity: first from radio 1 %llu radio 2 %llu, duplicates %llu, missed by both %llu\n",
+                (unsigned long long) first[0], (unsigned long long) first[1], (unsigned long long) duplicates,
+                (unsigned long long) missed);
+    }
+
+    if (config_.messageBytes) {
+        /* messages the UART dropped never reach an aggregator */
+        uint64_t payloads = 0;
+        uint64_t messages = 0;
+        for (const flow_stats_t & f : flows_) {
+            const aggregate_stats_t & a = nodes_[f.src]->aggregateStats();
+            payloads += a.payloads;
+            messages += a.messages;
+        }
+        fprintf(out, "aggregate: %llu messages of %u bytes in %llu payloads, %.2f per payload, %.0f delivered/s\n",
+                (unsigned long long) messages, config_.messageBytes, (unsigned long long) payloads,
+                payloads ? (double) messages / payloads : 0, delivered / config_.seconds);
+    }
+
+    if (config_.topology == TOPOLOGY_MESH) reportMesh(out, perFlow);
+
+    const medium_stats_t & m = medium_.stats();
+    fprintf(out, "%stotal: sent %llu delivered %llu pdr %.3f goodput %.0f bps avg latency %.0f us max %llu us\n",
+            perFlow ? "\n" : "", (unsigned long long) sent, (unsigned long long) delivered, pdr, goodput, latency,
+            (unsigned long long) latencyMax);
+    if (hist.getCount()) {
+        fprintf(out, "latency: p50 %u us p99 %u us p999 %u us\n",
+                hist.percentile(0.5f), hist.percentile(0.99f), hist.percentile(0.999f));
+    }
+    fprintf(out, "medium: transmissions %llu delivered %llu captured %llu collisions %llu missed busy %llu\n",
+            (unsigned long long) m.transmissions, (unsigned long long) m.delivered,
+            (unsigned long long) m.captured, (unsigned long long) m.collisions,
+            (unsigned long long) m.missedBusy);
+    if (config_.medium.fadingDb > 0) {
+        fprintf(out, "fading %.0f dB: lost %llu\n", config_.medium.fadingDb, (unsigned long long) m.fadeLost);
+    }
+    if (config_.medium.randomLoss > 0) {
+        fprintf(out, "random loss %.3f: lost %llu\n", config_.medium.randomLoss, (unsigned long long) m.randomLost);
+    }
+    if (config_.replay) {
+        fprintf(out, "replay: %llu payloads, %llu attempts, attempt loss %.3f, lost %llu\n",
+                (unsigned long long) config_.replay->payloads(), (unsigned long long) config_.replay->attempts(),
+                config_.replay->attemptLossRate(), (unsigned long long) m.replayLost);
+    }
+}
+
+/* delivered over sent between two snapshots of the flows, the later one last */
+static double
+pdrBetween(const std::vector<flow_stats_t> & from, const std::vector<flow_stats_t> & to)
+{
+    uint64_t sent = 0;
+    uint64_t delivered = 0;
+    for (uint32_t i = 0; i < to.size(); ++i) {
+        sent += to[i].sent - (from.empty() ? 0 : from[i].sent);
+        delivered += to[i].delivered - (from.empty() ? 0 : from[i].delivered);
+    }
+    return sent ? (double) delivered / sent : 0;
+}
+
+void
+Scenario::reportMesh(FILE * out, bool perFlow)
+{
+    uint64_t forwarded = 0;
+    uint64_t dropped = 0;
+    uint64_t duplicates = 0;
+    uint64_t changes = 0;
+
+    for (std::unique_ptr<SimNode> & n : nodes_) {
+        const route_stats_t & r = n->routeStats();
+        forwarded += n->forwarded();
+        dropped += r.dropped;
+        duplicates += r.duplicates;
+        changes += r.parentChanges;
+
+        if (!perFlow || n->config().routeSink) continue;
+        if (r.parent == ROUTE_NONE) {
+            fprintf(out, "route node %u: no parent\n", n->id());
+        } else {
+            fprintf(out, "route node %u: parent %u cost %.2f forwarded %llu dropped %u\n", n->id(), r.parent,
+                    (double) r.cost / ROUTE_ETX_ONE, (unsigned long long) n->forwarded(), r.dropped);
+        }
+    }
+
+    fprintf(out, "mesh: %zu routers, forwarded %llu dropped %llu duplicates %llu, %llu parent changes\n",
+            nodes_.size(), (unsigned long long) forwarded, (unsigned long long) dropped,
+            (unsigned long long) duplicates, (unsigned long long) changes);
+
+    if (config_.fadeAt <= 0 || atFade_.empty()) return;
+    if (fadedNode_ == UINT32_MAX) {
+        fprintf(out, "fade at %.3f s: no relay carried traffic\n", config_.fadeAt);
+        return;
+    }
+
+    fprintf(out, "fade at %.3f s: relay %u, %llu payloads forwarded before, %.0f dB more loss\n",
+            config_.fadeAt, fadedNode_, (unsigned long long) fadedForwarded_, config_.fadeDb);
+    if (afterFade_.empty()) {
+        fprintf(out, "  pdr before %.3f after %.3f\n", pdrBetween({}, atFade_), pdrBetween(atFade_, flows_));
+    } else {
+        fprintf(out, "  pdr before %.3f, first second after %.3f, rest %.3f\n", pdrBetween({}, atFade_),
+                pdrBetween(atFade_, afterFade_), pdrBetween(afterFade_, flows_));
+    }
+}
+
+bool
+Scenario::writeLatency(const char * path)
+{
+    FILE * f = fopen(path, "w");
+    if (!f) return false;
+
+    LatencyHistogram hist;
+    for (const flow_stats_t & flow : flows_) hist.merge(flow.latency);
+
+    fprintf(f, "top_us,count\n");
+    for (uint16_t b = 0; b < LATENCY_BUCKETS; ++b) {
+        if (hist.getBucket(b)) fprintf(f, "%u,%u\n", LatencyHistogram::bucketTop(b), hist.getBucket(b));
+    }
+    fclose(f);
+    return true;
+}
+
+const char *
+rfsim::rateName(data_rate rate)
+{
+    switch (rate) {
+    case DATA_RATE_250KBPS:
+        return "250 kbps";
+    case DATA_RATE_2MBPS:
+        return "2 Mbps";
+    default:
+        return "1 Mbps";
+    }
+}
+
+const char *
+rfsim::macName(mac_policy_e mac)
+{
+    switch (mac) {
+    case MAC_CSMA:
+        return "csma";
+    case MAC_TDMA:
+        return "tdma";
+    default:
+        return "aloha";
+    }
+}
+
+const char *
+rfsim::topologyName(topology_e topology)
+{
+    switch (topology) {
+    case TOPOLOGY_STAR:
+        return "star";
+    case TOPOLOGY_CHAIN:
+        return "chain";
+    case TOPOLOGY_PULL:
+        return "pull";
+    case TOPOLOGY_MESH:
+        return "mesh";
+    default:
+        return "pairs";
+    }
+}
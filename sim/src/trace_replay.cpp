@@ -0,0 +1,73 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "trace_replay.h"
+
+using namespace rfsim;
+
+TraceReplay::TraceReplay()
+    : payloads_(0)
+{
+}
+
+bool
+TraceReplay::load(const char * path)
+{
+    FILE * f = fopen(path, "r");
+    if (!f) return false;
+
+    lost_.clear();
+    payloads_ = 0;
+
+    char line[128];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long timeUs;
+        unsigned seq, channel, outcome;
+
+        /* the header and anything else that is not a record */
+        if (sscanf(line, "%lu,%u,%u,%u", &timeUs, &seq, &channel, &outcome) != 4) continue;
+        if (outcome & TRACE_RX) continue;
+
+        uint32_t arc = outcome & TRACE_ARC_MASK;
+        if (outcome & TRACE_TX_DS) {
+            lost_.insert(lost_.end(), arc, true);
+            lost_.push_back(false);
+        } else if (outcome & TRACE_MAX_RT) {
+            lost_.insert(lost_.end(), arc + 1, true);
+        } else {
+            continue;
+        }
+        payloads_++;
+    }
+
+    fclose(f);
+    return !lost_.empty();
+}
+
+bool
+TraceReplay::attemptLost(uint64_t n) const
+{
+    return lost_[n % lost_.size()];
+}
+
+uint64_t
+TraceReplay::attempts() const
+{
+    return lost_.size();
+}
+
+uint64_t
+TraceReplay::payloads() const
+{
+    return payloads_;
+}
+
+double
+TraceReplay::attemptLossRate() const
+{
+    if (lost_.empty()) return 0;
+
+    uint64_t n = 0;
+    for (bool l : lost_) n += l;
+    return (double) n / lost_.size();
+}
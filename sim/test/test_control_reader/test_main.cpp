@@ -0,0 +1,255 @@
+/*
+ *  Control commands among the computer's data, over a line the test
+ *  releases a few bytes at a time as if they were still on their way.
+ *
+ *  Whatever lands where, the data has to come out whole and in order and
+ *  every command has to be seen once, after the data sent before it.
+ */
+
+#include <Arduino.h>
+#include <string.h>
+#include <unity.h>
+
+#include "../../../TX/src/control_reader.cpp"
+
+#define LINE_BYTES 1024
+
+static uint8_t line[LINE_BYTES];
+static uint32_t line_bytes;     // written by the computer
+static uint32_t arrived;        // of them, in the Arduino's buffer
+static uint32_t taken;          // of them, read by the ControlReader
+
+static int
+readLine(void * ctx)
+{
+    (void) ctx;
+    return (taken < arrived) ? line[taken++] : -1;
+}
+
+/*
+ * data
+ *  args:
+ *      bytes, size: what the computer sends as data, escaped on the way
+ *  Description:
+ *      Writes the bytes to the line as writeData() in arduino_serial_io.py
+ */
+static void
+data(const uint8_t * bytes, uint32_t size)
+{
+    for (uint32_t i = 0; i < size; ++i) {
+        if (bytes[i] == TX_CHAR || bytes[i] == CONTROL_ESCAPE) {
+            line[line_bytes++] = CONTROL_ESCAPE;
+            line[line_bytes++] = bytes[i] ^ CONTROL_ESCAPE_XOR;
+        } else {
+            line[line_bytes++] = bytes[i];
+        }
+    }
+}
+
+/*
+ * command
+ *  args:
+ *      c: CONTROL_PAUSE and so on
+ *  Description:
+ *      Writes a command to the line as sendControl() does
+ */
+static void
+command(char c)
+{
+    for (uint8_t i = 0; i < TX_CHAR_REPS; ++i) line[line_bytes++] = TX_CHAR;
+    line[line_bytes++] = (uint8_t) c;
+}
+
+/*
+ * readData
+ *  args:
+ *      reader: what reads the line
+ *      out, size: where the data goes and how much to read
+ *  Description:
+ *      Reads data until `size' bytes are in or a command is next, as
+ *      setFromSerial() does
+ *  Returns:
+ *      the bytes read
+ */
+static uint32_t
+readData(ControlReader & reader, uint8_t * out, uint32_t size)
+{
+    uint32_t got = 0;
+    while (got < size && reader.available()) out[got++] = (uint8_t) reader.read();
+    return got;
+}
+
+static uint8_t chunk[MAX_CHUNK_CHARS + 1];
+static uint8_t out[MAX_CHUNK_CHARS + 1];
+
+void
+setUp(void)
+{
+    line_bytes = arrived = taken = 0;
+
+    /* the chunk size, then bytes that need escaping among the others */
+    chunk[0] = MAX_CHUNK_CHARS;
+    for (uint32_t i = 1; i <= MAX_CHUNK_CHARS; ++i) {
+        chunk[i] = (i % 5) ? (uint8_t) (i * 7) : ((i % 2) ? TX_CHAR : CONTROL_ESCAPE);
+    }
+    memset(out, 0, sizeof(out));
+}
+
+void
+tearDown(void)
+{
+}
+
+static void
+test_escaped_data_comes_back(void)
+{
+    ControlReader reader(readLine, nullptr);
+    data(chunk, sizeof(chunk));
+    arrived = line_bytes;
+
+    TEST_ASSERT_EQUAL_UINT32(sizeof(chunk), readData(reader, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY(chunk, out, sizeof(chunk));
+    TEST_ASSERT_EQUAL(CONTROL_NONE, reader.command());
+    TEST_ASSERT_FALSE(reader.available());
+}
+
+static void
+test_pause_and_resume_in_the_middle_of_a_chunk(void)
+{
+    ControlReader reader(readLine, nullptr);
+    data(chunk, 40);
+    command(CONTROL_PAUSE);
+    command(CONTROL_RESUME);
+    data(chunk + 40, sizeof(chunk) - 40);
+
+    /* the bytes trickle in while the Arduino reads */
+    uint32_t got = 0;
+    char seen[2] {};
+    uint8_t commands = 0;
+    while (got < sizeof(chunk)) {
+        if (arrived < line_bytes) arrived += 3;
+        if (arrived > line_bytes) arrived = line_bytes;
+
+        got += readData(reader, out + got, sizeof(chunk) - got);
+        if (reader.command() != CONTROL_NONE) {
+            TEST_ASSERT_TRUE(commands < 2);
+            TEST_ASSERT_EQUAL_UINT32(40, got);
+            seen[commands++] = reader.takeCommand();
+        }
+    }
+
+    TEST_ASSERT_EQUAL(CONTROL_PAUSE, seen[0]);
+    TEST_ASSERT_EQUAL(CONTROL_RESUME, seen[1]);
+    TEST_ASSERT_EQUAL_MEMORY(chunk, out, sizeof(chunk));
+}
+
+static void
+test_data_before_a_command_is_held(void)
+{
+    ControlReader reader(readLine, nullptr);
+
+    /* the computer's handshake, then a pause, while the Arduino is on the radio */
+    uint8_t handshake = HANDSHAKE_CHAR;
+    data(&handshake, 1);
+    command(CONTROL_PAUSE);
+    arrived = line_bytes;
+
+    TEST_ASSERT_TRUE(reader.seekCommand());
+    TEST_ASSERT_EQUAL(CONTROL_PAUSE, reader.takeCommand());
+
+    /* paused until the resume comes */
+    TEST_ASSERT_FALSE(reader.seekCommand());
+    command(CONTROL_RESUME);
+    arrived = line_bytes;
+    TEST_ASSERT_TRUE(reader.seekCommand());
+    TEST_ASSERT_EQUAL(CONTROL_RESUME, reader.takeCommand());
+
+    TEST_ASSERT_TRUE(reader.available());
+    TEST_ASSERT_EQUAL(HANDSHAKE_CHAR, reader.read());
+    TEST_ASSERT_FALSE(reader.available());
+}
+
+static void
+test_command_split_over_arrivals(void)
+{
+    ControlReader reader(readLine, nullptr);
+    command(CONTROL_ABORT);
+
+    arrived = TX_CHAR_REPS - 1;
+    TEST_ASSERT_FALSE(reader.available());
+    TEST_ASSERT_FALSE(reader.seekCommand());
+
+    arrived = TX_CHAR_REPS;
+    TEST_ASSERT_FALSE(reader.seekCommand());
+
+    arrived = line_bytes;
+    TEST_ASSERT_TRUE(reader.seekCommand());
+    TEST_ASSERT_EQUAL(CONTROL_ABORT, reader.command());
+}
+
+static void
+test_escape_split_over_arrivals(void)
+{
+    ControlReader reader(readLine, nullptr);
+    uint8_t tilde = TX_CHAR;
+    data(&tilde, 1);
+
+    arrived = 1;
+    TEST_ASSERT_FALSE(reader.available());
+
+    arrived = line_bytes;
+    TEST_ASSERT_TRUE(reader.available());
+    TEST_ASSERT_EQUAL(TX_CHAR, reader.read());
+    TEST_ASSERT_EQUAL(CONTROL_NONE, reader.command());
+}
+
+static void
+test_seek_stops_when_the_hold_is_full(void)
+{
+    ControlReader reader(readLine, nullptr);
+    uint8_t bytes[CONTROL_HOLD_BYTES + 10];
+    for (uint32_t i = 0; i < sizeof(bytes); ++i) bytes[i] = (uint8_t) (i * 3);
+    data(bytes, sizeof(bytes));
+    command(CONTROL_PAUSE);
+    arrived = line_bytes;
+
+    /* the command waits behind the data that did not fit */
+    TEST_ASSERT_FALSE(reader.seekCommand());
+
+    uint8_t read[sizeof(bytes)];
+    TEST_ASSERT_EQUAL_UINT32(sizeof(bytes), readData(reader, read, sizeof(read)));
+    TEST_ASSERT_EQUAL_MEMORY(bytes, read, sizeof(bytes));
+    TEST_ASSERT_FALSE(reader.available());
+    TEST_ASSERT_EQUAL(CONTROL_PAUSE, reader.command());
+}
+
+static void
+test_clear_drops_the_data_held(void)
+{
+    ControlReader reader(readLine, nullptr);
+    data(chunk, 10);
+    command(CONTROL_ABORT);
+    data(chunk + 10, 5);
+    arrived = line_bytes;
+
+    TEST_ASSERT_TRUE(reader.seekCommand());
+    TEST_ASSERT_EQUAL(CONTROL_ABORT, reader.takeCommand());
+    reader.clear();
+
+    TEST_ASSERT_EQUAL_UINT32(5, readData(reader, out, sizeof(out)));
+    TEST_ASSERT_EQUAL_MEMORY(chunk + 10, out, 5);
+}
+
+int
+main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_escaped_data_comes_back);
+    RUN_TEST(test_pause_and_resume_in_the_middle_of_a_chunk);
+    RUN_TEST(test_data_before_a_command_is_held);
+    RUN_TEST(test_command_split_over_arrivals);
+    RUN_TEST(test_escape_split_over_arrivals);
+    RUN_TEST(test_seek_stops_when_the_hold_is_full);
+    RUN_TEST(test_clear_drops_the_data_held);
+    return UNITY_END();
+}
@@ -0,0 +1,164 @@
+/*
+ *  The hybrid ARQ's Reed-Solomon erasure code.
+ *
+ *  Any k of a group's symbols, data or parity, have to give back the k
+ *  data symbols byte for byte.
+ */
+
+#include <Arduino.h>
+#include <string.h>
+#include <unity.h>
+
+#include "../../../TX/src/erasure_code.cpp"
+
+static ErasureCode code;
+static uint8_t data[ERASURE_MAX_DATA * ERASURE_MAX_SYMBOL_BYTES];
+static uint8_t symbols[ERASURE_MAX_SYMBOLS * ERASURE_MAX_SYMBOL_BYTES];
+
+/*
+ * fill
+ *  args:
+ *      k, size, parities: data symbols, bytes per symbol and parity symbols
+ *      seed: of the bytes, so every group is different
+ *  Description:
+ *      Fills the data symbols with bytes of an LCG and the slots with the
+ *      group as sent, the parity after the data
+ */
+static void
+fill(uint8_t k, uint8_t size, uint8_t parities, uint32_t seed)
+{
+    for (uint16_t i = 0; i < k * size; ++i) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t) (seed >> 16);
+    }
+
+    memset(symbols, 0, sizeof(symbols));
+    memcpy(symbols, data, k * size);
+    for (uint8_t p = 0; p < parities; ++p) {
+        code.encode(data, k, p, size, symbols + (k + p) * size);
+    }
+}
+
+/*
+ * lose
+ *  args:
+ *      k, size: data symbols and bytes per symbol
+ *      have: bit i set if symbol i arrived
+ *  Description:
+ *      Scribbles over the data symbols that did not arrive, so only a
+ *      decode gives them back
+ */
+static void
+lose(uint8_t k, uint8_t size, uint32_t have)
+{
+    for (uint8_t i = 0; i < k; ++i) {
+        if (!(have & ((uint32_t) 1 << i))) memset(symbols + i * size, 0xA5, size);
+    }
+}
+
+void
+setUp(void)
+{
+}
+
+void
+tearDown(void)
+{
+}
+
+static void
+test_nothing_lost(void)
+{
+    fill(8, 32, 4, 1);
+    TEST_ASSERT_TRUE(code.decode(symbols, 0xFF, 8, 32));
+    TEST_ASSERT_EQUAL_MEMORY(data, symbols, 8 * 32);
+}
+
+static void
+test_parity_is_not_data(void)
+{
+    fill(4, 16, 2, 2);
+
+    /* parity symbols differ from each other and from every data symbol */
+    TEST_ASSERT_TRUE(memcmp(symbols + 4 * 16, symbols + 5 * 16, 16) != 0);
+    for (uint8_t i = 0; i < 4; ++i) {
+        TEST_ASSERT_TRUE(memcmp(symbols + 4 * 16, data + i * 16, 16) != 0);
+    }
+}
+
+static void
+test_every_pattern_of_a_small_group(void)
+{
+    const uint8_t k = 4, parities = 3, n = k + parities;
+
+    for (uint32_t have = 0; have < (1u << n); ++have) {
+        fill(k, 8, parities, have);
+        lose(k, 8, have);
+
+        bool enough = __builtin_popcount(have) >= k;
+        TEST_ASSERT_EQUAL(enough, code.decode(symbols, have, k, 8));
+        if (enough) TEST_ASSERT_EQUAL_MEMORY(data, symbols, k * 8);
+    }
+}
+
+static void
+test_all_data_lost(void)
+{
+    const uint8_t k = ERASURE_MAX_DATA;
+    fill(k, ERASURE_MAX_SYMBOL_BYTES, ERASURE_MAX_PARITY, 3);
+
+    uint32_t have = 0xFFFFFFFFu << k;
+    lose(k, ERASURE_MAX_SYMBOL_BYTES, have);
+
+    TEST_ASSERT_TRUE(code.decode(symbols, have, k, ERASURE_MAX_SYMBOL_BYTES));
+    TEST_ASSERT_EQUAL_MEMORY(data, symbols, k * ERASURE_MAX_SYMBOL_BYTES);
+}
+
+static void
+test_scattered_losses_of_a_full_group(void)
+{
+    const uint8_t k = ERASURE_MAX_DATA;
+
+    /* data 1, 5, 6, 11 and 15 lost, parity 0, 2, 3, 9 and 14 in their place */
+    uint32_t have = 0xFFFFu & ~((1u << 1) | (1u << 5) | (1u << 6) | (1u << 11) | (1u << 15));
+    have |= ((1u << 0) | (1u << 2) | (1u << 3) | (1u << 9) | (1u << 14)) << k;
+
+    fill(k, 30, ERASURE_MAX_PARITY, 4);
+    lose(k, 30, have);
+
+    TEST_ASSERT_TRUE(code.decode(symbols, have, k, 30));
+    TEST_ASSERT_EQUAL_MEMORY(data, symbols, k * 30);
+}
+
+static void
+test_one_byte_symbols(void)
+{
+    fill(3, 1, 2, 5);
+    uint32_t have = (1u << 1) | (1u << 3) | (1u << 4);
+    lose(3, 1, have);
+
+    TEST_ASSERT_TRUE(code.decode(symbols, have, 3, 1));
+    TEST_ASSERT_EQUAL_MEMORY(data, symbols, 3);
+}
+
+static void
+test_too_few_symbols(void)
+{
+    fill(8, 32, 4, 6);
+    TEST_ASSERT_FALSE(code.decode(symbols, 0x7F, 8, 32));
+    TEST_ASSERT_FALSE(code.decode(symbols, 0, 8, 32));
+}
+
+int
+main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_nothing_lost);
+    RUN_TEST(test_parity_is_not_data);
+    RUN_TEST(test_every_pattern_of_a_small_group);
+    RUN_TEST(test_all_data_lost);
+    RUN_TEST(test_scattered_losses_of_a_full_group);
+    RUN_TEST(test_one_byte_symbols);
+    RUN_TEST(test_too_few_symbols);
+    return UNITY_END();
+}
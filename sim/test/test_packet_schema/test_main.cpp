@@ -0,0 +1,135 @@
+/*
+ *  The header layouts of packet_schema.h against the bytes they stand
+ *  for.
+ *
+ *  Headers that were packed by hand before have to come out byte for byte
+ *  as they did, so that boards of either build still talk.
+ */
+
+#include <string.h>
+#include <unity.h>
+
+#include "packet_schema.h"
+#include "aggregator.h"
+#include "latency_stamp.h"
+#include "route.h"
+
+typedef PacketField<0, 16> Seq;
+typedef PacketFieldAfter<Seq, 1> Last;
+typedef PacketFieldAfter<Last, 3> Stream;
+typedef PacketFieldAfter<Stream, 12> Length;
+typedef PacketLayout<32, Seq, Last, Stream, Length> Header;
+
+static char payload[32];
+
+void
+setUp(void)
+{
+    memset(payload, 0, sizeof(payload));
+}
+
+void
+tearDown(void)
+{
+}
+
+static void
+test_put_then_get(void)
+{
+    Seq::put(payload, 0xBEEF);
+    Last::put(payload, 1);
+    Stream::put(payload, 5);
+    Length::put(payload, 0xABC);
+
+    TEST_ASSERT_EQUAL_UINT32(0xBEEF, Seq::get(payload));
+    TEST_ASSERT_EQUAL_UINT32(1, Last::get(payload));
+    TEST_ASSERT_EQUAL_UINT32(5, Stream::get(payload));
+    TEST_ASSERT_EQUAL_UINT32(0xABC, Length::get(payload));
+}
+
+static void
+test_put_leaves_the_other_bits(void)
+{
+    memset(payload, 0xFF, sizeof(payload));
+    Stream::put(payload, 0);
+
+    /* bits 17 to 19 of byte 2 only */
+    TEST_ASSERT_EQUAL_HEX8(0xFF, (uint8_t) payload[1]);
+    TEST_ASSERT_EQUAL_HEX8(0xF1, (uint8_t) payload[2]);
+    TEST_ASSERT_EQUAL_HEX8(0xFF, (uint8_t) payload[3]);
+    TEST_ASSERT_EQUAL_UINT32(1, Last::get(payload));
+    TEST_ASSERT_EQUAL_UINT32(0xFFF, Length::get(payload));
+}
+
+static void
+test_put_keeps_the_low_bits(void)
+{
+    Stream::put(payload, 0xFF);
+    TEST_ASSERT_EQUAL_UINT32(Stream::MAX, Stream::get(payload));
+    TEST_ASSERT_EQUAL_UINT32(0, Last::get(payload));
+    TEST_ASSERT_EQUAL_UINT32(0, Length::get(payload));
+}
+
+static void
+test_little_endian_bytes(void)
+{
+    Seq::put(payload, 0x1234);
+    TEST_ASSERT_EQUAL_HEX8(0x34, (uint8_t) payload[0]);
+    TEST_ASSERT_EQUAL_HEX8(0x12, (uint8_t) payload[1]);
+
+    typedef PacketField<8, 32> Word;
+    Word::put(payload, 0xDEADBEEF);
+    TEST_ASSERT_EQUAL_HEX8(0xEF, (uint8_t) payload[1]);
+    TEST_ASSERT_EQUAL_HEX8(0xDE, (uint8_t) payload[4]);
+    TEST_ASSERT_EQUAL_UINT32(0xDEADBEEF, Word::get(payload));
+}
+
+static void
+test_sizes_and_types(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(4, Header::BYTES);
+    TEST_ASSERT_EQUAL_UINT32(28, Header::DATA_BYTES);
+    TEST_ASSERT_EQUAL_UINT32(0x7, Stream::MAX);
+    TEST_ASSERT_EQUAL_UINT32(0xFFFFFFFF, (PacketField<0, 32>::MAX));
+    TEST_ASSERT_EQUAL_UINT32(1, sizeof(Stream::type));
+    TEST_ASSERT_EQUAL_UINT32(2, sizeof(Length::type));
+    TEST_ASSERT_EQUAL_UINT32(4, sizeof(LatencySent::type));
+}
+
+static void
+test_aggregate_header_shares_a_byte(void)
+{
+    AggregateLength::put(payload, 17);
+    AggregateFlow::put(payload, 6);
+    TEST_ASSERT_EQUAL_HEX8((6 << AGGREGATE_LENGTH_BITS) | 17, (uint8_t) payload[0]);
+    TEST_ASSERT_EQUAL_UINT32(1, AggregateHeader::BYTES);
+}
+
+static void
+test_hand_packed_offsets_kept(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(8 * LATENCY_SENT_OFFSET, LatencySent::OFFSET);
+    TEST_ASSERT_EQUAL_UINT32(8 * LATENCY_GOT_OFFSET, LatencyGot::OFFSET);
+    TEST_ASSERT_EQUAL_UINT32(8 * LATENCY_ANSWERED_OFFSET, LatencyAnswered::OFFSET);
+
+    /* the route header as it was: '@', type, from, cost, then origin, ttl and seq */
+    TEST_ASSERT_EQUAL_UINT32(8 * 3, RouteCost::OFFSET);
+    TEST_ASSERT_EQUAL_UINT32(RouteParent::OFFSET, RouteOrigin::OFFSET);
+    TEST_ASSERT_EQUAL_UINT32(8 * 7, RouteSeq::OFFSET);
+    TEST_ASSERT_EQUAL_UINT32(8, ROUTE_DATA_OFFSET);
+    TEST_ASSERT_EQUAL_UINT32(24, ROUTE_DATA_BYTES);
+}
+
+int
+main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_put_then_get);
+    RUN_TEST(test_put_leaves_the_other_bits);
+    RUN_TEST(test_put_keeps_the_low_bits);
+    RUN_TEST(test_little_endian_bytes);
+    RUN_TEST(test_sizes_and_types);
+    RUN_TEST(test_aggregate_header_shares_a_byte);
+    RUN_TEST(test_hand_packed_offsets_kept);
+    return UNITY_END();
+}
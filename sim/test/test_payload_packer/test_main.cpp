@@ -0,0 +1,222 @@
+/*
+ *  The payload packer against chunks of any size, through pack() as the TX
+ *  main's sendFileData() calls it.
+ *
+ *  Whatever the chunks, the payloads have to carry the file in order and
+ *  all be full but the last, and whole payloads of a chunk have to go out
+ *  from the chunk itself when nothing is held.
+ */
+
+#include <Arduino.h>
+#include <string.h>
+#include <unity.h>
+
+#include "../../../TX/src/payload_packer.cpp"
+
+#define FILE_BYTES 1000
+
+static char file[FILE_BYTES];
+static char out[FILE_BYTES + FIFO_SIZE_BYTES];
+static uint32_t out_bytes;
+static uint32_t in_place;           // payloads sent from the chunk
+static uint32_t sends_left;         // before the transfer stops
+
+/* what the packer is sending, for send() to look at */
+struct packing {
+    PayloadPacker * packer;
+    const char * chunk;
+    uint32_t chunk_bytes;
+};
+
+/*
+ * send
+ *  args:
+ *      ctx: the packing
+ *      payload: FIFO_SIZE_BYTES from the chunk or from the packer
+ *  Description:
+ *      Takes the payload as sendPacked() does when it goes on the air,
+ *      counting the ones sent from the chunk, and stops the transfer once
+ *      sends_left runs out
+ *  Returns:
+ *      false once the transfer stopped
+ */
+static bool
+send(void * ctx, const char * payload)
+{
+    packing * p = (packing *) ctx;
+
+    if (payload >= p->chunk && payload < p->chunk + p->chunk_bytes) {
+        TEST_ASSERT_TRUE(payload + FIFO_SIZE_BYTES <= p->chunk + p->chunk_bytes);
+        ++in_place;
+        memcpy(out + out_bytes, payload, FIFO_SIZE_BYTES);
+        out_bytes += FIFO_SIZE_BYTES;
+    } else {
+        TEST_ASSERT_TRUE(payload == p->packer->getPayload());
+        TEST_ASSERT_TRUE(p->packer->full());
+        memcpy(out + out_bytes, payload, p->packer->getSize());
+        out_bytes += p->packer->getSize();
+    }
+
+    return --sends_left > 0;
+}
+
+/*
+ * pack
+ *  args:
+ *      capacity: file bytes per payload
+ *      chunk: bytes per serial chunk
+ *  Description:
+ *      Packs the file chunk by chunk as sendFileData() does, then takes
+ *      what is held as the short last payload, as finishFile() does
+ *  Returns:
+ *      the payloads sent from the chunks
+ */
+static uint32_t
+pack(uint8_t capacity, uint32_t chunk)
+{
+    PayloadPacker packer(capacity);
+
+    for (uint32_t at = 0; at < FILE_BYTES; at += chunk) {
+        uint32_t size = (FILE_BYTES - at < chunk) ? FILE_BYTES - at : chunk;
+        packing p {&packer, file + at, size};
+        packer.pack(file + at, size, send, &p);
+    }
+
+    /* the rest of the file, zero padded */
+    const char * payload = packer.getPayload();
+    for (uint8_t i = packer.getSize(); i < FIFO_SIZE_BYTES; ++i) {
+        TEST_ASSERT_EQUAL_HEX8(0, payload[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT32(FILE_BYTES % capacity, packer.getSize());
+    memcpy(out + out_bytes, payload, packer.getSize());
+    out_bytes += packer.getSize();
+
+    TEST_ASSERT_EQUAL_UINT32(FILE_BYTES, out_bytes);
+    TEST_ASSERT_EQUAL_MEMORY(file, out, FILE_BYTES);
+    return in_place;
+}
+
+void
+setUp(void)
+{
+    for (uint32_t i = 0; i < FILE_BYTES; ++i) file[i] = (char) (i * 7 + 1);
+    memset(out, 0, sizeof(out));
+    out_bytes = 0;
+    in_place = 0;
+    sends_left = UINT32_MAX;
+}
+
+void
+tearDown(void)
+{
+}
+
+static void
+test_fill_takes_what_fits(void)
+{
+    PayloadPacker packer;
+
+    TEST_ASSERT_EQUAL_UINT32(20, packer.fill(file, 20));
+    TEST_ASSERT_FALSE(packer.full());
+    TEST_ASSERT_EQUAL_UINT32(12, packer.fill(file + 20, 20));
+    TEST_ASSERT_TRUE(packer.full());
+    TEST_ASSERT_EQUAL_UINT32(0, packer.fill(file + 32, 20));
+    TEST_ASSERT_EQUAL_MEMORY(file, packer.getPayload(), FIFO_SIZE_BYTES);
+
+    packer.clear();
+    TEST_ASSERT_EQUAL_UINT8(0, packer.getSize());
+    TEST_ASSERT_FALSE(packer.full());
+}
+
+static void
+test_capacity_leaves_a_trailer(void)
+{
+    PayloadPacker packer(28);
+
+    TEST_ASSERT_EQUAL_UINT32(28, packer.fill(file, 40));
+    TEST_ASSERT_TRUE(packer.full());
+    for (uint8_t i = 28; i < FIFO_SIZE_BYTES; ++i) {
+        TEST_ASSERT_EQUAL_HEX8(0, packer.getPayload()[i]);
+    }
+}
+
+static void
+test_chunks_of_a_payload(void)
+{
+    /* every payload but the short last one straight from its chunk */
+    TEST_ASSERT_EQUAL_UINT32(FILE_BYTES / FIFO_SIZE_BYTES, pack(FIFO_SIZE_BYTES, FIFO_SIZE_BYTES));
+}
+
+static void
+test_chunks_of_whole_payloads(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(FILE_BYTES / FIFO_SIZE_BYTES, pack(FIFO_SIZE_BYTES, 4 * FIFO_SIZE_BYTES));
+}
+
+static void
+test_chunks_across_payloads(void)
+{
+    /* 90 bytes leave 26 held, after which the next chunk has to be copied */
+    TEST_ASSERT_TRUE(pack(FIFO_SIZE_BYTES, 90) > 0);
+    TEST_ASSERT_TRUE(in_place < FILE_BYTES / FIFO_SIZE_BYTES);
+}
+
+static void
+test_chunks_smaller_than_a_payload(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(0, pack(FIFO_SIZE_BYTES, 5));
+}
+
+static void
+test_one_byte_chunks(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(0, pack(FIFO_SIZE_BYTES, 1));
+}
+
+static void
+test_capacity_dividing_the_file(void)
+{
+    TEST_ASSERT_EQUAL_UINT32(0, pack(25, 64));
+}
+
+static void
+test_latency_stamp_capacity(void)
+{
+    /* a trailer needs room, so never from the chunk */
+    TEST_ASSERT_EQUAL_UINT32(0, pack(28, 127));
+}
+
+static void
+test_stopped_transfer_sends_no_more(void)
+{
+    PayloadPacker packer;
+    packing p {&packer, file, FILE_BYTES};
+    sends_left = 3;
+
+    /* 10 held, then 3 payloads, the first copied and two from the chunk */
+    packer.pack(file, 10, send, &p);
+    packer.pack(file + 10, FILE_BYTES - 10, send, &p);
+
+    TEST_ASSERT_EQUAL_UINT32(0, sends_left);
+    TEST_ASSERT_EQUAL_UINT32(2, in_place);
+    TEST_ASSERT_EQUAL_UINT32(3 * FIFO_SIZE_BYTES, out_bytes);
+    TEST_ASSERT_EQUAL_MEMORY(file, out, out_bytes);
+    TEST_ASSERT_EQUAL_UINT8(0, packer.getSize());
+}
+
+int
+main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fill_takes_what_fits);
+    RUN_TEST(test_capacity_leaves_a_trailer);
+    RUN_TEST(test_chunks_of_a_payload);
+    RUN_TEST(test_chunks_of_whole_payloads);
+    RUN_TEST(test_chunks_across_payloads);
+    RUN_TEST(test_chunks_smaller_than_a_payload);
+    RUN_TEST(test_one_byte_chunks);
+    RUN_TEST(test_capacity_dividing_the_file);
+    RUN_TEST(test_latency_stamp_capacity);
+    RUN_TEST(test_stopped_transfer_sends_no_more);
+    return UNITY_END();
+}
@@ -0,0 +1,180 @@
+/*
+ *  The rate shaper's token bucket against a clock the test moves by hand.
+ *
+ *  The firmware sources are built unchanged, as in src/firmware.cpp, but
+ *  without the simulator: micros() and delayMicroseconds() are the test's.
+ */
+
+#include <Arduino.h>
+#include <unity.h>
+
+#include "../../../TX/src/token_bucket.cpp"
+#include "../../../TX/src/rate_shaper.cpp"
+
+static unsigned long now_us;
+
+unsigned long
+micros(void)
+{
+    return now_us;
+}
+
+void
+delayMicroseconds(uint32_t us)
+{
+    now_us += us;
+}
+
+void
+setUp(void)
+{
+    now_us = 1000;
+}
+
+void
+tearDown(void)
+{
+}
+
+static void
+test_unlimited_never_waits(void)
+{
+    TokenBucket bucket;
+    bucket.configure(BUCKET_UNLIMITED, 0);
+
+    for (int i = 0; i < 100; ++i) {
+        TEST_ASSERT_EQUAL_UINT32(0, bucket.waitUs(32));
+        bucket.consume(32);
+    }
+}
+
+static void
+test_burst_then_rate(void)
+{
+    TokenBucket bucket;
+    bucket.configure(3200, 96);
+
+    /* three payloads back to back, then one every 10 ms */
+    for (int i = 0; i < 3; ++i) {
+        TEST_ASSERT_EQUAL_UINT32(0, bucket.waitUs(32));
+        bucket.consume(32);
+    }
+    TEST_ASSERT_EQUAL_UINT32(10000, bucket.waitUs(32));
+
+    now_us += 9999;
+    TEST_ASSERT_EQUAL_UINT32(1, bucket.waitUs(32));
+    now_us += 1;
+    TEST_ASSERT_EQUAL_UINT32(0, bucket.waitUs(32));
+}
+
+static void
+test_wait_rounds_up(void)
+{
+    TokenBucket bucket;
+    bucket.configure(3, 32);
+    bucket.consume(32);
+
+    /* a byte takes 333333.3 us at 3 B/s */
+    TEST_ASSERT_EQUAL_UINT32(333334, bucket.waitUs(1));
+}
+
+static void
+test_refill_stops_at_burst(void)
+{
+    TokenBucket bucket;
+    bucket.configure(1000, 64);
+    bucket.consume(64);
+
+    now_us += 10000000;
+    TEST_ASSERT_EQUAL_UINT32(0, bucket.waitUs(64));
+    bucket.consume(64);
+    TEST_ASSERT_EQUAL_UINT32(32000, bucket.waitUs(32));
+}
+
+static void
+test_zero_burst_is_one_payload(void)
+{
+    TokenBucket bucket;
+    bucket.configure(3200, 0);
+
+    TEST_ASSERT_EQUAL_UINT32(0, bucket.waitUs(32));
+    bucket.consume(32);
+    TEST_ASSERT_EQUAL_UINT32(10000, bucket.waitUs(32));
+}
+
+static void
+test_send_larger_than_burst_waits_for_full(void)
+{
+    TokenBucket bucket;
+    bucket.configure(1000, 32);
+    bucket.consume(32);
+
+    TEST_ASSERT_EQUAL_UINT32(32000, bucket.waitUs(100));
+}
+
+static void
+test_micros_wrap(void)
+{
+    now_us = 0xFFFFFFFFul - 5000;
+    TokenBucket bucket;
+    bucket.configure(3200, 32);
+    bucket.consume(32);
+
+    now_us += 10000;
+    TEST_ASSERT_EQUAL_UINT32(0, bucket.waitUs(32));
+}
+
+static void
+test_shaper_charges_link_and_flow(void)
+{
+    shaping_config_t config {};
+    config.link.rate.num = 6400;
+    config.link.burst.num = 64;
+    config.flows[SHAPER_FLOW_CONTROL].rate.num = 1600;
+    config.flows[SHAPER_FLOW_CONTROL].burst.num = 32;
+
+    RateShaper shaper;
+    shaper.configure(&config);
+
+    /* the control flow's own cap holds it back before the link's does */
+    shaper.consume(SHAPER_FLOW_CONTROL, 32);
+    TEST_ASSERT_EQUAL_UINT32(20000, shaper.waitUs(SHAPER_FLOW_CONTROL, 32));
+    TEST_ASSERT_EQUAL_UINT32(0, shaper.waitUs(SHAPER_FLOW_FILE, 32));
+
+    /* and every flow takes from the link */
+    shaper.consume(SHAPER_FLOW_FILE, 32);
+    TEST_ASSERT_EQUAL_UINT32(5000, shaper.waitUs(SHAPER_FLOW_MESSAGES, 32));
+}
+
+static void
+test_shaper_paces_a_write(void)
+{
+    shaping_config_t config {};
+    config.link.rate.num = 3200;
+    config.link.burst.num = 32;
+
+    RateShaper shaper;
+    shaper.configure(&config);
+
+    /* as abandonFile() does with its END payload, right after one of the file */
+    shaper.consume(SHAPER_FLOW_FILE, 32);
+    shaper.pace(SHAPER_FLOW_FILE, 32);
+    TEST_ASSERT_EQUAL_UINT32(1000 + 10000, now_us);
+    TEST_ASSERT_EQUAL_UINT32(10000, shaper.waitUs(SHAPER_FLOW_FILE, 32));
+}
+
+int
+main(void)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_unlimited_never_waits);
+    RUN_TEST(test_burst_then_rate);
+    RUN_TEST(test_wait_rounds_up);
+    RUN_TEST(test_refill_stops_at_burst);
+    RUN_TEST(test_zero_burst_is_one_payload);
+    RUN_TEST(test_send_larger_than_burst_waits_for_full);
+    RUN_TEST(test_micros_wrap);
+    RUN_TEST(test_shaper_charges_link_and_flow);
+    RUN_TEST(test_shaper_paces_a_write);
+    return UNITY_END();
+}